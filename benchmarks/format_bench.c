@@ -0,0 +1,199 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "../src/memtable.h"
+#include "../src/sstable.h"
+#include "../src/value_log.h"
+#include "../src/wal.h"
+
+#define WAL_FILE "format_bench.wal"           ///< Scratch WAL file.
+#define SSTABLE_FILE "format_bench-0.sstable" ///< Scratch SSTable file.
+#define VALUE_LOG_FILE "format_bench.vlog"    ///< Scratch ValueLog file.
+#define RECORDS (256 * 1024)                  ///< Number of writes per run.
+#define MIN_KEY_LEN 16                        ///< Shortest key.
+#define MAX_KEY_LEN 24                        ///< Longest key.
+#define DELETE_EVERY 16                       ///< One write in 16 deletes.
+
+/*
+ * Write amplification of the on-disk formats. Every run writes RECORDS random
+ * keys of 16 to 24 bytes, with values of a given size, to a ValueLog and a
+ * WAL, and flushes the MemTable of the distinct keys to a SSTable. The file
+ * sizes with the varint record headers are compared against the sizes the
+ * same records took with the fixed-size headers, along with the bytes each file
+ * takes per byte of keys and values written (WA). The time to replay the WAL
+ * shows the cost of decoding the varints.
+ */
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t
+next_random(uint64_t* state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static size_t
+file_size(const char* path)
+{
+  struct stat st;
+  if (stat(path, &st) == -1) {
+    perror("stat");
+    exit(1);
+  }
+  return (size_t)st.st_size;
+}
+
+static void
+report(const char* name, size_t fixed, size_t varint, size_t user)
+{
+  printf("%-10s %14zu %14zu %9.1f%% %10.2f %10.2f\n",
+         name,
+         fixed,
+         varint,
+         100.0 * (double)(fixed - varint) / (double)fixed,
+         (double)fixed / (double)user,
+         (double)varint / (double)user);
+}
+
+static void
+run(size_t value_len)
+{
+  remove(WAL_FILE);
+  remove(SSTABLE_FILE);
+  remove(VALUE_LOG_FILE);
+
+  struct ValueLog* log = ValueLog_new(VALUE_LOG_FILE, 0, 0);
+  struct WAL* wal = WAL_new(WAL_FILE, 1, 0);
+  struct MemTable* memtable = MemTable_new(SIZE_MAX);
+  if (log == NULL || wal == NULL) {
+    exit(1);
+  }
+
+  char* value = malloc(value_len);
+  memset(value, 'v', value_len);
+
+  uint64_t state = 0x9E3779B97F4A7C15ULL;
+  size_t user = 0;
+  size_t log_fixed = 0;
+  size_t wal_fixed = WAL_HEADER_SIZE;
+  for (size_t i = 0; i < RECORDS; i++) {
+    char key[MAX_KEY_LEN];
+    size_t key_len =
+      MIN_KEY_LEN + next_random(&state) % (MAX_KEY_LEN - MIN_KEY_LEN + 1);
+    for (size_t j = 0; j < key_len; j++) {
+      key[j] = (char)next_random(&state);
+    }
+
+    size_t pos;
+    int64_t value_loc = -1;
+    if (i % DELETE_EVERY == DELETE_EVERY - 1) {
+      if (ValueLog_append_tombstone(log, &pos, key, key_len) == -1) {
+        exit(1);
+      }
+      log_fixed += VALUE_LOG_ENTRY_HEADER_SIZE + key_len;
+      user += key_len;
+    } else {
+      if (ValueLog_append(log, &pos, key, key_len, value, value_len) == -1) {
+        exit(1);
+      }
+      log_fixed += VALUE_LOG_ENTRY_HEADER_SIZE + key_len + value_len;
+      user += key_len + value_len;
+      value_loc = (int64_t)pos;
+    }
+
+    if (WAL_append(wal, key, key_len, value_loc) == -1) {
+      exit(1);
+    }
+    wal_fixed += WAL_RECORD_HEADER_SIZE + key_len;
+    MemTable_set(memtable, key, key_len, value_loc);
+  }
+  if (ValueLog_sync(log) == -1) {
+    exit(1);
+  }
+  size_t wal_varint = wal->size;
+  WAL_free(wal);
+  free(value);
+
+  size_t sstable_fixed = 0;
+  struct MemTableIterator iter;
+  MemTableIterator_init(&iter, memtable);
+  struct MemTableRecord* record;
+  while ((record = MemTableIterator_next(&iter)) != NULL) {
+    sstable_fixed += sizeof(uint64_t) + sizeof(int64_t) + record->key_len;
+  }
+
+  struct SSTable* table = SSTable_new_from_memtable(SSTABLE_FILE, memtable);
+  if (table == NULL) {
+    exit(1);
+  }
+  SSTable_free(table);
+  MemTable_free(memtable);
+
+  printf("%zu byte values\n", value_len);
+  report("ValueLog", log_fixed, file_size(VALUE_LOG_FILE), user);
+  report("WAL", wal_fixed, wal_varint, user);
+  report("SSTable", sstable_fixed, file_size(SSTABLE_FILE), user);
+
+  memtable = MemTable_new(SIZE_MAX);
+  wal = WAL_open(WAL_FILE);
+  double start = now();
+  if (wal == NULL || WAL_load_memtable(wal, memtable) == -1) {
+    exit(1);
+  }
+  double elapsed = now() - start;
+  printf("WAL replay %.0f records/s\n\n", RECORDS / elapsed);
+  WAL_free(wal);
+  MemTable_free(memtable);
+  ValueLog_free(log);
+
+  remove(WAL_FILE);
+  remove(SSTABLE_FILE);
+  remove(VALUE_LOG_FILE);
+}
+
+int
+main()
+{
+  printf("%-10s %14s %14s %10s %10s %10s\n",
+         "file",
+         "fixed (B)",
+         "varint (B)",
+         "saved",
+         "fixed WA",
+         "varint WA");
+
+  size_t value_lens[] = { 16, 128, 1024 };
+  for (size_t i = 0; i < sizeof(value_lens) / sizeof(size_t); i++) {
+    run(value_lens[i]);
+  }
+
+  return 0;
+}
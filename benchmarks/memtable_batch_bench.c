@@ -0,0 +1,138 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/memtable.h"
+
+#define KEY_LEN 16 ///< Length of the benchmark keys.
+
+/*
+ * Bulk insert benchmark of MemTable_set_batch against one MemTable_set per
+ * key. Every run loads a MemTable with random keys in batches of a given
+ * size. Single-key sets shift the array tail on every insert, while a batch
+ * shifts it once.
+ */
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t
+next_random(uint64_t* state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static double
+load_single(const struct MemTableBatchEntry* entries, size_t records)
+{
+  struct MemTable* memtable = MemTable_new(SIZE_MAX);
+
+  double start = now();
+  for (size_t i = 0; i < records; i++) {
+    MemTable_set(
+      memtable, entries[i].key, entries[i].key_len, entries[i].value_loc);
+  }
+  double ms = (now() - start) * 1e3;
+
+  MemTable_free(memtable);
+  return ms;
+}
+
+static double
+load_batch(const struct MemTableBatchEntry* entries,
+           size_t records,
+           size_t batch_size)
+{
+  struct MemTable* memtable = MemTable_new(SIZE_MAX);
+
+  double start = now();
+  for (size_t i = 0; i < records; i += batch_size) {
+    size_t n = records - i < batch_size ? records - i : batch_size;
+    MemTable_set_batch(memtable, entries + i, n);
+  }
+  double ms = (now() - start) * 1e3;
+
+  if (memtable->size != records) {
+    printf("size mismatch: %zu != %zu\n", memtable->size, records);
+  }
+
+  MemTable_free(memtable);
+  return ms;
+}
+
+static void
+run(size_t records)
+{
+  uint64_t state = 0x9E3779B97F4A7C15ULL ^ records;
+
+  char* keys = malloc(records * KEY_LEN);
+  for (size_t i = 0; i < records * KEY_LEN; i++) {
+    keys[i] = (char)next_random(&state);
+  }
+
+  struct MemTableBatchEntry* entries =
+    malloc(records * sizeof(struct MemTableBatchEntry));
+  for (size_t i = 0; i < records; i++) {
+    entries[i].key = keys + i * KEY_LEN;
+    entries[i].key_len = KEY_LEN;
+    entries[i].value_loc = (int64_t)i;
+  }
+
+  double single_ms = load_single(entries, records);
+
+  size_t batches[] = { 16, 256, 4096 };
+  for (size_t i = 0; i < sizeof(batches) / sizeof(batches[0]); i++) {
+    double batch_ms = load_batch(entries, records, batches[i]);
+    printf("%10zu %10zu %14.1f %14.1f %8.1fx\n",
+           records,
+           batches[i],
+           single_ms,
+           batch_ms,
+           single_ms / batch_ms);
+  }
+
+  free(entries);
+  free(keys);
+}
+
+int
+main()
+{
+  size_t sizes[] = { 64 * 1024, 256 * 1024 };
+
+  printf("%10s %10s %14s %14s %9s\n",
+         "records",
+         "batch",
+         "single (ms)",
+         "batch (ms)",
+         "speedup");
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    run(sizes[i]);
+  }
+
+  return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/memtable.h"
+
+#define ROUNDS 512          ///< Number of MemTables filled per run.
+#define KEYS_PER_ROUND 1024 ///< Number of keys inserted per MemTable.
+#define KEY_LEN 16          ///< Length of the benchmark keys.
+#define MAX_THREADS 64      ///< Upper limit on the number of writer threads.
+
+/*
+ * Multi-threaded insert benchmark of the array MemTable against the lock-free
+ * SkipList MemTable. Every round fills a fresh MemTable with KEYS_PER_ROUND
+ * random keys split across the writer threads. The array MemTable isn't
+ * thread-safe, so its writers share a mutex.
+ */
+
+struct BenchArgs
+{
+  struct MemTable* memtable;
+  pthread_mutex_t* lock;
+  const char* keys;
+  size_t start;
+  size_t end;
+  pthread_barrier_t* barrier;
+};
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void*
+insert_keys(void* arg)
+{
+  struct BenchArgs* args = arg;
+
+  pthread_barrier_wait(args->barrier);
+  for (size_t i = args->start; i < args->end; i++) {
+    if (args->lock != NULL) {
+      pthread_mutex_lock(args->lock);
+    }
+    MemTable_set(
+      args->memtable, args->keys + i * KEY_LEN, KEY_LEN, (int64_t)i * 128);
+    if (args->lock != NULL) {
+      pthread_mutex_unlock(args->lock);
+    }
+  }
+
+  return NULL;
+}
+
+static double
+run(int concurrent, int threads, const char* keys, size_t keys_per_round)
+{
+  pthread_mutex_t lock;
+  pthread_mutex_init(&lock, NULL);
+
+  double elapsed = 0;
+  for (int round = 0; round < ROUNDS; round++) {
+    struct MemTable* memtable =
+      concurrent ? MemTable_new_concurrent(MEMTABLE_DEFAULT_BUDGET)
+                 : MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, threads + 1);
+
+    pthread_t tids[MAX_THREADS];
+    struct BenchArgs args[MAX_THREADS];
+    size_t per_thread = keys_per_round / (size_t)threads;
+    for (int t = 0; t < threads; t++) {
+      args[t].memtable = memtable;
+      args[t].lock = concurrent ? NULL : &lock;
+      args[t].keys = keys + round * keys_per_round * KEY_LEN;
+      args[t].start = (size_t)t * per_thread;
+      args[t].end = t == threads - 1 ? keys_per_round : (t + 1) * per_thread;
+      args[t].barrier = &barrier;
+      pthread_create(&tids[t], NULL, insert_keys, &args[t]);
+    }
+
+    double start = now();
+    pthread_barrier_wait(&barrier);
+    for (int t = 0; t < threads; t++) {
+      pthread_join(tids[t], NULL);
+    }
+    elapsed += now() - start;
+
+    pthread_barrier_destroy(&barrier);
+    MemTable_free(memtable);
+  }
+
+  pthread_mutex_destroy(&lock);
+  return (double)(keys_per_round * ROUNDS) / elapsed;
+}
+
+int
+main()
+{
+  size_t keys_per_round = KEYS_PER_ROUND;
+  char* keys = malloc(keys_per_round * ROUNDS * KEY_LEN);
+
+  uint64_t state = 0x9E3779B97F4A7C15ULL;
+  for (size_t i = 0; i < keys_per_round * ROUNDS * KEY_LEN; i++) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    keys[i] = (char)state;
+  }
+
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cores > MAX_THREADS) {
+    cores = MAX_THREADS;
+  }
+
+  printf("%-8s %18s %18s\n", "threads", "array (ops/s)", "skiplist (ops/s)");
+  for (int threads = 1; threads <= cores; threads *= 2) {
+    double array = run(0, threads, keys, keys_per_round);
+    double skiplist = run(1, threads, keys, keys_per_round);
+    printf("%-8d %18.0f %18.0f\n", threads, array, skiplist);
+  }
+
+  free(keys);
+  return 0;
+}
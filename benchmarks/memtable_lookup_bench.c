@@ -0,0 +1,198 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/common.h"
+#include "../src/hash_index.h"
+#include "../src/memtable.h"
+
+#define KEY_LEN 16        ///< Length of the benchmark keys.
+#define LOOKUPS (1 << 20) ///< Number of lookups per measurement.
+
+/*
+ * Point lookup benchmark of the array MemTable at 1K, 64K and 1M records.
+ * MemTable_get searches the inline key prefixes. It is compared against a
+ * binary search that follows the record pointer to the key on every probe,
+ * which is how the MemTable searched before the prefixes were added.
+ *
+ * The same lookups are then run against a MemTable with a HashIndex, along
+ * with the memory used by the HashIndex, its hit ratio and the average number
+ * of slots probed per lookup. The counters include the existence checks of
+ * the inserts that loaded the MemTable, which miss, along with the timed
+ * lookups, which hit.
+ *
+ * Two key sets are measured: random keys, where the prefix decides nearly
+ * every comparison, and keys that share their first 8 bytes, where every
+ * comparison falls back to the full key.
+ */
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t
+next_random(uint64_t* state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static struct MemTableRecord*
+pointer_search(const struct MemTable* memtable,
+               const char* key,
+               size_t key_len)
+{
+  int a = 0;
+  int b = (int)memtable->size - 1;
+
+  while (a <= b) {
+    int m = a + (b - a) / 2;
+
+    int cmp = WiscKey_key_cmp(
+      memtable->records[m]->key, memtable->records[m]->key_len, key, key_len);
+    if (cmp == 0) {
+      return memtable->records[m];
+    } else if (cmp < 0) {
+      b = m - 1;
+    } else {
+      a = m + 1;
+    }
+  }
+
+  return NULL;
+}
+
+static int
+key_cmp(const void* a, const void* b)
+{
+  return memcmp(a, b, KEY_LEN);
+}
+
+static void
+run(const char* name, size_t records, int shared_prefix)
+{
+  uint64_t state = 0x9E3779B97F4A7C15ULL ^ records;
+
+  char* keys = malloc(records * KEY_LEN);
+  for (size_t i = 0; i < records * KEY_LEN; i++) {
+    keys[i] = (char)next_random(&state);
+  }
+  if (shared_prefix) {
+    for (size_t i = 0; i < records; i++) {
+      memcpy(keys + i * KEY_LEN, "user:000", MEMTABLE_PREFIX_LEN);
+    }
+  }
+
+  // Insert in sorted order so loading a large MemTable is a series of
+  // appends instead of array shifts.
+  qsort(keys, records, KEY_LEN, key_cmp);
+
+  struct MemTable* memtable = MemTable_new(SIZE_MAX);
+  struct MemTable* hashed = MemTable_new(SIZE_MAX);
+  MemTable_enable_hash_index(hashed);
+  for (size_t i = 0; i < records; i++) {
+    MemTable_set(memtable, keys + i * KEY_LEN, KEY_LEN, (int64_t)i);
+    MemTable_set(hashed, keys + i * KEY_LEN, KEY_LEN, (int64_t)i);
+  }
+
+  size_t* order = malloc(LOOKUPS * sizeof(size_t));
+  for (size_t i = 0; i < LOOKUPS; i++) {
+    order[i] = next_random(&state) % records;
+  }
+
+  int64_t check = 0;
+  int64_t hash_check = 0;
+
+  double start = now();
+  for (size_t i = 0; i < LOOKUPS; i++) {
+    const char* key = keys + order[i] * KEY_LEN;
+    check += MemTable_get(memtable, key, KEY_LEN)->value_loc;
+  }
+  double prefix_ns = (now() - start) * 1e9 / LOOKUPS;
+
+  start = now();
+  for (size_t i = 0; i < LOOKUPS; i++) {
+    const char* key = keys + order[i] * KEY_LEN;
+    check -= pointer_search(memtable, key, KEY_LEN)->value_loc;
+  }
+  double pointer_ns = (now() - start) * 1e9 / LOOKUPS;
+
+  start = now();
+  for (size_t i = 0; i < LOOKUPS; i++) {
+    const char* key = keys + order[i] * KEY_LEN;
+    hash_check += MemTable_get(hashed, key, KEY_LEN)->value_loc;
+  }
+  double hash_ns = (now() - start) * 1e9 / LOOKUPS;
+
+  // The value of every key is its index in the sorted keys.
+  for (size_t i = 0; i < LOOKUPS; i++) {
+    hash_check -= (int64_t)order[i];
+  }
+
+  struct HashIndexStats stats;
+  MemTable_hash_index_stats(hashed, &stats);
+
+  printf("%-14s %10zu %16.1f %16.1f %16.1f %12.2f %8.1f %8.2f%s\n",
+         name,
+         records,
+         pointer_ns,
+         prefix_ns,
+         hash_ns,
+         (double)MemTable_hash_index_memory(hashed) / (1024 * 1024),
+         100.0 * (double)stats.hits / (double)stats.lookups,
+         (double)stats.probes / (double)stats.lookups,
+         check == 0 && hash_check == 0 ? "" : " (mismatch)");
+
+  MemTable_free(hashed);
+  MemTable_free(memtable);
+  free(order);
+  free(keys);
+}
+
+int
+main()
+{
+  size_t sizes[] = { 1024, 64 * 1024, 1024 * 1024 };
+
+  printf("%-14s %10s %16s %16s %16s %12s %8s %8s\n",
+         "keys",
+         "records",
+         "pointer (ns/op)",
+         "prefix (ns/op)",
+         "hash (ns/op)",
+         "index (MiB)",
+         "hits (%)",
+         "probes");
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    run("random", sizes[i], 0);
+  }
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    run("shared-prefix", sizes[i], 1);
+  }
+
+  return 0;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/value_log.h"
+
+#define BENCH_FILE "value_batch_bench.data" ///< Scratch ValueLog file.
+#define LOG_SIZE (256 * 1024 * 1024)        ///< Bytes of values written.
+#define KEY_LEN 16                          ///< Length of the keys.
+
+/*
+ * Appends to the ValueLog one entry at a time with ValueLog_append and in
+ * batches with ValueLog_append_batch. Short entries are gathered in the append
+ * buffer either way, so the batches mostly save the lock and the buffer
+ * copies. Entries larger than the buffer are written one `pwritev` each, and a
+ * batch writes them with one call.
+ */
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void
+run(size_t value_len, size_t batch_len)
+{
+  remove(BENCH_FILE);
+
+  struct ValueLog* log = ValueLog_new(BENCH_FILE, 0, 0);
+  size_t count = LOG_SIZE / value_len;
+  size_t* locs = malloc(count * sizeof(size_t));
+  char key[KEY_LEN];
+  char* value = malloc(value_len);
+  memset(key, 'k', sizeof(key));
+  memset(value, 'v', value_len);
+
+  struct ValueLogBatchEntry* entries =
+    malloc(batch_len * sizeof(struct ValueLogBatchEntry));
+  for (size_t i = 0; i < batch_len; i++) {
+    entries[i] = (struct ValueLogBatchEntry){ key, KEY_LEN, value, value_len };
+  }
+
+  double start = now();
+  for (size_t i = 0; i < count; i += batch_len) {
+    size_t n = count - i < batch_len ? count - i : batch_len;
+    int res = batch_len == 1
+                ? ValueLog_append(log, &locs[i], key, KEY_LEN, value, value_len)
+                : ValueLog_append_batch(log, &locs[i], entries, n);
+    if (res == -1) {
+      fprintf(stderr, "append failed\n");
+      exit(1);
+    }
+  }
+  if (ValueLog_sync(log) == -1) {
+    fprintf(stderr, "sync failed\n");
+    exit(1);
+  }
+  double elapsed = now() - start;
+
+  printf("%10zu %8zu %14.0f %10.0f\n",
+         value_len,
+         batch_len,
+         count / elapsed,
+         (double)LOG_SIZE / (1024 * 1024) / elapsed);
+
+  free(entries);
+  free(value);
+  free(locs);
+  ValueLog_free(log);
+  remove(BENCH_FILE);
+}
+
+int
+main()
+{
+  printf("%10s %8s %14s %10s\n", "value", "batch", "appends/s", "MB/s");
+
+  size_t value_lens[] = { 256, 4 * 1024, 128 * 1024 };
+  size_t batch_lens[] = { 1, 16, 256 };
+  for (size_t v = 0; v < sizeof(value_lens) / sizeof(value_lens[0]); v++) {
+    for (size_t b = 0; b < sizeof(batch_lens) / sizeof(batch_lens[0]); b++) {
+      run(value_lens[v], batch_lens[b]);
+    }
+  }
+
+  return 0;
+}
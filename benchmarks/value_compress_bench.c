@@ -0,0 +1,159 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "../src/codec.h"
+#include "../src/value_log.h"
+
+#define BENCH_FILE "value_compress_bench.data" ///< Scratch ValueLog file.
+#define VALUES (32 * 1024)                     ///< Values written per run.
+#define READS (128 * 1024)                     ///< Random reads per run.
+#define KEY_LEN 16                             ///< Length of the keys.
+
+/*
+ * Appends and random reads of JSON-like and random values in the ValueLog
+ * with each codec that is built in. The size of the file shows how much the
+ * values shrink, and random values show the cost of trying to compress a value
+ * that is then stored as it is.
+ */
+
+static volatile uint64_t sink; ///< Keeps the reads from being optimized out.
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void
+make_json(char* buf, size_t len, uint32_t seed)
+{
+  size_t n = 0;
+  for (uint32_t i = seed; n < len; i++) {
+    char record[128];
+    int record_len = snprintf(record,
+                              sizeof(record),
+                              "{\"id\":%u,\"name\":\"user-%u\",\"active\":%s},",
+                              i * 7919,
+                              i % 97,
+                              i % 3 == 0 ? "true" : "false");
+    size_t copy = (size_t)record_len < len - n ? (size_t)record_len : len - n;
+    memcpy(buf + n, record, copy);
+    n += copy;
+  }
+}
+
+static void
+run(const char* name, int codec, size_t value_len, int json)
+{
+  remove(BENCH_FILE);
+
+  struct ValueLog* log = ValueLog_new(BENCH_FILE, 0, 0);
+  ValueLog_set_compression(log, codec, 64, 1.1);
+
+  size_t* locs = malloc(VALUES * sizeof(size_t));
+  char key[KEY_LEN];
+  char* value = malloc(value_len);
+  memset(key, 'k', sizeof(key));
+  srand(1);
+
+  double elapsed = 0;
+  for (size_t i = 0; i < VALUES; i++) {
+    if (json) {
+      make_json(value, value_len, (uint32_t)i);
+    } else {
+      for (size_t j = 0; j < value_len; j++) {
+        value[j] = (char)(rand() & 0xFF);
+      }
+    }
+    double start = now();
+    if (ValueLog_append(log, &locs[i], key, KEY_LEN, value, value_len) == -1) {
+      fprintf(stderr, "append failed\n");
+      exit(1);
+    }
+    elapsed += now() - start;
+  }
+  ValueLog_sync(log);
+  double append = elapsed;
+
+  struct stat st;
+  stat(BENCH_FILE, &st);
+
+  uint64_t sum = 0;
+  double start = now();
+  for (size_t i = 0; i < READS; i++) {
+    size_t len;
+    if (ValueLog_read(log,
+                      value,
+                      value_len,
+                      &len,
+                      locs[(size_t)rand() % VALUES]) == -1) {
+      fprintf(stderr, "read failed\n");
+      exit(1);
+    }
+    sum += (uint8_t)value[len - 1];
+  }
+  double read = now() - start;
+
+  double mb = (double)value_len / (1024 * 1024);
+  printf("%-6s %-7s %8zu %10.1f %12.0f %12.0f\n",
+         name,
+         json ? "json" : "random",
+         value_len,
+         (double)st.st_size / (1024 * 1024),
+         VALUES * mb / append,
+         READS * mb / read);
+  sink = sum;
+
+  free(value);
+  free(locs);
+  ValueLog_free(log);
+  remove(BENCH_FILE);
+}
+
+int
+main()
+{
+  printf("%-6s %-7s %8s %10s %12s %12s\n",
+         "codec",
+         "values",
+         "value",
+         "file MB",
+         "append MB/s",
+         "read MB/s");
+
+  const char* names[] = { "none", "lz", "zlib", "zstd" };
+  int codecs[] = { CODEC_NONE, CODEC_LZ, CODEC_ZLIB, CODEC_ZSTD };
+  size_t value_lens[] = { 256, 4096 };
+  for (size_t l = 0; l < sizeof(value_lens) / sizeof(value_lens[0]); l++) {
+    for (int json = 1; json >= 0; json--) {
+      for (size_t c = 0; c < sizeof(codecs) / sizeof(codecs[0]); c++) {
+        if (Codec_supported(codecs[c])) {
+          run(names[c], codecs[c], value_lens[l], json);
+        }
+      }
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/value_log.h"
+
+#define BENCH_FILE "value_read_bench.data" ///< Scratch ValueLog file.
+#define LOG_SIZE (256 * 1024 * 1024)       ///< Bytes of values written.
+#define READS (256 * 1024)                 ///< Random reads per run.
+#define KEY_LEN 16                         ///< Length of the keys.
+
+/*
+ * Random value reads from the ValueLog, which is small enough to stay in the
+ * page cache. Each value is read five ways: into a new allocation with
+ * ValueLog_get, into a reused buffer with ValueLog_read, both again with the
+ * length of the entry and its key, which read the whole entry at once and check
+ * the key, and as a pinned slice of a mapping with ValueLog_get_slice, whose
+ * bytes are summed so the pages are touched.
+ */
+
+static volatile uint64_t sink; ///< Keeps the reads from being optimized out.
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void
+run(size_t value_len)
+{
+  remove(BENCH_FILE);
+
+  struct ValueLog* log = ValueLog_new(BENCH_FILE, 0, 0);
+  size_t count = LOG_SIZE / value_len;
+  size_t* locs = malloc(count * sizeof(size_t));
+  char key[KEY_LEN];
+  char* value = malloc(value_len);
+  memset(key, 'k', sizeof(key));
+  memset(value, 'v', value_len);
+  for (size_t i = 0; i < count; i++) {
+    if (ValueLog_append(log, &locs[i], key, KEY_LEN, value, value_len) == -1) {
+      fprintf(stderr, "append failed\n");
+      exit(1);
+    }
+  }
+  ValueLog_sync(log);
+  size_t size = log->head - locs[count - 1];
+
+  size_t* order = malloc(READS * sizeof(size_t));
+  srand(1);
+  for (size_t i = 0; i < READS; i++) {
+    order[i] = locs[(size_t)rand() % count];
+  }
+
+  uint64_t sum = 0;
+  double start = now();
+  for (size_t i = 0; i < READS; i++) {
+    char* read;
+    size_t len;
+    if (ValueLog_get(log, &read, &len, order[i]) == -1) {
+      exit(1);
+    }
+    sum += (uint8_t)read[len - 1];
+    free(read);
+  }
+  double get = now() - start;
+
+  start = now();
+  for (size_t i = 0; i < READS; i++) {
+    size_t len;
+    if (ValueLog_read(log, value, value_len, &len, order[i]) == -1) {
+      exit(1);
+    }
+    sum += (uint8_t)value[len - 1];
+  }
+  double read = now() - start;
+
+  start = now();
+  for (size_t i = 0; i < READS; i++) {
+    char* read;
+    size_t len;
+    if (ValueLog_get_sized(
+          log, &read, &len, order[i], size, key, KEY_LEN) == -1) {
+      exit(1);
+    }
+    sum += (uint8_t)read[len - 1];
+    free(read);
+  }
+  double get_sized = now() - start;
+
+  start = now();
+  for (size_t i = 0; i < READS; i++) {
+    size_t len;
+    if (ValueLog_read_sized(
+          log, value, value_len, &len, order[i], size, key, KEY_LEN) == -1) {
+      exit(1);
+    }
+    sum += (uint8_t)value[len - 1];
+  }
+  double read_sized = now() - start;
+
+  start = now();
+  for (size_t i = 0; i < READS; i++) {
+    struct ValueLogSlice slice;
+    if (ValueLog_get_slice(log, &slice, order[i]) == -1) {
+      exit(1);
+    }
+    for (size_t j = 0; j < slice.len; j += 64) {
+      sum += (uint8_t)slice.data[j];
+    }
+    ValueLog_release_slice(log, &slice);
+  }
+  double slice = now() - start;
+
+  printf("%10zu %14.0f %14.0f %14.0f %14.0f %14.0f\n",
+         value_len,
+         READS / get,
+         READS / read,
+         READS / get_sized,
+         READS / read_sized,
+         READS / slice);
+  sink = sum;
+
+  free(order);
+  free(value);
+  free(locs);
+  ValueLog_free(log);
+  remove(BENCH_FILE);
+}
+
+int
+main()
+{
+  printf("%10s %14s %14s %14s %14s %14s\n",
+         "value",
+         "get/s",
+         "read/s",
+         "get sized/s",
+         "read sized/s",
+         "slice/s");
+
+  run(256);
+  run(1024);
+  run(4 * 1024);
+  run(16 * 1024);
+  run(64 * 1024);
+
+  return 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/memtable.h"
+#include "../src/wal.h"
+
+#define BENCH_FILE "wal_replay_bench.wal" ///< Scratch WAL file.
+#define KEY_LEN 16                        ///< Length of the benchmark keys.
+#define DISTINCT_KEYS (64 * 1024)         ///< Number of distinct keys.
+#define DEFAULT_MIB 1024                  ///< Default size of the WAL.
+
+/*
+ * WAL recovery benchmark. Writes a WAL of the given size in MiB (1 GiB by
+ * default) and replays it into a MemTable, reporting MB/s and records/s. The
+ * records overwrite a fixed set of random keys, so the MemTable stays small
+ * while the WAL grows to several GB.
+ *
+ * The mmap replay of WAL_load_memtable is compared against a replay through
+ * stdio that peeks and reads every record with fgetc and fread, which is how
+ * the WAL was replayed before. The mmap replay is measured again into a
+ * MemTable with a HashIndex, which is how the database recovers its WALs. The
+ * WAL was just written, so every replay reads it from the page cache.
+ */
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t
+next_random(uint64_t* state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static int
+read_varint(FILE* file, uint64_t* value)
+{
+  *value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int byte = fgetc(file);
+    if (byte == EOF) {
+      return -1;
+    }
+    *value |= (uint64_t)(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return 0;
+    }
+  }
+  return -1;
+}
+
+static int
+stdio_replay(const char* path, struct MemTable* memtable)
+{
+  FILE* file = fopen(path, "r");
+  if (file == NULL || fseek(file, WAL_HEADER_SIZE, SEEK_SET) == -1) {
+    return -1;
+  }
+
+  while (1) {
+    int peek = fgetc(file);
+    ungetc(peek, file);
+    if (peek == EOF) {
+      break;
+    }
+
+    uint32_t crc;
+    uint64_t key_len;
+    uint64_t value_loc;
+    if (fread(&crc, sizeof(uint32_t), 1, file) != 1 ||
+        read_varint(file, &key_len) == -1 ||
+        read_varint(file, &value_loc) == -1) {
+      fclose(file);
+      return -1;
+    }
+
+    char key[key_len];
+    if (fread(&key, sizeof(char), key_len, file) != key_len) {
+      fclose(file);
+      return -1;
+    }
+
+    if (value_loc == 0) {
+      MemTable_delete(memtable, key, key_len);
+    } else {
+      MemTable_set(memtable, key, key_len, (int64_t)value_loc - 1);
+    }
+  }
+
+  fclose(file);
+  return 0;
+}
+
+static void
+report(const char* name, size_t bytes, size_t records, double elapsed)
+{
+  printf("%-10s %12.1f %14.0f\n",
+         name,
+         (double)bytes / elapsed / 1e6,
+         (double)records / elapsed);
+}
+
+int
+main(int argc, char** argv)
+{
+  size_t mib = argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_MIB;
+  size_t target = mib * 1024 * 1024;
+
+  uint64_t state = 0x9E3779B97F4A7C15ULL;
+  char* keys = malloc(DISTINCT_KEYS * KEY_LEN);
+  for (size_t i = 0; i < DISTINCT_KEYS * KEY_LEN; i++) {
+    keys[i] = (char)next_random(&state);
+  }
+
+  remove(BENCH_FILE);
+  struct WAL* wal = WAL_new(BENCH_FILE, 1, 0);
+  if (wal == NULL) {
+    return 1;
+  }
+  size_t records = 0;
+  for (; wal->size < target; records++) {
+    const char* key = keys + (next_random(&state) % DISTINCT_KEYS) * KEY_LEN;
+    int64_t value_loc = records % 16 == 0 ? -1 : (int64_t)records;
+    if (WAL_append(wal, key, KEY_LEN, value_loc) == -1) {
+      return 1;
+    }
+  }
+  size_t bytes = wal->size - WAL_HEADER_SIZE;
+  WAL_free(wal);
+
+  printf("WAL of %.1f MB with %zu records\n\n", (double)bytes / 1e6, records);
+  printf("%-10s %12s %14s\n", "replay", "MB/s", "records/s");
+
+  struct MemTable* memtable = MemTable_new(SIZE_MAX);
+  double start = now();
+  if (stdio_replay(BENCH_FILE, memtable) == -1) {
+    return 1;
+  }
+  report("stdio", bytes, records, now() - start);
+  MemTable_free(memtable);
+
+  memtable = MemTable_new(SIZE_MAX);
+  wal = WAL_open(BENCH_FILE);
+  start = now();
+  if (WAL_load_memtable(wal, memtable) == -1) {
+    return 1;
+  }
+  report("mmap", bytes, records, now() - start);
+  WAL_free(wal);
+  MemTable_free(memtable);
+
+  memtable = MemTable_new(SIZE_MAX);
+  MemTable_enable_hash_index(memtable);
+  wal = WAL_open(BENCH_FILE);
+  start = now();
+  if (WAL_load_memtable(wal, memtable) == -1) {
+    return 1;
+  }
+  report("mmap+hash", bytes, records, now() - start);
+  WAL_free(wal);
+  MemTable_free(memtable);
+
+  remove(BENCH_FILE);
+  free(keys);
+
+  return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/wal.h"
+
+#define BENCH_FILE "wal_sync_bench.wal" ///< Scratch WAL file.
+#define RECORDS (8 * 1024)              ///< Number of synced records per run.
+#define KEY_LEN 16                      ///< Length of the benchmark keys.
+#define MAX_THREADS 64                  ///< Limit on writer threads.
+#define SEGMENT_SIZE                                                           \
+  (RECORDS * (WAL_RECORD_MAX_HEADER_SIZE + KEY_LEN)) ///< Size of a segment.
+
+/*
+ * Synced write benchmark of the WAL. Every writer appends a record and waits
+ * for it to be on disk before writing the next one. Group commit lets
+ * concurrent writers share a sync. It is compared against writers that hold a
+ * lock across their append and sync, which costs one sync per record. Group
+ * commit is also run with the syncs submitted through io_uring, which reports 0
+ * if WiscKey was built without liburing.
+ *
+ * A single synced writer is then run against a WAL that grows with every
+ * append, a freshly preallocated segment, and a recycled segment whose blocks
+ * have been written before.
+ */
+
+struct BenchArgs
+{
+  struct WAL* wal;
+  pthread_mutex_t* lock;
+  size_t records;
+};
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void*
+write_records(void* arg)
+{
+  struct BenchArgs* args = arg;
+
+  char key[KEY_LEN] = { 0 };
+  for (size_t i = 0; i < args->records; i++) {
+    if (args->lock != NULL) {
+      pthread_mutex_lock(args->lock);
+    }
+
+    if (WAL_append(args->wal, key, KEY_LEN, (int64_t)i) == -1 ||
+        WAL_sync(args->wal) == -1) {
+      fprintf(stderr, "write failed\n");
+      exit(1);
+    }
+
+    if (args->lock != NULL) {
+      pthread_mutex_unlock(args->lock);
+    }
+  }
+
+  return NULL;
+}
+
+static double
+run(size_t threads, int serial, int uring, double* records_per_sync)
+{
+  remove(BENCH_FILE);
+  struct WAL* wal = WAL_new(BENCH_FILE, 1, 0);
+  if (wal == NULL) {
+    exit(1);
+  }
+  if (uring && WAL_enable_io_uring(wal) == -1) {
+    WAL_free(wal);
+    remove(BENCH_FILE);
+    return 0;
+  }
+
+  pthread_mutex_t lock;
+  pthread_mutex_init(&lock, NULL);
+
+  pthread_t tids[MAX_THREADS];
+  struct BenchArgs args[MAX_THREADS];
+
+  double start = now();
+  for (size_t i = 0; i < threads; i++) {
+    args[i].wal = wal;
+    args[i].lock = serial ? &lock : NULL;
+    args[i].records = RECORDS / threads;
+    pthread_create(&tids[i], NULL, write_records, &args[i]);
+  }
+  for (size_t i = 0; i < threads; i++) {
+    pthread_join(tids[i], NULL);
+  }
+  double elapsed = now() - start;
+
+  *records_per_sync = (double)wal->appended / (double)wal->syncs;
+  double ops = (double)wal->appended / elapsed;
+
+  pthread_mutex_destroy(&lock);
+  WAL_free(wal);
+  remove(BENCH_FILE);
+
+  return ops;
+}
+
+static double
+run_segment(size_t segment_size, int recycle)
+{
+  remove(BENCH_FILE);
+  if (recycle) {
+    // Write the whole segment once so its blocks are allocated and written.
+    struct WAL* wal = WAL_new(BENCH_FILE, 1, segment_size);
+    struct BenchArgs args = { wal, NULL, RECORDS };
+    write_records(&args);
+    WAL_free(wal);
+  }
+
+  struct WAL* wal = WAL_new(BENCH_FILE, 2, segment_size);
+  if (wal == NULL) {
+    exit(1);
+  }
+
+  struct BenchArgs args = { wal, NULL, RECORDS };
+  double start = now();
+  write_records(&args);
+  double elapsed = now() - start;
+
+  WAL_free(wal);
+  remove(BENCH_FILE);
+
+  return (double)RECORDS / elapsed;
+}
+
+int
+main()
+{
+  printf("%8s %16s %16s %16s %16s\n",
+         "threads",
+         "serial (op/s)",
+         "group (op/s)",
+         "io_uring (op/s)",
+         "records/sync");
+  for (size_t threads = 1; threads <= 32; threads *= 2) {
+    double records_per_sync;
+    double serial = run(threads, 1, 0, &records_per_sync);
+    double uring = run(threads, 0, 1, &records_per_sync);
+    double group = run(threads, 0, 0, &records_per_sync);
+    printf("%8zu %16.0f %16.0f %16.0f %16.1f\n",
+           threads,
+           serial,
+           group,
+           uring,
+           records_per_sync);
+  }
+
+  printf("\n%-12s %16s\n", "segment", "synced (op/s)");
+  printf("%-12s %16.0f\n", "growing", run_segment(0, 0));
+  printf("%-12s %16.0f\n", "preallocated", run_segment(SEGMENT_SIZE, 0));
+  printf("%-12s %16.0f\n", "recycled", run_segment(SEGMENT_SIZE, 1));
+
+  return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/wisckey.h"
+
+#define BENCH_DIR "wisckey_cache_bench.db" ///< Scratch database directory.
+#define KEYS (128 * 1024)                  ///< Number of keys loaded.
+#define READS (1024 * 1024)                ///< Reads per run.
+#define HOT_KEYS (KEYS / 10)               ///< Keys that take HOT_PERCENT.
+#define HOT_PERCENT 90                     ///< Share of reads of hot keys.
+#define KEY_LEN 16                         ///< Length of the benchmark keys.
+#define VALUE_LEN 1024                     ///< Length of the values.
+
+/*
+ * Skewed point reads through the value cache. HOT_PERCENT of the reads go to
+ * the first HOT_KEYS keys and the rest are spread over all of them. The reads
+ * run with the cache off and with caches sized relative to the hot set, and
+ * the hit rate and evictions show how well each size covers the working set.
+ */
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void
+remove_dir(const char* path)
+{
+  DIR* dir = opendir(path);
+  if (dir == NULL) {
+    return;
+  }
+
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    char file[512];
+    snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+    remove(file);
+  }
+  closedir(dir);
+
+  rmdir(path);
+}
+
+static void
+run(const char* name, size_t cache_size)
+{
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.value_cache_size = cache_size;
+
+  struct WiscKeyDB* db = WiscKeyDB_open(BENCH_DIR, &options);
+  if (db == NULL) {
+    fprintf(stderr, "open failed\n");
+    exit(1);
+  }
+
+  char key[KEY_LEN + 1];
+  char value[VALUE_LEN];
+  srand(1);
+  double start = now();
+  for (size_t i = 0; i < READS; i++) {
+    int k = rand() % 100 < HOT_PERCENT ? rand() % HOT_KEYS : rand() % KEYS;
+    snprintf(key, sizeof(key), "key-%011d", k);
+    if (WiscKeyDB_get(db, value, key, KEY_LEN) != VALUE_LEN) {
+      fprintf(stderr, "read failed\n");
+      exit(1);
+    }
+  }
+  double elapsed = now() - start;
+
+  struct WiscKeyDBCacheStats stats;
+  WiscKeyDB_cache_stats(db, &stats);
+  WiscKeyDB_free(db);
+
+  size_t lookups = stats.hits + stats.misses;
+  printf("%-10s %12.0f %10.1f %12zu %12.1f\n",
+         name,
+         READS / elapsed,
+         lookups > 0 ? 100.0 * (double)stats.hits / (double)lookups : 0.0,
+         stats.evictions,
+         (double)stats.size / 1e6);
+}
+
+int
+main()
+{
+  remove_dir(BENCH_DIR);
+
+  struct WiscKeyDB* db = WiscKeyDB_new(BENCH_DIR);
+  if (db == NULL) {
+    fprintf(stderr, "open failed\n");
+    return 1;
+  }
+
+  char key[KEY_LEN + 1];
+  char value[VALUE_LEN];
+  memset(value, 'v', sizeof(value));
+  for (int i = 0; i < KEYS; i++) {
+    snprintf(key, sizeof(key), "key-%011d", i);
+    if (WiscKeyDB_set(db, key, value, KEY_LEN, VALUE_LEN) == -1) {
+      fprintf(stderr, "write failed\n");
+      return 1;
+    }
+  }
+  WiscKeyDB_free(db);
+
+  printf("%-10s %12s %10s %12s %12s\n",
+         "cache",
+         "reads/s",
+         "hits (%)",
+         "evictions",
+         "cached (MB)");
+
+  size_t hot_size = (size_t)HOT_KEYS * VALUE_LEN;
+  run("off", 0);
+  run("hot/2", hot_size / 2);
+  run("hot", hot_size);
+  run("2*hot", 2 * hot_size);
+
+  remove_dir(BENCH_DIR);
+
+  return 0;
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <dirent.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/wisckey.h"
+
+#define BENCH_DIR "wisckey_gc_bench.db" ///< Scratch database directory.
+#define KEYS (16 * 1024)                ///< Number of distinct keys.
+#define ROUNDS 32                       ///< Times every key is overwritten.
+#define KEY_LEN 16                      ///< Length of the benchmark keys.
+#define VALUE_LEN 1024                  ///< Length of the values.
+#define GC_RATE (64 * 1024 * 1024)      ///< Rate of the throttled collector.
+#define SEGMENT_SIZE (4 * 1024 * 1024)  ///< Size of the ValueLog segments.
+
+/*
+ * Foreground cost of the ValueLog garbage collector. A writer overwrites KEYS
+ * keys ROUNDS times, so most of the ValueLog is garbage, and the latency of
+ * every write is recorded. The writer runs without a collector, with the
+ * rate-limited background thread, and next to a thread that runs unthrottled
+ * passes with WiscKeyDB_gc back to back, both with a single ValueLog file and
+ * with segments. The space the ValueLog takes on disk at the end shows what the
+ * collector reclaimed.
+ */
+
+struct GCArgs
+{
+  struct WiscKeyDB* db; ///< The database to collect.
+  volatile int done;    ///< Set once the writer has finished.
+};
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void
+remove_dir(const char* path)
+{
+  DIR* dir = opendir(path);
+  if (dir == NULL) {
+    return;
+  }
+
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    char file[512];
+    snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+    remove(file);
+  }
+  closedir(dir);
+
+  rmdir(path);
+}
+
+static int
+double_cmp(const void* a, const void* b)
+{
+  double lhs = *(const double*)a;
+  double rhs = *(const double*)b;
+  return lhs < rhs ? -1 : lhs > rhs;
+}
+
+static void*
+collect(void* arg)
+{
+  struct GCArgs* args = arg;
+  while (!args->done) {
+    if (WiscKeyDB_gc(args->db) == -1) {
+      fprintf(stderr, "gc failed\n");
+      exit(1);
+    }
+  }
+
+  return NULL;
+}
+
+/*
+ * Bytes allocated on disk by the ValueLog file or segments.
+ */
+static size_t
+value_log_on_disk()
+{
+  DIR* dir = opendir(BENCH_DIR);
+  if (dir == NULL) {
+    return 0;
+  }
+
+  size_t allocated = 0;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    size_t len = strlen(entry->d_name);
+    if (strcmp(entry->d_name, "value.log") == 0 ||
+        (len > 5 && strcmp(entry->d_name + len - 5, ".vlog") == 0)) {
+      char file[512];
+      snprintf(file, sizeof(file), "%s/%s", BENCH_DIR, entry->d_name);
+      struct stat st;
+      if (stat(file, &st) == 0) {
+        allocated += (size_t)st.st_blocks * 512;
+      }
+    }
+  }
+  closedir(dir);
+
+  return allocated;
+}
+
+static void
+run(const char* name, size_t gc_rate, int gc_thread, size_t segment)
+{
+  remove_dir(BENCH_DIR);
+
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.value_log_gc_rate = gc_rate;
+  options.value_log_segment = segment;
+
+  struct WiscKeyDB* db = WiscKeyDB_open(BENCH_DIR, &options);
+  if (db == NULL) {
+    fprintf(stderr, "open failed\n");
+    exit(1);
+  }
+
+  struct GCArgs args = { db, 0 };
+  pthread_t tid;
+  if (gc_thread && pthread_create(&tid, NULL, collect, &args) != 0) {
+    exit(1);
+  }
+
+  size_t writes = (size_t)KEYS * ROUNDS;
+  double* latencies = malloc(writes * sizeof(double));
+  char key[KEY_LEN + 1];
+  char value[VALUE_LEN];
+  memset(value, 'v', sizeof(value));
+
+  double start = now();
+  for (size_t i = 0; i < writes; i++) {
+    snprintf(key, sizeof(key), "key-%011zu", i % KEYS);
+    double write_start = now();
+    if (WiscKeyDB_set(db, key, value, KEY_LEN, VALUE_LEN) == -1) {
+      fprintf(stderr, "write failed\n");
+      exit(1);
+    }
+    latencies[i] = now() - write_start;
+  }
+  double elapsed = now() - start;
+
+  args.done = 1;
+  if (gc_thread) {
+    pthread_join(tid, NULL);
+  }
+
+  size_t on_disk = value_log_on_disk();
+  WiscKeyDB_free(db);
+
+  qsort(latencies, writes, sizeof(double), double_cmp);
+  printf("%-12s %12.0f %10.1f %10.1f %10.1f %12.1f\n",
+         name,
+         (double)writes / elapsed,
+         latencies[writes / 2] * 1e6,
+         latencies[writes * 99 / 100] * 1e6,
+         latencies[writes * 999 / 1000] * 1e6,
+         (double)on_disk / 1e6);
+
+  free(latencies);
+  remove_dir(BENCH_DIR);
+}
+
+int
+main()
+{
+  printf("%-12s %12s %10s %10s %10s %12s\n",
+         "gc",
+         "writes/s",
+         "p50 (us)",
+         "p99 (us)",
+         "p99.9 (us)",
+         "on disk (MB)");
+
+  run("off", 0, 0, 0);
+  run("throttled", GC_RATE, 0, 0);
+  run("unthrottled", 0, 1, 0);
+  run("seg/throt", GC_RATE, 0, SEGMENT_SIZE);
+  run("seg/unthrot", 0, 1, SEGMENT_SIZE);
+
+  return 0;
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/wisckey.h"
+
+#define BENCH_DIR "wisckey_inline_bench.db" ///< Scratch database directory.
+#define KEYS (32 * 1024)                    ///< Number of keys written.
+#define READS (256 * 1024)                  ///< Random reads per run.
+#define KEY_LEN 16                          ///< Length of the benchmark keys.
+#define MAX_VALUE_LEN 4096                  ///< Length of the largest values.
+
+/*
+ * Writes, random reads and a full scan with values of several sizes, once
+ * with every value in the ValueLog and once with every value inline in the
+ * LSM-tree. The reads and the scan run after a restart, so every key is in a
+ * SSTable. Inline values save the second read of a get and the ValueLog reads
+ * of a scan, while separated values keep the SSTables small.
+ */
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void
+remove_dir(const char* path)
+{
+  DIR* dir = opendir(path);
+  if (dir == NULL) {
+    return;
+  }
+
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    char file[512];
+    snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+    remove(file);
+  }
+  closedir(dir);
+
+  rmdir(path);
+}
+
+static struct WiscKeyDB*
+open_db(size_t inline_value_size)
+{
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.inline_value_size = inline_value_size;
+
+  struct WiscKeyDB* db = WiscKeyDB_open(BENCH_DIR, &options);
+  if (db == NULL) {
+    fprintf(stderr, "open failed\n");
+    exit(1);
+  }
+
+  return db;
+}
+
+static void
+run(size_t value_len, size_t inline_value_size)
+{
+  remove_dir(BENCH_DIR);
+
+  char key[KEY_LEN + 1];
+  char value[MAX_VALUE_LEN];
+  memset(value, 'v', sizeof(value));
+
+  struct WiscKeyDB* db = open_db(inline_value_size);
+  double start = now();
+  for (int i = 0; i < KEYS; i++) {
+    snprintf(key, sizeof(key), "key-%011d", i);
+    if (WiscKeyDB_set(db, key, value, KEY_LEN, value_len) == -1) {
+      fprintf(stderr, "write failed\n");
+      exit(1);
+    }
+  }
+  double write_elapsed = now() - start;
+  WiscKeyDB_free(db);
+
+  db = open_db(inline_value_size);
+  srand(1);
+  start = now();
+  for (int i = 0; i < READS; i++) {
+    snprintf(key, sizeof(key), "key-%011d", rand() % KEYS);
+    if (WiscKeyDB_get_into(db, value, sizeof(value), key, KEY_LEN) !=
+        value_len) {
+      fprintf(stderr, "read failed\n");
+      exit(1);
+    }
+  }
+  double read_elapsed = now() - start;
+
+  start = now();
+  struct WiscKeyDBScan* scan = WiscKeyDB_scan(db, NULL, 0, NULL, 0);
+  const char* scan_key;
+  size_t scan_key_len;
+  const char* scan_value;
+  size_t scan_value_len;
+  size_t scanned = 0;
+  while (WiscKeyDBScan_next(
+           scan, &scan_key, &scan_key_len, &scan_value, &scan_value_len) ==
+         1) {
+    scanned++;
+  }
+  WiscKeyDBScan_free(scan);
+  double scan_elapsed = now() - start;
+  WiscKeyDB_free(db);
+
+  if (scanned != KEYS) {
+    fprintf(stderr, "scan failed\n");
+    exit(1);
+  }
+
+  printf("%-8zu %-10s %12.0f %12.0f %12.0f\n",
+         value_len,
+         inline_value_size > value_len ? "inline" : "separated",
+         KEYS / write_elapsed,
+         READS / read_elapsed,
+         KEYS / scan_elapsed);
+}
+
+int
+main()
+{
+  printf("%-8s %-10s %12s %12s %12s\n",
+         "value",
+         "mode",
+         "writes/s",
+         "reads/s",
+         "scan keys/s");
+
+  size_t value_lens[] = { 16, 64, 256, 1024, MAX_VALUE_LEN };
+  for (size_t i = 0; i < sizeof(value_lens) / sizeof(value_lens[0]); i++) {
+    run(value_lens[i], 0);
+    run(value_lens[i], MAX_VALUE_LEN + 1);
+  }
+
+  remove_dir(BENCH_DIR);
+
+  return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <dirent.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/wisckey.h"
+
+#define BENCH_DIR "wisckey_read_bench.db" ///< Scratch database directory.
+#define KEYS (256 * 1024)                 ///< Number of keys loaded.
+#define READS (256 * 1024)                ///< Random reads per thread.
+#define KEY_LEN 16                        ///< Length of the benchmark keys.
+#define VALUE_LEN 256                     ///< Length of the values.
+#define MAX_THREADS 16                    ///< Most reader threads run.
+
+/*
+ * Random point reads from several threads. The database is loaded and
+ * reopened, so the keys are found in the SSTables and the values in the
+ * ValueLog, both read with `pread`. Every thread reads READS random keys, once
+ * on its own and once behind a lock shared by all readers, which is how reads
+ * on a shared file position have to be serialized.
+ */
+
+struct ReaderArgs
+{
+  struct WiscKeyDB* db;  ///< The database to read from.
+  pthread_mutex_t* lock; ///< Lock taken around every read or NULL.
+  unsigned int seed;     ///< Seed of the random keys.
+};
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void
+remove_dir(const char* path)
+{
+  DIR* dir = opendir(path);
+  if (dir == NULL) {
+    return;
+  }
+
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    char file[512];
+    snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+    remove(file);
+  }
+  closedir(dir);
+
+  rmdir(path);
+}
+
+static void*
+read_keys(void* arg)
+{
+  struct ReaderArgs* args = arg;
+
+  char key[KEY_LEN + 1];
+  char value[VALUE_LEN];
+  for (size_t i = 0; i < READS; i++) {
+    snprintf(key, sizeof(key), "key-%011d", rand_r(&args->seed) % KEYS);
+    if (args->lock != NULL) {
+      pthread_mutex_lock(args->lock);
+    }
+    size_t len = WiscKeyDB_get(args->db, value, key, KEY_LEN);
+    if (args->lock != NULL) {
+      pthread_mutex_unlock(args->lock);
+    }
+    if (len != VALUE_LEN) {
+      fprintf(stderr, "read failed\n");
+      exit(1);
+    }
+  }
+
+  return NULL;
+}
+
+static double
+run(struct WiscKeyDB* db, size_t threads, pthread_mutex_t* lock)
+{
+  pthread_t tids[MAX_THREADS];
+  struct ReaderArgs args[MAX_THREADS];
+
+  double start = now();
+  for (size_t i = 0; i < threads; i++) {
+    args[i].db = db;
+    args[i].lock = lock;
+    args[i].seed = (unsigned int)i + 1;
+    if (pthread_create(&tids[i], NULL, read_keys, &args[i]) != 0) {
+      exit(1);
+    }
+  }
+  for (size_t i = 0; i < threads; i++) {
+    pthread_join(tids[i], NULL);
+  }
+
+  return (double)(threads * READS) / (now() - start);
+}
+
+int
+main()
+{
+  remove_dir(BENCH_DIR);
+
+  struct WiscKeyDB* db = WiscKeyDB_new(BENCH_DIR);
+  if (db == NULL) {
+    fprintf(stderr, "open failed\n");
+    return 1;
+  }
+
+  char key[KEY_LEN + 1];
+  char value[VALUE_LEN];
+  memset(value, 'v', sizeof(value));
+  for (int i = 0; i < KEYS; i++) {
+    snprintf(key, sizeof(key), "key-%011d", i);
+    if (WiscKeyDB_set(db, key, value, KEY_LEN, VALUE_LEN) == -1) {
+      fprintf(stderr, "write failed\n");
+      return 1;
+    }
+  }
+  WiscKeyDB_free(db);
+
+  db = WiscKeyDB_new(BENCH_DIR);
+  if (db == NULL) {
+    fprintf(stderr, "open failed\n");
+    return 1;
+  }
+
+  pthread_mutex_t lock;
+  pthread_mutex_init(&lock, NULL);
+
+  printf("%8s %16s %16s\n", "threads", "reads/s", "serialized/s");
+  for (size_t threads = 1; threads <= MAX_THREADS; threads *= 2) {
+    double lock_free = run(db, threads, NULL);
+    double serialized = run(db, threads, &lock);
+    printf("%8zu %16.0f %16.0f\n", threads, lock_free, serialized);
+  }
+
+  pthread_mutex_destroy(&lock);
+  WiscKeyDB_free(db);
+  remove_dir(BENCH_DIR);
+
+  return 0;
+}
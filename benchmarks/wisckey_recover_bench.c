@@ -0,0 +1,146 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/wisckey.h"
+
+#define BENCH_DIR "wisckey_recover_bench.db" ///< Scratch database directory.
+#define WRITES (512 * 1024)                  ///< Number of writes to recover.
+#define KEY_LEN 16                           ///< Length of the benchmark keys.
+#define VALUE_LEN 100                        ///< Length of the values.
+#define SHARDS 16                            ///< Number of WALs to recover.
+#define MEMTABLE_SIZE (16 * 1024 * 1024)     ///< Budget of each MemTable.
+
+/*
+ * Recovery benchmark of the database. Every run writes WRITES random keys into
+ * SHARDS MemTables that are large enough to never be flushed and closes the
+ * database, which leaves one full WAL per shard. The time to open the database
+ * again, which replays every WAL into a SSTable, is measured with a growing
+ * number of recovery threads.
+ */
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t
+next_random(uint64_t* state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static void
+remove_dir(const char* path)
+{
+  DIR* dir = opendir(path);
+  if (dir == NULL) {
+    return;
+  }
+
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    char file[512];
+    snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+    remove(file);
+  }
+  closedir(dir);
+
+  rmdir(path);
+}
+
+static double
+run(const char* keys, size_t threads)
+{
+  remove_dir(BENCH_DIR);
+
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.memtable_shards = SHARDS;
+  options.memtable_size = MEMTABLE_SIZE;
+
+  struct WiscKeyDB* db = WiscKeyDB_open(BENCH_DIR, &options);
+  if (db == NULL) {
+    fprintf(stderr, "open failed\n");
+    exit(1);
+  }
+
+  char value[VALUE_LEN];
+  memset(value, 'v', sizeof(value));
+  for (size_t i = 0; i < WRITES; i++) {
+    char* key = (char*)keys + i * KEY_LEN;
+    if (WiscKeyDB_set(db, key, value, KEY_LEN, VALUE_LEN) == -1) {
+      fprintf(stderr, "write failed\n");
+      exit(1);
+    }
+  }
+  WiscKeyDB_free(db);
+
+  options.recovery_threads = threads;
+
+  double start = now();
+  db = WiscKeyDB_open(BENCH_DIR, &options);
+  double elapsed = now() - start;
+  if (db == NULL) {
+    fprintf(stderr, "recovery failed\n");
+    exit(1);
+  }
+
+  WiscKeyDB_free(db);
+  remove_dir(BENCH_DIR);
+
+  return elapsed;
+}
+
+int
+main()
+{
+  uint64_t state = 0x9E3779B97F4A7C15ULL;
+  char* keys = malloc(WRITES * KEY_LEN);
+  for (size_t i = 0; i < WRITES * KEY_LEN; i++) {
+    keys[i] = (char)next_random(&state);
+  }
+
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t max_threads = cpus > 0 ? (size_t)cpus : 1;
+  if (max_threads > SHARDS) {
+    max_threads = SHARDS;
+  }
+
+  printf("%8s %14s %16s\n", "threads", "recovery (s)", "records/s");
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    double elapsed = run(keys, threads);
+    printf("%8zu %14.3f %16.0f\n", threads, elapsed, WRITES / elapsed);
+  }
+
+  free(keys);
+  return 0;
+}
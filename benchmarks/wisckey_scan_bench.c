@@ -0,0 +1,180 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/wisckey.h"
+
+#define BENCH_DIR "wisckey_scan_bench.db" ///< Scratch database directory.
+#define KEYS (128 * 1024)                 ///< Number of keys loaded.
+#define KEY_LEN 16                        ///< Length of the benchmark keys.
+#define VALUE_LEN 4096                    ///< Length of the values.
+
+/*
+ * Full range scans with the values read ahead by the read pool. The keys are
+ * written in random order, so the values of neighbouring keys are far apart in
+ * the ValueLog and every value is a random read. The pages of the ValueLog are
+ * dropped from the page cache before each scan, and the scans run with the
+ * values read one at a time and with several thread counts and read ahead
+ * depths.
+ */
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void
+remove_dir(const char* path)
+{
+  DIR* dir = opendir(path);
+  if (dir == NULL) {
+    return;
+  }
+
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    char file[512];
+    snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+    remove(file);
+  }
+  closedir(dir);
+
+  rmdir(path);
+}
+
+static void
+drop_cache()
+{
+  int fd = open(BENCH_DIR "/value.log", O_RDONLY);
+  if (fd == -1) {
+    return;
+  }
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+}
+
+static void
+run(size_t threads, size_t prefetch)
+{
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.scan_threads = threads;
+  options.scan_prefetch = prefetch;
+
+  struct WiscKeyDB* db = WiscKeyDB_open(BENCH_DIR, &options);
+  if (db == NULL) {
+    fprintf(stderr, "open failed\n");
+    exit(1);
+  }
+  drop_cache();
+
+  double start = now();
+  struct WiscKeyDBScan* scan = WiscKeyDB_scan(db, NULL, 0, NULL, 0);
+  if (scan == NULL) {
+    fprintf(stderr, "scan failed\n");
+    exit(1);
+  }
+
+  size_t keys = 0;
+  size_t bytes = 0;
+  const char* key;
+  size_t key_len;
+  const char* value;
+  size_t value_len;
+  int res;
+  while ((res = WiscKeyDBScan_next(
+            scan, &key, &key_len, &value, &value_len)) == 1) {
+    keys++;
+    bytes += key_len + value_len;
+  }
+  WiscKeyDBScan_free(scan);
+  double elapsed = now() - start;
+
+  WiscKeyDB_free(db);
+  if (res == -1 || keys != KEYS) {
+    fprintf(stderr, "scan failed\n");
+    exit(1);
+  }
+
+  printf("%8zu %9zu %12.0f %12.1f\n",
+         threads,
+         prefetch,
+         keys / elapsed,
+         (double)bytes / elapsed / 1e6);
+}
+
+int
+main()
+{
+  remove_dir(BENCH_DIR);
+
+  struct WiscKeyDB* db = WiscKeyDB_new(BENCH_DIR);
+  if (db == NULL) {
+    fprintf(stderr, "open failed\n");
+    return 1;
+  }
+
+  int* order = malloc(KEYS * sizeof(int));
+  for (int i = 0; i < KEYS; i++) {
+    order[i] = i;
+  }
+  srand(1);
+  for (int i = KEYS - 1; i > 0; i--) {
+    int j = rand() % (i + 1);
+    int tmp = order[i];
+    order[i] = order[j];
+    order[j] = tmp;
+  }
+
+  char key[KEY_LEN + 1];
+  char value[VALUE_LEN];
+  memset(value, 'v', sizeof(value));
+  for (int i = 0; i < KEYS; i++) {
+    snprintf(key, sizeof(key), "key-%011d", order[i]);
+    if (WiscKeyDB_set(db, key, value, KEY_LEN, VALUE_LEN) == -1) {
+      fprintf(stderr, "write failed\n");
+      return 1;
+    }
+  }
+  WiscKeyDB_free(db);
+  free(order);
+
+  printf("%8s %9s %12s %12s\n", "threads", "prefetch", "keys/s", "MB/s");
+
+  run(0, 1);
+  run(1, 64);
+  run(4, 64);
+  run(8, 64);
+  run(16, 128);
+  run(32, 256);
+
+  remove_dir(BENCH_DIR);
+
+  return 0;
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <dirent.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/wisckey.h"
+
+#define BENCH_DIR "wisckey_write_bench.db" ///< Scratch database directory.
+#define WRITES (128 * 1024)                ///< Number of writes per run.
+#define SYNCED_WRITES (8 * 1024)           ///< Number of synced writes per run.
+#define KEY_LEN 16                         ///< Length of the benchmark keys.
+#define VALUE_LEN 100                      ///< Length of the values.
+#define MAX_THREADS 64                     ///< Limit on writer threads.
+
+/*
+ * Multi-threaded write benchmark of the database with one MemTable against one
+ * MemTable shard per writer thread. Every run writes WRITES random keys split
+ * across the writer threads into a fresh database.
+ *
+ * Synced writes are then compared between a database with WALs and one that
+ * recovers from the ValueLog, which writes each key once and syncs one file.
+ */
+
+struct BenchArgs
+{
+  struct WiscKeyDB* db;
+  const char* keys;
+  size_t start;
+  size_t end;
+};
+
+static double
+now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t
+next_random(uint64_t* state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static void
+remove_dir(const char* path)
+{
+  DIR* dir = opendir(path);
+  if (dir == NULL) {
+    return;
+  }
+
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    char file[512];
+    snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+    remove(file);
+  }
+  closedir(dir);
+
+  rmdir(path);
+}
+
+static void*
+write_keys(void* arg)
+{
+  struct BenchArgs* args = arg;
+
+  char value[VALUE_LEN];
+  memset(value, 'v', sizeof(value));
+
+  for (size_t i = args->start; i < args->end; i++) {
+    char* key = (char*)args->keys + i * KEY_LEN;
+    if (WiscKeyDB_set(args->db, key, value, KEY_LEN, VALUE_LEN) == -1) {
+      fprintf(stderr, "write failed\n");
+      exit(1);
+    }
+  }
+
+  return NULL;
+}
+
+static double
+run(const char* keys,
+    size_t writes,
+    size_t threads,
+    const struct WiscKeyDBOptions* options)
+{
+  remove_dir(BENCH_DIR);
+
+  struct WiscKeyDB* db = WiscKeyDB_open(BENCH_DIR, options);
+  if (db == NULL) {
+    fprintf(stderr, "open failed\n");
+    exit(1);
+  }
+
+  pthread_t tids[MAX_THREADS];
+  struct BenchArgs args[MAX_THREADS];
+  size_t per_thread = writes / threads;
+
+  double start = now();
+  for (size_t i = 0; i < threads; i++) {
+    args[i].db = db;
+    args[i].keys = keys;
+    args[i].start = i * per_thread;
+    args[i].end = i + 1 == threads ? writes : (i + 1) * per_thread;
+    pthread_create(&tids[i], NULL, write_keys, &args[i]);
+  }
+  for (size_t i = 0; i < threads; i++) {
+    pthread_join(tids[i], NULL);
+  }
+  double elapsed = now() - start;
+
+  WiscKeyDB_free(db);
+  remove_dir(BENCH_DIR);
+
+  return (double)writes / elapsed;
+}
+
+int
+main()
+{
+  uint64_t state = 0x9E3779B97F4A7C15ULL;
+  char* keys = malloc(WRITES * KEY_LEN);
+  for (size_t i = 0; i < WRITES * KEY_LEN; i++) {
+    keys[i] = (char)next_random(&state);
+  }
+
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t max_threads = cpus > 0 ? (size_t)cpus : 1;
+  if (max_threads > MAX_THREADS) {
+    max_threads = MAX_THREADS;
+  }
+
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+
+  printf("%8s %18s %18s\n", "threads", "1 shard (op/s)", "N shards (op/s)");
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    options.memtable_shards = 1;
+    double single = run(keys, WRITES, threads, &options);
+    options.memtable_shards = threads;
+    double sharded = run(keys, WRITES, threads, &options);
+    printf("%8zu %18.0f %18.0f\n", threads, single, sharded);
+  }
+
+  WiscKeyDBOptions_init(&options);
+  options.sync_writes = 1;
+
+  printf("\n%8s %18s %18s\n", "threads", "WAL (op/s)", "ValueLog (op/s)");
+  for (size_t threads = 1; threads <= 16; threads *= 4) {
+    options.value_log_wal = 0;
+    double wal = run(keys, SYNCED_WRITES, threads, &options);
+    options.value_log_wal = 1;
+    double value_log = run(keys, SYNCED_WRITES, threads, &options);
+    printf("%8zu %18.0f %18.0f\n", threads, wal, value_log);
+  }
+
+  free(keys);
+  return 0;
+}
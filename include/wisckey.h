@@ -19,14 +19,245 @@
 
 #include <stdlib.h>
 
+#define WISCKEY_COMPRESSION_NONE 0 ///< Values are stored as they are.
+#define WISCKEY_COMPRESSION_LZ 1   ///< The built-in LZ77 codec.
+#define WISCKEY_COMPRESSION_ZLIB 2 ///< zlib, if WiscKey was built with it.
+#define WISCKEY_COMPRESSION_ZSTD 3 ///< Zstandard, if WiscKey was built with it.
+
 struct WiscKeyDB;
+struct WiscKeyDBScan;
+
+/**
+ * @brief Tuning options of a database.
+ *
+ * Initialize the options with WiscKeyDBOptions_init before changing them.
+ */
+struct WiscKeyDBOptions
+{
+  size_t memtable_size;      ///< Byte budget of a MemTable. The budget counts
+                             ///< the key bytes plus a fixed overhead per
+                             ///< record. A full MemTable is flushed to a
+                             ///< SSTable, so this sets the size of the
+                             ///< SSTables.
+  int memtable_hash_index;   ///< Set to 1 to keep a hash index over the keys
+                             ///< of the active MemTable for `O(1)` point
+                             ///< lookups at the cost of extra memory. Off by
+                             ///< default.
+  size_t memtable_shards;    ///< Number of MemTable shards. Each shard has
+                             ///< its own lock, MemTables of `memtable_size`,
+                             ///< and flush thread, so writers to different
+                             ///< shards run in parallel. Defaults to 1.
+  char** split_keys;         ///< `memtable_shards - 1` sorted keys that split
+                             ///< the key space into one range per shard. A
+                             ///< key goes to the shard after the last split
+                             ///< key that is less than or equal to it. Set to
+                             ///< NULL to pick the shard by the key's hash.
+  size_t* split_key_lengths; ///< The lengths of `split_keys`.
+  int sync_writes;           ///< Set to 1 to sync every write to disk before
+                             ///< it returns. Concurrent writers share the
+                             ///< syncs through group commit. Off by default.
+  size_t wal_segment_size;   ///< Bytes preallocated for each WAL segment. A
+                             ///< full segment also freezes its MemTable.
+                             ///< Set to 0 to use `memtable_size`.
+  int wal_io_uring;          ///< Set to 1 to submit the syncs of the WAL
+                             ///< and the ValueLog through io_uring. Falls
+                             ///< back to `pwrite` and `fdatasync` if WiscKey
+                             ///< was built without liburing. Off by default.
+  int value_log_wal;         ///< Set to 1 to recover the MemTables from the
+                             ///< ValueLog instead of keeping WALs. Every write
+                             ///< then goes to disk once and a synced write
+                             ///< pays for a single sync. Off by default.
+  size_t recovery_threads;   ///< Number of threads that replay the WALs on
+                             ///< open, each WAL into its own SSTable. Set to 0
+                             ///< for one thread per CPU.
+  size_t value_log_gc_rate;  ///< Bytes of the ValueLog per second that a
+                             ///< background thread garbage collects. A pass
+                             ///< starts once the ValueLog has doubled in size
+                             ///< since the last one. Set to 0 to turn the
+                             ///< thread off. Off by default.
+  size_t value_log_gc_limit; ///< Bytes of the ValueLog that a pass of the
+                             ///< background thread collects at most. The
+                             ///< next pass picks the segments again by their
+                             ///< garbage then. Set to 0 for no limit.
+                             ///< Defaults to 256 MiB.
+  double value_log_gc_ratio; ///< Share of a sealed segment that has to be
+                             ///< garbage for the collector to rewrite it.
+                             ///< Defaults to 0.5.
+  size_t value_log_segment;  ///< Bytes in each file of a segmented ValueLog.
+                             ///< The collector rewrites the segments with
+                             ///< the most garbage and deletes them. Set to 0
+                             ///< to keep the ValueLog in a single file, which
+                             ///< a database can't change once it is created.
+                             ///< Off by default.
+  size_t value_cache_size;   ///< Bytes of values kept in memory by a cache
+                             ///< in front of the ValueLog, so hot keys are
+                             ///< read without I/O. Set to 0 to turn the cache
+                             ///< off. Off by default.
+  size_t scan_threads;       ///< Number of threads that read the values of a
+                             ///< scan ahead of time. Set to 0 to read them on
+                             ///< the scanning thread. Defaults to 8.
+  size_t scan_prefetch;      ///< Number of keys a scan reads ahead. Defaults
+                             ///< to 64.
+  size_t inline_value_size;  ///< Values shorter than this are kept with
+                             ///< their keys in the LSM-tree instead of the
+                             ///< ValueLog, so reading them takes no extra
+                             ///< I/O. Can be changed between opens. Set to 0
+                             ///< to separate every value. Off by default.
+  int compression;           ///< One of the `WISCKEY_COMPRESSION_*` codecs to
+                             ///< compress the values in the ValueLog with.
+                             ///< A codec that WiscKey was built without falls
+                             ///< back to WISCKEY_COMPRESSION_LZ. Values are
+                             ///< decompressed with the codec they were
+                             ///< written with. Off by default.
+  size_t compress_min_size;  ///< Values shorter than this aren't compressed.
+                             ///< Defaults to 64.
+  double compress_min_ratio; ///< A compressed value is only kept if it is at
+                             ///< least this many times smaller. Defaults to
+                             ///< 1.1.
+};
+
+/**
+ * @brief Counters of the value cache.
+ *
+ * Compare `size` with the working set and the hit rate to size the cache.
+ */
+struct WiscKeyDBCacheStats
+{
+  size_t hits;      ///< Number of reads that found their value in the cache.
+  size_t misses;    ///< Number of reads that went to the ValueLog.
+  size_t evictions; ///< Number of values evicted to make room.
+  size_t len;       ///< Number of values in the cache.
+  size_t size;      ///< Bytes taken by the values, overhead included.
+};
+
+/**
+ * @brief Value read without a copy by WiscKeyDB_get_slice.
+ *
+ * Note: Release the slice with WiscKeyDB_release_slice.
+ */
+struct WiscKeyDBSlice
+{
+  const char* data; ///< The value. Points into a mapping of the ValueLog.
+  size_t len;       ///< Length of the value.
+  void* pin;        ///< The mapping that is pinned or NULL for a copy.
+};
 
+/**
+ * @brief Sets the options to their defaults.
+ *
+ * @param options The options to initialize.
+ */
+void
+WiscKeyDBOptions_init(struct WiscKeyDBOptions* options);
+
+/**
+ * @brief Opens the database in a directory with the default options.
+ *
+ * The directory is created if it doesn't exist. Any WAL left behind by a
+ * previous run is replayed and flushed to a SSTable before this function
+ * returns.
+ *
+ * Note: Close the database with WiscKeyDB_free.
+ *
+ * @param dir The directory of the database.
+ * @return A pointer to the database or NULL if it couldn't be opened.
+ */
 struct WiscKeyDB*
 WiscKeyDB_new(char* dir);
 
+/**
+ * @brief Opens the database in a directory.
+ *
+ * Same as WiscKeyDB_new, with the given options.
+ *
+ * @param dir The directory of the database.
+ * @param options The options of the database.
+ * @return A pointer to the database or NULL if it couldn't be opened.
+ */
+struct WiscKeyDB*
+WiscKeyDB_open(char* dir, const struct WiscKeyDBOptions* options);
+
+/**
+ * @brief Gets the value of a key.
+ *
+ * Pass NULL for `ptr` to query the length of the value. Otherwise, the value
+ * is copied into `ptr`, which must hold at least the returned length.
+ *
+ * @param db The database to read from.
+ * @param ptr The buffer to copy the value into or NULL.
+ * @param key The key to read.
+ * @param key_length The length of the key.
+ * @return The length of the value or 0 if the key doesn't exist.
+ */
 size_t
 WiscKeyDB_get(struct WiscKeyDB* db, char* ptr, char* key, size_t key_length);
 
+/**
+ * @brief Gets the value of a key into a buffer of a given size.
+ *
+ * The value is read straight into `buf` if it fits. Otherwise, only its length
+ * is returned, so the length can be queried with a `buf_len` of 0.
+ *
+ * @param db The database to read from.
+ * @param buf The buffer to read the value into or NULL.
+ * @param buf_len The size of `buf`.
+ * @param key The key to read.
+ * @param key_length The length of the key.
+ * @return The length of the value or 0 if the key doesn't exist.
+ */
+size_t
+WiscKeyDB_get_into(struct WiscKeyDB* db,
+                   char* buf,
+                   size_t buf_len,
+                   char* key,
+                   size_t key_length);
+
+/**
+ * @brief Gets the value of a key without copying it.
+ *
+ * The slice points into a read-only mapping of the ValueLog. It stays valid
+ * until it is released, even if the garbage collector moves the value. The
+ * space the collector frees is only returned to the file system once no slice
+ * is pinned, so release slices promptly.
+ *
+ * A value kept inline with its key is copied instead, and its slice has no pin.
+ *
+ * Note: Release the slice with WiscKeyDB_release_slice before the database is
+ * closed.
+ *
+ * @param db The database to read from.
+ * @param slice A pointer that is assigned to the value.
+ * @param key The key to read.
+ * @param key_length The length of the key.
+ * @return This function returns 0 if the value was found and -1 if the key
+ * doesn't exist or there was an error.
+ */
+int
+WiscKeyDB_get_slice(struct WiscKeyDB* db,
+                    struct WiscKeyDBSlice* slice,
+                    char* key,
+                    size_t key_length);
+
+/**
+ * @brief Releases a slice returned by WiscKeyDB_get_slice.
+ *
+ * @param db The database the slice was read from.
+ * @param slice The slice to release.
+ */
+void
+WiscKeyDB_release_slice(struct WiscKeyDB* db, struct WiscKeyDBSlice* slice);
+
+/**
+ * @brief Sets the value of a key.
+ *
+ * @param db The database to write to.
+ * @param key The key to write.
+ * @param value The value to write.
+ * @param key_length The length of the key.
+ * @param value_length The length of the value.
+ * @return This function returns 0 if the value was written and -1 if there was
+ * an error.
+ */
 int
 WiscKeyDB_set(struct WiscKeyDB* db,
               char* key,
@@ -34,7 +265,109 @@ WiscKeyDB_set(struct WiscKeyDB* db,
               size_t key_length,
               size_t value_length);
 
+/**
+ * @brief Deletes a key.
+ *
+ * @param db The database to delete the key from.
+ * @param key The key to delete.
+ * @param key_length The length of the key.
+ * @return This function returns 0 if the delete was written and -1 if there
+ * was an error.
+ */
 int
 WiscKeyDB_delete(struct WiscKeyDB* db, char* key, size_t key_length);
 
+/**
+ * @brief Garbage collects the ValueLog.
+ *
+ * Runs a full pass over the ValueLog without the rate limit and the budget of
+ * the background thread. Live values are copied to the head and the space of
+ * the others is freed. A segmented ValueLog only collects the sealed segments
+ * that hold at least `value_log_gc_ratio` garbage. With `value_log_wal`, the
+ * pass stops at the oldest entry that isn't in a SSTable yet.
+ *
+ * @param db The database to collect.
+ * @return This function returns 0 if the pass finished and -1 if there was an
+ * error.
+ */
+int
+WiscKeyDB_gc(struct WiscKeyDB* db);
+
+/**
+ * @brief Starts a scan over a range of keys.
+ *
+ * The scan walks the keys in order and reads the values of the next
+ * `scan_prefetch` keys in parallel on the `scan_threads` reader threads, so
+ * the ValueLog sees many random reads at once. The keys are the ones in the
+ * database when the scan starts. A value that the garbage collector moves
+ * during the scan is read again at its new location.
+ *
+ * Note: Free the scan with WiscKeyDBScan_free before the database is closed.
+ *
+ * @param db The database to scan.
+ * @param start The lowest key of the range or NULL to start at the lowest key.
+ * @param start_length The length of `start`.
+ * @param end The key after the range or NULL to scan to the end.
+ * @param end_length The length of `end`.
+ * @return A pointer to the scan or NULL if there was an error.
+ */
+struct WiscKeyDBScan*
+WiscKeyDB_scan(struct WiscKeyDB* db,
+               char* start,
+               size_t start_length,
+               char* end,
+               size_t end_length);
+
+/**
+ * @brief Gets the next key and value of a scan.
+ *
+ * The key and the value belong to the scan and stay valid until the next call.
+ *
+ * @param scan The scan to advance.
+ * @param key A pointer that is assigned to the key.
+ * @param key_length A pointer that is assigned to the length of the key.
+ * @param value A pointer that is assigned to the value.
+ * @param value_length A pointer that is assigned to the length of the value.
+ * @return This function returns 1 if there was a key, 0 if the scan is done
+ * and -1 if there was an error.
+ */
+int
+WiscKeyDBScan_next(struct WiscKeyDBScan* scan,
+                   const char** key,
+                   size_t* key_length,
+                   const char** value,
+                   size_t* value_length);
+
+/**
+ * @brief Frees a scan.
+ *
+ * Waits for the values that are still being read ahead.
+ *
+ * @param scan The scan to free.
+ */
+void
+WiscKeyDBScan_free(struct WiscKeyDBScan* scan);
+
+/**
+ * @brief Reads the counters of the value cache.
+ *
+ * All the counters are 0 if the cache is off.
+ *
+ * @param db The database to read.
+ * @param stats A pointer that is assigned to the counters.
+ */
+void
+WiscKeyDB_cache_stats(struct WiscKeyDB* db, struct WiscKeyDBCacheStats* stats);
+
+/**
+ * @brief Closes the database.
+ *
+ * This function waits for an in-progress MemTable flush to finish. The active
+ * MemTable is left in its WAL and recovered on the next open.
+ *
+ * @param db The database to close.
+ */
+void
+WiscKeyDB_free(struct WiscKeyDB* db);
+
 #endif /* WISCKEY_H */
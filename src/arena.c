@@ -0,0 +1,157 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+static struct ArenaBlock*
+ArenaBlock_new(size_t size, size_t used)
+{
+  struct ArenaBlock* block = malloc(sizeof(struct ArenaBlock) + size);
+  if (block == NULL) {
+    return NULL;
+  }
+  block->size = size;
+  block->next = NULL;
+  atomic_init(&block->used, used);
+
+  return block;
+}
+
+static char*
+ArenaBlock_claim(struct ArenaBlock* block, size_t size)
+{
+  size_t used = atomic_load_explicit(&block->used, memory_order_relaxed);
+  while (used + size <= block->size) {
+    if (atomic_compare_exchange_weak_explicit(&block->used,
+                                              &used,
+                                              used + size,
+                                              memory_order_relaxed,
+                                              memory_order_relaxed)) {
+      return block->data + used;
+    }
+  }
+
+  return NULL;
+}
+
+static void
+Arena_count(struct Arena* arena, size_t size)
+{
+  atomic_fetch_add_explicit(&arena->allocations, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&arena->bytes_used, size, memory_order_relaxed);
+}
+
+struct Arena*
+Arena_new(size_t block_size)
+{
+  struct Arena* arena = malloc(sizeof(struct Arena));
+
+  atomic_init(&arena->blocks, NULL);
+  atomic_init(&arena->large, NULL);
+  arena->block_size = block_size;
+
+  atomic_init(&arena->allocations, 0);
+  atomic_init(&arena->bytes_used, 0);
+  atomic_init(&arena->bytes_reserved, 0);
+
+  return arena;
+}
+
+void*
+Arena_alloc(struct Arena* arena, size_t size)
+{
+  size_t aligned =
+    (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+  while (1) {
+    struct ArenaBlock* current =
+      atomic_load_explicit(&arena->blocks, memory_order_acquire);
+
+    if (current != NULL) {
+      char* mem = ArenaBlock_claim(current, aligned);
+      if (mem != NULL) {
+        Arena_count(arena, aligned);
+        return mem;
+      }
+    }
+
+    if (aligned > arena->block_size / 4) {
+      // Large allocations get their own block behind the current one so the
+      // free space in the current block isn't thrown away.
+      struct ArenaBlock* block = ArenaBlock_new(aligned, aligned);
+      if (block == NULL) {
+        return NULL;
+      }
+
+      block->next = atomic_load_explicit(&arena->large, memory_order_relaxed);
+      while (!atomic_compare_exchange_weak_explicit(&arena->large,
+                                                    &block->next,
+                                                    block,
+                                                    memory_order_release,
+                                                    memory_order_relaxed)) {
+      }
+
+      atomic_fetch_add_explicit(
+        &arena->bytes_reserved, aligned, memory_order_relaxed);
+      Arena_count(arena, aligned);
+      return block->data;
+    }
+
+    // The current block is full, race the other writers to install a new one
+    // with this allocation already claimed at the start of it.
+    struct ArenaBlock* block = ArenaBlock_new(arena->block_size, aligned);
+    if (block == NULL) {
+      return NULL;
+    }
+    block->next = current;
+
+    if (atomic_compare_exchange_strong_explicit(&arena->blocks,
+                                                &current,
+                                                block,
+                                                memory_order_acq_rel,
+                                                memory_order_acquire)) {
+      atomic_fetch_add_explicit(
+        &arena->bytes_reserved, arena->block_size, memory_order_relaxed);
+      Arena_count(arena, aligned);
+      return block->data;
+    }
+
+    // Another writer installed a block first, retry with that one.
+    free(block);
+  }
+}
+
+static void
+ArenaBlock_free_list(struct ArenaBlock* block)
+{
+  while (block != NULL) {
+    struct ArenaBlock* next = block->next;
+    free(block);
+    block = next;
+  }
+}
+
+void
+Arena_free(struct Arena* arena)
+{
+  ArenaBlock_free_list(atomic_load(&arena->blocks));
+  ArenaBlock_free_list(atomic_load(&arena->large));
+
+  free(arena);
+}
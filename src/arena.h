@@ -0,0 +1,110 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WISCKEY_ARENA_H
+#define WISCKEY_ARENA_H
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+/**
+ * @file
+ * @author Adam Comer <adambcomer@gmail.com>
+ * @date March 2, 2025
+ * @copyright Apache-2.0 License
+ * @brief Bump-pointer allocator for short-lived, same-lifetime allocations.
+ */
+
+#define ARENA_BLOCK_SIZE (64 * 1024) ///< Default size of an Arena block.
+#define ARENA_ALIGNMENT 8            ///< Alignment of every Arena allocation.
+
+/**
+ * @brief Contiguous chunk of memory owned by an Arena.
+ */
+struct ArenaBlock
+{
+  struct ArenaBlock* next; ///< The next block in the Arena's block list.
+  size_t size;             ///< The number of usable bytes in `data`.
+  _Atomic size_t used;     ///< The number of bytes handed out from `data`.
+  char data[];             ///< The memory handed out by the Arena.
+};
+
+/**
+ * @brief Bump-pointer allocator.
+ *
+ * The Arena carves allocations out of large blocks by moving a pointer forward.
+ * Nothing is freed individually; every allocation is released at once when the
+ * Arena is freed. This makes it a good fit for the MemTable, where all the
+ * records share the lifetime of the table.
+ *
+ * Allocations that are larger than a quarter of the block size and don't fit in
+ * the current block get a dedicated block so that they don't waste the rest of
+ * the current block.
+ *
+ * Allocation is lock-free. Threads claim space in the current block with a
+ * compare-and-swap on the block's `used` counter, and a thread that finds the
+ * block full races to install a new one. This lets concurrent writers share a
+ * MemTable's Arena without a mutex.
+ */
+struct Arena
+{
+  _Atomic(struct ArenaBlock*)
+    blocks; ///< List of regular blocks, current block first.
+  _Atomic(struct ArenaBlock*) large; ///< List of dedicated blocks.
+  size_t block_size;                 ///< Size of a regular block.
+
+  _Atomic size_t allocations;    ///< Number of allocations served.
+  _Atomic size_t bytes_used;     ///< Number of bytes handed out with padding.
+  _Atomic size_t bytes_reserved; ///< Number of bytes allocated for blocks.
+};
+
+/**
+ * @brief Creates a new empty Arena.
+ *
+ * No memory is reserved until the first allocation.
+ *
+ * Note: Free this Arena with Arena_free.
+ *
+ * @param block_size The size of a regular block. Use ARENA_BLOCK_SIZE for the
+ * default.
+ * @return A pointer to a new Arena.
+ */
+struct Arena*
+Arena_new(size_t block_size);
+
+/**
+ * @brief Allocates memory from an Arena.
+ *
+ * The memory is aligned to ARENA_ALIGNMENT and lives until the Arena is freed.
+ * This function is safe to call from multiple threads at once.
+ *
+ * @param arena The Arena to allocate from.
+ * @param size The number of bytes to allocate.
+ * @return A pointer to the allocated memory or NULL if the system is out of
+ * memory.
+ */
+void*
+Arena_alloc(struct Arena* arena, size_t size);
+
+/**
+ * @brief Frees an Arena and every allocation made from it.
+ *
+ * @param arena The Arena to free.
+ */
+void
+Arena_free(struct Arena* arena);
+
+#endif /* WISCKEY_ARENA_H */
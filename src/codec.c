@@ -0,0 +1,337 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "codec.h"
+
+#ifdef WISCKEY_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef WISCKEY_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/*
+ * Hash of the CODEC_LZ_MIN_MATCH bytes at `p`.
+ */
+static uint32_t
+Codec_lz_hash(const unsigned char* p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(uint32_t));
+  return (v * 2654435761U) >> (32 - CODEC_LZ_HASH_BITS);
+}
+
+/*
+ * Writes the part of a length that doesn't fit in its nibble as a run of 255
+ * bytes and the remainder. Returns 0 if it doesn't fit.
+ */
+static int
+Codec_lz_write_len(unsigned char* dst, size_t dst_cap, size_t* op, size_t len)
+{
+  while (1) {
+    if (*op == dst_cap) {
+      return 0;
+    }
+    unsigned char b = len < 255 ? (unsigned char)len : 255;
+    dst[(*op)++] = b;
+    if (b < 255) {
+      return 1;
+    }
+    len -= 255;
+  }
+}
+
+/*
+ * Writes a sequence of literals followed by a match, or only the literals if
+ * `match_len` is 0. Returns 0 if it doesn't fit.
+ */
+static int
+Codec_lz_write_sequence(unsigned char* dst,
+                        size_t dst_cap,
+                        size_t* op,
+                        const unsigned char* literals,
+                        size_t literals_len,
+                        size_t offset,
+                        size_t match_len)
+{
+  if (*op == dst_cap) {
+    return 0;
+  }
+  size_t match_code = match_len > 0 ? match_len - CODEC_LZ_MIN_MATCH : 0;
+  unsigned char literals_nibble = literals_len < 15 ? literals_len : 15;
+  unsigned char match_nibble = match_code < 15 ? match_code : 15;
+  dst[(*op)++] = (unsigned char)(literals_nibble << 4 | match_nibble);
+
+  if (literals_len >= 15 &&
+      !Codec_lz_write_len(dst, dst_cap, op, literals_len - 15)) {
+    return 0;
+  }
+  if (literals_len > dst_cap - *op) {
+    return 0;
+  }
+  memcpy(dst + *op, literals, literals_len);
+  *op += literals_len;
+  if (match_len == 0) {
+    return 1;
+  }
+
+  if (dst_cap - *op < 2) {
+    return 0;
+  }
+  dst[(*op)++] = (unsigned char)(offset & 0xFF);
+  dst[(*op)++] = (unsigned char)(offset >> 8);
+  if (match_code >= 15 &&
+      !Codec_lz_write_len(dst, dst_cap, op, match_code - 15)) {
+    return 0;
+  }
+
+  return 1;
+}
+
+static size_t
+Codec_lz_compress(char* dst, size_t dst_cap, const char* src, size_t src_len)
+{
+  const unsigned char* in = (const unsigned char*)src;
+  unsigned char* out = (unsigned char*)dst;
+
+  // Positions of earlier bytes by their hash. A stale or colliding position is
+  // caught by comparing the bytes.
+  uint32_t table[1 << CODEC_LZ_HASH_BITS];
+  memset(table, 0, sizeof(table));
+
+  size_t op = 0;
+  size_t anchor = 0;
+  size_t ip = 0;
+  size_t misses = 0;
+  while (src_len >= CODEC_LZ_MIN_MATCH &&
+         ip <= src_len - CODEC_LZ_MIN_MATCH) {
+    uint32_t hash = Codec_lz_hash(in + ip);
+    size_t candidate = table[hash];
+    table[hash] = (uint32_t)ip;
+
+    if (candidate >= ip || ip - candidate > CODEC_LZ_MAX_OFFSET ||
+        memcmp(in + candidate, in + ip, CODEC_LZ_MIN_MATCH) != 0) {
+      // The step grows over bytes that don't compress, so they are skipped
+      // quickly.
+      ip += 1 + (misses++ >> 5);
+      continue;
+    }
+
+    size_t match_len = CODEC_LZ_MIN_MATCH;
+    while (ip + match_len < src_len &&
+           in[candidate + match_len] == in[ip + match_len]) {
+      match_len++;
+    }
+    if (!Codec_lz_write_sequence(out,
+                                 dst_cap,
+                                 &op,
+                                 in + anchor,
+                                 ip - anchor,
+                                 ip - candidate,
+                                 match_len)) {
+      return 0;
+    }
+    ip += match_len;
+    anchor = ip;
+    misses = 0;
+  }
+
+  if (anchor < src_len &&
+      !Codec_lz_write_sequence(
+        out, dst_cap, &op, in + anchor, src_len - anchor, 0, 0)) {
+    return 0;
+  }
+
+  return op;
+}
+
+/*
+ * Adds the extra bytes of a length to `len`. Returns 0 if they are cut short.
+ */
+static int
+Codec_lz_read_len(const unsigned char* src,
+                  size_t src_len,
+                  size_t* ip,
+                  size_t* len)
+{
+  while (1) {
+    if (*ip == src_len) {
+      return 0;
+    }
+    unsigned char b = src[(*ip)++];
+    *len += b;
+    if (b < 255) {
+      return 1;
+    }
+  }
+}
+
+static int
+Codec_lz_decompress(char* dst,
+                    size_t dst_len,
+                    const char* src,
+                    size_t src_len)
+{
+  const unsigned char* in = (const unsigned char*)src;
+  unsigned char* out = (unsigned char*)dst;
+
+  size_t ip = 0;
+  size_t op = 0;
+  while (ip < src_len) {
+    unsigned char token = in[ip++];
+
+    size_t literals_len = token >> 4;
+    if (literals_len == 15 &&
+        !Codec_lz_read_len(in, src_len, &ip, &literals_len)) {
+      return -1;
+    }
+    if (literals_len > src_len - ip || literals_len > dst_len - op) {
+      return -1;
+    }
+    memcpy(out + op, in + ip, literals_len);
+    ip += literals_len;
+    op += literals_len;
+    if (ip == src_len) {
+      break;
+    }
+
+    if (src_len - ip < 2) {
+      return -1;
+    }
+    size_t offset = (size_t)in[ip] | (size_t)in[ip + 1] << 8;
+    ip += 2;
+    size_t match_len = token & 15;
+    if (match_len == 15 && !Codec_lz_read_len(in, src_len, &ip, &match_len)) {
+      return -1;
+    }
+    match_len += CODEC_LZ_MIN_MATCH;
+    if (offset == 0 || offset > op || match_len > dst_len - op) {
+      return -1;
+    }
+
+    // A match that overlaps its own output repeats the bytes before it, so it
+    // is copied one byte at a time.
+    if (offset >= match_len) {
+      memcpy(out + op, out + op - offset, match_len);
+    } else {
+      for (size_t i = 0; i < match_len; i++) {
+        out[op + i] = out[op - offset + i];
+      }
+    }
+    op += match_len;
+  }
+
+  return op == dst_len ? 0 : -1;
+}
+
+int
+Codec_supported(int codec)
+{
+  switch (codec) {
+    case CODEC_NONE:
+    case CODEC_LZ:
+      return 1;
+#ifdef WISCKEY_HAVE_ZLIB
+    case CODEC_ZLIB:
+      return 1;
+#endif
+#ifdef WISCKEY_HAVE_ZSTD
+    case CODEC_ZSTD:
+      return 1;
+#endif
+    default:
+      return 0;
+  }
+}
+
+size_t
+Codec_compress(int codec,
+               char* dst,
+               size_t dst_cap,
+               const char* src,
+               size_t src_len)
+{
+  if (src_len == 0) {
+    return 0;
+  }
+
+  switch (codec) {
+    case CODEC_LZ:
+      return Codec_lz_compress(dst, dst_cap, src, src_len);
+#ifdef WISCKEY_HAVE_ZLIB
+    case CODEC_ZLIB: {
+      uLongf len = dst_cap;
+      if (compress2((Bytef*)dst,
+                    &len,
+                    (const Bytef*)src,
+                    src_len,
+                    CODEC_ZLIB_LEVEL) != Z_OK) {
+        return 0;
+      }
+      return len;
+    }
+#endif
+#ifdef WISCKEY_HAVE_ZSTD
+    case CODEC_ZSTD: {
+      size_t len = ZSTD_compress(dst, dst_cap, src, src_len, CODEC_ZSTD_LEVEL);
+      return ZSTD_isError(len) ? 0 : len;
+    }
+#endif
+    default:
+      return 0;
+  }
+}
+
+int
+Codec_decompress(int codec,
+                 char* dst,
+                 size_t dst_len,
+                 const char* src,
+                 size_t src_len)
+{
+  switch (codec) {
+    case CODEC_NONE:
+      if (src_len != dst_len) {
+        return -1;
+      }
+      memcpy(dst, src, src_len);
+      return 0;
+    case CODEC_LZ:
+      return Codec_lz_decompress(dst, dst_len, src, src_len);
+#ifdef WISCKEY_HAVE_ZLIB
+    case CODEC_ZLIB: {
+      uLongf len = dst_len;
+      if (uncompress((Bytef*)dst, &len, (const Bytef*)src, src_len) != Z_OK ||
+          len != dst_len) {
+        return -1;
+      }
+      return 0;
+    }
+#endif
+#ifdef WISCKEY_HAVE_ZSTD
+    case CODEC_ZSTD: {
+      size_t len = ZSTD_decompress(dst, dst_len, src, src_len);
+      return ZSTD_isError(len) || len != dst_len ? -1 : 0;
+    }
+#endif
+    default:
+      return -1;
+  }
+}
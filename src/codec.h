@@ -0,0 +1,113 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WISCKEY_CODEC_H
+#define WISCKEY_CODEC_H
+
+#include <stddef.h>
+
+/**
+ * @file
+ * @author Adam Comer <adambcomer@gmail.com>
+ * @date May 2, 2025
+ * @copyright Apache-2.0 License
+ * @brief Compression codecs of the values in the ValueLog.
+ */
+
+#define CODEC_NONE 0 ///< The value is stored as it is.
+#define CODEC_LZ 1   ///< The built-in LZ77 codec.
+#define CODEC_ZLIB 2 ///< Deflate through zlib.
+#define CODEC_ZSTD 3 ///< Zstandard through libzstd.
+#define CODEC_LZ_HASH_BITS                                                     \
+  12 ///< Bits of the hash table of the built-in codec's compressor.
+#define CODEC_LZ_MIN_MATCH 4 ///< Shortest match of the built-in codec.
+#define CODEC_LZ_MAX_OFFSET                                                    \
+  65535 ///< Farthest back a match of the built-in codec can start.
+#define CODEC_ZLIB_LEVEL 1 ///< Compression level of zlib.
+#define CODEC_ZSTD_LEVEL 1 ///< Compression level of Zstandard.
+
+/**
+ * @brief Compression codecs, identified by the byte stored with each value.
+ *
+ * The IDs are written to disk, so they never change, and they match the
+ * `WISCKEY_COMPRESSION_*` options.
+ *
+ * The built-in codec is always available. It is a byte-oriented LZ77 in the
+ * style of LZ4: a block is a run of sequences, and each sequence is a token
+ * followed by literal bytes and a match. The high nibble of the token holds the
+ * number of literals and the low nibble the match length minus
+ * CODEC_LZ_MIN_MATCH, and a nibble of 15 continues in extra bytes that are
+ * added up until one is below 255. The literals are followed by the match
+ * offset as a little-endian `uint16_t` and the extra bytes of the match length.
+ * The last sequence may end after its literals and have no match.
+ *
+ * zlib and Zstandard are only available when the library is built with them,
+ * which is detected when the build is configured.
+ */
+
+/**
+ * @brief Checks if a codec is available in this build.
+ *
+ * @param codec The ID of the codec.
+ * @return 1 if values can be compressed and decompressed with the codec and 0
+ * otherwise.
+ */
+int
+Codec_supported(int codec);
+
+/**
+ * @brief Compresses a value.
+ *
+ * Compression gives up once the output doesn't fit in `dst_cap` bytes, so a cap
+ * below the value's length also sets how much the value has to shrink.
+ *
+ * @param codec The ID of the codec.
+ * @param dst The buffer to compress the value into.
+ * @param dst_cap The size of `dst`.
+ * @param src The value to compress.
+ * @param src_len The length of the value.
+ * @return The length of the compressed value or 0 if it doesn't fit, the value
+ * is empty or the codec isn't available.
+ */
+size_t
+Codec_compress(int codec,
+               char* dst,
+               size_t dst_cap,
+               const char* src,
+               size_t src_len);
+
+/**
+ * @brief Decompresses a value into a buffer of its exact length.
+ *
+ * The input is checked while it is decoded, so a corrupt value fails instead of
+ * writing outside of `dst`.
+ *
+ * @param codec The ID of the codec.
+ * @param dst The buffer to decompress the value into.
+ * @param dst_len The length of the decompressed value.
+ * @param src The compressed value.
+ * @param src_len The length of the compressed value.
+ * @return This function returns 0 if the value was decompressed and -1 if it is
+ * corrupt, doesn't decompress to `dst_len` bytes or the codec isn't available.
+ */
+int
+Codec_decompress(int codec,
+                 char* dst,
+                 size_t dst_len,
+                 const char* src,
+                 size_t src_len);
+
+#endif /* WISCKEY_CODEC_H */
@@ -14,7 +14,12 @@
  * limitations under the License.
  */
 
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "src/common.h"
 
@@ -33,3 +38,159 @@ WiscKey_key_cmp(const char* lhs,
 
   return rhs_len < lhs_len ? -1 : 1;
 }
+
+uint64_t
+WiscKey_key_hash(const char* key, size_t key_len)
+{
+  const uint64_t m = 0xc6a4a7935bd1e995ULL;
+  const int r = 47;
+
+  uint64_t h = 0x8445d61a4e774912ULL ^ (key_len * m);
+
+  const unsigned char* data = (const unsigned char*)key;
+  const unsigned char* end = data + (key_len / 8) * 8;
+  while (data != end) {
+    uint64_t k;
+    memcpy(&k, data, sizeof(k));
+    data += 8;
+
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+
+    h ^= k;
+    h *= m;
+  }
+
+  switch (key_len & 7) {
+    case 7:
+      h ^= (uint64_t)data[6] << 48;
+      __attribute__((fallthrough));
+    case 6:
+      h ^= (uint64_t)data[5] << 40;
+      __attribute__((fallthrough));
+    case 5:
+      h ^= (uint64_t)data[4] << 32;
+      __attribute__((fallthrough));
+    case 4:
+      h ^= (uint64_t)data[3] << 24;
+      __attribute__((fallthrough));
+    case 3:
+      h ^= (uint64_t)data[2] << 16;
+      __attribute__((fallthrough));
+    case 2:
+      h ^= (uint64_t)data[1] << 8;
+      __attribute__((fallthrough));
+    case 1:
+      h ^= (uint64_t)data[0];
+      h *= m;
+  }
+
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+
+  return h;
+}
+
+static uint32_t crc32c_table[256];
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+static void
+crc32c_init()
+{
+  // Reflected Castagnoli polynomial
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (int j = 0; j < 8; j++) {
+      crc = (crc >> 1) ^ (0x82F63B78U & (0U - (crc & 1)));
+    }
+    crc32c_table[i] = crc;
+  }
+}
+
+uint32_t
+WiscKey_crc32c(uint32_t crc, const void* data, size_t len)
+{
+  pthread_once(&crc32c_once, crc32c_init);
+
+  const unsigned char* bytes = data;
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc = crc32c_table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+  }
+
+  return ~crc;
+}
+
+size_t
+WiscKey_varint_encode(char* buf, uint64_t value)
+{
+  unsigned char* bytes = (unsigned char*)buf;
+
+  size_t len = 0;
+  while (value >= 0x80) {
+    bytes[len++] = (unsigned char)(value | 0x80);
+    value >>= 7;
+  }
+  bytes[len++] = (unsigned char)value;
+
+  return len;
+}
+
+size_t
+WiscKey_varint_decode(const char* buf, size_t len, uint64_t* value)
+{
+  const unsigned char* bytes = (const unsigned char*)buf;
+
+  // Lengths and most locations fit in one or two bytes.
+  if (len >= 1 && bytes[0] < 0x80) {
+    *value = bytes[0];
+    return 1;
+  }
+  if (len >= 2 && bytes[1] < 0x80) {
+    *value = (uint64_t)(bytes[0] & 0x7F) | (uint64_t)bytes[1] << 7;
+    return 2;
+  }
+
+  uint64_t result = 0;
+  for (size_t i = 0; i < len && i < WISCKEY_VARINT_MAX; i++) {
+    result |= (uint64_t)(bytes[i] & 0x7F) << (7 * i);
+    if (bytes[i] < 0x80) {
+      *value = result;
+      return i + 1;
+    }
+  }
+
+  return 0;
+}
+
+size_t
+WiscKey_varint_len(uint64_t value)
+{
+  size_t len = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    len++;
+  }
+
+  return len;
+}
+
+int
+WiscKey_sync_dir(const char* path)
+{
+  int fd = open(path, O_RDONLY | O_DIRECTORY);
+  if (fd == -1) {
+    perror("open");
+    return -1;
+  }
+
+  int res = fsync(fd);
+  if (res == -1) {
+    perror("fsync");
+  }
+  close(fd);
+
+  return res;
+}
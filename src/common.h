@@ -17,8 +17,11 @@
 #ifndef WISCKEY_COMMON_H
 #define WISCKEY_COMMON_H
 
+#include <stdint.h>
 #include <stdlib.h>
 
+#define WISCKEY_VARINT_MAX 10 ///< Longest encoding of a 64-bit varint.
+
 /**
  * @brief Lexigraphical comparison of two keys.
  *
@@ -35,4 +38,78 @@ WiscKey_key_cmp(const char* lhs,
                 const char* rhs,
                 size_t rhs_len);
 
+/**
+ * @brief 64-bit hash of a key.
+ *
+ * This function uses MurmurHash64A. It is not a cryptographic hash.
+ *
+ * @param key The key to hash.
+ * @param key_len The length of the key.
+ * @return The hash of the key.
+ */
+uint64_t
+WiscKey_key_hash(const char* key, size_t key_len);
+
+/**
+ * @brief Extends a CRC-32C checksum with more bytes.
+ *
+ * Start a new checksum with a `crc` of 0.
+ *
+ * @param crc The checksum of the bytes so far.
+ * @param data The bytes to add.
+ * @param len The number of bytes.
+ * @return The checksum of all the bytes.
+ */
+uint32_t
+WiscKey_crc32c(uint32_t crc, const void* data, size_t len);
+
+/**
+ * @brief Encodes an integer as a LEB128 varint.
+ *
+ * The integer is written 7 bits at a time, least significant first, with the
+ * high bit of every byte but the last set. Values below 128 take one byte.
+ *
+ * @param buf The buffer to write to. It must have room for WISCKEY_VARINT_MAX
+ * bytes.
+ * @param value The integer to encode.
+ * @return The number of bytes written.
+ */
+size_t
+WiscKey_varint_encode(char* buf, uint64_t value);
+
+/**
+ * @brief Decodes a LEB128 varint.
+ *
+ * @param buf The bytes to decode.
+ * @param len The number of readable bytes in `buf`.
+ * @param value A pointer that is assigned to the decoded integer.
+ * @return The number of bytes read or 0 if the varint is cut short or longer
+ * than WISCKEY_VARINT_MAX bytes.
+ */
+size_t
+WiscKey_varint_decode(const char* buf, size_t len, uint64_t* value);
+
+/**
+ * @brief Length of the LEB128 varint encoding of an integer.
+ *
+ * @param value The integer to encode.
+ * @return The number of bytes that WiscKey_varint_encode writes.
+ */
+size_t
+WiscKey_varint_len(uint64_t value);
+
+/**
+ * @brief Syncs a directory, so the files created, renamed or removed in it
+ * survive a crash.
+ *
+ * `fsync` of a file only makes its contents durable. Its entry in the
+ * directory is only durable once the directory is synced too.
+ *
+ * @param path The path of the directory.
+ * @return This function returns 0 if the directory was synced and -1 if there
+ * was an error.
+ */
+int
+WiscKey_sync_dir(const char* path);
+
 #endif /* WISKEY_COMMON_H */
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash_index.h"
+
+struct HashIndex*
+HashIndex_new()
+{
+  struct HashIndex* index = malloc(sizeof(struct HashIndex));
+
+  index->entries =
+    calloc(HASH_INDEX_MIN_CAPACITY, sizeof(struct HashIndexEntry));
+  index->capacity = HASH_INDEX_MIN_CAPACITY;
+  index->size = 0;
+
+  index->lookups = 0;
+  index->hits = 0;
+  index->probes = 0;
+
+  return index;
+}
+
+struct MemTableRecord*
+HashIndex_get(struct HashIndex* index,
+              const char* key,
+              size_t key_len,
+              uint64_t hash)
+{
+  index->lookups++;
+
+  size_t mask = index->capacity - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    struct HashIndexEntry* entry = &index->entries[i];
+    index->probes++;
+
+    if (entry->record == NULL) {
+      return NULL;
+    }
+    if (entry->hash == hash && entry->record->key_len == key_len &&
+        memcmp(entry->record->key, key, key_len) == 0) {
+      index->hits++;
+      return entry->record;
+    }
+  }
+}
+
+static void
+HashIndex_insert(struct HashIndexEntry* entries,
+                 size_t capacity,
+                 struct MemTableRecord* record,
+                 uint64_t hash)
+{
+  size_t mask = capacity - 1;
+  size_t i = hash & mask;
+  while (entries[i].record != NULL) {
+    i = (i + 1) & mask;
+  }
+
+  entries[i].hash = hash;
+  entries[i].record = record;
+}
+
+void
+HashIndex_put(struct HashIndex* index,
+              struct MemTableRecord* record,
+              uint64_t hash)
+{
+  if ((index->size + 1) * 2 > index->capacity) {
+    // Grow the table
+    size_t capacity = index->capacity * 2;
+    struct HashIndexEntry* entries =
+      calloc(capacity, sizeof(struct HashIndexEntry));
+
+    for (size_t i = 0; i < index->capacity; i++) {
+      if (index->entries[i].record != NULL) {
+        HashIndex_insert(entries,
+                         capacity,
+                         index->entries[i].record,
+                         index->entries[i].hash);
+      }
+    }
+
+    free(index->entries);
+    index->entries = entries;
+    index->capacity = capacity;
+  }
+
+  HashIndex_insert(index->entries, index->capacity, record, hash);
+  index->size++;
+}
+
+size_t
+HashIndex_memory(const struct HashIndex* index)
+{
+  return sizeof(struct HashIndex) +
+         index->capacity * sizeof(struct HashIndexEntry);
+}
+
+void
+HashIndex_stats(const struct HashIndex* index, struct HashIndexStats* stats)
+{
+  stats->lookups = index->lookups;
+  stats->hits = index->hits;
+  stats->probes = index->probes;
+}
+
+void
+HashIndex_free(struct HashIndex* index)
+{
+  free(index->entries);
+  free(index);
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WISCKEY_HASH_INDEX_H
+#define WISCKEY_HASH_INDEX_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "memtable.h"
+
+/**
+ * @file
+ * @author Adam Comer <adambcomer@gmail.com>
+ * @date March 23, 2025
+ * @copyright Apache-2.0 License
+ * @brief Open-addressing hash index over MemTableRecords.
+ */
+
+#define HASH_INDEX_MIN_CAPACITY 128 ///< Initial number of slots in a HashIndex.
+
+/**
+ * @brief Single slot in a HashIndex.
+ *
+ * A slot is empty when `record` is NULL. The full hash is kept in the slot so
+ * that probes skip most mismatches without touching the key, and so that the
+ * table can grow without hashing the keys again.
+ */
+struct HashIndexEntry
+{
+  uint64_t hash;                 ///< Hash of the record's key.
+  struct MemTableRecord* record; ///< The indexed record or NULL.
+};
+
+/**
+ * @brief Open-addressing hash table from keys to MemTableRecords.
+ *
+ * The HashIndex uses linear probing and doubles its capacity whenever it is
+ * half full. Entries are never removed, because MemTable deletes are recorded
+ * as tombstone records.
+ *
+ * The counters report how often lookups found their key and how many slots
+ * they probed. The memory used by the table is `capacity` times the size of a
+ * HashIndexEntry.
+ */
+struct HashIndex
+{
+  struct HashIndexEntry* entries; ///< Array of slots.
+  size_t capacity;                ///< The number of slots. Always a power of 2.
+  size_t size;                    ///< The number of filled slots.
+
+  size_t lookups; ///< Number of calls to HashIndex_get.
+  size_t hits;    ///< Number of lookups that found their key.
+  size_t probes;  ///< Number of slots inspected by all lookups.
+};
+
+/**
+ * @brief Counters of a HashIndex.
+ */
+struct HashIndexStats
+{
+  size_t lookups; ///< Number of calls to HashIndex_get.
+  size_t hits;    ///< Number of lookups that found their key.
+  size_t probes;  ///< Number of slots inspected by all lookups.
+};
+
+/**
+ * @brief Creates a new empty HashIndex.
+ *
+ * Note: Free this HashIndex with HashIndex_free.
+ *
+ * @return A pointer to a new HashIndex.
+ */
+struct HashIndex*
+HashIndex_new();
+
+/**
+ * @brief Gets a MemTableRecord from a HashIndex by key.
+ *
+ * @param index The HashIndex to search.
+ * @param key The key to search with.
+ * @param key_len The length of the key.
+ * @param hash The hash of the key from WiscKey_key_hash.
+ * @return The MemTableRecord of the key or NULL if it isn't indexed.
+ */
+struct MemTableRecord*
+HashIndex_get(struct HashIndex* index,
+              const char* key,
+              size_t key_len,
+              uint64_t hash);
+
+/**
+ * @brief Adds a MemTableRecord to a HashIndex.
+ *
+ * The key of the record must not already be in the HashIndex.
+ *
+ * @param index The HashIndex to add to.
+ * @param record The record to index.
+ * @param hash The hash of the record's key from WiscKey_key_hash.
+ */
+void
+HashIndex_put(struct HashIndex* index,
+              struct MemTableRecord* record,
+              uint64_t hash);
+
+/**
+ * @brief Gets the number of bytes used by a HashIndex.
+ *
+ * @param index The HashIndex to measure.
+ * @return The size of the HashIndex and its slots in bytes.
+ */
+size_t
+HashIndex_memory(const struct HashIndex* index);
+
+/**
+ * @brief Reads the lookup counters of a HashIndex.
+ *
+ * The hit ratio is `hits / lookups` and the average probe length is
+ * `probes / lookups`.
+ *
+ * @param index The HashIndex to read.
+ * @param stats A pointer that is assigned to the counters.
+ */
+void
+HashIndex_stats(const struct HashIndex* index, struct HashIndexStats* stats);
+
+/**
+ * @brief Frees a HashIndex.
+ *
+ * Note: The indexed MemTableRecords are not freed.
+ *
+ * @param index The HashIndex to free.
+ */
+void
+HashIndex_free(struct HashIndex* index);
+
+#endif /* WISCKEY_HASH_INDEX_H */
@@ -19,37 +19,191 @@
 #include <string.h>
 
 #include "common.h"
+#include "hash_index.h"
 #include "memtable.h"
+#include "skiplist.h"
+
+/*
+ * Copies an inline value into the Arena of a MemTable and charges it to the
+ * byte budget.
+ */
+static struct MemTableValue*
+MemTableValue_new(struct MemTable* memtable, const char* value, size_t len)
+{
+  struct MemTableValue* copy =
+    Arena_alloc(memtable->arena, sizeof(struct MemTableValue) + len);
+  copy->len = len;
+  if (len > 0) {
+    memcpy(copy->data, value, len);
+  }
+  __atomic_fetch_add(&memtable->bytes,
+                     sizeof(struct MemTableValue) + len,
+                     __ATOMIC_RELAXED);
+
+  return copy;
+}
 
 static struct MemTableRecord*
-MemTableRecord_new(const char* key, size_t key_len, int64_t value_loc)
+MemTableRecord_new(struct Arena* arena,
+                   const char* key,
+                   size_t key_len,
+                   int64_t value_loc,
+                   size_t value_size,
+                   struct MemTableValue* value)
 {
-  struct MemTableRecord* record = malloc(sizeof(struct MemTableRecord));
+  // The key is stored directly behind the record in the same allocation.
+  struct MemTableRecord* record =
+    Arena_alloc(arena, sizeof(struct MemTableRecord) + key_len);
 
-  record->key = malloc(key_len);
+  record->key = (char*)(record + 1);
   memcpy(record->key, key, key_len);
   record->key_len = key_len;
 
   record->value_loc = value_loc;
+  record->value_size = value_size;
+  record->value = value;
 
   return record;
 }
 
 struct MemTable*
-MemTable_new()
+MemTable_new(size_t budget)
 {
   struct MemTable* memtable = malloc(sizeof(struct MemTable));
+  memtable->records =
+    malloc(MEMTABLE_MIN_CAPACITY * sizeof(struct MemTableRecord*));
+  memtable->prefixes =
+    malloc(MEMTABLE_MIN_CAPACITY * sizeof(struct MemTableKeyPrefix));
+  memtable->capacity = MEMTABLE_MIN_CAPACITY;
   memtable->size = 0;
+  memtable->bytes = 0;
+  memtable->budget = budget;
+  memtable->arena = Arena_new(MEMTABLE_ARENA_BLOCK_SIZE);
+  memtable->skiplist = NULL;
+  memtable->hash_index = NULL;
 
-  for (int i = 0; i < MEMTABLE_SIZE; i++) {
-    memtable->records[i] = NULL;
-  }
+  return memtable;
+}
+
+struct MemTable*
+MemTable_new_concurrent(size_t budget)
+{
+  struct MemTable* memtable = MemTable_new(budget);
+  memtable->skiplist = SkipList_new(memtable->arena);
+
+  // The SkipList doesn't use the arrays.
+  free(memtable->records);
+  free(memtable->prefixes);
+  memtable->records = NULL;
+  memtable->prefixes = NULL;
+  memtable->capacity = 0;
 
   return memtable;
 }
 
+int
+MemTable_enable_hash_index(struct MemTable* memtable)
+{
+  if (memtable->skiplist != NULL) {
+    return -1;
+  }
+  if (memtable->hash_index != NULL) {
+    return 0;
+  }
+
+  memtable->hash_index = HashIndex_new();
+  for (size_t i = 0; i < memtable->size; i++) {
+    struct MemTableRecord* record = memtable->records[i];
+    HashIndex_put(memtable->hash_index,
+                  record,
+                  WiscKey_key_hash(record->key, record->key_len));
+  }
+
+  return 0;
+}
+
+size_t
+MemTable_hash_index_memory(const struct MemTable* memtable)
+{
+  if (memtable->hash_index == NULL) {
+    return 0;
+  }
+
+  return HashIndex_memory(memtable->hash_index);
+}
+
+void
+MemTable_hash_index_stats(const struct MemTable* memtable,
+                          struct HashIndexStats* stats)
+{
+  if (memtable->hash_index == NULL) {
+    memset(stats, 0, sizeof(*stats));
+    return;
+  }
+
+  HashIndex_stats(memtable->hash_index, stats);
+}
+
+static uint64_t
+key_prefix(const char* key, size_t key_len)
+{
+  unsigned char bytes[MEMTABLE_PREFIX_LEN] = { 0 };
+  if (key_len > 0) {
+    memcpy(bytes,
+           key,
+           key_len < MEMTABLE_PREFIX_LEN ? key_len : MEMTABLE_PREFIX_LEN);
+  }
+
+  uint64_t prefix;
+  memcpy(&prefix, bytes, sizeof(prefix));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  prefix = __builtin_bswap64(prefix);
+#endif
+
+  return prefix;
+}
+
+/*
+ * Compares the key against the record at an index, same sign convention as
+ * WiscKey_key_cmp. The inline prefix decides the order unless the prefixes tie
+ * and one of the keys is longer than the prefix.
+ */
 static int
-binary_search(const struct MemTable* memtable, const char* key, size_t key_len)
+slot_cmp(const struct MemTable* memtable,
+         size_t idx,
+         const char* key,
+         size_t key_len,
+         uint64_t prefix)
+{
+  const struct MemTableKeyPrefix* slot = &memtable->prefixes[idx];
+  if (slot->prefix != prefix) {
+    return prefix < slot->prefix ? -1 : 1;
+  }
+
+  if (slot->key_len <= MEMTABLE_PREFIX_LEN && key_len <= MEMTABLE_PREFIX_LEN) {
+    // Both keys are entirely in the prefix, so the shorter key sorts first.
+    if (slot->key_len == key_len) {
+      return 0;
+    }
+    return key_len < slot->key_len ? -1 : 1;
+  }
+
+  const struct MemTableRecord* record = memtable->records[idx];
+  if (slot->key_len >= MEMTABLE_PREFIX_LEN && key_len >= MEMTABLE_PREFIX_LEN) {
+    // The first bytes are known to be equal.
+    return WiscKey_key_cmp(record->key + MEMTABLE_PREFIX_LEN,
+                           record->key_len - MEMTABLE_PREFIX_LEN,
+                           key + MEMTABLE_PREFIX_LEN,
+                           key_len - MEMTABLE_PREFIX_LEN);
+  }
+  return WiscKey_key_cmp(record->key, record->key_len, key, key_len);
+}
+
+static int
+binary_search(const struct MemTable* memtable,
+              const char* key,
+              size_t key_len,
+              uint64_t prefix)
 {
   if (memtable->size == 0) {
     return -1;
@@ -61,8 +215,7 @@ binary_search(const struct MemTable* memtable, const char* key, size_t key_len)
   while (a < b) {
     int m = a + (b - a) / 2;
 
-    int cmp = WiscKey_key_cmp(
-      memtable->records[m]->key, memtable->records[m]->key_len, key, key_len);
+    int cmp = slot_cmp(memtable, m, key, key_len, prefix);
     if (cmp == 0) {
       return m;
     } else if (cmp < 0) {
@@ -72,8 +225,7 @@ binary_search(const struct MemTable* memtable, const char* key, size_t key_len)
     }
   }
 
-  int cmp = WiscKey_key_cmp(
-    memtable->records[a]->key, memtable->records[a]->key_len, key, key_len);
+  int cmp = slot_cmp(memtable, a, key, key_len, prefix);
   if (cmp == 0) {
     return a;
   }
@@ -83,18 +235,18 @@ binary_search(const struct MemTable* memtable, const char* key, size_t key_len)
 static unsigned int
 insertion_point(const struct MemTable* memtable,
                 const char* key,
-                size_t key_len)
+                size_t key_len,
+                uint64_t prefix)
 {
   int a = 0;
   int b = (int)memtable->size;
 
   while (a < b) {
-    int m = (a + b) / 2;
+    int m = a + (b - a) / 2;
 
-    int cmp = WiscKey_key_cmp(
-      memtable->records[m]->key, memtable->records[m]->key_len, key, key_len);
+    int cmp = slot_cmp(memtable, m, key, key_len, prefix);
     if (cmp < 0) {
-      b = m - 1;
+      b = m;
     } else {
       a = m + 1;
     }
@@ -103,10 +255,325 @@ insertion_point(const struct MemTable* memtable,
   return a;
 }
 
+static struct MemTableRecord*
+MemTable_insert(struct MemTable* memtable,
+                const char* key,
+                size_t key_len,
+                uint64_t prefix,
+                int64_t value_loc,
+                size_t value_size,
+                struct MemTableValue* value)
+{
+  struct MemTableRecord* record = MemTableRecord_new(
+    memtable->arena, key, key_len, value_loc, value_size, value);
+
+  if (memtable->size == memtable->capacity) {
+    // Grow the array
+    memtable->capacity *= 2;
+    memtable->records = realloc(
+      memtable->records, memtable->capacity * sizeof(struct MemTableRecord*));
+    memtable->prefixes =
+      realloc(memtable->prefixes,
+              memtable->capacity * sizeof(struct MemTableKeyPrefix));
+  }
+
+  unsigned int insert_idx = insertion_point(memtable, key, key_len, prefix);
+
+  if (insert_idx < memtable->size) {
+    // Shift the arrays by one slot;
+    memmove(&memtable->records[insert_idx + 1],
+            &memtable->records[insert_idx],
+            sizeof(struct MemTableRecord*) * (memtable->size - insert_idx));
+    memmove(&memtable->prefixes[insert_idx + 1],
+            &memtable->prefixes[insert_idx],
+            sizeof(struct MemTableKeyPrefix) * (memtable->size - insert_idx));
+  }
+
+  memtable->records[insert_idx] = record;
+  memtable->prefixes[insert_idx].prefix = prefix;
+  memtable->prefixes[insert_idx].key_len = key_len;
+  memtable->size++;
+  memtable->bytes += key_len + MEMTABLE_RECORD_OVERHEAD;
+
+  return record;
+}
+
+/*
+ * Sets the value location and the inline value of a key in the array
+ * MemTable, inserting a new record when the key is missing.
+ */
+static void
+MemTable_put(struct MemTable* memtable,
+             const char* key,
+             size_t key_len,
+             int64_t value_loc,
+             size_t value_size,
+             struct MemTableValue* value)
+{
+  uint64_t prefix = key_prefix(key, key_len);
+
+  if (memtable->hash_index != NULL) {
+    uint64_t hash = WiscKey_key_hash(key, key_len);
+    struct MemTableRecord* record =
+      HashIndex_get(memtable->hash_index, key, key_len, hash);
+    if (record == NULL) {
+      record = MemTable_insert(
+        memtable, key, key_len, prefix, value_loc, value_size, value);
+      HashIndex_put(memtable->hash_index, record, hash);
+      return;
+    }
+
+    record->value_loc = value_loc;
+    record->value_size = value_size;
+    record->value = value;
+    return;
+  }
+
+  int idx = binary_search(memtable, key, key_len, prefix);
+  if (idx == -1) {
+    MemTable_insert(
+      memtable, key, key_len, prefix, value_loc, value_size, value);
+    return;
+  }
+
+  memtable->records[idx]->value_loc = value_loc;
+  memtable->records[idx]->value_size = value_size;
+  memtable->records[idx]->value = value;
+}
+
+static void
+MemTable_put_concurrent(struct MemTable* memtable,
+                        const char* key,
+                        size_t key_len,
+                        int64_t value_loc,
+                        size_t value_size,
+                        struct MemTableValue* value)
+{
+  if (SkipList_put(
+        memtable->skiplist, key, key_len, value_loc, value_size, value) == 1) {
+    __atomic_fetch_add(&memtable->size, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(
+      &memtable->bytes, key_len + MEMTABLE_RECORD_OVERHEAD, __ATOMIC_RELAXED);
+  }
+}
+
+/*
+ * Entry of a batch while it is being merged into the MemTable.
+ */
+struct BatchSlot
+{
+  const struct MemTableBatchEntry* entry; ///< The entry from the caller.
+  uint64_t prefix;                        ///< Key prefix of the entry.
+  uint64_t hash;                          ///< Hash of the key if indexed.
+  size_t order;                           ///< Position in the caller's batch.
+  struct MemTableRecord* record;          ///< The new record of the key.
+};
+
+static int
+batch_slot_cmp(const void* a, const void* b)
+{
+  const struct BatchSlot* lhs = a;
+  const struct BatchSlot* rhs = b;
+
+  // Sort by key and then by batch order, so the last write of a key is last.
+  if (lhs->prefix != rhs->prefix) {
+    return lhs->prefix < rhs->prefix ? -1 : 1;
+  }
+  int cmp = WiscKey_key_cmp(rhs->entry->key,
+                            rhs->entry->key_len,
+                            lhs->entry->key,
+                            lhs->entry->key_len);
+  if (cmp != 0) {
+    return cmp;
+  }
+  return lhs->order < rhs->order ? -1 : 1;
+}
+
+static void
+MemTable_apply_batch(struct MemTable* memtable,
+                     const struct MemTableBatchEntry* entries,
+                     size_t n,
+                     int delete)
+{
+  if (memtable->skiplist != NULL) {
+    for (size_t i = 0; i < n; i++) {
+      const struct MemTableBatchEntry* entry = &entries[i];
+      if (delete) {
+        MemTable_put_concurrent(
+          memtable, entry->key, entry->key_len, -1, 0, NULL);
+        continue;
+      }
+
+      struct MemTableValue* value = NULL;
+      if (entry->value_loc == MEMTABLE_VALUE_INLINE) {
+        value = MemTableValue_new(memtable, entry->value, entry->value_len);
+      }
+      MemTable_put_concurrent(memtable,
+                              entry->key,
+                              entry->key_len,
+                              entry->value_loc,
+                              entry->value_size,
+                              value);
+    }
+    return;
+  }
+  if (n == 0) {
+    return;
+  }
+
+  // Keys that already exist are overwritten in batch order, which keeps the
+  // last write. Only the new keys are sorted and merged into the arrays.
+  struct BatchSlot* slots = malloc(n * sizeof(struct BatchSlot));
+  size_t new_keys = 0;
+  for (size_t i = 0; i < n; i++) {
+    const struct MemTableBatchEntry* entry = &entries[i];
+    uint64_t prefix = key_prefix(entry->key, entry->key_len);
+
+    struct MemTableRecord* record = NULL;
+    uint64_t hash = 0;
+    if (memtable->hash_index != NULL) {
+      hash = WiscKey_key_hash(entry->key, entry->key_len);
+      record =
+        HashIndex_get(memtable->hash_index, entry->key, entry->key_len, hash);
+    } else {
+      int idx = binary_search(memtable, entry->key, entry->key_len, prefix);
+      if (idx != -1) {
+        record = memtable->records[idx];
+      }
+    }
+
+    if (record != NULL) {
+      if (delete) {
+        record->value_loc = -1;
+        record->value_size = 0;
+      } else {
+        if (entry->value_loc == MEMTABLE_VALUE_INLINE) {
+          record->value =
+            MemTableValue_new(memtable, entry->value, entry->value_len);
+        }
+        record->value_loc = entry->value_loc;
+        record->value_size = entry->value_size;
+      }
+      continue;
+    }
+
+    slots[new_keys].entry = entry;
+    slots[new_keys].prefix = prefix;
+    slots[new_keys].hash = hash;
+    slots[new_keys].order = i;
+    slots[new_keys].record = NULL;
+    new_keys++;
+  }
+  if (new_keys > 1) {
+    qsort(slots, new_keys, sizeof(struct BatchSlot), batch_slot_cmp);
+  }
+
+  // Keep the last entry of every new key and create its record.
+  size_t added = 0;
+  for (size_t i = 0; i < new_keys; i++) {
+    if (i + 1 < new_keys && slots[i].prefix == slots[i + 1].prefix &&
+        WiscKey_key_cmp(slots[i].entry->key,
+                        slots[i].entry->key_len,
+                        slots[i + 1].entry->key,
+                        slots[i + 1].entry->key_len) == 0) {
+      continue;
+    }
+
+    const struct MemTableBatchEntry* entry = slots[i].entry;
+    int64_t value_loc = delete ? -1 : entry->value_loc;
+    struct MemTableValue* value = NULL;
+    if (value_loc == MEMTABLE_VALUE_INLINE) {
+      value = MemTableValue_new(memtable, entry->value, entry->value_len);
+    }
+    slots[added] = slots[i];
+    slots[added].record = MemTableRecord_new(memtable->arena,
+                                             entry->key,
+                                             entry->key_len,
+                                             value_loc,
+                                             delete ? 0 : entry->value_size,
+                                             value);
+    if (memtable->hash_index != NULL) {
+      HashIndex_put(
+        memtable->hash_index, slots[added].record, slots[added].hash);
+    }
+    memtable->bytes += entry->key_len + MEMTABLE_RECORD_OVERHEAD;
+    added++;
+  }
+
+  if (added > 0) {
+    if (memtable->size + added > memtable->capacity) {
+      // Grow the arrays
+      while (memtable->size + added > memtable->capacity) {
+        memtable->capacity *= 2;
+      }
+      memtable->records =
+        realloc(memtable->records,
+                memtable->capacity * sizeof(struct MemTableRecord*));
+      memtable->prefixes =
+        realloc(memtable->prefixes,
+                memtable->capacity * sizeof(struct MemTableKeyPrefix));
+    }
+
+    // Merge from the back so every record is moved at most once. The merge
+    // stops as soon as the last new record is placed.
+    size_t i = memtable->size;
+    size_t j = added;
+    size_t k = memtable->size + added;
+    memtable->size += added;
+    while (j > 0) {
+      j--;
+
+      const struct MemTableRecord* record = slots[j].record;
+      while (i > 0 && slot_cmp(memtable,
+                               i - 1,
+                               record->key,
+                               record->key_len,
+                               slots[j].prefix) < 0) {
+        i--;
+        k--;
+        memtable->records[k] = memtable->records[i];
+        memtable->prefixes[k] = memtable->prefixes[i];
+      }
+
+      k--;
+      memtable->records[k] = slots[j].record;
+      memtable->prefixes[k].prefix = slots[j].prefix;
+      memtable->prefixes[k].key_len = record->key_len;
+    }
+  }
+
+  free(slots);
+}
+
+void
+MemTable_set_batch(struct MemTable* memtable,
+                   const struct MemTableBatchEntry* entries,
+                   size_t n)
+{
+  MemTable_apply_batch(memtable, entries, n, 0);
+}
+
+void
+MemTable_delete_batch(struct MemTable* memtable,
+                      const struct MemTableBatchEntry* entries,
+                      size_t n)
+{
+  MemTable_apply_batch(memtable, entries, n, 1);
+}
+
 struct MemTableRecord*
 MemTable_get(const struct MemTable* memtable, const char* key, size_t key_len)
 {
-  int idx = binary_search(memtable, key, key_len);
+  if (memtable->skiplist != NULL) {
+    return SkipList_get(memtable->skiplist, key, key_len);
+  }
+
+  if (memtable->hash_index != NULL) {
+    return HashIndex_get(
+      memtable->hash_index, key, key_len, WiscKey_key_hash(key, key_len));
+  }
+
+  int idx = binary_search(memtable, key, key_len, key_prefix(key, key_len));
   if (idx == -1) {
     return NULL;
   }
@@ -120,60 +587,140 @@ MemTable_set(struct MemTable* memtable,
              size_t key_len,
              int64_t value_loc)
 {
-  int idx = binary_search(memtable, key, key_len);
-  if (idx == -1) {
-    struct MemTableRecord* record = MemTableRecord_new(key, key_len, value_loc);
+  MemTable_set_sized(memtable, key, key_len, value_loc, 0);
+}
 
-    unsigned int insert_idx = insertion_point(memtable, key, key_len);
+void
+MemTable_set_sized(struct MemTable* memtable,
+                   const char* key,
+                   size_t key_len,
+                   int64_t value_loc,
+                   size_t value_size)
+{
+  if (memtable->skiplist != NULL) {
+    MemTable_put_concurrent(
+      memtable, key, key_len, value_loc, value_size, NULL);
+    return;
+  }
 
-    if (insert_idx < memtable->size) {
-      // Shift the array of records by one pointer;
-      memmove(&memtable->records[insert_idx + 1],
-              &memtable->records[insert_idx],
-              sizeof(struct MemTableRecord*) * (memtable->size - insert_idx));
-    }
+  MemTable_put(memtable, key, key_len, value_loc, value_size, NULL);
+}
 
-    memtable->records[insert_idx] = record;
-    memtable->size++;
+void
+MemTable_set_value(struct MemTable* memtable,
+                   const char* key,
+                   size_t key_len,
+                   const char* value,
+                   size_t value_len)
+{
+  struct MemTableValue* copy = MemTableValue_new(memtable, value, value_len);
+  if (memtable->skiplist != NULL) {
+    MemTable_put_concurrent(
+      memtable, key, key_len, MEMTABLE_VALUE_INLINE, 0, copy);
     return;
   }
 
-  memtable->records[idx]->value_loc = value_loc;
+  MemTable_put(memtable, key, key_len, MEMTABLE_VALUE_INLINE, 0, copy);
 }
 
 void
 MemTable_delete(struct MemTable* memtable, const char* key, size_t key_len)
 {
-  int idx = binary_search(memtable, key, key_len);
+  if (memtable->skiplist != NULL) {
+    MemTable_put_concurrent(memtable, key, key_len, -1, 0, NULL);
+    return;
+  }
 
-  if (idx == -1) {
-    struct MemTableRecord* record = MemTableRecord_new(key, key_len, -1);
+  MemTable_put(memtable, key, key_len, -1, 0, NULL);
+}
 
-    unsigned int insert_idx = insertion_point(memtable, key, key_len);
+int
+MemTable_should_flush(const struct MemTable* memtable)
+{
+  return __atomic_load_n(&memtable->bytes, __ATOMIC_RELAXED) >=
+         memtable->budget;
+}
 
-    if (insert_idx < memtable->size) {
-      // Shift the array of records by one pointer;
-      memmove(&(memtable->records[insert_idx + 1]),
-              &memtable->records[insert_idx],
-              sizeof(struct MemTableRecord*) * (memtable->size - insert_idx));
-    }
+void
+MemTableIterator_init(struct MemTableIterator* iter,
+                      const struct MemTable* memtable)
+{
+  iter->memtable = memtable;
+  iter->index = 0;
+  iter->node = NULL;
+
+  if (memtable->skiplist != NULL) {
+    iter->node = SkipList_first(memtable->skiplist);
+  }
+}
+
+void
+MemTableIterator_seek(struct MemTableIterator* iter,
+                      const struct MemTable* memtable,
+                      const char* key,
+                      size_t key_len)
+{
+  iter->memtable = memtable;
+  iter->index = 0;
+  iter->node = NULL;
 
-    memtable->records[insert_idx] = record;
-    memtable->size++;
+  if (memtable->skiplist != NULL) {
+    iter->node = SkipList_seek(memtable->skiplist, key, key_len);
     return;
   }
 
-  memtable->records[idx]->value_loc = -1;
+  // Finds the first record that isn't less than the key.
+  uint64_t prefix = key_prefix(key, key_len);
+  int a = 0;
+  int b = (int)memtable->size;
+  while (a < b) {
+    int m = a + (b - a) / 2;
+
+    int cmp = slot_cmp(memtable, m, key, key_len, prefix);
+    if (cmp <= 0) {
+      b = m;
+    } else {
+      a = m + 1;
+    }
+  }
+
+  iter->index = (size_t)a;
+}
+
+struct MemTableRecord*
+MemTableIterator_next(struct MemTableIterator* iter)
+{
+  if (iter->memtable->skiplist != NULL) {
+    struct SkipListNode* node = iter->node;
+    if (node == NULL) {
+      return NULL;
+    }
+
+    iter->node = SkipList_next(node);
+    return &node->record;
+  }
+
+  if (iter->index >= iter->memtable->size) {
+    return NULL;
+  }
+
+  return iter->memtable->records[iter->index++];
 }
 
 void
 MemTable_free(struct MemTable* memtable)
 {
-  // Free the MemTableRecords and its char*
-  for (size_t i = 0; i < memtable->size; i++) {
-    free(memtable->records[i]->key);
-    free(memtable->records[i]);
+  if (memtable->skiplist != NULL) {
+    SkipList_free(memtable->skiplist);
   }
+  if (memtable->hash_index != NULL) {
+    HashIndex_free(memtable->hash_index);
+  }
+
+  // The MemTableRecords and their keys are all held by the Arena
+  Arena_free(memtable->arena);
+  free(memtable->records);
+  free(memtable->prefixes);
 
   free(memtable);
 }
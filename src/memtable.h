@@ -20,7 +20,27 @@
 #include <stdint.h>
 #include <stdlib.h>
 
-#define MEMTABLE_SIZE 1024 ///< Max number of MemTableRecords in a MemTable
+#include "arena.h"
+
+struct HashIndex;
+struct HashIndexStats;
+
+struct SkipList;
+struct SkipListNode;
+
+#define MEMTABLE_DEFAULT_BUDGET                                                \
+  (4 * 1024 * 1024) ///< Default byte budget of a MemTable.
+#define MEMTABLE_MIN_CAPACITY                                                  \
+  64 ///< Initial capacity of the MemTable's records array.
+#define MEMTABLE_PREFIX_LEN                                                    \
+  8 ///< Number of key bytes held inline in a MemTableKeyPrefix.
+#define MEMTABLE_RECORD_OVERHEAD                                               \
+  (sizeof(struct MemTableRecord) + sizeof(struct MemTableRecord*) +            \
+   sizeof(struct MemTableKeyPrefix)) ///< Per-record bytes besides the key.
+#define MEMTABLE_ARENA_BLOCK_SIZE                                              \
+  (64 * 1024) ///< Size of the Arena blocks that back a MemTable.
+#define MEMTABLE_VALUE_INLINE                                                  \
+  (-3) ///< `value_loc` of a record whose value is held inline.
 
 /**
  * @file
@@ -30,17 +50,74 @@
  * @brief In-memory table of the records that have been modified most recently.
  */
 
+/**
+ * @brief Value held inline by a MemTableRecord.
+ *
+ * The length and the bytes are a single Arena allocation that never changes,
+ * so a record can switch to a new value with one pointer store.
+ */
+struct MemTableValue
+{
+  size_t len;  ///< The length of the value.
+  char data[]; ///< The value.
+};
+
 /**
  * @brief Single Record in the MemTable.
  *
  * Each MemTableRecord holds the key and the position of the record in the
- * ValueLog.
+ * ValueLog. The record and its key are allocated together from the MemTable's
+ * Arena.
+ *
+ * A small value can be held by the record itself instead of the ValueLog. Its
+ * `value_loc` is then MEMTABLE_VALUE_INLINE and `value` points at a copy in
+ * the Arena.
+ *
+ * Together, `value_loc` and `value_size` point at the whole ValueLog entry, so
+ * the value can be fetched with one read of the exact size.
  */
 struct MemTableRecord
 {
-  char* key;         ///< The key of the record.
+  char* key;                   ///< The key of the record.
+  size_t key_len;              ///< The length of the key.
+  int64_t value_loc;           ///< The location of the value in the ValueLog,
+                               ///< -1 for a tombstone or
+                               ///< MEMTABLE_VALUE_INLINE.
+  size_t value_size;           ///< The length of the ValueLog entry at
+                               ///< `value_loc`, or 0 if it isn't known.
+  struct MemTableValue* value; ///< The inline value. Only valid if
+                               ///< `value_loc` is MEMTABLE_VALUE_INLINE.
+};
+
+/**
+ * @brief Inline copy of the start of a MemTableRecord's key.
+ *
+ * The first MEMTABLE_PREFIX_LEN bytes of the key are packed big-endian into an
+ * integer, padded with zeros, so that comparing two prefixes as integers gives
+ * the same order as comparing the bytes. Most comparisons during a search are
+ * decided by the prefix without loading the record or its key.
+ */
+struct MemTableKeyPrefix
+{
+  uint64_t prefix; ///< The first bytes of the key as a big-endian integer.
+  size_t key_len;  ///< The length of the full key.
+};
+
+/**
+ * @brief Single key-value pair of a batch write to a MemTable.
+ */
+struct MemTableBatchEntry
+{
+  const char* key;   ///< The key of the record.
   size_t key_len;    ///< The length of the key.
-  int64_t value_loc; ///< The location of the value in the ValueLog.
+  int64_t value_loc; ///< The location of the value in the ValueLog or
+                     ///< MEMTABLE_VALUE_INLINE. Ignored by
+                     ///< MemTable_delete_batch.
+  size_t value_size; ///< The length of the ValueLog entry at `value_loc`, or
+                     ///< 0 if it isn't known.
+  const char* value; ///< The inline value. Only read if `value_loc` is
+                     ///< MEMTABLE_VALUE_INLINE.
+  size_t value_len;  ///< The length of the inline value.
 };
 
 /**
@@ -50,12 +127,61 @@ struct MemTableRecord
  * given time, there is only one active MemTable in the database engine. The
  * MemTable is always the first store to be searched when a key-value pair is
  * requested.
+ *
+ * The records and their keys live in an Arena owned by the MemTable, so they
+ * are released in one shot when the MemTable is freed. The Arena's counters
+ * report the number of allocations and the bytes used by the MemTable.
+ *
+ * The size of a MemTable is limited by a byte budget instead of a record count.
+ * Every new record charges its key length plus MEMTABLE_RECORD_OVERHEAD to
+ * `bytes`. Overwrites and deletes of an existing key reuse the record and
+ * don't change `bytes`. An inline value charges its length plus
+ * `sizeof(struct MemTableValue)` on every write, since an overwrite copies the
+ * new value instead of reusing the old one. Once `bytes` reaches `budget`,
+ * MemTable_should_flush signals that the MemTable should be frozen and flushed
+ * to a SSTable.
+ *
+ * The array MemTable keeps a MemTableKeyPrefix for every record in a parallel
+ * array. Binary search probes the dense prefix array and only follows the
+ * record pointer to the full key when two prefixes tie.
+ *
+ * The array MemTable can also keep a HashIndex over its keys, enabled with
+ * MemTable_enable_hash_index. Point lookups and the existence check of
+ * MemTable_set and MemTable_delete then probe the hash table in `O(1)` and
+ * only new keys pay for a binary search to find their slot in the array. The
+ * HashIndex costs extra memory that is not charged to the byte budget; see
+ * MemTable_hash_index_memory.
+ *
+ * A MemTable is backed either by a sorted array of records or, when created
+ * with MemTable_new_concurrent, by a lock-free SkipList. The array is the
+ * fastest option for a single writer. The SkipList lets many writers and
+ * readers use the MemTable at the same time without locks. Both are used
+ * through the same MemTable functions; use a MemTableIterator to walk the
+ * records in order regardless of the backing structure.
  */
 struct MemTable
 {
-  struct MemTableRecord*
-    records[MEMTABLE_SIZE]; ///< Array of records sorted by key.
-  size_t size;              ///< The number of records filled in `records`.
+  struct MemTableRecord** records;    ///< Growable array of records sorted by
+                                      ///< key. Unused with a SkipList.
+  struct MemTableKeyPrefix* prefixes; ///< Key prefixes of `records`, index by
+                                      ///< index. Unused with a SkipList.
+  size_t capacity;                    ///< Capacity of the arrays.
+  size_t size;                        ///< The number of records.
+  size_t bytes;                       ///< Bytes charged to the byte budget.
+  size_t budget;                      ///< Byte budget of the MemTable.
+  struct Arena* arena;                ///< Arena that holds records and keys.
+  struct SkipList* skiplist;          ///< Concurrent SkipList or NULL.
+  struct HashIndex* hash_index;       ///< Index over the keys or NULL.
+};
+
+/**
+ * @brief Iterator over the records of a MemTable in key order.
+ */
+struct MemTableIterator
+{
+  const struct MemTable* memtable; ///< The MemTable being iterated.
+  size_t index;                    ///< Next index into the records array.
+  struct SkipListNode* node;       ///< Next node in the SkipList.
 };
 
 /**
@@ -63,17 +189,71 @@ struct MemTable
  *
  * Note: Free this MemTable with MemTable_free.
  *
+ * @param budget The byte budget of the MemTable. Use MEMTABLE_DEFAULT_BUDGET
+ * for the default.
  * @return A new empty MemTable.
  */
 struct MemTable*
-MemTable_new();
+MemTable_new(size_t budget);
+
+/**
+ * @brief Creates a new empty MemTable backed by a lock-free SkipList.
+ *
+ * MemTable_get, MemTable_set, and MemTable_delete on this MemTable are safe to
+ * call from multiple threads at once.
+ *
+ * Note: Free this MemTable with MemTable_free.
+ *
+ * @param budget The byte budget of the MemTable. Use MEMTABLE_DEFAULT_BUDGET
+ * for the default.
+ * @return A new empty concurrent MemTable.
+ */
+struct MemTable*
+MemTable_new_concurrent(size_t budget);
+
+/**
+ * @brief Builds a HashIndex over the keys of a MemTable.
+ *
+ * The HashIndex is kept up to date by MemTable_set and MemTable_delete until
+ * the MemTable is freed. Enabling it twice has no effect.
+ *
+ * @param memtable The MemTable to index.
+ * @return This function returns 0 on success or -1 if the MemTable is backed
+ * by a SkipList, which doesn't support a HashIndex.
+ */
+int
+MemTable_enable_hash_index(struct MemTable* memtable);
+
+/**
+ * @brief Gets the number of bytes used by the HashIndex of a MemTable.
+ *
+ * @param memtable The MemTable to measure.
+ * @return The size of the HashIndex in bytes or 0 if it isn't enabled.
+ */
+size_t
+MemTable_hash_index_memory(const struct MemTable* memtable);
+
+/**
+ * @brief Reads the lookup counters of the HashIndex of a MemTable.
+ *
+ * The existence checks of MemTable_set and MemTable_delete are counted along
+ * with the lookups of MemTable_get.
+ *
+ * @param memtable The MemTable to read.
+ * @param stats A pointer that is assigned to the counters, or to zeros if the
+ * HashIndex isn't enabled.
+ */
+void
+MemTable_hash_index_stats(const struct MemTable* memtable,
+                          struct HashIndexStats* stats);
 
 /**
  * @brief Gets a MemTableRecord from a MemTable by key.
  *
  * This function will return NULL if none of the records in the MemTable.
  *
- * This function uses binary search for a runtime of `O(log(n))`.
+ * This function uses binary search for a runtime of `O(log(n))`, or the
+ * HashIndex for `O(1)` when it is enabled.
  *
  * @param memtable The MemTable to search.
  * @param key The key to search the MemTable with.
@@ -100,6 +280,47 @@ MemTable_set(struct MemTable* memtable,
              size_t key_len,
              int64_t value_loc);
 
+/**
+ * @brief Sets a key-value pair in a MemTable along with the length of the
+ * value's ValueLog entry.
+ *
+ * Same as MemTable_set, and the record's `value_size` is set too.
+ *
+ * @param memtable The MemTable to set a value to.
+ * @param key The key to set this value for.
+ * @param key_len The length of the key.
+ * @param value_loc The seek location to the value in the ValueLog.
+ * @param value_size The length of the ValueLog entry at `value_loc`, with its
+ * header and key, or 0 if it isn't known.
+ */
+void
+MemTable_set_sized(struct MemTable* memtable,
+                   const char* key,
+                   size_t key_len,
+                   int64_t value_loc,
+                   size_t value_size);
+
+/**
+ * @brief Sets a key to a value that is held inline in a MemTable.
+ *
+ * The value is copied into the Arena of the MemTable and the record's
+ * `value_loc` is set to MEMTABLE_VALUE_INLINE.
+ *
+ * This function uses binary search for a runtime of `O(log(n))`.
+ *
+ * @param memtable The MemTable to set a value to.
+ * @param key The key to set this value for.
+ * @param key_len The length of the key.
+ * @param value The value.
+ * @param value_len The length of the value.
+ */
+void
+MemTable_set_value(struct MemTable* memtable,
+                   const char* key,
+                   size_t key_len,
+                   const char* value,
+                   size_t value_len);
+
 /**
  * @brief Deletes a record from a MemTable.
  *
@@ -115,11 +336,93 @@ MemTable_set(struct MemTable* memtable,
 void
 MemTable_delete(struct MemTable* memtable, const char* key, size_t key_len);
 
+/**
+ * @brief Sets a batch of key-value pairs in a MemTable.
+ *
+ * Keys that already exist are overwritten in place. The new keys are sorted
+ * and merged into the records array in one pass instead of shifting the array
+ * once per key. When a key appears more than once in the batch, the last entry
+ * wins. The runtime is `O(n*log(m) + k*log(k) + r)` for a batch of `n` entries
+ * with `k` new keys, a MemTable of `m` records, and `r` records behind the
+ * first new key, instead of `O(n*m)`.
+ *
+ * Entries with a `value_loc` of MEMTABLE_VALUE_INLINE set their value inline
+ * like MemTable_set_value. The whole batch is applied even if it goes over the
+ * byte budget.
+ *
+ * @param memtable The MemTable to set the values to.
+ * @param entries The key-value pairs to set.
+ * @param n The number of entries.
+ */
+void
+MemTable_set_batch(struct MemTable* memtable,
+                   const struct MemTableBatchEntry* entries,
+                   size_t n);
+
+/**
+ * @brief Deletes a batch of keys from a MemTable.
+ *
+ * This function works like MemTable_set_batch but sets a tombstone for every
+ * key. The `value_loc` of the entries is ignored.
+ *
+ * @param memtable The MemTable to delete the records from.
+ * @param entries The keys to delete.
+ * @param n The number of entries.
+ */
+void
+MemTable_delete_batch(struct MemTable* memtable,
+                      const struct MemTableBatchEntry* entries,
+                      size_t n);
+
+/**
+ * @brief Checks if a MemTable has used up its byte budget.
+ *
+ * @param memtable The MemTable to check.
+ * @return This function returns 1 if the MemTable should be flushed and 0 if
+ * it still has room.
+ */
+int
+MemTable_should_flush(const struct MemTable* memtable);
+
+/**
+ * @brief Starts an iterator at the lowest key of a MemTable.
+ *
+ * @param iter The iterator to initialize.
+ * @param memtable The MemTable to iterate over.
+ */
+void
+MemTableIterator_init(struct MemTableIterator* iter,
+                      const struct MemTable* memtable);
+
+/**
+ * @brief Starts an iterator at the first key at or after a given key.
+ *
+ * @param iter The iterator to initialize.
+ * @param memtable The MemTable to iterate over.
+ * @param key The key to start at.
+ * @param key_len The length of the key.
+ */
+void
+MemTableIterator_seek(struct MemTableIterator* iter,
+                      const struct MemTable* memtable,
+                      const char* key,
+                      size_t key_len);
+
+/**
+ * @brief Gets the next record of a MemTable in key order.
+ *
+ * @param iter The iterator to advance.
+ * @return The next MemTableRecord or NULL if the iterator is exhausted.
+ */
+struct MemTableRecord*
+MemTableIterator_next(struct MemTableIterator* iter);
+
 /**
  * @brief Frees a MemTable and its records.
  *
  * Note: This function will free all the MemTableRecords plus their keys in this
- * MemTable.
+ * MemTable by releasing the MemTable's Arena. Pointers to MemTableRecords are
+ * invalid after this call.
  *
  * @param memtable The MemTable to free.
  */
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "read_pool.h"
+
+static void*
+ReadPool_thread(void* arg)
+{
+  struct ReadPool* pool = arg;
+
+  pthread_mutex_lock(&pool->lock);
+  while (1) {
+    while (pool->head == NULL && !pool->closing) {
+      pthread_cond_wait(&pool->work_cond, &pool->lock);
+    }
+    if (pool->head == NULL) {
+      break;
+    }
+
+    struct ReadPoolRead* read = pool->head;
+    pool->head = read->next;
+    if (pool->head == NULL) {
+      pool->tail = NULL;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    read->res = ValueLog_get_sized(pool->log,
+                                   &read->value,
+                                   &read->value_len,
+                                   read->loc,
+                                   read->size,
+                                   read->key,
+                                   read->key_len);
+
+    pthread_mutex_lock(&pool->lock);
+    read->done = 1;
+    pthread_cond_broadcast(&pool->done_cond);
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
+
+struct ReadPool*
+ReadPool_new(struct ValueLog* log, size_t threads)
+{
+  struct ReadPool* pool = malloc(sizeof(struct ReadPool));
+  pool->log = log;
+  pool->threads = calloc(threads, sizeof(pthread_t));
+  pool->threads_len = 0;
+  pool->head = NULL;
+  pool->tail = NULL;
+  pool->closing = 0;
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->work_cond, NULL);
+  pthread_cond_init(&pool->done_cond, NULL);
+
+  for (size_t i = 0; i < threads; i++) {
+    if (pthread_create(&pool->threads[i], NULL, ReadPool_thread, pool) != 0) {
+      fprintf(stderr, "Failed to start a ValueLog reader thread\n");
+      ReadPool_free(pool);
+      return NULL;
+    }
+    pool->threads_len++;
+  }
+
+  return pool;
+}
+
+void
+ReadPool_submit(struct ReadPool* pool, struct ReadPoolRead* read)
+{
+  read->done = 0;
+  read->next = NULL;
+
+  pthread_mutex_lock(&pool->lock);
+  if (pool->tail == NULL) {
+    pool->head = read;
+  } else {
+    pool->tail->next = read;
+  }
+  pool->tail = read;
+  pthread_cond_signal(&pool->work_cond);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void
+ReadPool_wait(struct ReadPool* pool, struct ReadPoolRead* read)
+{
+  pthread_mutex_lock(&pool->lock);
+  while (!read->done) {
+    pthread_cond_wait(&pool->done_cond, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void
+ReadPool_free(struct ReadPool* pool)
+{
+  pthread_mutex_lock(&pool->lock);
+  pool->closing = 1;
+  pthread_cond_broadcast(&pool->work_cond);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (size_t i = 0; i < pool->threads_len; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+
+  pthread_cond_destroy(&pool->done_cond);
+  pthread_cond_destroy(&pool->work_cond);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->threads);
+  free(pool);
+}
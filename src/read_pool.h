@@ -0,0 +1,117 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WISCKEY_READ_POOL_H
+#define WISCKEY_READ_POOL_H
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "value_log.h"
+
+/**
+ * @file
+ * @author Adam Comer <adambcomer@gmail.com>
+ * @date October 18, 2026
+ * @copyright Apache-2.0 License
+ * @brief Thread pool that reads values from the ValueLog ahead of time.
+ */
+
+/**
+ * @brief Value read submitted to a ReadPool.
+ *
+ * The caller owns the read. It must stay in place from ReadPool_submit until
+ * ReadPool_wait returns.
+ */
+struct ReadPoolRead
+{
+  size_t loc;                ///< ValueLog location of the value to read.
+  size_t size;               ///< Length of the entry at `loc` or 0.
+  const char* key;           ///< The key that the entry holds or NULL.
+  size_t key_len;            ///< Length of the key.
+  char* value;               ///< The value, allocated by ValueLog_get_sized.
+  size_t value_len;          ///< Length of the value.
+  int res;                   ///< The result of ValueLog_get_sized.
+  int done;                  ///< Set once the read finished.
+  struct ReadPoolRead* next; ///< Next read in the queue.
+};
+
+/**
+ * @brief Pool of threads that read values from a ValueLog.
+ *
+ * Reads are queued in the order they are submitted and taken by the first idle
+ * thread, so up to `threads_len` of them are in flight at once and the device
+ * sees a deep queue of random reads. The reads use `pread` through
+ * ValueLog_get_sized and need no lock on the ValueLog.
+ */
+struct ReadPool
+{
+  struct ValueLog* log;      ///< The ValueLog to read from.
+  pthread_t* threads;        ///< The reader threads.
+  size_t threads_len;        ///< The number of reader threads.
+  struct ReadPoolRead* head; ///< Oldest queued read or NULL.
+  struct ReadPoolRead* tail; ///< Newest queued read or NULL.
+  int closing;               ///< Set when the pool is shutting down.
+
+  pthread_mutex_t lock;     ///< Guards the queue and the `done` flags.
+  pthread_cond_t work_cond; ///< Signals a queued read.
+  pthread_cond_t done_cond; ///< Signals a finished read.
+};
+
+/**
+ * @brief Creates a ReadPool and starts its threads.
+ *
+ * Note: Free this ReadPool with ReadPool_free.
+ *
+ * @param log The ValueLog to read from.
+ * @param threads The number of reader threads.
+ * @return A pointer to a ReadPool or NULL if the threads couldn't be started.
+ */
+struct ReadPool*
+ReadPool_new(struct ValueLog* log, size_t threads);
+
+/**
+ * @brief Queues the read of a value.
+ *
+ * @param pool The ReadPool to read with.
+ * @param read The read. Only `loc` has to be set.
+ */
+void
+ReadPool_submit(struct ReadPool* pool, struct ReadPoolRead* read);
+
+/**
+ * @brief Waits for a read to finish.
+ *
+ * Note: The caller is responsible for freeing `read->value` if `read->res` is
+ * 0.
+ *
+ * @param pool The ReadPool the read was submitted to.
+ * @param read The read to wait for.
+ */
+void
+ReadPool_wait(struct ReadPool* pool, struct ReadPoolRead* read);
+
+/**
+ * @brief Stops the threads and frees the ReadPool.
+ *
+ * Every submitted read must be waited for first.
+ *
+ * @param pool The ReadPool to free.
+ */
+void
+ReadPool_free(struct ReadPool* pool);
+
+#endif /* WISCKEY_READ_POOL_H */
@@ -0,0 +1,273 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "common.h"
+#include "skiplist.h"
+
+static struct SkipListNode*
+SkipListNode_new(struct Arena* arena,
+                 const char* key,
+                 size_t key_len,
+                 int64_t value_loc,
+                 size_t value_size,
+                 struct MemTableValue* value,
+                 int height)
+{
+  // The tower and the key are stored directly behind the node.
+  size_t tower_size = sizeof(_Atomic(struct SkipListNode*)) * (size_t)height;
+  struct SkipListNode* node =
+    Arena_alloc(arena, sizeof(struct SkipListNode) + tower_size + key_len);
+  if (node == NULL) {
+    return NULL;
+  }
+
+  node->record.key = (char*)node + sizeof(struct SkipListNode) + tower_size;
+  if (key_len > 0) {
+    memcpy(node->record.key, key, key_len);
+  }
+  node->record.key_len = key_len;
+  node->record.value_loc = value_loc;
+  node->record.value_size = value_size;
+  node->record.value = value;
+  node->height = height;
+
+  for (int i = 0; i < height; i++) {
+    atomic_init(&node->next[i], NULL);
+  }
+
+  return node;
+}
+
+static int
+SkipListNode_cmp(const struct SkipListNode* node,
+                 const char* key,
+                 size_t key_len)
+{
+  // Positive if the key sorts after the node, same as the MemTable.
+  return WiscKey_key_cmp(
+    node->record.key, node->record.key_len, key, key_len);
+}
+
+static int
+random_height()
+{
+  static _Thread_local uint64_t state = 0;
+  if (state == 0) {
+    state = (uint64_t)(uintptr_t)&state ^ 0x9E3779B97F4A7C15ULL;
+  }
+
+  int height = 1;
+  while (height < SKIPLIST_MAX_HEIGHT) {
+    // xorshift64
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    if (state % SKIPLIST_BRANCHING != 0) {
+      break;
+    }
+    height++;
+  }
+
+  return height;
+}
+
+/*
+ * Walks one level starting at `pred` until the next node is not less than the
+ * key. Returns the last node that is less than the key and stores its
+ * successor.
+ */
+static struct SkipListNode*
+find_level(struct SkipListNode* pred,
+           int level,
+           const char* key,
+           size_t key_len,
+           struct SkipListNode** succ)
+{
+  while (1) {
+    struct SkipListNode* next =
+      atomic_load_explicit(&pred->next[level], memory_order_acquire);
+    if (next == NULL || SkipListNode_cmp(next, key, key_len) <= 0) {
+      *succ = next;
+      return pred;
+    }
+    pred = next;
+  }
+}
+
+/*
+ * Overwrites the value of a record. An inline value is published before the
+ * location that points readers at it, and the old one is left in place for
+ * readers that are still on their way to it. A reader may pair the location
+ * with the entry size of another write, so the size is only a hint.
+ */
+static void
+SkipList_store(struct MemTableRecord* record,
+               int64_t value_loc,
+               size_t value_size,
+               struct MemTableValue* value)
+{
+  if (value != NULL) {
+    __atomic_store_n(&record->value, value, __ATOMIC_RELEASE);
+  }
+  __atomic_store_n(&record->value_size, value_size, __ATOMIC_RELAXED);
+  __atomic_store_n(&record->value_loc, value_loc, __ATOMIC_RELEASE);
+}
+
+struct SkipList*
+SkipList_new(struct Arena* arena)
+{
+  struct SkipList* list = malloc(sizeof(struct SkipList));
+
+  list->arena = arena;
+  list->head =
+    SkipListNode_new(arena, NULL, 0, -1, 0, NULL, SKIPLIST_MAX_HEIGHT);
+  atomic_init(&list->height, 1);
+  atomic_init(&list->size, 0);
+
+  return list;
+}
+
+struct MemTableRecord*
+SkipList_get(const struct SkipList* list, const char* key, size_t key_len)
+{
+  struct SkipListNode* pred = list->head;
+  struct SkipListNode* succ = NULL;
+
+  int height = atomic_load_explicit(&list->height, memory_order_relaxed);
+  for (int level = height - 1; level >= 0; level--) {
+    pred = find_level(pred, level, key, key_len, &succ);
+  }
+
+  if (succ != NULL && SkipListNode_cmp(succ, key, key_len) == 0) {
+    return &succ->record;
+  }
+  return NULL;
+}
+
+int
+SkipList_put(struct SkipList* list,
+             const char* key,
+             size_t key_len,
+             int64_t value_loc,
+             size_t value_size,
+             struct MemTableValue* value)
+{
+  int height = random_height();
+
+  int list_height = atomic_load_explicit(&list->height, memory_order_relaxed);
+  while (height > list_height &&
+         !atomic_compare_exchange_weak_explicit(&list->height,
+                                                &list_height,
+                                                height,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+  }
+  if (list_height < height) {
+    list_height = height;
+  }
+
+  struct SkipListNode* preds[SKIPLIST_MAX_HEIGHT];
+  struct SkipListNode* succs[SKIPLIST_MAX_HEIGHT];
+
+  struct SkipListNode* pred = list->head;
+  for (int level = list_height - 1; level >= 0; level--) {
+    pred = find_level(pred, level, key, key_len, &succs[level]);
+    preds[level] = pred;
+  }
+
+  if (succs[0] != NULL && SkipListNode_cmp(succs[0], key, key_len) == 0) {
+    SkipList_store(&succs[0]->record, value_loc, value_size, value);
+    return 0;
+  }
+
+  struct SkipListNode* node = SkipListNode_new(
+    list->arena, key, key_len, value_loc, value_size, value, height);
+  if (node == NULL) {
+    return -1;
+  }
+
+  for (int level = 0; level < height; level++) {
+    while (1) {
+      atomic_store_explicit(
+        &node->next[level], succs[level], memory_order_relaxed);
+
+      struct SkipListNode* expected = succs[level];
+      if (atomic_compare_exchange_strong_explicit(&preds[level]->next[level],
+                                                  &expected,
+                                                  node,
+                                                  memory_order_release,
+                                                  memory_order_relaxed)) {
+        break;
+      }
+
+      // Another writer linked a node after the predecessor, find the splice
+      // at this level again. Nodes are never removed, so the old predecessor
+      // is still a valid place to restart from.
+      preds[level] =
+        find_level(preds[level], level, key, key_len, &succs[level]);
+
+      if (level == 0 && succs[0] != NULL &&
+          SkipListNode_cmp(succs[0], key, key_len) == 0) {
+        // Lost the race to insert the same key. The node stays unused in the
+        // Arena and the winner's record takes the value.
+        SkipList_store(&succs[0]->record, value_loc, value_size, value);
+        return 0;
+      }
+    }
+  }
+
+  atomic_fetch_add_explicit(&list->size, 1, memory_order_relaxed);
+  return 1;
+}
+
+struct SkipListNode*
+SkipList_first(const struct SkipList* list)
+{
+  return atomic_load_explicit(&list->head->next[0], memory_order_acquire);
+}
+
+struct SkipListNode*
+SkipList_seek(const struct SkipList* list, const char* key, size_t key_len)
+{
+  struct SkipListNode* pred = list->head;
+  struct SkipListNode* succ = NULL;
+
+  int height = atomic_load_explicit(&list->height, memory_order_relaxed);
+  for (int level = height - 1; level >= 0; level--) {
+    pred = find_level(pred, level, key, key_len, &succ);
+  }
+
+  return succ;
+}
+
+struct SkipListNode*
+SkipList_next(const struct SkipListNode* node)
+{
+  return atomic_load_explicit(&node->next[0], memory_order_acquire);
+}
+
+void
+SkipList_free(struct SkipList* list)
+{
+  free(list);
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WISCKEY_SKIPLIST_H
+#define WISCKEY_SKIPLIST_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "memtable.h"
+
+/**
+ * @file
+ * @author Adam Comer <adambcomer@gmail.com>
+ * @date March 9, 2025
+ * @copyright Apache-2.0 License
+ * @brief Lock-free concurrent skiplist of MemTableRecords.
+ */
+
+#define SKIPLIST_MAX_HEIGHT 16 ///< Max height of a SkipListNode tower.
+#define SKIPLIST_BRANCHING 4   ///< 1 in n nodes grow to the next level.
+
+/**
+ * @brief Single node in a SkipList.
+ *
+ * The node holds a MemTableRecord followed by its tower of next pointers. The
+ * node, the tower, and the key are a single Arena allocation.
+ */
+struct SkipListNode
+{
+  struct MemTableRecord record; ///< The record stored in this node.
+  int height;                   ///< The number of levels in `next`.
+  _Atomic(struct SkipListNode*) next[]; ///< Tower of next pointers.
+};
+
+/**
+ * @brief Lock-free skiplist of MemTableRecords sorted by key.
+ *
+ * Any number of threads can insert and read at the same time. Writers link
+ * new nodes into each level of the tower with compare-and-swap, so readers
+ * never block and never observe a partially linked node at level 0. Nodes are
+ * never unlinked; deletes are recorded as tombstones in `value_loc`, the same
+ * as the array MemTable.
+ *
+ * Overwrites of an existing key store the new `value_loc` atomically. Readers
+ * that race with writers should load `value_loc` with an atomic load, and
+ * then `value` if the value is inline.
+ */
+struct SkipList
+{
+  struct SkipListNode* head; ///< Sentinel node with a full height tower.
+  struct Arena* arena;       ///< Arena that holds the nodes and their keys.
+  _Atomic int height;        ///< The current height of the tallest tower.
+  _Atomic size_t size;       ///< The number of nodes in the SkipList.
+};
+
+/**
+ * @brief Creates a new empty SkipList.
+ *
+ * Note: Free this SkipList with SkipList_free. The Arena is not owned by the
+ * SkipList and must outlive it.
+ *
+ * @param arena The Arena to allocate the nodes from.
+ * @return A pointer to a new SkipList.
+ */
+struct SkipList*
+SkipList_new(struct Arena* arena);
+
+/**
+ * @brief Gets a MemTableRecord from a SkipList by key.
+ *
+ * This function runs in expected `O(log(n))` and never blocks.
+ *
+ * @param list The SkipList to search.
+ * @param key The key to search with.
+ * @param key_len The length of the key.
+ * @return The MemTableRecord of the key or NULL if it doesn't exist.
+ */
+struct MemTableRecord*
+SkipList_get(const struct SkipList* list, const char* key, size_t key_len);
+
+/**
+ * @brief Inserts a key into a SkipList or overwrites its `value_loc`.
+ *
+ * This function is safe to call from multiple threads at once.
+ *
+ * @param list The SkipList to insert into.
+ * @param key The key to insert.
+ * @param key_len The length of the key.
+ * @param value_loc The location of the value in the ValueLog, -1 for a
+ * tombstone or MEMTABLE_VALUE_INLINE.
+ * @param value_size The length of the ValueLog entry at `value_loc` or 0.
+ * @param value The inline value in the Arena or NULL.
+ * @return This function returns 1 if a new node was inserted, 0 if an existing
+ * record was overwritten, and -1 if the Arena is out of memory.
+ */
+int
+SkipList_put(struct SkipList* list,
+             const char* key,
+             size_t key_len,
+             int64_t value_loc,
+             size_t value_size,
+             struct MemTableValue* value);
+
+/**
+ * @brief Gets the node with the lowest key in a SkipList.
+ *
+ * @param list The SkipList to iterate over.
+ * @return The first node or NULL if the SkipList is empty.
+ */
+struct SkipListNode*
+SkipList_first(const struct SkipList* list);
+
+/**
+ * @brief Gets the node with the lowest key at or after a given key.
+ *
+ * @param list The SkipList to search.
+ * @param key The key to search for.
+ * @param key_len The length of the key.
+ * @return The node or NULL if every key is less than `key`.
+ */
+struct SkipListNode*
+SkipList_seek(const struct SkipList* list, const char* key, size_t key_len);
+
+/**
+ * @brief Gets the node that follows a node in key order.
+ *
+ * @param node The current node.
+ * @return The next node or NULL if `node` is the last one.
+ */
+struct SkipListNode*
+SkipList_next(const struct SkipListNode* node);
+
+/**
+ * @brief Frees a SkipList.
+ *
+ * Note: The nodes live in the Arena and are released with it.
+ *
+ * @param list The SkipList to free.
+ */
+void
+SkipList_free(struct SkipList* list);
+
+#endif /* WISCKEY_SKIPLIST_H */
@@ -18,44 +18,228 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "sstable.h"
 
+static int
+SSTable_read_varint(FILE* file, uint64_t* value)
+{
+  *value = 0;
+  for (int i = 0; i < WISCKEY_VARINT_MAX; i++) {
+    int byte = fgetc(file);
+    if (byte == EOF) {
+      return -1;
+    }
+
+    *value |= (uint64_t)(byte & 0x7F) << (7 * i);
+    if ((byte & 0x80) == 0) {
+      return i + 1;
+    }
+  }
+  return -1;
+}
+
+/*
+ * Decodes the value tag of a record. `value_len` is assigned to the length of
+ * an inline value or 0. Returns 1 if an entry size follows the tag.
+ */
+static int
+SSTable_decode_tag(const struct SSTable* table,
+                   uint64_t tag,
+                   int64_t* value_loc,
+                   uint64_t* value_len)
+{
+  *value_len = 0;
+  if (table->version == SSTABLE_VERSION_LOC) {
+    *value_loc = (int64_t)tag - 1;
+  } else if (tag & 1) {
+    *value_loc = MEMTABLE_VALUE_INLINE;
+    *value_len = tag >> 1;
+  } else {
+    *value_loc = (int64_t)(tag >> 1) - 1;
+  }
+
+  return table->version == SSTABLE_VERSION && *value_loc >= 0;
+}
+
+/**
+ * Reads the header of the record at the current position of the file. Returns
+ * the length of the header or -1 at the end of the file or on an error.
+ */
+static int
+SSTable_read_record_header(struct SSTable* table,
+                           uint64_t* key_len,
+                           int64_t* value_loc,
+                           uint64_t* value_len,
+                           uint64_t* value_size)
+{
+  *value_size = 0;
+  if (table->version == SSTABLE_VERSION_FIXED) {
+    *value_len = 0;
+    if (fread(key_len, sizeof(uint64_t), 1, table->file) != 1 ||
+        fread(value_loc, sizeof(int64_t), 1, table->file) != 1) {
+      return -1;
+    }
+    return sizeof(uint64_t) + sizeof(int64_t);
+  }
+
+  uint64_t tag;
+  int key_len_len = SSTable_read_varint(table->file, key_len);
+  if (key_len_len == -1) {
+    return -1;
+  }
+  int tag_len = SSTable_read_varint(table->file, &tag);
+  if (tag_len == -1) {
+    return -1;
+  }
+
+  int size_len = 0;
+  if (SSTable_decode_tag(table, tag, value_loc, value_len)) {
+    size_len = SSTable_read_varint(table->file, value_size);
+    if (size_len == -1) {
+      return -1;
+    }
+  }
+  return key_len_len + tag_len + size_len;
+}
+
+/*
+ * Decodes the record header at `buf`, of which `len` bytes can be read.
+ * Returns the length of the header or 0 if it is cut short.
+ */
+static size_t
+SSTable_decode_record_header(const struct SSTable* table,
+                             const char* buf,
+                             size_t len,
+                             uint64_t* key_len,
+                             int64_t* value_loc,
+                             uint64_t* value_len,
+                             uint64_t* value_size)
+{
+  *value_size = 0;
+  if (table->version == SSTABLE_VERSION_FIXED) {
+    *value_len = 0;
+    if (len < sizeof(uint64_t) + sizeof(int64_t)) {
+      return 0;
+    }
+    memcpy(key_len, buf, sizeof(uint64_t));
+    memcpy(value_loc, buf + sizeof(uint64_t), sizeof(int64_t));
+    return sizeof(uint64_t) + sizeof(int64_t);
+  }
+
+  uint64_t tag;
+  size_t key_len_len = WiscKey_varint_decode(buf, len, key_len);
+  if (key_len_len == 0) {
+    return 0;
+  }
+  size_t tag_len =
+    WiscKey_varint_decode(buf + key_len_len, len - key_len_len, &tag);
+  if (tag_len == 0) {
+    return 0;
+  }
+
+  size_t header_len = key_len_len + tag_len;
+  if (SSTable_decode_tag(table, tag, value_loc, value_len)) {
+    size_t size_len =
+      WiscKey_varint_decode(buf + header_len, len - header_len, value_size);
+    if (size_len == 0) {
+      return 0;
+    }
+    header_len += size_len;
+  }
+  return header_len;
+}
+
+/*
+ * Copies `len` bytes from `start` bytes into the record at `offset`. The bytes
+ * that are among the `buf_len` bytes already read into `buf` are copied from
+ * there and the rest is read from the file.
+ */
+static int
+SSTable_read_bytes(struct SSTable* table,
+                   const char* buf,
+                   size_t buf_len,
+                   uint64_t offset,
+                   size_t start,
+                   char* dst,
+                   size_t len)
+{
+  size_t have = 0;
+  if (start < buf_len) {
+    have = buf_len - start < len ? buf_len - start : len;
+    memcpy(dst, buf + start, have);
+  }
+  if (have < len) {
+    size_t rest = len - have;
+    ssize_t b_read = pread(
+      fileno(table->file), dst + have, rest, (off_t)(offset + start + have));
+    if (b_read != (ssize_t)rest) {
+      perror("pread");
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
 int
 SSTableRecord_read(struct SSTable* table,
                    struct SSTableRecord* record,
-                   uint64_t offset)
+                   uint64_t offset,
+                   int read_value)
 {
-  int seek_res = fseeko(table->file, (long long)offset, SEEK_SET);
-  if (seek_res == -1) {
-    perror("fseeko");
+  // Positional reads leave the file offset alone, so any number of threads
+  // can search the SSTable. Short keys and values come with the header in one
+  // read.
+  char buf[SSTABLE_RECORD_MAX_HEADER_SIZE + SSTABLE_INLINE_KEY_SIZE];
+  ssize_t b_read = pread(fileno(table->file), buf, sizeof(buf), (off_t)offset);
+  if (b_read == -1) {
+    perror("pread");
     return -1;
   }
 
   uint64_t key_len;
-  size_t file_res = fread(&key_len, sizeof(uint64_t), 1, table->file);
-  if (file_res != 1) {
-    perror("fread");
+  int64_t val_loc;
+  uint64_t value_len;
+  uint64_t value_size;
+  size_t header_len = SSTable_decode_record_header(
+    table, buf, (size_t)b_read, &key_len, &val_loc, &value_len, &value_size);
+  if (header_len == 0) {
+    fprintf(stderr, "SSTable record at %lu is cut short\n", offset);
     return -1;
   }
 
-  int64_t val_loc;
-  file_res = fread(&val_loc, sizeof(int64_t), 1, table->file);
-  if (file_res != 1) {
-    perror("fread");
+  char* table_key = malloc(key_len > 0 ? key_len : 1);
+  if (SSTable_read_bytes(
+        table, buf, (size_t)b_read, offset, header_len, table_key, key_len) ==
+      -1) {
+    free(table_key);
     return -1;
   }
 
-  char* table_key = malloc(key_len);
-  file_res = fread(table_key, sizeof(char), key_len, table->file);
-  if (file_res != key_len) {
-    perror("fread");
-    return -1;
+  char* value = NULL;
+  if (read_value && val_loc == MEMTABLE_VALUE_INLINE) {
+    value = malloc(value_len > 0 ? value_len : 1);
+    if (SSTable_read_bytes(table,
+                           buf,
+                           (size_t)b_read,
+                           offset,
+                           header_len + key_len,
+                           value,
+                           value_len) == -1) {
+      free(value);
+      free(table_key);
+      return -1;
+    }
   }
 
   record->key_len = key_len;
   record->value_loc = val_loc;
+  record->value_size = value_size;
   record->key = table_key;
+  record->value = value;
+  record->value_len = value_len;
 
   return 0;
 }
@@ -148,8 +332,26 @@ SSTable_new(char* path)
   table->records = malloc(SSTABLE_MIN_SIZE * sizeof(uint64_t));
   table->capacity = SSTABLE_MIN_SIZE;
   table->size = 0;
+  table->low_key = NULL;
+  table->high_key = NULL;
+
+  // SSTables written before the header was added start with a record.
+  uint32_t header[2];
+  size_t file_res = fread(header, sizeof(uint32_t), 2, table->file);
+  if (file_res == 2 && header[0] == SSTABLE_MAGIC) {
+    if (header[1] != SSTABLE_VERSION && header[1] != SSTABLE_VERSION_INLINE &&
+        header[1] != SSTABLE_VERSION_LOC) {
+      fprintf(stderr, "Unknown SSTable version %u in %s\n", header[1], path);
+      SSTable_free(table);
+      return NULL;
+    }
+    table->version = header[1];
+  } else {
+    table->version = SSTABLE_VERSION_FIXED;
+    rewind(table->file);
+  }
 
-  uint64_t curr_offset = 0;
+  uint64_t curr_offset = ftello(table->file);
   while (1) {
     int peek = fgetc(table->file);
     ungetc(peek, table->file);
@@ -158,103 +360,46 @@ SSTable_new(char* path)
     }
 
     uint64_t key_len;
-    size_t file_res = fread(&key_len, sizeof(uint64_t), 1, table->file);
-    if (file_res != 1) {
+    int64_t val_loc;
+    uint64_t value_len;
+    uint64_t value_size;
+    int header_len = SSTable_read_record_header(
+      table, &key_len, &val_loc, &value_len, &value_size);
+    if (header_len == -1) {
       perror("fread");
-      free(table);
+      SSTable_free(table);
       return NULL;
     }
 
-    uint64_t next = key_len + sizeof(int64_t);
-
-    file_res = fseeko(table->file, (long long)next, SEEK_CUR);
-    if (file_res != 0) {
-      perror("fread");
-      free(table);
+    int seek_res =
+      fseeko(table->file, (long long)(key_len + value_len), SEEK_CUR);
+    if (seek_res != 0) {
+      perror("fseeko");
+      SSTable_free(table);
       return NULL;
     }
 
     SSTable_append_offset(table, curr_offset);
 
-    curr_offset += next + sizeof(uint64_t);
-  }
-
-  int seek_res = fseeko( // NOLINT(clang-analyzer-core.CallAndMessage)
-    table->file,
-    (long long)table->records[0],
-    SEEK_SET);
-  if (seek_res == -1) {
-    perror("fseeko");
-    free(table);
-    return NULL;
-  }
-
-  uint64_t low_key_len;
-  size_t file_res = fread(&low_key_len, sizeof(uint64_t), 1, table->file);
-  if (file_res != 1) {
-    perror("fread");
-    free(table);
-    return NULL;
-  }
-
-  uint64_t val_loc;
-  file_res = fread(&val_loc, sizeof(int64_t), 1, table->file);
-  if (file_res != 1) {
-    perror("fread");
-    free(table);
-    return NULL;
-  }
-
-  char* low_key = malloc(low_key_len);
-  file_res = fread(low_key, sizeof(char), low_key_len, table->file);
-  if (file_res != low_key_len) {
-    perror("fread");
-    free(table);
-    free(low_key);
-    return NULL;
-  }
-
-  table->low_key = low_key;
-  table->low_key_len = low_key_len;
-
-  seek_res =
-    fseeko(table->file, (long long)table->records[table->size - 1], SEEK_SET);
-  if (seek_res == -1) {
-    perror("fseeko");
-    free(table);
-    free(low_key);
-    return NULL;
+    curr_offset += header_len + key_len + value_len;
   }
 
-  uint64_t high_key_len;
-  file_res = fread(&high_key_len, sizeof(uint64_t), 1, table->file);
-  if (file_res != 1) {
-    perror("fread");
-    free(table);
-    free(low_key);
+  struct SSTableRecord low;
+  if (SSTableRecord_read(table, &low, table->records[0], 0) == -1) {
+    SSTable_free(table);
     return NULL;
   }
+  table->low_key = low.key;
+  table->low_key_len = low.key_len;
 
-  file_res = fread(&val_loc, sizeof(int64_t), 1, table->file);
-  if (file_res != 1) {
-    perror("fread");
-    free(table);
-    free(low_key);
+  struct SSTableRecord high;
+  if (SSTableRecord_read(
+        table, &high, table->records[table->size - 1], 0) == -1) {
+    SSTable_free(table);
     return NULL;
   }
-
-  char* high_key = malloc(high_key_len);
-  file_res = fread(high_key, sizeof(char), high_key_len, table->file);
-  if (file_res != high_key_len) {
-    perror("fread");
-    free(table);
-    free(low_key);
-    free(high_key);
-    return NULL;
-  }
-
-  table->high_key = high_key;
-  table->high_key_len = high_key_len;
+  table->high_key = high.key;
+  table->high_key_len = high.key_len;
 
   return table;
 }
@@ -268,31 +413,65 @@ SSTable_new_from_memtable(char* path, struct MemTable* memtable)
     return NULL;
   }
 
-  for (size_t i = 0; i < memtable->size; i++) {
-    uint64_t key_len = memtable->records[i]->key_len;
-    int64_t value_loc = memtable->records[i]->value_loc;
+  uint32_t header[2] = { SSTABLE_MAGIC, SSTABLE_VERSION };
+  size_t res = fwrite(header, sizeof(uint32_t), 2, file);
+  if (res != 2) {
+    perror("fwrite");
+    return NULL;
+  }
+
+  struct MemTableIterator iter;
+  MemTableIterator_init(&iter, memtable);
+
+  struct MemTableRecord* record;
+  while ((record = MemTableIterator_next(&iter)) != NULL) {
+    // Locations are stored off by one, so a tombstone has a tag of 0.
+    uint64_t tag = (uint64_t)(record->value_loc + 1) << 1;
+    const struct MemTableValue* value = NULL;
+    if (record->value_loc == MEMTABLE_VALUE_INLINE) {
+      value = record->value;
+      tag = (uint64_t)value->len << 1 | 1;
+    }
 
-    size_t res = fwrite(&key_len, sizeof(uint64_t), 1, file);
-    if (res != 1) {
+    char record_header[SSTABLE_RECORD_MAX_HEADER_SIZE];
+    size_t header_len = WiscKey_varint_encode(record_header, record->key_len);
+    header_len += WiscKey_varint_encode(record_header + header_len, tag);
+    if (record->value_loc >= 0) {
+      header_len +=
+        WiscKey_varint_encode(record_header + header_len, record->value_size);
+    }
+
+    res = fwrite(record_header, sizeof(char), header_len, file);
+    if (res != header_len) {
       perror("fwrite");
       return NULL;
     }
 
-    res = fwrite(&value_loc, sizeof(int64_t), 1, file);
-    if (res != 1) {
+    res = fwrite(record->key, sizeof(char), record->key_len, file);
+    if (res != record->key_len) {
       perror("fwrite");
       return NULL;
     }
 
-    res = fwrite(memtable->records[i]->key, sizeof(char), key_len, file);
-    if (res != key_len) {
+    if (value != NULL &&
+        fwrite(value->data, sizeof(char), value->len, file) != value->len) {
       perror("fwrite");
       return NULL;
     }
   }
 
-  int res = fclose(file);
-  if (res == -1) {
+  // The SSTable must be durable before the WAL that covers it is removed.
+  if (fflush(file) == EOF) {
+    perror("fflush");
+    return NULL;
+  }
+
+  if (fsync(fileno(file)) == -1) {
+    perror("fsync");
+    return NULL;
+  }
+
+  if (fclose(file) == -1) {
     perror("fclose");
     return NULL;
   }
@@ -313,8 +492,50 @@ SSTable_key_cmp(struct SSTableRecord* r, const char* key, size_t key_len)
   return key_len < r->key_len ? -1 : 1;
 }
 
+/*
+ * Returns the value location of the record at an index that matched a search,
+ * and reads its inline value or assigns its entry size if it is asked for.
+ */
+static int64_t
+SSTable_found(struct SSTable* table,
+              size_t idx,
+              const struct SSTableRecord* found,
+              char** value,
+              size_t* value_len,
+              size_t* value_size)
+{
+  int64_t value_loc = found->value_loc;
+  if (value_size != NULL) {
+    *value_size = found->value_size;
+  }
+  if (value_loc != MEMTABLE_VALUE_INLINE || value == NULL) {
+    return value_loc;
+  }
+
+  struct SSTableRecord record;
+  if (SSTableRecord_read(table, &record, table->records[idx], 1) == -1) {
+    return -1;
+  }
+  free(record.key);
+  *value = record.value;
+  *value_len = record.value_len;
+
+  return value_loc;
+}
+
 int64_t
 SSTable_get_value_loc(struct SSTable* table, char* key, size_t key_len)
+{
+  return SSTable_get(table, key, key_len, NULL, NULL, NULL);
+}
+
+int64_t
+SSTable_get(struct SSTable* table,
+            char* key,
+            size_t key_len,
+            char** value,
+            size_t* value_len,
+            size_t* value_size)
 {
   if (table->size == 0) {
     return SSTABLE_KEY_NOT_FOUND;
@@ -327,7 +548,7 @@ SSTable_get_value_loc(struct SSTable* table, char* key, size_t key_len)
     int m = a + (b - a) / 2;
 
     struct SSTableRecord record;
-    int res = SSTableRecord_read(table, &record, table->records[m]);
+    int res = SSTableRecord_read(table, &record, table->records[m], 0);
     if (res == -1) {
       perror("Error reading record from SSTable");
       return -1;
@@ -336,7 +557,7 @@ SSTable_get_value_loc(struct SSTable* table, char* key, size_t key_len)
     int cmp = SSTable_key_cmp(&record, key, key_len);
     free(record.key);
     if (cmp == 0) {
-      return record.value_loc;
+      return SSTable_found(table, m, &record, value, value_len, value_size);
     } else if (cmp < 0) {
       b = m - 1;
     } else {
@@ -345,7 +566,7 @@ SSTable_get_value_loc(struct SSTable* table, char* key, size_t key_len)
   }
 
   struct SSTableRecord record;
-  int res = SSTableRecord_read(table, &record, table->records[a]);
+  int res = SSTableRecord_read(table, &record, table->records[a], 0);
   if (res == -1) {
     perror("Error reading record from SSTable");
     return -1;
@@ -354,7 +575,7 @@ SSTable_get_value_loc(struct SSTable* table, char* key, size_t key_len)
   int cmp = SSTable_key_cmp(&record, key, key_len);
   free(record.key);
   if (cmp == 0) {
-    return record.value_loc;
+    return SSTable_found(table, a, &record, value, value_len, value_size);
   }
   return SSTABLE_KEY_NOT_FOUND;
 }
@@ -388,6 +609,59 @@ SSTable_in_key_range(struct SSTable* table, char* key, size_t key_len)
   return 0;
 }
 
+int
+SSTableIterator_seek(struct SSTableIterator* iter,
+                     struct SSTable* table,
+                     const char* key,
+                     size_t key_len)
+{
+  iter->table = table;
+  iter->index = 0;
+  if (key == NULL) {
+    return 0;
+  }
+
+  // Finds the first record that isn't less than the key.
+  size_t a = 0;
+  size_t b = table->size;
+  while (a < b) {
+    size_t m = a + (b - a) / 2;
+
+    struct SSTableRecord record;
+    if (SSTableRecord_read(table, &record, table->records[m], 0) == -1) {
+      return -1;
+    }
+    int cmp = SSTable_key_cmp(&record, key, key_len);
+    free(record.key);
+
+    if (cmp > 0) {
+      a = m + 1;
+    } else {
+      b = m;
+    }
+  }
+
+  iter->index = a;
+  return 0;
+}
+
+int
+SSTableIterator_next(struct SSTableIterator* iter,
+                     struct SSTableRecord* record)
+{
+  if (iter->index >= iter->table->size) {
+    return 0;
+  }
+
+  uint64_t offset = iter->table->records[iter->index];
+  if (SSTableRecord_read(iter->table, record, offset, 1) == -1) {
+    return -1;
+  }
+  iter->index++;
+
+  return 1;
+}
+
 void
 SSTable_free(struct SSTable* table)
 {
@@ -17,8 +17,10 @@
 #ifndef WISCKEY_SSTABLE_H
 #define WISCKEY_SSTABLE_H
 
+#include <stdint.h>
 #include <stdio.h>
 
+#include "common.h"
 #include "memtable.h"
 
 /**
@@ -32,18 +34,33 @@
 #define SSTABLE_MIN_SIZE                                                       \
   1024 ///< Minimum number of records in a SSTable index array.
 #define SSTABLE_KEY_NOT_FOUND (-2) ///< Return value if the value is not found.
+#define SSTABLE_MAGIC 0x54535357U  ///< Magic number at the start of a SSTable.
+#define SSTABLE_VERSION 3          ///< Version of the records that are written.
+#define SSTABLE_VERSION_FIXED 0    ///< Version with fixed-size record headers.
+#define SSTABLE_VERSION_LOC 1      ///< Version without inline values.
+#define SSTABLE_VERSION_INLINE 2   ///< Version without ValueLog entry sizes.
+#define SSTABLE_HEADER_SIZE 8      ///< Size of the file header in bytes.
+#define SSTABLE_RECORD_MAX_HEADER_SIZE                                         \
+  (3 * WISCKEY_VARINT_MAX) ///< Longest record header in bytes.
+#define SSTABLE_INLINE_KEY_SIZE                                                \
+  64 ///< Key bytes read along with a record header.
 
 /**
  * @brief Single Record in a SSTable.
  *
  * Each SSTableRecord holds the key and the position of the record in the
- * ValueLog.
+ * ValueLog, or the value itself if it is held inline.
  */
 struct SSTableRecord
 {
   char* key;         ///< Key of the record.
   size_t key_len;    ///< Length of they key.
-  int64_t value_loc; ///< Location of the value in the ValueLog.
+  int64_t value_loc; ///< Location of the value in the ValueLog, -1 for a
+                     ///< tombstone or MEMTABLE_VALUE_INLINE.
+  size_t value_size; ///< Length of the ValueLog entry at `value_loc`, or 0 if
+                     ///< it isn't known.
+  char* value;       ///< The inline value or NULL.
+  size_t value_len;  ///< Length of the inline value.
 };
 
 /**
@@ -53,6 +70,30 @@ struct SSTableRecord
  * are sorted by their key as to support binary search. If a record isn't found
  * in the MemTable, then the database searches the SSTables starting with the
  * lowest one in the hierarchy.
+ *
+ * A SSTable starts with a header of the magic number and the format version,
+ * each a `uint32_t`. Every record is then laid out as:
+ *
+ * | Field            | Size          |
+ * |------------------|---------------|
+ * | Key length       | varint        |
+ * | Value tag        | varint        |
+ * | Entry size       | varint        |
+ * | Key              | Key length    |
+ * | Inline value     | Value length  |
+ *
+ * Records are read with `pread`, so any number of threads can search a
+ * SSTable at once.
+ *
+ * An even value tag is the value location plus one, times two, and a tag of 0
+ * marks a deleted key. A location is followed by the length of its ValueLog
+ * entry, or 0 if it isn't known, and the other tags have no entry size. An odd
+ * tag is the length of an inline value, times two plus one, and the value
+ * follows the key. SSTables of version SSTABLE_VERSION_INLINE have no entry
+ * sizes, and SSTables of version SSTABLE_VERSION_LOC have no inline values and
+ * store the value location plus one. SSTables written before the header was
+ * added are read as version SSTABLE_VERSION_FIXED, where a record starts with a
+ * `uint64_t` key length and an `int64_t` value location.
  */
 struct SSTable
 {
@@ -60,6 +101,7 @@ struct SSTable
   unsigned long timestamp; ///< Creation timestamp in microseconds.
   unsigned long level;     ///< Compaction level.
   FILE* file;              ///< File that the keys reside on.
+  uint32_t version;        ///< The format version of the SSTable.
   uint64_t* records; ///< In-memory index of the location of the keys. Growable
                      ///< array with size and capacity. Uses 8 bytes per key.
   size_t capacity;   ///< Capacity of the growable in-memory index.
@@ -73,6 +115,15 @@ struct SSTable
   size_t high_key_len; ///< Length of the highest key.
 };
 
+/**
+ * @brief Iterator over the records of a SSTable in key order.
+ */
+struct SSTableIterator
+{
+  struct SSTable* table; ///< The SSTable being iterated.
+  size_t index;          ///< Index of the next record.
+};
+
 /**
  * @brief Parses the creation timestamp in microseconds from a SSTable filename.
  *
@@ -110,7 +161,8 @@ SSTable_new(char* path);
  * @brief Creates a new SSTable from a full MemTable.
  *
  * This function will create a new SSTable at a path. If a file already exists
- * at this path, then the file will be overwritten.
+ * at this path, then the file will be overwritten. The file is synced to disk
+ * before the SSTable is loaded.
  *
  * Note: The MemTable will not be freed after creating a new SSTable. The caller
  * is responsible for freeing the MemTable.
@@ -132,12 +184,39 @@ SSTable_new_from_memtable(char* path, struct MemTable* memtable);
  * @param key The key to search with.
  * @param key_len The length of the key.
  * @return This function returns the position in the ValueLog if the key is
- * found. -2 if the key is not in the SSTable. -1 if there is an error reading
- * the record.
+ * found. MEMTABLE_VALUE_INLINE if the value is inline. -2 if the key is not in
+ * the SSTable. -1 if there is an error reading the record.
  */
 int64_t
 SSTable_get_value_loc(struct SSTable* table, char* key, size_t key_len);
 
+/**
+ * @brief Gets the location of a value or the value itself from a key.
+ *
+ * Same as SSTable_get_value_loc, and an inline value is read as well.
+ *
+ * Note: The caller is responsible for freeing `*value`.
+ *
+ * @param table The SSTable to search.
+ * @param key The key to search with.
+ * @param key_len The length of the key.
+ * @param value A pointer that is assigned to a copy of the inline value or
+ * NULL to skip it.
+ * @param value_len A pointer that is assigned to the length of the inline
+ * value.
+ * @param value_size A pointer that is assigned to the length of the ValueLog
+ * entry of the value, or 0 if it isn't known, or NULL to skip it.
+ * @return The same as SSTable_get_value_loc. `value` is only assigned if this
+ * function returns MEMTABLE_VALUE_INLINE.
+ */
+int64_t
+SSTable_get(struct SSTable* table,
+            char* key,
+            size_t key_len,
+            char** value,
+            size_t* value_len,
+            size_t* value_size);
+
 /**
  * @brief Checks if the given key could be in this SSTable.
  *
@@ -152,6 +231,39 @@ SSTable_get_value_loc(struct SSTable* table, char* key, size_t key_len);
 int
 SSTable_in_key_range(struct SSTable* table, char* key, size_t key_len);
 
+/**
+ * @brief Starts an iterator at the first key at or after a given key.
+ *
+ * The start is found with a binary search like SSTable_get_value_loc.
+ *
+ * @param iter The iterator to initialize.
+ * @param table The SSTable to iterate over.
+ * @param key The key to start at or NULL to start at the lowest key.
+ * @param key_len The length of the key.
+ * @return This function returns 0 if the iterator was positioned and -1 if
+ * there was an error reading a record.
+ */
+int
+SSTableIterator_seek(struct SSTableIterator* iter,
+                     struct SSTable* table,
+                     const char* key,
+                     size_t key_len);
+
+/**
+ * @brief Reads the next record of a SSTable in key order.
+ *
+ * Note: The caller is responsible for freeing `record->key` and
+ * `record->value`.
+ *
+ * @param iter The iterator to advance.
+ * @param record A pointer that is assigned to the next record.
+ * @return This function returns 1 if a record was read, 0 if the iterator is
+ * exhausted and -1 if there was an error.
+ */
+int
+SSTableIterator_next(struct SSTableIterator* iter,
+                     struct SSTableRecord* record);
+
 /**
  * @brief Frees the SSTable.
  *
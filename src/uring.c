@@ -0,0 +1,167 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "uring.h"
+
+#ifdef WISCKEY_HAVE_LIBURING
+
+#include <liburing.h>
+
+#define URING_WRITE 0 ///< User data of a write request.
+#define URING_SYNC 1  ///< User data of a sync request.
+
+struct Uring
+{
+  struct io_uring ring; ///< The submission and completion queues.
+};
+
+struct Uring*
+Uring_new()
+{
+  struct Uring* uring = malloc(sizeof(struct Uring));
+
+  if (io_uring_queue_init(URING_ENTRIES, &uring->ring, 0) < 0) {
+    free(uring);
+    return NULL;
+  }
+
+  return uring;
+}
+
+int
+Uring_write_sync(struct Uring* uring,
+                 int fd,
+                 const char* buf,
+                 size_t len,
+                 size_t offset)
+{
+  do {
+    unsigned chunk = len < URING_MAX_WRITE ? (unsigned)len : URING_MAX_WRITE;
+
+    // The sync is linked to the write, so it only runs once the whole chunk
+    // is written. A short write cancels the sync and the rest is resubmitted.
+    unsigned requests = 1;
+    struct io_uring_sqe* sqe;
+    if (chunk > 0) {
+      sqe = io_uring_get_sqe(&uring->ring);
+      io_uring_prep_write(sqe, fd, buf, chunk, (off_t)offset);
+      io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+      sqe->user_data = URING_WRITE;
+      requests++;
+    }
+    sqe = io_uring_get_sqe(&uring->ring);
+    io_uring_prep_fsync(sqe, fd, IORING_FSYNC_DATASYNC);
+    sqe->user_data = URING_SYNC;
+
+    int res = io_uring_submit_and_wait(&uring->ring, requests);
+    if (res < 0) {
+      errno = -res;
+      perror("io_uring_submit_and_wait");
+      return -1;
+    }
+
+    int written = 0;
+    int synced = 0;
+    for (unsigned i = 0; i < requests; i++) {
+      struct io_uring_cqe* cqe;
+      do {
+        res = io_uring_wait_cqe(&uring->ring, &cqe);
+      } while (res == -EINTR);
+      if (res < 0) {
+        errno = -res;
+        perror("io_uring_wait_cqe");
+        return -1;
+      }
+
+      if (cqe->user_data == URING_WRITE) {
+        written = cqe->res;
+      } else {
+        synced = cqe->res;
+      }
+      io_uring_cqe_seen(&uring->ring, cqe);
+    }
+
+    if (written < 0) {
+      errno = -written;
+      perror("write");
+      return -1;
+    }
+    if ((unsigned)written == chunk && synced < 0) {
+      errno = -synced;
+      perror("fdatasync");
+      return -1;
+    }
+    // A write that makes no progress would be resubmitted forever.
+    if (chunk > 0 && written == 0) {
+      fprintf(stderr, "io_uring write of %u bytes wrote nothing\n", chunk);
+      return -1;
+    }
+
+    buf += written;
+    len -= (size_t)written;
+    offset += (size_t)written;
+  } while (len > 0);
+
+  return 0;
+}
+
+void
+Uring_free(struct Uring* uring)
+{
+  if (uring == NULL) {
+    return;
+  }
+
+  io_uring_queue_exit(&uring->ring);
+  free(uring);
+}
+
+#else
+
+struct Uring*
+Uring_new()
+{
+  return NULL;
+}
+
+int
+Uring_write_sync(struct Uring* uring,
+                 int fd,
+                 const char* buf,
+                 size_t len,
+                 size_t offset)
+{
+  (void)uring;
+  (void)fd;
+  (void)buf;
+  (void)len;
+  (void)offset;
+
+  fprintf(stderr, "WiscKey was built without io_uring\n");
+  return -1;
+}
+
+void
+Uring_free(struct Uring* uring)
+{
+  (void)uring;
+}
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WISCKEY_URING_H
+#define WISCKEY_URING_H
+
+#include <stddef.h>
+
+/**
+ * @file
+ * @author Adam Comer <adambcomer@gmail.com>
+ * @date April 6, 2025
+ * @copyright Apache-2.0 License
+ * @brief Log writes and syncs submitted through io_uring.
+ */
+
+#define URING_ENTRIES 8 ///< Submission queue entries of a Uring.
+#define URING_MAX_WRITE                                                        \
+  (1U << 30) ///< Largest write submitted as a single request.
+
+/**
+ * @brief An io_uring that writes and syncs a log file with one system call.
+ *
+ * Uring_write_sync submits a write and an `fdatasync` as linked requests, so
+ * the kernel only starts the sync once the write has completed and the caller
+ * enters the kernel once for both instead of once for each.
+ *
+ * io_uring is only used when the library is built with liburing, which is
+ * detected when the build is configured. Without it, or when the kernel
+ * refuses to set up a ring, Uring_new returns NULL and the callers keep using
+ * `pwrite` and `fdatasync`.
+ *
+ * A Uring isn't thread-safe. Its owner must make sure only one thread submits
+ * to it at a time.
+ */
+struct Uring;
+
+/**
+ * @brief Sets up a new io_uring.
+ *
+ * Note: Free this Uring with Uring_free.
+ *
+ * @return A new Uring or NULL if io_uring isn't available.
+ */
+struct Uring*
+Uring_new();
+
+/**
+ * @brief Writes a buffer to a file and syncs it to the disk.
+ *
+ * This function returns once the write and the sync have both completed.
+ *
+ * @param uring The Uring to submit the requests to.
+ * @param fd The file to write to.
+ * @param buf The bytes to write.
+ * @param len The number of bytes to write. With a length of 0 the file is only
+ * synced.
+ * @param offset The file offset to write the bytes to.
+ * @return This function returns 0 if the bytes were written and synced and -1
+ * if there was an error.
+ */
+int
+Uring_write_sync(struct Uring* uring,
+                 int fd,
+                 const char* buf,
+                 size_t len,
+                 size_t offset);
+
+/**
+ * @brief Frees the Uring.
+ *
+ * @param uring The Uring to free.
+ */
+void
+Uring_free(struct Uring* uring);
+
+#endif /* WISCKEY_URING_H */
@@ -0,0 +1,297 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "value_cache.h"
+
+struct ValueCache*
+ValueCache_new(size_t capacity)
+{
+  struct ValueCache* cache = malloc(sizeof(struct ValueCache));
+
+  for (size_t i = 0; i < VALUE_CACHE_SHARDS; i++) {
+    struct ValueCacheShard* shard = &cache->shards[i];
+    shard->buckets =
+      calloc(VALUE_CACHE_MIN_BUCKETS, sizeof(struct ValueCacheEntry*));
+    shard->buckets_len = VALUE_CACHE_MIN_BUCKETS;
+    shard->len = 0;
+    shard->size = 0;
+    shard->capacity = capacity / VALUE_CACHE_SHARDS;
+    shard->hand = NULL;
+
+    shard->hits = 0;
+    shard->misses = 0;
+    shard->evictions = 0;
+
+    pthread_mutex_init(&shard->lock, NULL);
+  }
+
+  return cache;
+}
+
+static uint64_t
+ValueCache_hash(uint64_t loc)
+{
+  return WiscKey_key_hash((const char*)&loc, sizeof(uint64_t));
+}
+
+static struct ValueCacheShard*
+ValueCache_shard(struct ValueCache* cache, uint64_t hash)
+{
+  return &cache->shards[hash % VALUE_CACHE_SHARDS];
+}
+
+/*
+ * Returns the bucket of a hash. The low bits picked the shard, so the bucket
+ * is picked by the high bits.
+ */
+static struct ValueCacheEntry**
+ValueCache_bucket(struct ValueCacheShard* shard, uint64_t hash)
+{
+  return &shard->buckets[(hash >> 32) & (shard->buckets_len - 1)];
+}
+
+/*
+ * Returns the link that points at the entry of a location, or at the NULL at
+ * the end of its bucket if the location isn't cached.
+ */
+static struct ValueCacheEntry**
+ValueCache_find(struct ValueCacheShard* shard, uint64_t hash, uint64_t loc)
+{
+  struct ValueCacheEntry** link = ValueCache_bucket(shard, hash);
+  while (*link != NULL && (*link)->loc != loc) {
+    link = &(*link)->next;
+  }
+
+  return link;
+}
+
+static size_t
+ValueCache_charge(size_t value_len)
+{
+  return sizeof(struct ValueCacheEntry) + value_len;
+}
+
+/*
+ * Unlinks an entry from its bucket and from the clock and frees it.
+ */
+static void
+ValueCache_remove(struct ValueCacheShard* shard,
+                  struct ValueCacheEntry** link,
+                  struct ValueCacheEntry* entry)
+{
+  *link = entry->next;
+
+  if (entry->clock_next == entry) {
+    shard->hand = NULL;
+  } else {
+    entry->clock_prev->clock_next = entry->clock_next;
+    entry->clock_next->clock_prev = entry->clock_prev;
+    if (shard->hand == entry) {
+      shard->hand = entry->clock_next;
+    }
+  }
+
+  shard->len--;
+  shard->size -= ValueCache_charge(entry->len);
+  free(entry);
+}
+
+/*
+ * Sweeps the clock hand until it finds an entry that wasn't referenced since
+ * the last sweep, and evicts it.
+ */
+static void
+ValueCache_evict(struct ValueCacheShard* shard)
+{
+  struct ValueCacheEntry* entry = shard->hand;
+  while (entry->referenced) {
+    entry->referenced = 0;
+    entry = entry->clock_next;
+  }
+  shard->hand = entry;
+
+  struct ValueCacheEntry** link =
+    ValueCache_find(shard, ValueCache_hash(entry->loc), entry->loc);
+  ValueCache_remove(shard, link, entry);
+  shard->evictions++;
+}
+
+/*
+ * Doubles the number of buckets once there are more entries than buckets.
+ */
+static void
+ValueCache_grow(struct ValueCacheShard* shard)
+{
+  size_t old_len = shard->buckets_len;
+  struct ValueCacheEntry** old = shard->buckets;
+
+  shard->buckets_len = old_len * 2;
+  shard->buckets = calloc(shard->buckets_len, sizeof(struct ValueCacheEntry*));
+  for (size_t i = 0; i < old_len; i++) {
+    struct ValueCacheEntry* entry = old[i];
+    while (entry != NULL) {
+      struct ValueCacheEntry* next = entry->next;
+      struct ValueCacheEntry** bucket =
+        ValueCache_bucket(shard, ValueCache_hash(entry->loc));
+      entry->next = *bucket;
+      *bucket = entry;
+      entry = next;
+    }
+  }
+
+  free(old);
+}
+
+int
+ValueCache_get(struct ValueCache* cache,
+               uint64_t loc,
+               char* buf,
+               size_t buf_len,
+               size_t* value_len)
+{
+  uint64_t hash = ValueCache_hash(loc);
+  struct ValueCacheShard* shard = ValueCache_shard(cache, hash);
+
+  pthread_mutex_lock(&shard->lock);
+  struct ValueCacheEntry* entry = *ValueCache_find(shard, hash, loc);
+  if (entry == NULL) {
+    shard->misses++;
+    pthread_mutex_unlock(&shard->lock);
+    return 0;
+  }
+
+  entry->referenced = 1;
+  *value_len = entry->len;
+  if (buf != NULL && buf_len >= entry->len) {
+    memcpy(buf, entry->value, entry->len);
+  }
+  shard->hits++;
+  pthread_mutex_unlock(&shard->lock);
+
+  return 1;
+}
+
+void
+ValueCache_put(struct ValueCache* cache,
+               uint64_t loc,
+               const char* value,
+               size_t value_len)
+{
+  uint64_t hash = ValueCache_hash(loc);
+  struct ValueCacheShard* shard = ValueCache_shard(cache, hash);
+  size_t charge = ValueCache_charge(value_len);
+  if (charge > shard->capacity) {
+    return;
+  }
+
+  // The copy is made before the lock is taken, so a miss doesn't hold up the
+  // other readers of the shard.
+  struct ValueCacheEntry* entry = malloc(charge);
+  entry->loc = loc;
+  entry->len = value_len;
+  entry->referenced = 0;
+  memcpy(entry->value, value, value_len);
+
+  pthread_mutex_lock(&shard->lock);
+  if (*ValueCache_find(shard, hash, loc) != NULL) {
+    pthread_mutex_unlock(&shard->lock);
+    free(entry);
+    return;
+  }
+
+  while (shard->size + charge > shard->capacity) {
+    ValueCache_evict(shard);
+  }
+  if (shard->len >= shard->buckets_len) {
+    ValueCache_grow(shard);
+  }
+
+  struct ValueCacheEntry** bucket = ValueCache_bucket(shard, hash);
+  entry->next = *bucket;
+  *bucket = entry;
+
+  if (shard->hand == NULL) {
+    entry->clock_prev = entry;
+    entry->clock_next = entry;
+    shard->hand = entry;
+  } else {
+    entry->clock_next = shard->hand;
+    entry->clock_prev = shard->hand->clock_prev;
+    shard->hand->clock_prev->clock_next = entry;
+    shard->hand->clock_prev = entry;
+  }
+
+  shard->len++;
+  shard->size += charge;
+  pthread_mutex_unlock(&shard->lock);
+}
+
+void
+ValueCache_erase(struct ValueCache* cache, uint64_t loc)
+{
+  uint64_t hash = ValueCache_hash(loc);
+  struct ValueCacheShard* shard = ValueCache_shard(cache, hash);
+
+  pthread_mutex_lock(&shard->lock);
+  struct ValueCacheEntry** link = ValueCache_find(shard, hash, loc);
+  if (*link != NULL) {
+    ValueCache_remove(shard, link, *link);
+  }
+  pthread_mutex_unlock(&shard->lock);
+}
+
+void
+ValueCache_stats(struct ValueCache* cache, struct ValueCacheStats* stats)
+{
+  memset(stats, 0, sizeof(struct ValueCacheStats));
+
+  for (size_t i = 0; i < VALUE_CACHE_SHARDS; i++) {
+    struct ValueCacheShard* shard = &cache->shards[i];
+    pthread_mutex_lock(&shard->lock);
+    stats->hits += shard->hits;
+    stats->misses += shard->misses;
+    stats->evictions += shard->evictions;
+    stats->len += shard->len;
+    stats->size += shard->size;
+    pthread_mutex_unlock(&shard->lock);
+  }
+}
+
+void
+ValueCache_free(struct ValueCache* cache)
+{
+  for (size_t i = 0; i < VALUE_CACHE_SHARDS; i++) {
+    struct ValueCacheShard* shard = &cache->shards[i];
+    for (size_t j = 0; j < shard->buckets_len; j++) {
+      struct ValueCacheEntry* entry = shard->buckets[j];
+      while (entry != NULL) {
+        struct ValueCacheEntry* next = entry->next;
+        free(entry);
+        entry = next;
+      }
+    }
+    free(shard->buckets);
+    pthread_mutex_destroy(&shard->lock);
+  }
+
+  free(cache);
+}
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WISCKEY_VALUE_CACHE_H
+#define WISCKEY_VALUE_CACHE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * @file
+ * @author Adam Comer <adambcomer@gmail.com>
+ * @date October 18, 2026
+ * @copyright Apache-2.0 License
+ * @brief Sharded CLOCK cache of ValueLog values.
+ */
+
+#define VALUE_CACHE_SHARDS 16 ///< Number of shards in a ValueCache.
+#define VALUE_CACHE_MIN_BUCKETS                                                \
+  64 ///< Initial number of hash buckets in a shard.
+
+/**
+ * @brief Cached value.
+ *
+ * The value bytes follow the entry in the same allocation.
+ */
+struct ValueCacheEntry
+{
+  uint64_t loc;                       ///< ValueLog location of the value.
+  size_t len;                         ///< Length of the value.
+  int referenced;                     ///< Set by hits, cleared by the hand.
+  struct ValueCacheEntry* next;       ///< Next entry in the hash bucket.
+  struct ValueCacheEntry* clock_prev; ///< Previous entry on the clock.
+  struct ValueCacheEntry* clock_next; ///< Next entry on the clock.
+  char value[];                       ///< The value bytes.
+};
+
+/**
+ * @brief Shard of a ValueCache with its own lock.
+ *
+ * The entries are chained in a hash table and form a ring that the clock hand
+ * sweeps. A hit sets the referenced bit of its entry. To make room, the hand
+ * clears the bit of referenced entries and evicts the first entry it finds
+ * without it. New entries are inserted right behind the hand, so they get a
+ * full sweep before they are looked at.
+ */
+struct ValueCacheShard
+{
+  struct ValueCacheEntry** buckets; ///< Hash buckets. Chained through `next`.
+  size_t buckets_len;               ///< The number of buckets. A power of 2.
+  size_t len;                       ///< The number of entries.
+  size_t size;                      ///< Bytes charged for the entries.
+  size_t capacity;                  ///< Most bytes the entries may take.
+  struct ValueCacheEntry* hand;     ///< The clock hand or NULL if empty.
+
+  size_t hits;      ///< Number of lookups that found their value.
+  size_t misses;    ///< Number of lookups that didn't.
+  size_t evictions; ///< Number of entries evicted to make room.
+
+  pthread_mutex_t lock; ///< Guards the shard.
+};
+
+/**
+ * @brief Cache of values keyed by their ValueLog location.
+ *
+ * A location is never reused for another value, so a cached value is only
+ * ever stale in the sense that nothing points at its location anymore. The
+ * database erases the locations that the garbage collector frees and that
+ * deletes leave behind, and CLOCK ages out the rest.
+ *
+ * The byte capacity is split evenly between VALUE_CACHE_SHARDS shards picked
+ * by the hash of the location. Every entry is charged its value length plus
+ * the size of a ValueCacheEntry, and values larger than a shard are never
+ * cached.
+ */
+struct ValueCache
+{
+  struct ValueCacheShard shards[VALUE_CACHE_SHARDS]; ///< The shards.
+};
+
+/**
+ * @brief Counters of a ValueCache, summed over its shards.
+ */
+struct ValueCacheStats
+{
+  size_t hits;      ///< Number of lookups that found their value.
+  size_t misses;    ///< Number of lookups that didn't.
+  size_t evictions; ///< Number of entries evicted to make room.
+  size_t len;       ///< The number of entries.
+  size_t size;      ///< Bytes charged for the entries.
+};
+
+/**
+ * @brief Creates a new empty ValueCache.
+ *
+ * Note: Free this ValueCache with ValueCache_free.
+ *
+ * @param capacity Most bytes the cached values may take.
+ * @return A pointer to a new ValueCache.
+ */
+struct ValueCache*
+ValueCache_new(size_t capacity);
+
+/**
+ * @brief Looks up the value at a ValueLog location.
+ *
+ * The length of a cached value is always assigned to `value_len`. The value is
+ * only copied if `buf` is large enough to hold it.
+ *
+ * @param cache The ValueCache to search.
+ * @param loc The ValueLog location of the value.
+ * @param buf The buffer to copy the value into or NULL.
+ * @param buf_len The size of `buf`.
+ * @param value_len A pointer that is assigned to the length of the value.
+ * @return This function returns 1 if the value is cached and 0 if it isn't.
+ */
+int
+ValueCache_get(struct ValueCache* cache,
+               uint64_t loc,
+               char* buf,
+               size_t buf_len,
+               size_t* value_len);
+
+/**
+ * @brief Caches the value at a ValueLog location.
+ *
+ * Entries are evicted until the value fits in its shard. A value that is
+ * already cached is left alone.
+ *
+ * @param cache The ValueCache to add to.
+ * @param loc The ValueLog location of the value.
+ * @param value The value.
+ * @param value_len The length of the value.
+ */
+void
+ValueCache_put(struct ValueCache* cache,
+               uint64_t loc,
+               const char* value,
+               size_t value_len);
+
+/**
+ * @brief Removes the value at a ValueLog location if it is cached.
+ *
+ * @param cache The ValueCache to remove from.
+ * @param loc The ValueLog location of the value.
+ */
+void
+ValueCache_erase(struct ValueCache* cache, uint64_t loc);
+
+/**
+ * @brief Sums the counters of the shards.
+ *
+ * @param cache The ValueCache to read.
+ * @param stats A pointer that is assigned to the counters.
+ */
+void
+ValueCache_stats(struct ValueCache* cache, struct ValueCacheStats* stats);
+
+/**
+ * @brief Frees the ValueCache and every cached value.
+ *
+ * @param cache The ValueCache to free.
+ */
+void
+ValueCache_free(struct ValueCache* cache);
+
+#endif /* WISCKEY_VALUE_CACHE_H */
@@ -14,133 +14,2132 @@
  * limitations under the License.
  */
 
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
-#include "value_log.h"
+#include "codec.h"
+#include "memtable.h"
+#include "value_log.h"
+
+/*
+ * Encodes the file header of the current version with the magic number.
+ */
+static void
+ValueLog_encode_header(char* header, uint64_t tail)
+{
+  uint32_t magic = VALUE_LOG_MAGIC;
+  uint32_t version = VALUE_LOG_VERSION;
+  memcpy(header, &magic, sizeof(uint32_t));
+  memcpy(header + sizeof(uint32_t), &version, sizeof(uint32_t));
+  memcpy(header + 2 * sizeof(uint32_t), &tail, sizeof(uint64_t));
+}
+
+/*
+ * Reads the version and the tail from the header of an existing file, or
+ * writes the header of a new one. Files without the magic number predate the
+ * header and have no tail.
+ */
+static int
+ValueLog_read_header(struct ValueLog* log, size_t* tail)
+{
+  char header[VALUE_LOG_HEADER_SIZE];
+  uint32_t magic;
+  uint32_t version;
+  uint64_t tail_64;
+
+  ssize_t b_read = pread(log->fd, header, sizeof(header), 0);
+  if (b_read == -1) {
+    perror("pread");
+    return -1;
+  }
+  if (b_read == 0) {
+    ValueLog_encode_header(header, 0);
+
+    ssize_t b_written = pwrite(log->fd, header, sizeof(header), 0);
+    if (b_written != sizeof(header)) {
+      perror("pwrite");
+      return -1;
+    }
+    log->version = VALUE_LOG_VERSION;
+    *tail = 0;
+    return 0;
+  }
+
+  memcpy(&magic, header, sizeof(uint32_t));
+  if (b_read == sizeof(header) && magic == VALUE_LOG_MAGIC) {
+    memcpy(&version, header + sizeof(uint32_t), sizeof(uint32_t));
+    if (version != VALUE_LOG_VERSION && version != VALUE_LOG_VERSION_VARINT) {
+      fprintf(stderr, "Unknown ValueLog version %u\n", version);
+      return -1;
+    }
+    memcpy(&tail_64, header + 2 * sizeof(uint32_t), sizeof(uint64_t));
+    log->version = version;
+    *tail = tail_64;
+    return 0;
+  }
+
+  log->version = VALUE_LOG_VERSION_FIXED;
+  *tail = 0;
+  return 0;
+}
+
+/*
+ * Position of the first entry in the file.
+ */
+static size_t
+ValueLog_start(const struct ValueLog* log)
+{
+  return log->version == VALUE_LOG_VERSION_FIXED ? 0 : VALUE_LOG_HEADER_SIZE;
+}
+
+struct ValueLog*
+ValueLog_new(const char* path, size_t head, size_t tail)
+{
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd == -1) {
+    perror("open");
+    return NULL;
+  }
+
+  struct ValueLog* log = malloc(sizeof(struct ValueLog));
+  log->fd = fd;
+  log->buf = malloc(VALUE_LOG_BUFFER_SIZE);
+  log->buf_len = 0;
+  log->buf_cap = VALUE_LOG_BUFFER_SIZE;
+  log->map = NULL;
+  log->pins = 0;
+  log->segment_size = 0;
+  log->dir = NULL;
+  log->segments_id = 0;
+  atomic_init(&log->segments, NULL);
+  atomic_init(&log->segments_len, 0);
+  log->segments_cap = 0;
+  log->retired = NULL;
+  log->retired_len = 0;
+  log->codec = CODEC_NONE;
+  log->compress_min_size = 0;
+  log->compress_min_ratio = 1;
+  log->uring = NULL;
+  pthread_mutex_init(&log->uring_lock, NULL);
+  pthread_mutex_init(&log->readers_lock, NULL);
+  pthread_cond_init(&log->readers_cond, NULL);
+  pthread_mutex_init(&log->lock, NULL);
+
+  size_t stored_tail;
+  if (ValueLog_read_header(log, &stored_tail) == -1) {
+    atomic_init(&log->written, 0);
+    ValueLog_free(log);
+    return NULL;
+  }
+  if (stored_tail > tail) {
+    tail = stored_tail;
+  }
+
+  size_t start = ValueLog_start(log);
+  log->head = head > start ? head : start;
+  log->tail = tail > start ? tail : start;
+  log->punched = log->tail;
+  atomic_init(&log->written, log->head);
+
+  return log;
+}
+
+static char*
+ValueLog_segment_path(const struct ValueLog* log, uint64_t id)
+{
+  size_t len = strlen(log->dir) + 32;
+  char* path = malloc(len);
+  snprintf(path,
+           len,
+           "%s/%lu" VALUE_LOG_SEGMENT_SUFFIX,
+           log->dir,
+           (unsigned long)id);
+
+  return path;
+}
+
+/*
+ * Opens a segment and reads its garbage from the header, or creates it with a
+ * new header if it has none. A new segment is synced with its entry in the
+ * directory, so a crash can't lose a segment that entries were written to.
+ */
+static struct ValueLogSegment*
+ValueLog_open_segment(const struct ValueLog* log, uint64_t id)
+{
+  char* path = ValueLog_segment_path(log, id);
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  free(path);
+  if (fd == -1) {
+    perror("open");
+    return NULL;
+  }
+
+  char header[VALUE_LOG_HEADER_SIZE];
+  uint32_t version = VALUE_LOG_VERSION;
+  uint64_t garbage = 0;
+  ssize_t b_read = pread(fd, header, sizeof(header), 0);
+  if (b_read == -1) {
+    perror("pread");
+    close(fd);
+    return NULL;
+  }
+  if (b_read < (ssize_t)sizeof(header)) {
+    // A segment without a full header was created but never appended to.
+    ValueLog_encode_header(header, 0);
+    if (pwrite(fd, header, sizeof(header), 0) != sizeof(header)) {
+      perror("pwrite");
+      close(fd);
+      return NULL;
+    }
+    if (fdatasync(fd) == -1) {
+      perror("fdatasync");
+      close(fd);
+      return NULL;
+    }
+    if (WiscKey_sync_dir(log->dir) == -1) {
+      close(fd);
+      return NULL;
+    }
+  } else {
+    uint32_t magic;
+    memcpy(&magic, header, sizeof(uint32_t));
+    memcpy(&version, header + sizeof(uint32_t), sizeof(uint32_t));
+    if (magic != VALUE_LOG_MAGIC ||
+        (version != VALUE_LOG_VERSION && version != VALUE_LOG_VERSION_VARINT)) {
+      fprintf(stderr,
+              "Unknown ValueLog segment format in %lu\n",
+              (unsigned long)id);
+      close(fd);
+      return NULL;
+    }
+    memcpy(&garbage, header + 2 * sizeof(uint32_t), sizeof(uint64_t));
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    perror("fstat");
+    close(fd);
+    return NULL;
+  }
+
+  struct ValueLogSegment* segment = malloc(sizeof(struct ValueLogSegment));
+  segment->id = id;
+  segment->version = version;
+  segment->fd = fd;
+  segment->size = (size_t)st.st_size;
+  segment->garbage = garbage;
+  segment->stored = garbage;
+  segment->map = NULL;
+  atomic_init(&segment->readers, 0);
+  atomic_init(&segment->removed, 0);
+
+  return segment;
+}
+
+/*
+ * Finds the segment of a location without the lock. Returns NULL if there is
+ * none.
+ */
+static struct ValueLogSegment*
+ValueLog_segment(struct ValueLog* log, size_t loc)
+{
+  uint64_t id = loc >> VALUE_LOG_SEGMENT_SHIFT;
+
+  // The array is published before its length, so the slots up to the length
+  // are in whichever array is loaded.
+  size_t len = atomic_load(&log->segments_len);
+  struct ValueLogSegment** segments = atomic_load(&log->segments);
+  if (id < log->segments_id || id - log->segments_id >= len) {
+    return NULL;
+  }
+
+  return segments[id - log->segments_id];
+}
+
+/*
+ * Drops a reader of a segment. The last reader of a removed segment wakes the
+ * removal waiting on it.
+ */
+static void
+ValueLog_release_segment(struct ValueLog* log, struct ValueLogSegment* segment)
+{
+  if (atomic_fetch_sub(&segment->readers, 1) == 1 &&
+      atomic_load(&segment->removed)) {
+    pthread_mutex_lock(&log->readers_lock);
+    pthread_cond_broadcast(&log->readers_cond);
+    pthread_mutex_unlock(&log->readers_lock);
+  }
+}
+
+/*
+ * Adds a segment with a higher ID than every other. Must be called with the
+ * lock of the ValueLog held.
+ */
+static void
+ValueLog_add_segment(struct ValueLog* log, struct ValueLogSegment* segment)
+{
+  size_t len = atomic_load(&log->segments_len);
+  struct ValueLogSegment** segments = atomic_load(&log->segments);
+  size_t slot = segment->id - log->segments_id;
+
+  if (slot >= log->segments_cap) {
+    size_t cap = log->segments_cap == 0 ? 16 : log->segments_cap * 2;
+    while (cap <= slot) {
+      cap *= 2;
+    }
+    struct ValueLogSegment** grown =
+      malloc(cap * sizeof(struct ValueLogSegment*));
+    if (len > 0) {
+      memcpy(grown, segments, len * sizeof(struct ValueLogSegment*));
+    }
+
+    // Readers may still use the old array, so it is kept until the end.
+    if (segments != NULL) {
+      log->retired =
+        realloc(log->retired,
+                (log->retired_len + 1) * sizeof(struct ValueLogSegment**));
+      log->retired[log->retired_len++] = segments;
+    }
+    atomic_store(&log->segments, grown);
+    segments = grown;
+    log->segments_cap = cap;
+  }
+
+  for (size_t i = len; i < slot; i++) {
+    segments[i] = NULL;
+  }
+  segments[slot] = segment;
+  atomic_store(&log->segments_len, slot + 1);
+}
+
+static int
+ValueLog_id_cmp(const void* a, const void* b)
+{
+  uint64_t lhs = *(const uint64_t*)a;
+  uint64_t rhs = *(const uint64_t*)b;
+  return lhs < rhs ? -1 : lhs > rhs;
+}
+
+struct ValueLog*
+ValueLog_new_segmented(const char* dir, size_t segment_size)
+{
+  DIR* d = opendir(dir);
+  if (d == NULL) {
+    perror("opendir");
+    return NULL;
+  }
+
+  uint64_t* ids = malloc(sizeof(uint64_t));
+  size_t ids_len = 0;
+  size_t ids_cap = 1;
+  struct dirent* entry;
+  size_t suffix_len = strlen(VALUE_LOG_SEGMENT_SUFFIX);
+  while ((entry = readdir(d)) != NULL) {
+    size_t len = strlen(entry->d_name);
+    if (len > suffix_len &&
+        strcmp(entry->d_name + len - suffix_len, VALUE_LOG_SEGMENT_SUFFIX) ==
+          0) {
+      if (ids_len == ids_cap) {
+        ids_cap *= 2;
+        ids = realloc(ids, ids_cap * sizeof(uint64_t));
+      }
+      ids[ids_len++] = strtoull(entry->d_name, NULL, 10);
+    }
+  }
+  closedir(d);
+
+  if (ids_len == 0) {
+    ids[ids_len++] = 0;
+  }
+  qsort(ids, ids_len, sizeof(uint64_t), ValueLog_id_cmp);
+
+  struct ValueLog* log = malloc(sizeof(struct ValueLog));
+  log->fd = -1;
+  log->version = VALUE_LOG_VERSION;
+  log->buf = malloc(VALUE_LOG_BUFFER_SIZE);
+  log->buf_len = 0;
+  log->buf_cap = VALUE_LOG_BUFFER_SIZE;
+  atomic_init(&log->written, 0);
+  log->map = NULL;
+  log->pins = 0;
+  log->segment_size = segment_size < VALUE_LOG_SEGMENT_MASK
+                        ? segment_size
+                        : VALUE_LOG_SEGMENT_MASK;
+  log->dir = strdup(dir);
+  log->segments_id = ids[0];
+  atomic_init(&log->segments, NULL);
+  atomic_init(&log->segments_len, 0);
+  log->segments_cap = 0;
+  log->retired = NULL;
+  log->retired_len = 0;
+  log->codec = CODEC_NONE;
+  log->compress_min_size = 0;
+  log->compress_min_ratio = 1;
+  log->uring = NULL;
+  pthread_mutex_init(&log->uring_lock, NULL);
+  pthread_mutex_init(&log->readers_lock, NULL);
+  pthread_cond_init(&log->readers_cond, NULL);
+  pthread_mutex_init(&log->lock, NULL);
+
+  struct ValueLogSegment* segment = NULL;
+  for (size_t i = 0; i < ids_len; i++) {
+    segment = ValueLog_open_segment(log, ids[i]);
+    if (segment == NULL) {
+      free(ids);
+      ValueLog_free(log);
+      return NULL;
+    }
+    ValueLog_add_segment(log, segment);
+  }
+  free(ids);
+
+  // The newest segment is appended to, in its own format.
+  log->fd = segment->fd;
+  log->version = segment->version;
+  log->head = (size_t)segment->id << VALUE_LOG_SEGMENT_SHIFT | segment->size;
+  log->tail =
+    (size_t)log->segments_id << VALUE_LOG_SEGMENT_SHIFT | VALUE_LOG_HEADER_SIZE;
+  log->punched = log->tail;
+  atomic_store(&log->written, log->head);
+
+  return log;
+}
+
+/*
+ * Offset of a location in its file.
+ */
+static size_t
+ValueLog_offset(const struct ValueLog* log, size_t loc)
+{
+  return log->segment_size > 0 ? loc & VALUE_LOG_SEGMENT_MASK : loc;
+}
+
+/*
+ * Writes the buffer to the file. Must be called with the lock of the ValueLog
+ * held.
+ */
+static int
+ValueLog_write_buffer(struct ValueLog* log)
+{
+  size_t written = atomic_load_explicit(&log->written, memory_order_relaxed);
+  size_t done = 0;
+  while (done < log->buf_len) {
+    ssize_t res = pwrite(log->fd,
+                         log->buf + done,
+                         log->buf_len - done,
+                         (off_t)ValueLog_offset(log, written + done));
+    if (res == -1) {
+      perror("pwrite");
+      // Keep what is left, so the next write retries it.
+      memmove(log->buf, log->buf + done, log->buf_len - done);
+      log->buf_len -= done;
+      atomic_store_explicit(
+        &log->written, written + done, memory_order_release);
+      return -1;
+    }
+    done += (size_t)res;
+  }
+
+  log->buf_len = 0;
+  atomic_store_explicit(&log->written, written + done, memory_order_release);
+
+  return 0;
+}
+
+/*
+ * Makes sure that the entry at `loc` is in the file and not only in the
+ * buffer, so it can be read with `pread`.
+ */
+static int
+ValueLog_written(struct ValueLog* log, size_t loc)
+{
+  if (loc < atomic_load_explicit(&log->written, memory_order_acquire)) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&log->lock);
+  int res = ValueLog_write_buffer(log);
+  pthread_mutex_unlock(&log->lock);
+
+  return res;
+}
+
+/*
+ * Reads up to `len` bytes at `loc`. Returns the number of bytes read, which is
+ * only short at the end of the file, or -1 if there was an error. A segment
+ * counts its readers, so it isn't closed under them.
+ */
+static ssize_t
+ValueLog_pread(struct ValueLog* log, char* buf, size_t len, size_t loc)
+{
+  int fd;
+  struct ValueLogSegment* segment = NULL;
+  if (log->segment_size == 0) {
+    fd = log->fd;
+  } else {
+    segment = ValueLog_segment(log, loc);
+    if (segment != NULL) {
+      atomic_fetch_add(&segment->readers, 1);
+      if (atomic_load(&segment->removed)) {
+        ValueLog_release_segment(log, segment);
+        segment = NULL;
+      }
+    }
+    if (segment == NULL) {
+      fprintf(stderr, "ValueLog segment of %zu is removed\n", loc);
+      return -1;
+    }
+    fd = segment->fd;
+  }
+
+  size_t offset = ValueLog_offset(log, loc);
+  size_t done = 0;
+  while (done < len) {
+    ssize_t res = pread(fd, buf + done, len - done, (off_t)(offset + done));
+    if (res == -1) {
+      perror("pread");
+      done = SIZE_MAX;
+      break;
+    }
+    if (res == 0) {
+      break;
+    }
+    done += (size_t)res;
+  }
+
+  if (segment != NULL) {
+    ValueLog_release_segment(log, segment);
+  }
+
+  return done == SIZE_MAX ? -1 : (ssize_t)done;
+}
+
+/*
+ * Format version of the file that holds `loc`.
+ */
+static uint32_t
+ValueLog_version(struct ValueLog* log, size_t loc)
+{
+  if (log->segment_size == 0) {
+    return log->version;
+  }
+
+  struct ValueLogSegment* segment = ValueLog_segment(log, loc);
+  return segment != NULL ? segment->version : log->version;
+}
+
+/*
+ * Decodes the header of the entry at `entry`, of which `len` bytes can be
+ * read. `value_len` is assigned to the length of the value in the file and
+ * `raw_len` to its length once decompressed. Returns the length of the header
+ * or 0 if it is cut short.
+ */
+static size_t
+ValueLog_decode_entry(uint32_t version,
+                      const char* entry,
+                      size_t len,
+                      uint64_t* key_len,
+                      uint64_t* value_len,
+                      int* tombstone,
+                      int* codec,
+                      uint64_t* raw_len)
+{
+  *codec = CODEC_NONE;
+  if (version == VALUE_LOG_VERSION_FIXED) {
+    if (len < VALUE_LOG_ENTRY_HEADER_SIZE) {
+      return 0;
+    }
+    memcpy(key_len, entry, sizeof(uint64_t));
+    memcpy(value_len, entry + sizeof(uint64_t), sizeof(uint64_t));
+    *tombstone = *value_len == VALUE_LOG_TOMBSTONE;
+    if (*tombstone) {
+      *value_len = 0;
+    }
+    *raw_len = *value_len;
+    return VALUE_LOG_ENTRY_HEADER_SIZE;
+  }
+
+  size_t header_len = WiscKey_varint_decode(entry, len, key_len);
+  if (header_len == 0) {
+    return 0;
+  }
+  size_t value_len_len =
+    WiscKey_varint_decode(entry + header_len, len - header_len, value_len);
+  if (value_len_len == 0) {
+    return 0;
+  }
+  header_len += value_len_len;
+
+  *tombstone = *value_len == 0;
+  if (!*tombstone) {
+    *value_len -= 1;
+  }
+  *raw_len = *value_len;
+  if (version == VALUE_LOG_VERSION_VARINT) {
+    return header_len;
+  }
+
+  if (header_len == len) {
+    return 0;
+  }
+  *codec = (unsigned char)entry[header_len++];
+  if (*codec != CODEC_NONE) {
+    size_t raw_len_len =
+      WiscKey_varint_decode(entry + header_len, len - header_len, raw_len);
+    if (raw_len_len == 0) {
+      return 0;
+    }
+    header_len += raw_len_len;
+  }
+  return header_len;
+}
+
+/*
+ * Encodes the header of an entry in a given format version. Returns the length
+ * of the header.
+ */
+static size_t
+ValueLog_encode_entry(uint32_t version,
+                      char* header,
+                      size_t key_len,
+                      size_t value_len,
+                      int tombstone,
+                      int codec,
+                      size_t raw_len)
+{
+  if (version == VALUE_LOG_VERSION_FIXED) {
+    uint64_t lens[2] = { key_len, tombstone ? VALUE_LOG_TOMBSTONE : value_len };
+    memcpy(header, lens, sizeof(lens));
+    return VALUE_LOG_ENTRY_HEADER_SIZE;
+  }
+
+  size_t header_len = WiscKey_varint_encode(header, key_len);
+  header_len +=
+    WiscKey_varint_encode(header + header_len, tombstone ? 0 : value_len + 1);
+  if (version == VALUE_LOG_VERSION_VARINT) {
+    return header_len;
+  }
+
+  header[header_len++] = (char)codec;
+  if (codec != CODEC_NONE) {
+    header_len += WiscKey_varint_encode(header + header_len, raw_len);
+  }
+  return header_len;
+}
+
+/*
+ * Writes the garbage of a segment to its header, for the caller to sync. Must
+ * be called with the lock of the ValueLog held.
+ */
+static int
+ValueLog_store_garbage(struct ValueLogSegment* segment)
+{
+  uint64_t garbage = segment->garbage;
+  if (pwrite(segment->fd, &garbage, sizeof(uint64_t), 2 * sizeof(uint32_t)) !=
+      sizeof(uint64_t)) {
+    perror("pwrite");
+    return -1;
+  }
+  segment->stored = segment->garbage;
+
+  return 0;
+}
+
+/*
+ * Seals the segment being appended to and starts the next one. Must be called
+ * with the lock of the ValueLog held.
+ */
+static int
+ValueLog_roll(struct ValueLog* log)
+{
+  // A sealed segment is never written to again, so it is synced once here
+  // with its garbage so far.
+  struct ValueLogSegment* active = ValueLog_segment(log, log->head);
+  if (ValueLog_write_buffer(log) == -1 ||
+      ValueLog_store_garbage(active) == -1) {
+    return -1;
+  }
+  if (fdatasync(log->fd) == -1) {
+    perror("fdatasync");
+    return -1;
+  }
+
+  struct ValueLogSegment* segment = ValueLog_open_segment(log, active->id + 1);
+  if (segment == NULL) {
+    return -1;
+  }
+  active->size = ValueLog_offset(log, log->head);
+  ValueLog_add_segment(log, segment);
+
+  log->fd = segment->fd;
+  log->version = segment->version;
+  log->head = (size_t)segment->id << VALUE_LOG_SEGMENT_SHIFT | segment->size;
+  atomic_store_explicit(&log->written, log->head, memory_order_release);
+
+  return 0;
+}
+
+/*
+ * Compresses a value for an append. Returns the compressed value, which the
+ * caller frees, or NULL if the value is stored as it is.
+ */
+static char*
+ValueLog_compress(const struct ValueLog* log,
+                  const char* value,
+                  size_t value_len,
+                  size_t* compressed_len)
+{
+  if (log->codec == CODEC_NONE || value_len == 0 ||
+      value_len < log->compress_min_size) {
+    return NULL;
+  }
+
+  // The codec gives up once the value doesn't shrink by the ratio.
+  size_t cap = (size_t)((double)value_len / log->compress_min_ratio);
+  if (cap == 0) {
+    return NULL;
+  }
+  char* compressed = malloc(cap);
+  *compressed_len =
+    Codec_compress(log->codec, compressed, cap, value, value_len);
+  if (*compressed_len == 0) {
+    free(compressed);
+    return NULL;
+  }
+
+  return compressed;
+}
+
+/*
+ * An entry being appended. It is compressed before the lock of the ValueLog is
+ * taken, and its header is encoded under the lock in the format of the segment
+ * it goes to.
+ */
+struct ValueLogPending
+{
+  const char* key;
+  size_t key_len;
+  const char* value; // The compressed value or the value as it is.
+  size_t value_len;
+  const char* raw; // The value as it is.
+  size_t raw_len;
+  int codec;
+  char* compressed; // Freed once the entry is written.
+  char header[VALUE_LOG_ENTRY_MAX_HEADER_SIZE];
+  size_t header_len;
+};
+
+/*
+ * Fills in an entry for an append and compresses its value.
+ */
+static void
+ValueLog_prepare(const struct ValueLog* log,
+                 struct ValueLogPending* entry,
+                 const char* key,
+                 size_t key_len,
+                 const char* value,
+                 size_t value_len,
+                 int tombstone)
+{
+  entry->key = key;
+  entry->key_len = key_len;
+  entry->value = value;
+  entry->value_len = value_len;
+  entry->raw = value;
+  entry->raw_len = value_len;
+  entry->codec = CODEC_NONE;
+  entry->compressed = NULL;
+
+  size_t compressed_len;
+  if (!tombstone) {
+    entry->compressed =
+      ValueLog_compress(log, value, value_len, &compressed_len);
+  }
+  if (entry->compressed != NULL) {
+    entry->codec = log->codec;
+    entry->value = entry->compressed;
+    entry->value_len = compressed_len;
+  }
+}
+
+/*
+ * Encodes the headers of the entries in the format of the segment being
+ * appended to. Values are stored as they are in the older formats. Must be
+ * called with the lock of the ValueLog held. Returns the length of the
+ * entries.
+ */
+static size_t
+ValueLog_encode_pending(const struct ValueLog* log,
+                        struct ValueLogPending* entries,
+                        size_t count,
+                        int tombstone)
+{
+  size_t len = 0;
+  for (size_t i = 0; i < count; i++) {
+    struct ValueLogPending* entry = &entries[i];
+    if (log->version != VALUE_LOG_VERSION && entry->codec != CODEC_NONE) {
+      entry->value = entry->raw;
+      entry->value_len = entry->raw_len;
+      entry->codec = CODEC_NONE;
+    }
+    entry->header_len = ValueLog_encode_entry(log->version,
+                                              entry->header,
+                                              entry->key_len,
+                                              entry->value_len,
+                                              tombstone,
+                                              entry->codec,
+                                              entry->raw_len);
+    len += entry->header_len + entry->key_len + entry->value_len;
+  }
+
+  return len;
+}
+
+/*
+ * Writes the entries at the head of the file with `pwritev`, in as few calls as
+ * IOV_MAX allows. Must be called with the lock of the ValueLog held and the
+ * buffer written out.
+ */
+static int
+ValueLog_pwritev(struct ValueLog* log,
+                 const struct ValueLogPending* entries,
+                 size_t count,
+                 size_t len)
+{
+  size_t iov_len = 3 * count;
+  struct iovec* iov = malloc(iov_len * sizeof(struct iovec));
+  for (size_t i = 0; i < count; i++) {
+    const struct ValueLogPending* entry = &entries[i];
+    iov[3 * i] = (struct iovec){ (void*)entry->header, entry->header_len };
+    iov[3 * i + 1] = (struct iovec){ (void*)entry->key, entry->key_len };
+    iov[3 * i + 2] = (struct iovec){ (void*)entry->value, entry->value_len };
+  }
+
+  size_t done = 0;
+  size_t first = 0;
+  while (done < len) {
+    int n = iov_len - first < IOV_MAX ? (int)(iov_len - first) : IOV_MAX;
+    ssize_t res = pwritev(log->fd,
+                          iov + first,
+                          n,
+                          (off_t)ValueLog_offset(log, log->head + done));
+    if (res <= 0) {
+      perror("pwritev");
+      free(iov);
+      return -1;
+    }
+    done += (size_t)res;
+
+    // Skip the vectors that were written and trim the one that was cut short.
+    while (first < iov_len && (size_t)res >= iov[first].iov_len) {
+      res -= (ssize_t)iov[first].iov_len;
+      first++;
+    }
+    if (res > 0) {
+      iov[first].iov_base = (char*)iov[first].iov_base + res;
+      iov[first].iov_len -= (size_t)res;
+    }
+  }
+  free(iov);
+
+  atomic_store_explicit(&log->written, log->head + len, memory_order_release);
+
+  return 0;
+}
+
+/*
+ * Writes entries next to each other at the head, and assigns their locations
+ * to `pos` and their length to `len`. Must be called with the lock of the
+ * ValueLog held.
+ */
+static int
+ValueLog_write_locked(struct ValueLog* log,
+                      size_t* pos,
+                      size_t* len,
+                      struct ValueLogPending* entries,
+                      size_t count,
+                      int tombstone)
+{
+  uint32_t version = log->version;
+  *len = ValueLog_encode_pending(log, entries, count, tombstone);
+
+  if (log->segment_size > 0) {
+    // Entries larger than a segment get one of their own.
+    size_t offset = ValueLog_offset(log, log->head);
+    if (offset > VALUE_LOG_HEADER_SIZE && offset + *len > log->segment_size &&
+        ValueLog_roll(log) == -1) {
+      return -1;
+    }
+
+    // A segment of an older format was sealed, and the new one is in the
+    // current format.
+    if (log->version != version) {
+      *len = ValueLog_encode_pending(log, entries, count, tombstone);
+    }
+
+    if (VALUE_LOG_HEADER_SIZE + *len > VALUE_LOG_SEGMENT_MASK) {
+      fprintf(stderr, "ValueLog entries of %zu bytes are too large\n", *len);
+      return -1;
+    }
+  }
+
+  if (log->buf_len + *len > log->buf_cap &&
+      ValueLog_write_buffer(log) == -1) {
+    return -1;
+  }
+
+  if (*len > log->buf_cap) {
+    if (ValueLog_pwritev(log, entries, count, *len) == -1) {
+      return -1;
+    }
+  } else {
+    for (size_t i = 0; i < count; i++) {
+      const struct ValueLogPending* entry = &entries[i];
+      char* dst = log->buf + log->buf_len;
+      memcpy(dst, entry->header, entry->header_len);
+      memcpy(dst + entry->header_len, entry->key, entry->key_len);
+      memcpy(dst + entry->header_len + entry->key_len,
+             entry->value,
+             entry->value_len);
+      log->buf_len += entry->header_len + entry->key_len + entry->value_len;
+    }
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    const struct ValueLogPending* entry = &entries[i];
+    size_t entry_len = entry->header_len + entry->key_len + entry->value_len;
+    pos[i] = log->head;
+    log->head += entry_len;
+
+    // A tombstone is only replayed, so it is garbage in a segment right away.
+    if (tombstone && log->segment_size > 0) {
+      ValueLog_segment(log, pos[i])->garbage += entry_len;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Writes entries at the head and frees them, and assigns the length of the
+ * entries to `len`. A tombstone has no value bytes. Entries are gathered in the
+ * buffer, and entries that don't fit in it are written directly. The head only
+ * moves once every entry is written.
+ */
+static int
+ValueLog_write_entries(struct ValueLog* log,
+                       size_t* pos,
+                       size_t* len,
+                       struct ValueLogPending* entries,
+                       size_t count,
+                       int tombstone)
+{
+  pthread_mutex_lock(&log->lock);
+  int res = ValueLog_write_locked(log, pos, len, entries, count, tombstone);
+  pthread_mutex_unlock(&log->lock);
+
+  for (size_t i = 0; i < count; i++) {
+    free(entries[i].compressed);
+  }
+
+  return res;
+}
+
+void
+ValueLog_set_compression(struct ValueLog* log,
+                         int codec,
+                         size_t min_size,
+                         double min_ratio)
+{
+  log->codec = codec;
+  log->compress_min_size = min_size;
+  log->compress_min_ratio = min_ratio > 1 ? min_ratio : 1;
+}
+
+int
+ValueLog_append(struct ValueLog* log,
+                size_t* pos,
+                const char* key,
+                size_t key_len,
+                const char* value,
+                size_t value_len)
+{
+  size_t len;
+  return ValueLog_append_sized(log, pos, &len, key, key_len, value, value_len);
+}
+
+int
+ValueLog_append_sized(struct ValueLog* log,
+                      size_t* pos,
+                      size_t* len,
+                      const char* key,
+                      size_t key_len,
+                      const char* value,
+                      size_t value_len)
+{
+  struct ValueLogPending entry;
+  ValueLog_prepare(log, &entry, key, key_len, value, value_len, 0);
+  return ValueLog_write_entries(log, pos, len, &entry, 1, 0);
+}
+
+int
+ValueLog_append_batch(struct ValueLog* log,
+                      size_t* pos,
+                      const struct ValueLogBatchEntry* entries,
+                      size_t count)
+{
+  if (count == 0) {
+    return 0;
+  }
+
+  struct ValueLogPending* pending = malloc(count * sizeof(*pending));
+  for (size_t i = 0; i < count; i++) {
+    ValueLog_prepare(log,
+                     &pending[i],
+                     entries[i].key,
+                     entries[i].key_len,
+                     entries[i].value,
+                     entries[i].value_len,
+                     0);
+  }
+  size_t len;
+  int res = ValueLog_write_entries(log, pos, &len, pending, count, 0);
+  free(pending);
+
+  return res;
+}
+
+int
+ValueLog_append_tombstone(struct ValueLog* log,
+                          size_t* pos,
+                          const char* key,
+                          size_t key_len)
+{
+  size_t len;
+  return ValueLog_append_tombstone_sized(log, pos, &len, key, key_len);
+}
+
+int
+ValueLog_append_tombstone_sized(struct ValueLog* log,
+                                size_t* pos,
+                                size_t* len,
+                                const char* key,
+                                size_t key_len)
+{
+  struct ValueLogPending entry;
+  ValueLog_prepare(log, &entry, key, key_len, "", 0, 1);
+  return ValueLog_write_entries(log, pos, len, &entry, 1, 1);
+}
+
+/*
+ * Replays the entries of one file from `pos` to `end` into a MemTable. Returns
+ * 1 if the replay stopped because the MemTable should be flushed, 0 if it
+ * reached `end` or a torn entry, and -1 if there was an error.
+ */
+static int
+ValueLog_load_file(struct ValueLog* log,
+                   int fd,
+                   uint32_t version,
+                   size_t* pos,
+                   size_t end,
+                   struct MemTable* memtable)
+{
+  // The mapping has to start at a page boundary.
+  size_t base = *pos - ValueLog_offset(log, *pos);
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t map_start = ValueLog_offset(log, *pos) / page * page;
+  size_t map_len = end - base - map_start;
+  char* data =
+    mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd, (off_t)map_start);
+  if (data == MAP_FAILED) {
+    perror("mmap");
+    return -1;
+  }
+  madvise(data, map_len, MADV_SEQUENTIAL);
+
+  struct MemTableBatchEntry* batch =
+    malloc(VALUE_LOG_REPLAY_BATCH * sizeof(struct MemTableBatchEntry));
+  size_t batch_len = 0;
+
+  size_t offset = *pos;
+  int torn = 0;
+  int full = 0;
+  while (offset < end) {
+    const char* entry = data + (offset - base - map_start);
+    size_t left = end - offset;
+
+    uint64_t key_len_64;
+    uint64_t value_len_64;
+    int tombstone;
+    int codec;
+    uint64_t raw_len;
+    size_t header_len = ValueLog_decode_entry(version,
+                                              entry,
+                                              left,
+                                              &key_len_64,
+                                              &value_len_64,
+                                              &tombstone,
+                                              &codec,
+                                              &raw_len);
+    if (header_len == 0) {
+      torn = 1;
+      break;
+    }
+
+    left -= header_len;
+    if (key_len_64 > left || value_len_64 > left - key_len_64) {
+      torn = 1;
+      break;
+    }
+
+    batch[batch_len].key = entry + header_len;
+    batch[batch_len].key_len = key_len_64;
+    batch[batch_len].value_loc = tombstone ? -1 : (int64_t)offset;
+    batch[batch_len].value_size =
+      tombstone ? 0 : header_len + key_len_64 + value_len_64;
+    batch_len++;
+    offset += header_len + key_len_64 + value_len_64;
+
+    if (batch_len == VALUE_LOG_REPLAY_BATCH) {
+      MemTable_set_batch(memtable, batch, batch_len);
+      batch_len = 0;
+      if (MemTable_should_flush(memtable)) {
+        full = 1;
+        break;
+      }
+    }
+  }
+  MemTable_set_batch(memtable, batch, batch_len);
+
+  // Only the file being appended to can end in a torn entry, which the next
+  // append overwrites. A sealed segment is skipped past it.
+  if (torn && fd == log->fd) {
+    log->head = offset;
+    atomic_store_explicit(&log->written, offset, memory_order_release);
+  } else if (torn) {
+    offset = end;
+  }
+  *pos = offset;
+
+  free(batch);
+  munmap(data, map_len);
+
+  return full;
+}
+
+int
+ValueLog_load_memtable(struct ValueLog* log,
+                       size_t* pos,
+                       struct MemTable* memtable)
+{
+  pthread_mutex_lock(&log->lock);
+  int res = ValueLog_write_buffer(log);
+  pthread_mutex_unlock(&log->lock);
+  if (res == -1) {
+    return -1;
+  }
+
+  if (log->segment_size == 0) {
+    struct stat st;
+    if (fstat(log->fd, &st) == -1) {
+      perror("fstat");
+      return -1;
+    }
+    size_t end =
+      log->head < (size_t)st.st_size ? log->head : (size_t)st.st_size;
+    if (*pos < ValueLog_start(log)) {
+      *pos = ValueLog_start(log);
+    }
+    if (*pos >= end) {
+      return 0;
+    }
+
+    res = ValueLog_load_file(log, log->fd, log->version, pos, end, memtable);
+    return res == -1 ? -1 : 0;
+  }
+
+  if (*pos < log->tail) {
+    *pos = log->tail;
+  }
+  while (*pos < log->head) {
+    struct ValueLogSegment* segment = ValueLog_segment(log, *pos);
+    size_t base = *pos - ValueLog_offset(log, *pos);
+    size_t end = base;
+    if (segment != NULL && segment->fd == log->fd) {
+      end = log->head;
+    } else if (segment != NULL && !atomic_load(&segment->removed)) {
+      end = base + segment->size;
+    }
+    if (ValueLog_offset(log, *pos) < VALUE_LOG_HEADER_SIZE) {
+      *pos = base + VALUE_LOG_HEADER_SIZE;
+    }
+    if (*pos >= end) {
+      *pos = base + (UINT64_C(1) << VALUE_LOG_SEGMENT_SHIFT) +
+             VALUE_LOG_HEADER_SIZE;
+      continue;
+    }
+
+    res = ValueLog_load_file(
+      log, segment->fd, segment->version, pos, end, memtable);
+    if (res != 0) {
+      return res == -1 ? -1 : 0;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Where the value of an entry is in the file and how it is stored.
+ */
+struct ValueLogValue
+{
+  size_t off;     ///< Position of the value in the file.
+  size_t len;     ///< Length of the value in the file.
+  int codec;      ///< Codec that the value is compressed with.
+  size_t raw_len; ///< Length of the value once decompressed.
+};
+
+/*
+ * Checks that the codec of the entry at `loc` can be decompressed by this
+ * build.
+ */
+static int
+ValueLog_check_codec(int codec, size_t loc)
+{
+  if (!Codec_supported(codec)) {
+    fprintf(stderr,
+            "ValueLog entry at %zu uses codec %d, which isn't built in\n",
+            loc,
+            codec);
+    return -1;
+  }
+
+  return 0;
+}
 
-struct ValueLog*
-ValueLog_new(const char* path, size_t head, size_t tail)
+/*
+ * Checks that the entry at `loc` holds `key`, unless `key` is NULL.
+ */
+static int
+ValueLog_check_key(const char* entry_key,
+                   size_t entry_key_len,
+                   const char* key,
+                   size_t key_len,
+                   size_t loc)
 {
-  char* mode = "w+";
-  if (access(path, F_OK) == 0) {
-    mode = "r+";
+  if (key != NULL &&
+      (entry_key_len != key_len || memcmp(entry_key, key, key_len) != 0)) {
+    fprintf(stderr, "ValueLog entry at %zu holds another key\n", loc);
+    return -1;
   }
 
-  FILE* file = fopen(path, mode);
-  if (file == NULL) {
-    perror("fopen");
-    return NULL;
+  return 0;
+}
+
+/*
+ * Finds the value of the entry at `loc`. The key is read along with the header
+ * and checked unless `key` is NULL.
+ */
+static int
+ValueLog_find_value(struct ValueLog* log,
+                    size_t loc,
+                    const char* key,
+                    size_t key_len,
+                    struct ValueLogValue* value)
+{
+  if (ValueLog_written(log, loc) == -1) {
+    return -1;
   }
 
-  struct ValueLog* log = malloc(sizeof(struct ValueLog));
+  char stack_header[VALUE_LOG_ENTRY_MAX_HEADER_SIZE];
+  char* header = stack_header;
+  size_t header_cap = sizeof(stack_header);
+  if (key != NULL) {
+    header_cap += key_len;
+    header = malloc(header_cap);
+  }
+  ssize_t b_read = ValueLog_pread(log, header, header_cap, loc);
+  if (b_read == -1) {
+    if (header != stack_header) {
+      free(header);
+    }
+    return -1;
+  }
 
-  log->file = file;
-  log->head = head;
-  log->tail = tail;
+  uint64_t key_len_64;
+  uint64_t value_len_64;
+  int tombstone;
+  uint64_t raw_len_64;
+  size_t header_len = ValueLog_decode_entry(ValueLog_version(log, loc),
+                                            header,
+                                            (size_t)b_read,
+                                            &key_len_64,
+                                            &value_len_64,
+                                            &tombstone,
+                                            &value->codec,
+                                            &raw_len_64);
+  int res = 0;
+  if (header_len == 0 ||
+      (key != NULL && key_len_64 == key_len &&
+       (size_t)b_read - header_len < key_len)) {
+    fprintf(stderr, "ValueLog entry at %zu is cut short\n", loc);
+    res = -1;
+  } else if (tombstone) {
+    fprintf(stderr, "ValueLog entry at %zu is a tombstone\n", loc);
+    res = -1;
+  } else if (ValueLog_check_codec(value->codec, loc) == -1 ||
+             ValueLog_check_key(
+               header + header_len, key_len_64, key, key_len, loc) == -1) {
+    res = -1;
+  }
+  if (header != stack_header) {
+    free(header);
+  }
+  if (res == -1) {
+    return -1;
+  }
 
-  return log;
+  value->off = loc + header_len + key_len_64;
+  value->len = value_len_64;
+  value->raw_len = raw_len_64;
+
+  return 0;
+}
+
+/*
+ * Reads a value found by ValueLog_find_value into a buffer of its length once
+ * decompressed. A compressed value is decompressed straight into `buf`.
+ */
+static int
+ValueLog_read_value(struct ValueLog* log,
+                    const struct ValueLogValue* value,
+                    char* buf,
+                    size_t loc)
+{
+  char* stored = buf;
+  if (value->codec != CODEC_NONE) {
+    stored = malloc(value->len > 0 ? value->len : 1);
+  }
+
+  int res = 0;
+  ssize_t b_read = ValueLog_pread(log, stored, value->len, value->off);
+  if (b_read != (ssize_t)value->len) {
+    fprintf(stderr, "ValueLog entry at %zu is cut short\n", loc);
+    res = -1;
+  } else if (value->codec != CODEC_NONE &&
+             Codec_decompress(
+               value->codec, buf, value->raw_len, stored, value->len) == -1) {
+    fprintf(stderr, "ValueLog entry at %zu doesn't decompress\n", loc);
+    res = -1;
+  }
+
+  if (stored != buf) {
+    free(stored);
+  }
+  return res;
+}
+
+/*
+ * Reads the entry at `loc` with one `pread` of its `size` bytes and checks its
+ * key unless `key` is NULL. The value is copied to `buf` if it holds the value,
+ * and otherwise assigned to `value` as a newly allocated block unless `value`
+ * is NULL. Without `value`, the entry has to fit in VALUE_LOG_FETCH_SIZE bytes.
+ * Returns 1 if the value was read, 0 if the entry isn't `size` bytes long, so
+ * it has to be found through its header, or -1 if there was an error.
+ */
+static int
+ValueLog_fetch(struct ValueLog* log,
+               size_t loc,
+               size_t size,
+               const char* key,
+               size_t key_len,
+               char* buf,
+               size_t buf_len,
+               char** value,
+               size_t* value_len)
+{
+  if (ValueLog_written(log, loc + size - 1) == -1) {
+    return -1;
+  }
+
+  // The entry isn't read into `buf`, whose length is only known to hold the
+  // value.
+  char stack_entry[VALUE_LOG_FETCH_SIZE];
+  char* entry = value == NULL ? stack_entry : malloc(size);
+  ssize_t b_read = ValueLog_pread(log, entry, size, loc);
+  if (b_read == -1) {
+    if (entry != stack_entry) {
+      free(entry);
+    }
+    return -1;
+  }
+
+  // A size that is stale or reads past the end of the file doesn't add up with
+  // the header, which is then read on its own.
+  uint64_t entry_key_len;
+  uint64_t stored_len;
+  int tombstone;
+  int codec;
+  uint64_t raw_len;
+  size_t header_len = ValueLog_decode_entry(ValueLog_version(log, loc),
+                                            entry,
+                                            (size_t)b_read,
+                                            &entry_key_len,
+                                            &stored_len,
+                                            &tombstone,
+                                            &codec,
+                                            &raw_len);
+  int res = 1;
+  if ((size_t)b_read != size || header_len == 0 || tombstone ||
+      entry_key_len > size || stored_len > size ||
+      header_len + entry_key_len + stored_len != size) {
+    res = 0;
+  } else if (ValueLog_check_codec(codec, loc) == -1 ||
+             ValueLog_check_key(
+               entry + header_len, entry_key_len, key, key_len, loc) == -1) {
+    res = -1;
+  }
+  if (res != 1) {
+    if (entry != stack_entry) {
+      free(entry);
+    }
+    return res;
+  }
+
+  *value_len = raw_len;
+  const char* stored = entry + header_len + entry_key_len;
+  char* dst = NULL;
+  if (buf != NULL && buf_len >= raw_len) {
+    dst = buf;
+  } else if (value != NULL) {
+    // A value stored as it is moves to the front of the block it was read
+    // into.
+    dst = codec == CODEC_NONE ? entry : malloc(raw_len > 0 ? raw_len : 1);
+  }
+
+  if (dst == NULL) {
+    // Only the length was asked for.
+  } else if (codec == CODEC_NONE) {
+    memmove(dst, stored, raw_len);
+  } else if (Codec_decompress(codec, dst, raw_len, stored, stored_len) ==
+             -1) {
+    fprintf(stderr, "ValueLog entry at %zu doesn't decompress\n", loc);
+    res = -1;
+  }
+
+  if (entry != stack_entry && entry != dst) {
+    free(entry);
+  }
+  if (dst != NULL && dst != buf) {
+    if (res == -1) {
+      free(dst);
+    } else {
+      *value = dst;
+    }
+  }
+  return res;
 }
 
 int
-ValueLog_append(struct ValueLog* log,
-                size_t* pos,
-                const char* key,
-                size_t key_len,
-                const char* value,
-                size_t value_len)
+ValueLog_get(struct ValueLog* log,
+             char** value,
+             size_t* value_len,
+             size_t loc)
 {
-  int res = fseek(log->file, (long)log->head, SEEK_SET);
-  if (res == -1) {
-    perror("fseek");
+  return ValueLog_get_sized(log, value, value_len, loc, 0, NULL, 0);
+}
+
+int
+ValueLog_get_sized(struct ValueLog* log,
+                   char** value,
+                   size_t* value_len,
+                   size_t loc,
+                   size_t size,
+                   const char* key,
+                   size_t key_len)
+{
+  if (size > 0) {
+    int res = ValueLog_fetch(
+      log, loc, size, key, key_len, NULL, 0, value, value_len);
+    if (res != 0) {
+      return res == 1 ? 0 : -1;
+    }
+  }
+
+  struct ValueLogValue found;
+  if (ValueLog_find_value(log, loc, key, key_len, &found) == -1) {
+    return -1;
+  }
+
+  *value_len = found.raw_len;
+  *value = malloc(*value_len > 0 ? *value_len : 1);
+  if (ValueLog_read_value(log, &found, *value, loc) == -1) {
+    free(*value);
+    return -1;
+  }
+
+  return 0;
+}
+
+int
+ValueLog_read(struct ValueLog* log,
+              char* buf,
+              size_t buf_len,
+              size_t* value_len,
+              size_t loc)
+{
+  return ValueLog_read_sized(log, buf, buf_len, value_len, loc, 0, NULL, 0);
+}
+
+int
+ValueLog_read_sized(struct ValueLog* log,
+                    char* buf,
+                    size_t buf_len,
+                    size_t* value_len,
+                    size_t loc,
+                    size_t size,
+                    const char* key,
+                    size_t key_len)
+{
+  // A larger value is read straight into `buf` after its header.
+  if (size > 0 && size <= VALUE_LOG_FETCH_SIZE) {
+    int res = ValueLog_fetch(
+      log, loc, size, key, key_len, buf, buf_len, NULL, value_len);
+    if (res != 0) {
+      return res == 1 ? 0 : -1;
+    }
+  }
+
+  struct ValueLogValue found;
+  if (ValueLog_find_value(log, loc, key, key_len, &found) == -1) {
+    return -1;
+  }
+  *value_len = found.raw_len;
+  if (buf == NULL || buf_len < *value_len) {
+    return 0;
+  }
+
+  return ValueLog_read_value(log, &found, buf, loc);
+}
+
+/*
+ * Drops a reference to a mapping. Must be called with the lock of the ValueLog
+ * held.
+ */
+static void
+ValueLog_unref_map(struct ValueLogMap* map)
+{
+  if (--map->refs > 0) {
+    return;
+  }
+
+  if (munmap(map->data, map->len) == -1) {
+    perror("munmap");
+  }
+  free(map);
+}
+
+/*
+ * Maps `len` bytes of a file and makes it the newest mapping in `newest`. Must
+ * be called with the lock of the ValueLog held.
+ */
+static int
+ValueLog_remap(struct ValueLogMap** newest, int fd, size_t len)
+{
+  char* data = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    perror("mmap");
     return -1;
   }
 
-  uint64_t key_len_64 = key_len;
-  uint64_t value_len_64 = value_len;
+  struct ValueLogMap* map = malloc(sizeof(struct ValueLogMap));
+  map->data = data;
+  map->len = len;
+  map->refs = 1;
+
+  if (*newest != NULL) {
+    ValueLog_unref_map(*newest);
+  }
+  *newest = map;
+
+  return 0;
+}
+
+/*
+ * Hole-punches the space before the tail. Must be called with the lock of the
+ * ValueLog held and no slice pinned.
+ */
+static int
+ValueLog_punch(struct ValueLog* log)
+{
+  if (log->punched >= log->tail) {
+    return 0;
+  }
 
-  size_t b_written = fwrite(&key_len_64, sizeof(uint64_t), 1, log->file);
-  if (b_written != 1) {
-    perror("fwrite");
+  // A file system without hole punching keeps the space, but the entries are
+  // still gone.
+  if (fallocate(log->fd,
+                FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                (off_t)log->punched,
+                (off_t)(log->tail - log->punched)) == -1 &&
+      errno != EOPNOTSUPP) {
+    perror("fallocate");
     return -1;
   }
-  b_written = fwrite(&value_len_64, sizeof(uint64_t), 1, log->file);
-  if (b_written != 1) {
-    perror("fwrite");
+  log->punched = log->tail;
+
+  return 0;
+}
+
+int
+ValueLog_get_slice(struct ValueLog* log,
+                   struct ValueLogSlice* slice,
+                   size_t loc)
+{
+  if (ValueLog_written(log, loc) == -1) {
     return -1;
   }
-  b_written = fwrite(key, sizeof(char), key_len, log->file);
-  if (b_written != key_len) {
-    perror("fwrite");
+
+  // A segment has a mapping of its own, which outlives the segment file.
+  pthread_mutex_lock(&log->lock);
+  struct ValueLogMap** map = &log->map;
+  int fd = log->fd;
+  size_t written = atomic_load_explicit(&log->written, memory_order_relaxed);
+  size_t end = ValueLog_offset(log, written);
+  if (log->segment_size > 0) {
+    struct ValueLogSegment* segment = ValueLog_segment(log, loc);
+    if (segment == NULL || atomic_load(&segment->removed)) {
+      pthread_mutex_unlock(&log->lock);
+      fprintf(stderr, "ValueLog segment of %zu is removed\n", loc);
+      return -1;
+    }
+    map = &segment->map;
+    if (segment->fd != log->fd) {
+      fd = segment->fd;
+      end = segment->size;
+    }
+  }
+
+  size_t offset = ValueLog_offset(log, loc);
+  uint32_t version = ValueLog_version(log, loc);
+  uint64_t key_len;
+  uint64_t value_len;
+  int tombstone;
+  int codec;
+  uint64_t raw_len;
+  size_t header_len = 0;
+  for (int mapped = 0; mapped < 2; mapped++) {
+    if (*map != NULL && offset < (*map)->len) {
+      header_len = ValueLog_decode_entry(version,
+                                         (*map)->data + offset,
+                                         (*map)->len - offset,
+                                         &key_len,
+                                         &value_len,
+                                         &tombstone,
+                                         &codec,
+                                         &raw_len);
+      if (header_len > 0 &&
+          offset + header_len + key_len + value_len <= (*map)->len) {
+        break;
+      }
+      header_len = 0;
+    }
+
+    // The entry was written after the newest mapping was made.
+    if (mapped == 0 && ValueLog_remap(map, fd, end) == -1) {
+      pthread_mutex_unlock(&log->lock);
+      return -1;
+    }
+  }
+  if (header_len == 0) {
+    pthread_mutex_unlock(&log->lock);
+    fprintf(stderr, "ValueLog entry at %zu is cut short\n", loc);
     return -1;
   }
-  b_written = fwrite(value, sizeof(char), value_len, log->file);
-  if (b_written != value_len) {
-    perror("fwrite");
+  if (tombstone) {
+    pthread_mutex_unlock(&log->lock);
+    fprintf(stderr, "ValueLog entry at %zu is a tombstone\n", loc);
     return -1;
   }
 
-  *pos = log->head;
-  log->head += sizeof(uint64_t) + sizeof(uint64_t) + key_len + value_len;
+  // A compressed value is decompressed into a copy, outside of the lock.
+  if (codec != CODEC_NONE) {
+    pthread_mutex_unlock(&log->lock);
+    char* value;
+    size_t len;
+    if (ValueLog_get(log, &value, &len, loc) == -1) {
+      return -1;
+    }
+    slice->data = value;
+    slice->len = len;
+    slice->map = NULL;
+    return 0;
+  }
+
+  slice->data = (*map)->data + offset + header_len + key_len;
+  slice->len = value_len;
+  slice->map = *map;
+  (*map)->refs++;
+  log->pins++;
+  pthread_mutex_unlock(&log->lock);
 
   return 0;
 }
 
+void
+ValueLog_release_slice(struct ValueLog* log, struct ValueLogSlice* slice)
+{
+  if (slice->map == NULL) {
+    free((char*)slice->data);
+    slice->data = NULL;
+    return;
+  }
+
+  pthread_mutex_lock(&log->lock);
+  ValueLog_unref_map(slice->map);
+  if (--log->pins == 0 && ValueLog_punch(log) == -1) {
+    fprintf(stderr, "Failed to free the ValueLog before %zu\n", log->tail);
+  }
+  pthread_mutex_unlock(&log->lock);
+
+  slice->data = NULL;
+  slice->map = NULL;
+}
+
 int
-ValueLog_get(const struct ValueLog* log,
-             char** value,
-             size_t* value_len,
-             size_t loc)
+ValueLog_read_entry(struct ValueLog* log,
+                    size_t loc,
+                    struct ValueLogEntry* entry)
 {
-  int res = fseek(log->file, (long)loc, SEEK_SET);
-  if (res == -1) {
+  if (ValueLog_written(log, loc) == -1) {
+    return -1;
+  }
+
+  char header[VALUE_LOG_ENTRY_MAX_HEADER_SIZE];
+  ssize_t b_read = ValueLog_pread(log, header, sizeof(header), loc);
+  if (b_read == -1) {
     return -1;
   }
 
   uint64_t key_len_64;
   uint64_t value_len_64;
+  uint64_t raw_len_64;
+  struct ValueLogValue value;
+  size_t header_len = ValueLog_decode_entry(ValueLog_version(log, loc),
+                                            header,
+                                            (size_t)b_read,
+                                            &key_len_64,
+                                            &value_len_64,
+                                            &entry->tombstone,
+                                            &value.codec,
+                                            &raw_len_64);
+  if (header_len == 0) {
+    fprintf(stderr, "ValueLog entry at %zu is cut short\n", loc);
+    return -1;
+  }
+  if (ValueLog_check_codec(value.codec, loc) == -1) {
+    return -1;
+  }
 
-  size_t b_read = fread(&key_len_64, sizeof(uint64_t), 1, log->file);
-  if (b_read != 1) {
-    perror("fread");
+  // A value stored as it is is read along with the key.
+  size_t key_read = key_len_64;
+  if (value.codec == CODEC_NONE) {
+    key_read += value_len_64;
+  }
+  size_t data_len = key_len_64 + raw_len_64;
+  entry->key = malloc(data_len > 0 ? data_len : 1);
+  b_read = ValueLog_pread(log, entry->key, key_read, loc + header_len);
+  if (b_read != (ssize_t)key_read) {
+    fprintf(stderr, "ValueLog entry at %zu is cut short\n", loc);
+    free(entry->key);
     return -1;
   }
 
-  b_read = fread(&value_len_64, sizeof(uint64_t), 1, log->file);
-  if (b_read != 1) {
-    perror("fread");
+  value.off = loc + header_len + key_len_64;
+  value.len = value_len_64;
+  value.raw_len = raw_len_64;
+  if (value.codec != CODEC_NONE &&
+      ValueLog_read_value(log, &value, entry->key + key_len_64, loc) == -1) {
+    free(entry->key);
     return -1;
   }
 
-  res = fseek(log->file, (long)key_len_64, SEEK_CUR);
-  if (res == -1) {
-    perror("fseek");
+  entry->key_len = key_len_64;
+  entry->value = entry->key + key_len_64;
+  entry->value_len = raw_len_64;
+  entry->len = header_len + key_len_64 + value_len_64;
+
+  return 0;
+}
+
+int
+ValueLog_set_tail(struct ValueLog* log, size_t tail)
+{
+  if (log->version == VALUE_LOG_VERSION_FIXED) {
+    fprintf(stderr, "ValueLog has no header to store the tail in\n");
+    return -1;
+  }
+  if (log->segment_size > 0) {
+    fprintf(stderr, "ValueLog segments are freed by removing them\n");
     return -1;
   }
+  if (tail <= log->tail) {
+    return 0;
+  }
 
-  *value = malloc(value_len_64);
-  *value_len = value_len_64;
-  b_read = fread(*value, sizeof(char), value_len_64, log->file);
-  if (b_read != value_len_64) {
-    perror("fread");
+  // The tail is on disk before the space is freed, so a crash never leaves a
+  // tail that points before a hole.
+  int fd = log->fd;
+  uint64_t tail_64 = tail;
+  ssize_t b_written =
+    pwrite(fd, &tail_64, sizeof(uint64_t), 2 * sizeof(uint32_t));
+  if (b_written != sizeof(uint64_t)) {
+    perror("pwrite");
+    return -1;
+  }
+  if (fdatasync(fd) == -1) {
+    perror("fdatasync");
     return -1;
   }
 
-  return 0;
+  // Pinned slices may point into the freed space, so the last one to be
+  // released punches the hole instead.
+  pthread_mutex_lock(&log->lock);
+  log->tail = tail;
+  int res = log->pins == 0 ? ValueLog_punch(log) : 0;
+  pthread_mutex_unlock(&log->lock);
+
+  return res;
+}
+
+void
+ValueLog_discard(struct ValueLog* log, size_t loc, size_t size)
+{
+  if (log->segment_size == 0) {
+    return;
+  }
+
+  // The segment can't be removed while the lock is held.
+  pthread_mutex_lock(&log->lock);
+  struct ValueLogSegment* segment = ValueLog_segment(log, loc);
+  if (segment == NULL || atomic_load(&segment->removed)) {
+    pthread_mutex_unlock(&log->lock);
+    return;
+  }
+  if (size > 0) {
+    segment->garbage += size;
+    pthread_mutex_unlock(&log->lock);
+    return;
+  }
+
+  char header[VALUE_LOG_ENTRY_MAX_HEADER_SIZE];
+  size_t header_avail;
+  size_t written = atomic_load_explicit(&log->written, memory_order_relaxed);
+  if (loc >= written) {
+    // The entry is still in the buffer.
+    header_avail = written + log->buf_len - loc;
+    if (header_avail > sizeof(header)) {
+      header_avail = sizeof(header);
+    }
+    memcpy(header, log->buf + (loc - written), header_avail);
+  } else {
+    ssize_t b_read = pread(segment->fd,
+                           header,
+                           sizeof(header),
+                           (off_t)ValueLog_offset(log, loc));
+    if (b_read == -1) {
+      perror("pread");
+      pthread_mutex_unlock(&log->lock);
+      return;
+    }
+    header_avail = (size_t)b_read;
+  }
+
+  uint64_t key_len;
+  uint64_t value_len;
+  int tombstone;
+  int codec;
+  uint64_t raw_len;
+  size_t header_len = ValueLog_decode_entry(segment->version,
+                                            header,
+                                            header_avail,
+                                            &key_len,
+                                            &value_len,
+                                            &tombstone,
+                                            &codec,
+                                            &raw_len);
+  if (header_len > 0) {
+    segment->garbage += header_len + key_len + value_len;
+  }
+  pthread_mutex_unlock(&log->lock);
+}
+
+static int
+ValueLog_garbage_cmp(const void* a, const void* b)
+{
+  const struct ValueLogSegmentStats* lhs = a;
+  const struct ValueLogSegmentStats* rhs = b;
+  return lhs->garbage > rhs->garbage ? -1 : lhs->garbage < rhs->garbage;
+}
+
+size_t
+ValueLog_garbage_segments(struct ValueLog* log,
+                          size_t limit,
+                          double min_ratio,
+                          struct ValueLogSegmentStats** segments)
+{
+  *segments = NULL;
+  if (log->segment_size == 0) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&log->lock);
+  size_t len = atomic_load(&log->segments_len);
+  struct ValueLogSegment** all = atomic_load(&log->segments);
+  *segments = malloc(len * sizeof(struct ValueLogSegmentStats));
+  struct ValueLogSegment** stored = malloc(len * sizeof(*stored));
+  size_t stored_len = 0;
+
+  size_t n = 0;
+  for (size_t i = 0; i < len; i++) {
+    struct ValueLogSegment* segment = all[i];
+    if (segment == NULL || atomic_load(&segment->removed) ||
+        segment->fd == log->fd) {
+      continue;
+    }
+
+    // The garbage discarded since the segment was sealed is stored, so the
+    // count isn't lost to a crash. The segment counts as a reader until its
+    // header is synced, so it isn't closed under the sync.
+    if (segment->garbage != segment->stored &&
+        ValueLog_store_garbage(segment) == 0) {
+      atomic_fetch_add(&segment->readers, 1);
+      stored[stored_len++] = segment;
+    }
+
+    size_t base = (size_t)segment->id << VALUE_LOG_SEGMENT_SHIFT;
+    if (segment->garbage == 0 ||
+        (double)segment->garbage < min_ratio * (double)segment->size ||
+        base + segment->size > limit) {
+      continue;
+    }
+    (*segments)[n].id = segment->id;
+    (*segments)[n].start = base + VALUE_LOG_HEADER_SIZE;
+    (*segments)[n].end = base + segment->size;
+    (*segments)[n].garbage = segment->garbage;
+    n++;
+  }
+  pthread_mutex_unlock(&log->lock);
+
+  for (size_t i = 0; i < stored_len; i++) {
+    if (fdatasync(stored[i]->fd) == -1) {
+      perror("fdatasync");
+    }
+    ValueLog_release_segment(log, stored[i]);
+  }
+  free(stored);
+
+  qsort(
+    *segments, n, sizeof(struct ValueLogSegmentStats), ValueLog_garbage_cmp);
+
+  return n;
+}
+
+int
+ValueLog_remove_segment(struct ValueLog* log, uint64_t id)
+{
+  if (log->segment_size == 0) {
+    fprintf(stderr, "ValueLog has no segments to remove\n");
+    return -1;
+  }
+
+  pthread_mutex_lock(&log->lock);
+  struct ValueLogSegment* segment =
+    ValueLog_segment(log, (size_t)id << VALUE_LOG_SEGMENT_SHIFT);
+  if (segment == NULL || atomic_load(&segment->removed)) {
+    pthread_mutex_unlock(&log->lock);
+    return 0;
+  }
+  if (segment->fd == log->fd) {
+    pthread_mutex_unlock(&log->lock);
+    fprintf(stderr, "ValueLog segment %lu is appended to\n", (unsigned long)id);
+    return -1;
+  }
+
+  atomic_store(&segment->removed, 1);
+  if (segment->map != NULL) {
+    ValueLog_unref_map(segment->map);
+    segment->map = NULL;
+  }
+  pthread_mutex_unlock(&log->lock);
+
+  // Readers that got in before the segment was marked finish first.
+  pthread_mutex_lock(&log->readers_lock);
+  while (atomic_load(&segment->readers) > 0) {
+    pthread_cond_wait(&log->readers_cond, &log->readers_lock);
+  }
+  pthread_mutex_unlock(&log->readers_lock);
+
+  // The segment stays gone after a crash, so its entries aren't replayed.
+  char* path = ValueLog_segment_path(log, id);
+  int res = unlink(path);
+  if (res == -1) {
+    perror("unlink");
+  } else {
+    res = WiscKey_sync_dir(log->dir);
+  }
+  free(path);
+
+  if (close(segment->fd) == -1) {
+    perror("close");
+  }
+  segment->fd = -1;
+
+  return res;
+}
+
+size_t
+ValueLog_head(struct ValueLog* log)
+{
+  pthread_mutex_lock(&log->lock);
+  size_t head = log->head;
+  pthread_mutex_unlock(&log->lock);
+
+  return head;
+}
+
+size_t
+ValueLog_size(struct ValueLog* log)
+{
+  pthread_mutex_lock(&log->lock);
+  if (log->segment_size == 0) {
+    size_t size = log->head - log->tail;
+    pthread_mutex_unlock(&log->lock);
+    return size;
+  }
+
+  size_t len = atomic_load(&log->segments_len);
+  struct ValueLogSegment** segments = atomic_load(&log->segments);
+  size_t size = 0;
+  for (size_t i = 0; i < len; i++) {
+    struct ValueLogSegment* segment = segments[i];
+    if (segment == NULL || atomic_load(&segment->removed)) {
+      continue;
+    }
+    size +=
+      segment->fd == log->fd ? ValueLog_offset(log, log->head) : segment->size;
+  }
+  pthread_mutex_unlock(&log->lock);
+
+  return size;
+}
+
+int
+ValueLog_enable_io_uring(struct ValueLog* log)
+{
+  pthread_mutex_lock(&log->uring_lock);
+  if (log->uring == NULL) {
+    log->uring = Uring_new();
+  }
+  int res = log->uring != NULL ? 0 : -1;
+  pthread_mutex_unlock(&log->uring_lock);
+
+  return res;
+}
+
+/*
+ * Writes the buffer and syncs the file as linked requests on the io_uring,
+ * without the lock of the ValueLog held. The buffered entries are copied out,
+ * so readers still find them in the buffer until they are written. They are
+ * then dropped from the buffer, unless an append wrote it out in the meantime.
+ * Must be called with the lock of the ring held.
+ */
+static int
+ValueLog_sync_uring(struct ValueLog* log)
+{
+  pthread_mutex_lock(&log->lock);
+  int fd = log->fd;
+  size_t start = atomic_load_explicit(&log->written, memory_order_relaxed);
+  size_t len = log->buf_len;
+  char* buf = malloc(len > 0 ? len : 1);
+  memcpy(buf, log->buf, len);
+
+  // The segment counts as a reader, so it isn't closed under the write. With
+  // nothing buffered, the written bytes may end on a segment that isn't there
+  // yet, and only the open file is synced.
+  struct ValueLogSegment* segment = NULL;
+  if (log->segment_size > 0) {
+    segment = ValueLog_segment(log, start);
+    if (segment == NULL || atomic_load(&segment->removed)) {
+      segment = NULL;
+      if (len > 0) {
+        pthread_mutex_unlock(&log->lock);
+        free(buf);
+        fprintf(stderr, "ValueLog segment of %zu is removed\n", start);
+        return -1;
+      }
+    } else {
+      atomic_fetch_add(&segment->readers, 1);
+    }
+  }
+  pthread_mutex_unlock(&log->lock);
+
+  int res =
+    Uring_write_sync(log->uring, fd, buf, len, ValueLog_offset(log, start));
+  free(buf);
+  if (segment != NULL) {
+    ValueLog_release_segment(log, segment);
+  }
+
+  if (res == 0 && len > 0) {
+    pthread_mutex_lock(&log->lock);
+    if (atomic_load_explicit(&log->written, memory_order_relaxed) == start) {
+      log->buf_len -= len;
+      memmove(log->buf, log->buf + len, log->buf_len);
+      atomic_store_explicit(&log->written, start + len, memory_order_release);
+    }
+    pthread_mutex_unlock(&log->lock);
+  }
+
+  return res;
 }
 
 int
-ValueLog_sync(const struct ValueLog* log)
+ValueLog_sync(struct ValueLog* log)
 {
-  int res = fflush(log->file);
-  if (res == EOF) {
-    perror("fflush");
+  pthread_mutex_lock(&log->uring_lock);
+  if (log->uring != NULL) {
+    int res = ValueLog_sync_uring(log);
+    pthread_mutex_unlock(&log->uring_lock);
+    return res;
+  }
+  pthread_mutex_unlock(&log->uring_lock);
+
+  // A segment rolled over while syncing was synced when it was sealed.
+  pthread_mutex_lock(&log->lock);
+  int res = ValueLog_write_buffer(log);
+  int fd = log->fd;
+  pthread_mutex_unlock(&log->lock);
+  if (res == -1) {
     return -1;
   }
 
-  res = fsync(fileno(log->file));
+  res = fsync(fd);
   if (res == -1) {
     perror("fsync");
     return -1;
@@ -151,10 +2150,54 @@ ValueLog_sync(const struct ValueLog* log)
 void
 ValueLog_free(struct ValueLog* log)
 {
-  int res = fclose(log->file);
-  if (res == -1) {
-    perror("fclose");
+  if (ValueLog_write_buffer(log) == -1) {
+    fprintf(stderr, "Lost the buffered ValueLog entries\n");
+  }
+
+  if (log->segment_size == 0) {
+    if (close(log->fd) == -1) {
+      perror("close");
+    }
   }
 
+  // The garbage of the segments is kept in their headers for the next open.
+  size_t segments_len = atomic_load(&log->segments_len);
+  struct ValueLogSegment** segments = atomic_load(&log->segments);
+  for (size_t i = 0; i < segments_len; i++) {
+    struct ValueLogSegment* segment = segments[i];
+    if (segment == NULL) {
+      continue;
+    }
+    if (!atomic_load(&segment->removed)) {
+      if (segment->garbage != segment->stored &&
+          ValueLog_store_garbage(segment) == 0 &&
+          fdatasync(segment->fd) == -1) {
+        perror("fdatasync");
+      }
+      if (close(segment->fd) == -1) {
+        perror("close");
+      }
+    }
+    if (segment->map != NULL) {
+      ValueLog_unref_map(segment->map);
+    }
+    free(segment);
+  }
+  free(segments);
+  for (size_t i = 0; i < log->retired_len; i++) {
+    free(log->retired[i]);
+  }
+  free(log->retired);
+  free(log->dir);
+
+  if (log->map != NULL) {
+    ValueLog_unref_map(log->map);
+  }
+  Uring_free(log->uring);
+  pthread_mutex_destroy(&log->uring_lock);
+  pthread_cond_destroy(&log->readers_cond);
+  pthread_mutex_destroy(&log->readers_lock);
+  pthread_mutex_destroy(&log->lock);
+  free(log->buf);
   free(log);
 }
@@ -17,8 +17,14 @@
 #ifndef WISCKEY_VALUE_LOG_H
 #define WISCKEY_VALUE_LOG_H
 
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 
+#include "common.h"
+#include "memtable.h"
+#include "uring.h"
+
 /**
  * @file
  * @author Adam Comer <adambcomer@gmail.com>
@@ -27,33 +33,240 @@
  * @brief Log file of the key-value pairs.
  */
 
+#define VALUE_LOG_MAGIC 0x474C5657U ///< Magic number at the start of the file.
+#define VALUE_LOG_VERSION 2         ///< Version of the entries written.
+#define VALUE_LOG_VERSION_VARINT 1  ///< Version without the codec byte.
+#define VALUE_LOG_VERSION_FIXED 0   ///< Version with fixed-size entry headers.
+#define VALUE_LOG_HEADER_SIZE 16    ///< Size of the file header in bytes.
+#define VALUE_LOG_ENTRY_HEADER_SIZE                                            \
+  16 ///< Size of an entry header in bytes in the fixed-size format.
+#define VALUE_LOG_ENTRY_MAX_HEADER_SIZE                                        \
+  (3 * WISCKEY_VARINT_MAX + 1) ///< Longest entry header in bytes.
+#define VALUE_LOG_TOMBSTONE                                                    \
+  UINT64_MAX ///< Value length of a tombstone in the fixed-size format.
+#define VALUE_LOG_REPLAY_BATCH                                                 \
+  4096 ///< Number of entries applied to the MemTable at once on replay.
+#define VALUE_LOG_BUFFER_SIZE                                                  \
+  (64 * 1024) ///< Size of the buffer that gathers appended entries.
+#define VALUE_LOG_FETCH_SIZE                                                   \
+  (32 * 1024) ///< Longest entry that ValueLog_read_sized reads in one go.
+#define VALUE_LOG_SEGMENT_SHIFT                                                \
+  32 ///< Bits of a segmented location that hold the offset in the segment.
+#define VALUE_LOG_SEGMENT_MASK                                                 \
+  ((UINT64_C(1) << VALUE_LOG_SEGMENT_SHIFT) - 1) ///< Mask of the offset.
+#define VALUE_LOG_SEGMENT_SUFFIX ".vlog" ///< File name suffix of a segment.
+
 /**
  * @brief Value Log of the Database.
  *
  * The Value Log stores the values in the database in the order that they were
  * written. New entries are written to the head of the file. To remove values
  * that have been overwritten or deleted, the database runs a garbage collection
- * process that hole-punches the file with `fallocate`. After the file has been
- * hole-punched, the tail is updated to the position of the last known write
- * that is still live.
+ * process that copies the live entries at the tail to the head and moves the
+ * tail past them with ValueLog_set_tail, which hole-punches the file with
+ * `fallocate`.
  *
  * The ValueLog entries also hold a copy of the key to speed up the garbage
  * collection procces.
+ *
+ * Appends can run on any number of threads, and their values are compressed
+ * before the lock of the ValueLog is taken. Reads use `pread` and can run on
+ * any number of threads alongside the appends. Appended entries are gathered
+ * in a buffer, and a read of an entry that is still in it writes the buffer out
+ * first.
+ *
+ * Values can also be read into a buffer of the caller with ValueLog_read, or
+ * without a copy as a slice of a read-only mapping of the file with
+ * ValueLog_get_slice. A pinned slice keeps its mapping alive, and the space
+ * freed by ValueLog_set_tail is only hole-punched once no slice is pinned.
+ * When the length of the whole entry is known, ValueLog_get_sized and
+ * ValueLog_read_sized read it with one `pread` and check its key.
+ *
+ * Because every entry has its key, the ValueLog can stand in for the WAL. A
+ * delete is then logged as a tombstone entry, which has no value bytes, and
+ * ValueLog_load_memtable rebuilds the MemTable from the entries after a
+ * checkpoint.
+ *
+ * The file starts with a header of the magic number and the format version,
+ * each a `uint32_t`, followed by the tail as a `uint64_t`. Every entry is then
+ * laid out as:
+ *
+ * | Field          | Size                           |
+ * |----------------|--------------------------------|
+ * | Key length     | varint                         |
+ * | Value length+1 | varint                         |
+ * | Codec          | 1 byte                         |
+ * | Raw length     | varint, if the codec isn't 0   |
+ * | Key            | Key length                     |
+ * | Value          | Value length                   |
+ *
+ * A value length of 0 marks a tombstone. The codec is one of the `CODEC_*` IDs,
+ * and a compressed value is followed by its length once decompressed. With
+ * ValueLog_set_compression, values of at least `compress_min_size` bytes are
+ * compressed, and the compressed value is only kept if it is at least
+ * `compress_min_ratio` times smaller. A value is decompressed straight into the
+ * buffer it is read into, and a slice of a compressed value is a decompressed
+ * copy instead of a pinned mapping.
+ *
+ * Files of version VALUE_LOG_VERSION_VARINT have no codec byte, and ValueLogs
+ * written before the header was added are read as version
+ * VALUE_LOG_VERSION_FIXED, where an entry starts with `uint64_t` key and value
+ * lengths and a tombstone has a value length of VALUE_LOG_TOMBSTONE. Both are
+ * appended to in their own format, without compression. The fixed-size format
+ * has no header to keep the tail in, so it can't be garbage collected.
+ *
+ * A segmented ValueLog is split into files of about `segment_size` bytes,
+ * named `<id>.vlog` by a sequence number. A location holds the ID of its
+ * segment above VALUE_LOG_SEGMENT_SHIFT and the offset in the segment below
+ * it, so locations still grow with every append. Only the newest segment is
+ * appended to. It is sealed and synced once the next entry doesn't fit, and a
+ * new segment is started. Every segment has the same header as the single
+ * file, but keeps the bytes of garbage it holds where the tail would be. Each
+ * segment has its own version, and new segments are always written in
+ * VALUE_LOG_VERSION.
+ * Callers report overwritten values with ValueLog_discard, and the garbage
+ * collector rewrites the live entries of the segments with the most garbage
+ * and deletes them with ValueLog_remove_segment instead of punching holes.
  */
 struct ValueLog
 {
-  FILE* file;  ///< The file that the values are written to.
+  int fd;           ///< The file that the values are written to.
+  uint32_t version; ///< The format version of the file, or of the segment
+                    ///< being appended to.
   size_t head; ///< The head of the ValueLog. This is where the next value will
                ///< be written.
   size_t tail; ///< The tail of the ValueLog. This is the position of the oldest
                ///< write that hasn't been overwritten or deleted.
+
+  char* buf;      ///< Entries at the head that aren't written to the file yet.
+  size_t buf_len; ///< The number of bytes in `buf`.
+  size_t buf_cap; ///< The capacity of `buf`.
+  _Atomic size_t written; ///< End of the entries written to the file. The
+                          ///< entries before it are read without a lock.
+  pthread_mutex_t lock;   ///< Guards the head and the buffer against other
+                          ///< appends and readers of the entries in it, and
+                          ///< the fields below.
+
+  struct ValueLogMap* map; ///< The newest mapping of the file or NULL.
+  size_t pins;             ///< The number of slices that are pinned.
+  size_t punched;          ///< End of the space that is hole-punched.
+
+  size_t segment_size;  ///< Size at which a segment is sealed or 0 if
+                        ///< the ValueLog is a single file.
+  char* dir;            ///< Directory of the segments or NULL.
+  uint64_t segments_id; ///< ID of the segment in the first slot.
+  struct ValueLogSegment** _Atomic segments; ///< Segments by ID. A slot is
+                                             ///< NULL if the segment was gone
+                                             ///< on open. Grown arrays are
+                                             ///< retired, so readers can use
+                                             ///< them without the lock.
+  _Atomic size_t segments_len;       ///< The number of slots in use.
+  size_t segments_cap;               ///< The capacity of `segments`.
+  struct ValueLogSegment*** retired; ///< Outgrown segment arrays.
+  size_t retired_len;                ///< The number of outgrown arrays.
+  pthread_mutex_t readers_lock;      ///< Guards the waits on `readers_cond`.
+  pthread_cond_t readers_cond;       ///< Signals that a removed segment lost
+                                     ///< its last reader.
+
+  int codec;                 ///< Codec that new values are compressed with.
+  size_t compress_min_size;  ///< Values shorter than this aren't compressed.
+  double compress_min_ratio; ///< Smallest ratio of the length of a value to
+                             ///< its compressed length that is kept.
+
+  struct Uring* uring;        ///< Ring that the syncs are submitted to or NULL.
+  pthread_mutex_t uring_lock; ///< Lets one sync at a time submit to the ring.
+};
+
+/**
+ * @brief File of a segmented ValueLog.
+ *
+ * A removed segment keeps its slot, so a reader that raced the removal finds
+ * it marked and fails instead of reading a closed file.
+ */
+struct ValueLogSegment
+{
+  uint64_t id;             ///< The ID of the segment.
+  uint32_t version;        ///< The format version of the segment.
+  int fd;                  ///< The file of the segment or -1 once removed.
+  size_t size;             ///< Bytes in the segment once it is sealed.
+  size_t garbage;          ///< Bytes of overwritten and deleted entries.
+  size_t stored;           ///< Garbage last written to the header.
+  struct ValueLogMap* map; ///< The newest mapping of the segment or NULL.
+  _Atomic size_t readers;  ///< Readers using `fd` without the lock.
+  _Atomic int removed;     ///< Set once the segment is removed.
+};
+
+/**
+ * @brief Garbage of a sealed segment, reported by ValueLog_garbage_segments.
+ */
+struct ValueLogSegmentStats
+{
+  uint64_t id;    ///< The ID of the segment.
+  size_t start;   ///< Location of the first entry of the segment.
+  size_t end;     ///< Location after the last entry of the segment.
+  size_t garbage; ///< Bytes of overwritten and deleted entries.
+};
+
+/**
+ * @brief Read-only mapping of the ValueLog file.
+ *
+ * The ValueLog holds a reference to its newest mapping and every pinned slice
+ * holds one to the mapping it points into. A mapping is unmapped when its last
+ * reference is dropped.
+ */
+struct ValueLogMap
+{
+  char* data;  ///< Start of the mapping.
+  size_t len;  ///< Length of the mapping.
+  size_t refs; ///< References to the mapping. Guarded by the ValueLog lock.
+};
+
+/**
+ * @brief Value pinned in a mapping of the ValueLog.
+ *
+ * Note: Release the slice with ValueLog_release_slice.
+ */
+struct ValueLogSlice
+{
+  const char* data;        ///< The value. Points into `map`.
+  size_t len;              ///< Length of the value.
+  struct ValueLogMap* map; ///< The mapping that is pinned or NULL if `data`
+                           ///< is a decompressed copy.
+};
+
+/**
+ * @brief Entry read from the ValueLog.
+ *
+ * The key and the value share one allocation that starts at `key`.
+ */
+struct ValueLogEntry
+{
+  char* key;        ///< Key of the entry.
+  size_t key_len;   ///< Length of the key.
+  char* value;      ///< Value of the entry. Points into the `key` allocation.
+  size_t value_len; ///< Length of the value, decompressed.
+  int tombstone;    ///< Set if the entry deletes its key.
+  size_t len;       ///< Length of the entry in the file, including its header.
+};
+
+/**
+ * @brief Key-value pair of a batch append to the ValueLog.
+ */
+struct ValueLogBatchEntry
+{
+  const char* key;   ///< Key of the entry.
+  size_t key_len;    ///< Length of the key.
+  const char* value; ///< Value of the entry.
+  size_t value_len;  ///< Length of the value.
 };
 
 /**
  * @brief Creates a new ValueLog or loads an existing one from disk.
  *
  * If the ValueLog file already exists, this function will only open the file
- * without scanning it. This function doesn't check if file has been corrupted.
+ * and read its header without scanning it. This function doesn't check if file
+ * has been corrupted. A new file gets a header, and the head and tail are moved
+ * past it. The tail is the larger of `tail` and the tail stored in the header.
  *
  * Note: Free this ValueLog with ValueLog_free.
  *
@@ -65,6 +278,42 @@ struct ValueLog
 struct ValueLog*
 ValueLog_new(const char* path, size_t head, size_t tail);
 
+/**
+ * @brief Creates a new segmented ValueLog or loads an existing one from disk.
+ *
+ * The segments are the `<id>.vlog` files in `dir`. New values are appended to
+ * the segment with the highest ID, and the first segment is created if there
+ * is none.
+ *
+ * Note: Free this ValueLog with ValueLog_free.
+ *
+ * @param dir Directory of the segments. The path must be null-terminated.
+ * @param segment_size Size at which a segment is sealed. A single entry larger
+ * than this gets a segment of its own.
+ * @return A pointer to a ValueLog or NULL if there was an error.
+ */
+struct ValueLog*
+ValueLog_new_segmented(const char* dir, size_t segment_size);
+
+/**
+ * @brief Compresses the values appended from now on.
+ *
+ * Values that don't shrink enough are still stored as they are. Files in an
+ * older format than VALUE_LOG_VERSION are never compressed.
+ *
+ * @param log The ValueLog to compress the values of.
+ * @param codec The ID of the codec or CODEC_NONE to stop compressing. It must
+ * be supported by this build.
+ * @param min_size Values shorter than this are stored as they are.
+ * @param min_ratio A compressed value is only kept if the value is at least
+ * this many times longer.
+ */
+void
+ValueLog_set_compression(struct ValueLog* log,
+                         int codec,
+                         size_t min_size,
+                         double min_ratio);
+
 /**
  * @brief Appends a new key-value pair to the ValueLog.
  *
@@ -90,6 +339,122 @@ ValueLog_append(struct ValueLog* log,
                 const char* value,
                 size_t value_len);
 
+/**
+ * @brief Appends a new key-value pair to the ValueLog, and gives the length of
+ * its entry.
+ *
+ * The entry ends at `*pos + *len`, which a caller that appends alongside other
+ * threads can't read from the head.
+ *
+ * @param log The ValueLog to write to.
+ * @param pos A pointer that is assigned to the location of the entry.
+ * @param len A pointer that is assigned to the length of the entry.
+ * @param key The key being written.
+ * @param key_len The length of the key.
+ * @param value The value that is being written.
+ * @param value_len The length of the value.
+ * @return This function returns 0 if the entry was written successfully and -1
+ * if there was an error.
+ */
+int
+ValueLog_append_sized(struct ValueLog* log,
+                      size_t* pos,
+                      size_t* len,
+                      const char* key,
+                      size_t key_len,
+                      const char* value,
+                      size_t value_len);
+
+/**
+ * @brief Appends a batch of key-value pairs to the ValueLog.
+ *
+ * The entries are laid out next to each other in order, like a run of
+ * ValueLog_append calls, but under one lock. A batch that doesn't fit in the
+ * append buffer is written with a single `pwritev` at the head, or a few if it
+ * has more than `IOV_MAX / 3` entries. In a segmented ValueLog the batch is
+ * kept in one segment, and a batch larger than a segment gets one of its own.
+ *
+ * The head only moves once the whole batch is written, so on an error none of
+ * the entries are in the ValueLog and the batch can be retried.
+ *
+ * @param log The ValueLog to write to.
+ * @param pos An array of `count` locations that are assigned to the locations
+ * of the entries.
+ * @param entries The key-value pairs being written.
+ * @param count The number of entries.
+ * @return This function returns 0 if the entries were written successfully and
+ * -1 if there was an error.
+ */
+int
+ValueLog_append_batch(struct ValueLog* log,
+                      size_t* pos,
+                      const struct ValueLogBatchEntry* entries,
+                      size_t count);
+
+/**
+ * @brief Appends a tombstone for a deleted key to the ValueLog.
+ *
+ * Tombstones are only needed when the ValueLog is used to recover the
+ * MemTable. They can't be fetched with ValueLog_get.
+ *
+ * @param log The ValueLog to write to.
+ * @param pos A pointer that is assigned to the location on the where the
+ * tombstone was written to.
+ * @param key The key being deleted.
+ * @param key_len The length of the key.
+ * @return This function returns 0 if the tombstone was written successfully
+ * and -1 if there was an error.
+ */
+int
+ValueLog_append_tombstone(struct ValueLog* log,
+                          size_t* pos,
+                          const char* key,
+                          size_t key_len);
+
+/**
+ * @brief Appends a tombstone for a key to the ValueLog, and gives the length of
+ * its entry, like ValueLog_append_sized.
+ *
+ * @param log The ValueLog to write to.
+ * @param pos A pointer that is assigned to the location of the tombstone.
+ * @param len A pointer that is assigned to the length of the tombstone.
+ * @param key The key being deleted.
+ * @param key_len The length of the key.
+ * @return This function returns 0 if the tombstone was written successfully
+ * and -1 if there was an error.
+ */
+int
+ValueLog_append_tombstone_sized(struct ValueLog* log,
+                                size_t* pos,
+                                size_t* len,
+                                const char* key,
+                                size_t key_len);
+
+/**
+ * @brief Replays the entries of the ValueLog into a MemTable.
+ *
+ * The entries from `pos`, or the first entry if `pos` is before it, to the head
+ * are applied in order, with their positions as the value locations and -1 for
+ * tombstones. The replay stops early once the MemTable should be flushed, so a
+ * long log can be recovered into several MemTables by calling this function
+ * until `pos` reaches the head.
+ *
+ * An entry that is cut short at the end of the file was torn by a crash. It is
+ * dropped and the head is moved back to its position, so the next append
+ * overwrites it.
+ *
+ * @param log The ValueLog to replay.
+ * @param pos The position to start the replay at. It is assigned to the
+ * position after the last replayed entry.
+ * @param memtable The MemTable to replay the entries into.
+ * @return This function returns 0 if the entries were replayed and -1 if
+ * there was an error.
+ */
+int
+ValueLog_load_memtable(struct ValueLog* log,
+                       size_t* pos,
+                       struct MemTable* memtable);
+
 /**
  * @brief Fetches a value from the ValueLog at a given position.
  *
@@ -106,11 +471,232 @@ ValueLog_append(struct ValueLog* log,
  * -1 if there was an error.
  */
 int
-ValueLog_get(const struct ValueLog* log,
+ValueLog_get(struct ValueLog* log,
              char** value,
              size_t* value_len,
              size_t value_loc);
 
+/**
+ * @brief Reads a value into a buffer of the caller.
+ *
+ * The length of the value is always assigned to `value_len`. The value is only
+ * read if `buf` is large enough to hold it, so the length can be queried with
+ * a NULL `buf` and a `buf_len` of 0.
+ *
+ * @param log The ValueLog to read from.
+ * @param buf The buffer to read the value into or NULL.
+ * @param buf_len The size of `buf`.
+ * @param value_len A pointer that is assigned to the length of the value.
+ * @param value_loc The location on the ValueLog that this value resides in.
+ * @return This function returns 0 if the value was read or its length
+ * queried, and -1 if there was an error.
+ */
+int
+ValueLog_read(struct ValueLog* log,
+              char* buf,
+              size_t buf_len,
+              size_t* value_len,
+              size_t value_loc);
+
+/**
+ * @brief Fetches a value with one read of its whole entry.
+ *
+ * The same as ValueLog_get, but the entry is read with a single `pread` of
+ * `value_size` bytes, its header and key included, instead of reading the
+ * header first. The size is only a hint: an entry that isn't `value_size` bytes
+ * long is read through its header. Unless `key` is NULL, the key of the entry
+ * is checked, so a stale location isn't taken for the value of the key.
+ *
+ * @param log The ValueLog to read from.
+ * @param value A double-pointer for the value, as in ValueLog_get.
+ * @param value_len A pointer that is assigned to the length of the value.
+ * @param value_loc The location on the ValueLog that this value resides in.
+ * @param value_size The length of the entry at `value_loc` or 0 if it isn't
+ * known.
+ * @param key The key that the entry holds or NULL.
+ * @param key_len The length of the key.
+ * @return This function returns 0 if the value was retrieved successfully and
+ * -1 if there was an error or the entry holds another key.
+ */
+int
+ValueLog_get_sized(struct ValueLog* log,
+                   char** value,
+                   size_t* value_len,
+                   size_t value_loc,
+                   size_t value_size,
+                   const char* key,
+                   size_t key_len);
+
+/**
+ * @brief Reads a value into a buffer of the caller with one read of its whole
+ * entry.
+ *
+ * The same as ValueLog_read, with the single read and the key check of
+ * ValueLog_get_sized. Only entries of up to VALUE_LOG_FETCH_SIZE bytes are read
+ * in one go, and their value is copied to `buf`. A larger value is read
+ * straight into `buf` after its header, which saves the copy.
+ *
+ * @param log The ValueLog to read from.
+ * @param buf The buffer to read the value into or NULL.
+ * @param buf_len The size of `buf`.
+ * @param value_len A pointer that is assigned to the length of the value.
+ * @param value_loc The location on the ValueLog that this value resides in.
+ * @param value_size The length of the entry at `value_loc` or 0 if it isn't
+ * known.
+ * @param key The key that the entry holds or NULL.
+ * @param key_len The length of the key.
+ * @return This function returns 0 if the value was read or its length
+ * queried, and -1 if there was an error or the entry holds another key.
+ */
+int
+ValueLog_read_sized(struct ValueLog* log,
+                    char* buf,
+                    size_t buf_len,
+                    size_t* value_len,
+                    size_t value_loc,
+                    size_t value_size,
+                    const char* key,
+                    size_t key_len);
+
+/**
+ * @brief Pins a value in a mapping of the ValueLog, without copying it.
+ *
+ * The file is mapped again when the value is past the end of the newest
+ * mapping. The slice stays valid until it is released, even if the garbage
+ * collector moves the tail past it in the meantime. A compressed value is
+ * decompressed into a copy that nothing pins.
+ *
+ * Note: Release the slice with ValueLog_release_slice before the ValueLog is
+ * freed.
+ *
+ * @param log The ValueLog to read from.
+ * @param slice A pointer that is assigned to the pinned value.
+ * @param value_loc The location on the ValueLog that this value resides in.
+ * @return This function returns 0 if the value was pinned and -1 if there was
+ * an error.
+ */
+int
+ValueLog_get_slice(struct ValueLog* log,
+                   struct ValueLogSlice* slice,
+                   size_t value_loc);
+
+/**
+ * @brief Releases a slice pinned with ValueLog_get_slice.
+ *
+ * Once the last slice is released, the space freed by ValueLog_set_tail in the
+ * meantime is hole-punched.
+ *
+ * @param log The ValueLog the slice was pinned in.
+ * @param slice The slice to release.
+ */
+void
+ValueLog_release_slice(struct ValueLog* log, struct ValueLogSlice* slice);
+
+/**
+ * @brief Reads the entry at a given position, key included.
+ *
+ * The value is decompressed if it is compressed.
+ *
+ * Note: The caller is responsible for freeing `entry->key`.
+ *
+ * @param log The ValueLog to read from.
+ * @param loc The position of the entry.
+ * @param entry A pointer that is assigned to the entry.
+ * @return This function returns 0 if the entry was read successfully and -1 if
+ * there was an error.
+ */
+int
+ValueLog_read_entry(struct ValueLog* log,
+                    size_t loc,
+                    struct ValueLogEntry* entry);
+
+/**
+ * @brief Frees the entries before a new tail.
+ *
+ * The tail is written to the header and synced before the range between the
+ * old and the new tail is hole-punched, so it survives a restart. The caller
+ * must make sure that nothing points at the freed entries anymore. While a
+ * slice is pinned, the hole punching waits for the last slice to be released.
+ *
+ * @param log The ValueLog to shrink.
+ * @param tail The new tail. A tail at or before the current one is ignored.
+ * @return This function returns 0 if the tail was moved and -1 if there was an
+ * error, or the ValueLog is in the fixed-size format or segmented.
+ */
+int
+ValueLog_set_tail(struct ValueLog* log, size_t tail);
+
+/**
+ * @brief Counts the entry at a location as garbage in its segment.
+ *
+ * This is a no-op if the ValueLog isn't segmented or the segment is gone. The
+ * counts only steer which segments are collected first, so a value that is
+ * never reported only delays the collection of its segment. The header of the
+ * entry is read to find its length, unless the length is given.
+ *
+ * @param log The segmented ValueLog.
+ * @param loc The location of the overwritten or deleted entry.
+ * @param size The length of the entry or 0 if it isn't known.
+ */
+void
+ValueLog_discard(struct ValueLog* log, size_t loc, size_t size);
+
+/**
+ * @brief Lists the sealed segments that hold garbage.
+ *
+ * The garbage of every sealed segment is stored in its header and synced, if it
+ * changed since it was last stored. A segment stores its garbage when it is
+ * sealed too, so a crash only loses the discards since the last call or seal.
+ *
+ * Note: The caller is responsible for freeing `segments`.
+ *
+ * @param log The segmented ValueLog.
+ * @param limit Only segments that end at or before this location are listed.
+ * @param min_ratio Only segments with at least this share of their bytes in
+ * garbage are listed.
+ * @param segments A pointer that is assigned to the segments, sorted from the
+ * most garbage to the least.
+ * @return The number of segments listed.
+ */
+size_t
+ValueLog_garbage_segments(struct ValueLog* log,
+                          size_t limit,
+                          double min_ratio,
+                          struct ValueLogSegmentStats** segments);
+
+/**
+ * @brief Deletes a sealed segment.
+ *
+ * The caller must make sure that nothing points at the entries of the segment
+ * anymore. Pinned slices of the segment stay valid until they are released.
+ *
+ * @param log The segmented ValueLog.
+ * @param id The ID of the segment.
+ * @return This function returns 0 if the segment was deleted and -1 if there
+ * was an error or the segment is the one being appended to.
+ */
+int
+ValueLog_remove_segment(struct ValueLog* log, uint64_t id);
+
+/**
+ * @brief The head of the ValueLog, where the next entry will be written.
+ *
+ * @param log The ValueLog.
+ * @return The head of the ValueLog.
+ */
+size_t
+ValueLog_head(struct ValueLog* log);
+
+/**
+ * @brief Bytes of the ValueLog that take up space on disk.
+ *
+ * @param log The ValueLog.
+ * @return The bytes between the tail and the head, or the bytes in every
+ * segment of a segmented ValueLog.
+ */
+size_t
+ValueLog_size(struct ValueLog* log);
+
 /**
  * @brief Syncs the ValueLog to the disk.
  *
@@ -123,13 +709,29 @@ ValueLog_get(const struct ValueLog* log,
  * disk and -1 if there was an error.
  */
 int
-ValueLog_sync(const struct ValueLog* log);
+ValueLog_sync(struct ValueLog* log);
+
+/**
+ * @brief Submits the syncs of ValueLog_sync through io_uring.
+ *
+ * The buffer is written and the file synced as linked requests without the
+ * lock of the ValueLog held. Appends that write the buffer out when it is full
+ * keep using `pwrite`, since they don't sync. The ValueLog keeps using `pwrite`
+ * and `fsync` if io_uring isn't available.
+ *
+ * @param log The ValueLog to submit through io_uring.
+ * @return This function returns 0 if io_uring is used and -1 if it isn't
+ * available.
+ */
+int
+ValueLog_enable_io_uring(struct ValueLog* log);
 
 /**
  * @brief Frees the ValueLog.
  *
  * Note: This function won't delete the file or the underlying data in the
- * ValueLog. This function only frees the memory allocated to a ValueLog.
+ * ValueLog. This function only frees the memory allocated to a ValueLog. Every
+ * slice must be released first.
  *
  * @param log The ValueLog to free.
  */
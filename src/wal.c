@@ -14,126 +14,662 @@
  * limitations under the License.
  */
 
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include "common.h"
 #include "memtable.h"
+#include "uring.h"
 #include "wal.h"
 
-struct WAL*
-WAL_new(char* path)
+static int
+write_all(int fd, const char* buf, size_t len, size_t offset)
 {
-  FILE* file = fopen(path, "a+");
-  if (file == NULL) {
-    perror("fopen");
-    return NULL;
+  while (len > 0) {
+    ssize_t n = pwrite(fd, buf, len, (off_t)offset);
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("pwrite");
+      return -1;
+    }
+    buf += n;
+    len -= (size_t)n;
+    offset += (size_t)n;
   }
 
+  return 0;
+}
+
+static struct WAL*
+WAL_init(int fd, char* path, uint64_t seq, size_t segment_size)
+{
   struct WAL* wal = malloc(sizeof(struct WAL));
-  wal->file = file;
+  wal->fd = fd;
   wal->path = path;
+  wal->seq = seq;
+  wal->segment_size = segment_size;
+  wal->version = WAL_VERSION;
+  wal->offset = WAL_HEADER_SIZE;
+  wal->size = WAL_HEADER_SIZE;
+
+  wal->buf = malloc(WAL_BUFFER_SIZE);
+  wal->buf_len = 0;
+  wal->buf_cap = WAL_BUFFER_SIZE;
+
+  wal->appended = 0;
+  wal->durable = 0;
+  wal->syncs = 0;
+  wal->syncing = 0;
+  wal->error = 0;
+  wal->uring = NULL;
+
+  pthread_mutex_init(&wal->lock, NULL);
+  pthread_cond_init(&wal->cond, NULL);
 
   return wal;
 }
 
+struct WAL*
+WAL_new(char* path, uint64_t seq, size_t segment_size)
+{
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd == -1) {
+    perror("open");
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    perror("fstat");
+    close(fd);
+    return NULL;
+  }
+
+  // Allocate the blocks of a new segment up front. A recycled segment already
+  // has them.
+  if (segment_size > (size_t)st.st_size &&
+      fallocate(fd, 0, 0, (off_t)segment_size) == -1) {
+    if (errno != EOPNOTSUPP || ftruncate(fd, (off_t)segment_size) == -1) {
+      perror("fallocate");
+      close(fd);
+      return NULL;
+    }
+  }
+
+  char header[WAL_HEADER_SIZE];
+  uint32_t magic = WAL_MAGIC;
+  uint32_t version = WAL_VERSION;
+  memcpy(header, &magic, sizeof(uint32_t));
+  memcpy(header + sizeof(uint32_t), &version, sizeof(uint32_t));
+  memcpy(header + 2 * sizeof(uint32_t), &seq, sizeof(uint64_t));
+
+  // The header must be durable before any record, or a recycled segment could
+  // replay its old records under its old sequence number.
+  if (write_all(fd, header, WAL_HEADER_SIZE, 0) == -1 || fdatasync(fd) == -1) {
+    perror("fdatasync");
+    close(fd);
+    return NULL;
+  }
+
+  return WAL_init(fd, path, seq, segment_size);
+}
+
+struct WAL*
+WAL_open(char* path)
+{
+  int fd = open(path, O_RDWR);
+  if (fd == -1) {
+    perror("open");
+    return NULL;
+  }
+
+  char header[WAL_HEADER_SIZE] = { 0 };
+  ssize_t n = pread(fd, header, WAL_HEADER_SIZE, 0);
+  if (n == -1) {
+    perror("pread");
+    close(fd);
+    return NULL;
+  }
+
+  uint32_t magic;
+  uint32_t version;
+  uint64_t seq;
+  memcpy(&magic, header, sizeof(uint32_t));
+  memcpy(&version, header + sizeof(uint32_t), sizeof(uint32_t));
+  memcpy(&seq, header + 2 * sizeof(uint32_t), sizeof(uint64_t));
+
+  if (magic == 0 && version == 0 && seq == 0) {
+    // The segment was created but its header never reached the disk.
+    struct WAL* wal = WAL_init(fd, path, 0, 0);
+    wal->offset = 0;
+    wal->size = 0;
+    return wal;
+  }
+  if (n != WAL_HEADER_SIZE || magic != WAL_MAGIC ||
+      version < WAL_VERSION_FIXED || version > WAL_VERSION) {
+    fprintf(stderr, "Unknown WAL format in %s\n", path);
+    close(fd);
+    return NULL;
+  }
+
+  struct WAL* wal = WAL_init(fd, path, seq, 0);
+  wal->version = version;
+  return wal;
+}
+
+/*
+ * Checksum of a record of `len` bytes, from the field after the crc to the end
+ * of the record.
+ */
+static uint32_t
+record_crc(uint64_t seq, const char* record, size_t len)
+{
+  uint32_t crc = WiscKey_crc32c(0, &seq, sizeof(uint64_t));
+  return WiscKey_crc32c(
+    crc, record + sizeof(uint32_t), len - sizeof(uint32_t));
+}
+
+/*
+ * Decodes the header of the record at the start of `left` bytes. `value_len`
+ * is assigned to the length of an inline value or 0, and `value_size` to the
+ * length of the ValueLog entry or 0. Returns the length of the header or 0 if
+ * the record is cut short.
+ */
+static size_t
+record_decode(const struct WAL* wal,
+              const char* record,
+              size_t left,
+              uint64_t* key_len,
+              int64_t* value_loc,
+              uint64_t* value_len,
+              uint64_t* value_size)
+{
+  *value_len = 0;
+  *value_size = 0;
+  if (wal->version == WAL_VERSION_FIXED) {
+    if (left < WAL_RECORD_HEADER_SIZE) {
+      return 0;
+    }
+
+    uint32_t key_len_32;
+    memcpy(&key_len_32, record + sizeof(uint32_t), sizeof(uint32_t));
+    memcpy(value_loc, record + 2 * sizeof(uint32_t), sizeof(int64_t));
+    *key_len = key_len_32;
+    return WAL_RECORD_HEADER_SIZE;
+  }
+
+  if (left < sizeof(uint32_t)) {
+    return 0;
+  }
+  size_t len = sizeof(uint32_t);
+  size_t n = WiscKey_varint_decode(record + len, left - len, key_len);
+  if (n == 0) {
+    return 0;
+  }
+  len += n;
+
+  // Locations are stored off by one, so a tombstone is a single zero byte.
+  uint64_t tag;
+  n = WiscKey_varint_decode(record + len, left - len, &tag);
+  if (n == 0) {
+    return 0;
+  }
+  if (wal->version == WAL_VERSION_LOC) {
+    *value_loc = (int64_t)tag - 1;
+  } else if (tag & 1) {
+    *value_loc = MEMTABLE_VALUE_INLINE;
+    *value_len = tag >> 1;
+  } else {
+    *value_loc = (int64_t)(tag >> 1) - 1;
+  }
+  len += n;
+
+  if (wal->version == WAL_VERSION && *value_loc >= 0) {
+    n = WiscKey_varint_decode(record + len, left - len, value_size);
+    if (n == 0) {
+      return 0;
+    }
+    len += n;
+  }
+
+  return len;
+}
+
+/*
+ * Checks the record at the start of `left` bytes and decodes its header.
+ * Returns the length of the header or 0 if the log ends at the record because
+ * it is cut short, torn, or left over from an earlier use of the segment.
+ */
+static size_t
+record_check(const struct WAL* wal,
+             const char* record,
+             size_t left,
+             uint64_t* key_len,
+             int64_t* value_loc,
+             uint64_t* value_len,
+             uint64_t* value_size)
+{
+  size_t header_len = record_decode(
+    wal, record, left, key_len, value_loc, value_len, value_size);
+  if (header_len == 0 || *key_len > left - header_len ||
+      *value_len > left - header_len - *key_len) {
+    return 0;
+  }
+
+  uint32_t crc;
+  memcpy(&crc, record, sizeof(uint32_t));
+  if (record_crc(wal->seq, record, header_len + *key_len + *value_len) != crc) {
+    return 0;
+  }
+
+  return header_len;
+}
+
+/*
+ * Size of the WAL file, 0 if it holds no records, or SIZE_MAX if there was an
+ * error.
+ */
+static size_t
+WAL_file_size(const struct WAL* wal)
+{
+  struct stat st;
+  if (fstat(wal->fd, &st) == -1) {
+    perror("fstat");
+    return SIZE_MAX;
+  }
+
+  return (size_t)st.st_size <= WAL_HEADER_SIZE ? 0 : (size_t)st.st_size;
+}
+
 int
 WAL_load_memtable(struct WAL* wal, struct MemTable* memtable)
 {
-  int res = fseek(wal->file, 0, SEEK_SET);
-  if (res == -1) {
-    perror("fopen");
+  size_t offset = WAL_HEADER_SIZE;
+  return WAL_load_range(wal, memtable, &offset, SIZE_MAX);
+}
+
+int
+WAL_load_range(struct WAL* wal,
+               struct MemTable* memtable,
+               size_t* offset,
+               size_t end)
+{
+  size_t size = WAL_file_size(wal);
+  if (size == SIZE_MAX) {
+    return -1;
+  }
+  if (end > size) {
+    end = size;
+  }
+  if (*offset >= end) {
+    return 0;
+  }
+
+  // The mapping has to start at a page boundary.
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t map_start = *offset / page * page;
+  size_t map_len = end - map_start;
+  char* data =
+    mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, wal->fd, (off_t)map_start);
+  if (data == MAP_FAILED) {
+    perror("mmap");
     return -1;
   }
+  madvise(data, map_len, MADV_SEQUENTIAL);
 
-  while (1) {
-    int peek = fgetc(wal->file);
-    ungetc(peek, wal->file);
-    if (peek == EOF) {
+  // The records are decoded in place and applied in batches. The keys point
+  // into the mapping, which stays valid until the batch has been copied into
+  // the MemTable.
+  struct MemTableBatchEntry* batch =
+    malloc(WAL_REPLAY_BATCH * sizeof(struct MemTableBatchEntry));
+  size_t batch_len = 0;
+
+  size_t pos = *offset;
+  while (pos < end) {
+    const char* record = data + (pos - map_start);
+    size_t left = end - pos;
+
+    uint64_t wal_key_len;
+    int64_t wal_value_loc;
+    uint64_t wal_value_len;
+    uint64_t wal_value_size;
+    size_t header_len = record_check(wal,
+                                     record,
+                                     left,
+                                     &wal_key_len,
+                                     &wal_value_loc,
+                                     &wal_value_len,
+                                     &wal_value_size);
+    if (header_len == 0) {
       break;
     }
 
-    uint64_t wal_key_len;
-    size_t file_res = fread(&wal_key_len, sizeof(uint64_t), 1, wal->file);
-    if (file_res != 1) {
-      perror("fread");
-      return -1;
+    // Tombstones are records with a value location of -1, so sets and
+    // deletes share a batch. Inline values point into the mapping like the
+    // keys.
+    batch[batch_len].key = record + header_len;
+    batch[batch_len].key_len = wal_key_len;
+    batch[batch_len].value_loc = wal_value_loc;
+    batch[batch_len].value_size = wal_value_size;
+    batch[batch_len].value = record + header_len + wal_key_len;
+    batch[batch_len].value_len = wal_value_len;
+    batch_len++;
+    pos += header_len + wal_key_len + wal_value_len;
+
+    if (batch_len == WAL_REPLAY_BATCH) {
+      MemTable_set_batch(memtable, batch, batch_len);
+      batch_len = 0;
     }
+  }
+  MemTable_set_batch(memtable, batch, batch_len);
+  *offset = pos;
 
-    int64_t wal_value_loc;
-    file_res = fread(&wal_value_loc, sizeof(int64_t), 1, wal->file);
-    if (file_res != 1) {
-      perror("fread");
-      return -1;
+  free(batch);
+  munmap(data, map_len);
+
+  return 0;
+}
+
+/*
+ * Returns the offset after the record at `offset` by the lengths in its header,
+ * without checking it, or 0 if the records can't be framed past it. Framing
+ * stops at a record of zeros, where the preallocated space of a segment starts.
+ */
+static size_t
+record_frame(const struct WAL* wal,
+             const char* data,
+             size_t offset,
+             size_t size)
+{
+  if (offset >= size) {
+    return 0;
+  }
+
+  uint64_t key_len;
+  int64_t value_loc;
+  uint64_t value_len;
+  uint64_t value_size;
+  size_t left = size - offset;
+  const char* record = data + offset;
+  size_t header_len = record_decode(
+    wal, record, left, &key_len, &value_loc, &value_len, &value_size);
+  if (header_len == 0 || key_len > left - header_len ||
+      value_len > left - header_len - key_len) {
+    return 0;
+  }
+
+  uint32_t crc;
+  memcpy(&crc, record, sizeof(uint32_t));
+  if (crc == 0 && key_len == 0) {
+    return 0;
+  }
+
+  return offset + header_len + key_len + value_len;
+}
+
+size_t
+WAL_split(struct WAL* wal, size_t parts, size_t min_len, size_t* bounds)
+{
+  bounds[0] = WAL_HEADER_SIZE;
+  bounds[1] = SIZE_MAX;
+  size_t size = WAL_file_size(wal);
+  if (size == SIZE_MAX || size == 0 || parts <= 1) {
+    return 1;
+  }
+
+  char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, wal->fd, 0);
+  if (data == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+  madvise(data, size, MADV_SEQUENTIAL);
+
+  // The first walk finds where the framing ends, so the ranges split the
+  // records and not the preallocated space after them.
+  size_t end = WAL_HEADER_SIZE;
+  size_t next;
+  while ((next = record_frame(wal, data, end, size)) != 0) {
+    end = next;
+  }
+  size_t len = end - WAL_HEADER_SIZE;
+  if (min_len > 0 && len / min_len < parts) {
+    parts = len / min_len;
+  }
+
+  size_t n = 1;
+  if (parts > 1) {
+    size_t target = len / parts;
+    size_t offset = WAL_HEADER_SIZE;
+    while (n < parts && (offset = record_frame(wal, data, offset, end)) != 0) {
+      if (offset - WAL_HEADER_SIZE >= n * target && offset < end) {
+        bounds[n++] = offset;
+      }
     }
+  }
+  bounds[n] = SIZE_MAX;
+  munmap(data, size);
+
+  return n;
+}
+
+/*
+ * Writes the buffer to the file without syncing it. Must be called with the
+ * lock held and no sync in progress.
+ */
+static int
+WAL_write_buffer(struct WAL* wal)
+{
+  int res = write_all(wal->fd, wal->buf, wal->buf_len, wal->offset);
+  wal->offset += wal->buf_len;
+  wal->buf_len = 0;
+  if (res == -1) {
+    wal->error = 1;
+  }
+
+  return res;
+}
+
+/*
+ * Appends a record with a value tag and the bytes of an inline value. The tag
+ * of a value location is followed by the size of its ValueLog entry.
+ */
+static int
+WAL_append_record(struct WAL* wal,
+                  const char* key,
+                  size_t key_len,
+                  uint64_t tag,
+                  size_t value_size,
+                  const char* value,
+                  size_t value_len)
+{
+  char header[WAL_RECORD_MAX_HEADER_SIZE];
+  size_t header_len = sizeof(uint32_t);
+  header_len += WiscKey_varint_encode(header + header_len, key_len);
+  header_len += WiscKey_varint_encode(header + header_len, tag);
+  if (tag != 0 && (tag & 1) == 0) {
+    header_len += WiscKey_varint_encode(header + header_len, value_size);
+  }
+  size_t record_len = header_len + key_len + value_len;
+
+  pthread_mutex_lock(&wal->lock);
+
+  if (wal->error) {
+    pthread_mutex_unlock(&wal->lock);
+    return -1;
+  }
 
-    char wal_key[wal_key_len];
-    file_res = fread(&wal_key, sizeof(char), wal_key_len, wal->file);
-    if (file_res != wal_key_len) {
-      perror("fread");
+  // Records are written in order, so the buffer can only be written out when
+  // no leader is writing the records before it.
+  if (wal->buf_len + record_len > WAL_BUFFER_SIZE && wal->buf_len > 0 &&
+      !wal->syncing) {
+    if (WAL_write_buffer(wal) == -1) {
+      pthread_mutex_unlock(&wal->lock);
       return -1;
     }
+  }
 
-    if (wal_value_loc == -1) {
-      MemTable_delete(memtable, wal_key, wal_key_len);
-    } else {
-      MemTable_set(memtable, wal_key, wal_key_len, wal_value_loc);
+  if (wal->buf_len + record_len > wal->buf_cap) {
+    size_t cap = wal->buf_cap;
+    while (wal->buf_len + record_len > cap) {
+      cap *= 2;
     }
+    wal->buf = realloc(wal->buf, cap);
+    wal->buf_cap = cap;
+  }
+
+  char* dst = wal->buf + wal->buf_len;
+  memcpy(dst, header, header_len);
+  memcpy(dst + header_len, key, key_len);
+  if (value_len > 0) {
+    memcpy(dst + header_len + key_len, value, value_len);
   }
 
+  uint32_t crc = record_crc(wal->seq, dst, record_len);
+  memcpy(dst, &crc, sizeof(uint32_t));
+
+  wal->buf_len += record_len;
+  wal->size += record_len;
+  wal->appended++;
+
+  pthread_mutex_unlock(&wal->lock);
   return 0;
 }
 
 int
 WAL_append(struct WAL* wal, const char* key, size_t key_len, int64_t value_loc)
 {
-  uint64_t key_len_64 = key_len;
-  int64_t value_loc_64 = value_loc;
+  return WAL_append_sized(wal, key, key_len, value_loc, 0);
+}
 
-  size_t b_written = fwrite(&key_len_64, sizeof(uint64_t), 1, wal->file);
-  if (b_written != 1) {
-    perror("fwrite");
-    return -1;
-  }
-  b_written = fwrite(&value_loc_64, sizeof(int64_t), 1, wal->file);
-  if (b_written != 1) {
-    perror("fwrite");
-    return -1;
-  }
-  b_written = fwrite(key, sizeof(char), key_len, wal->file);
-  if (b_written != key_len) {
-    perror("fwrite");
-    return -1;
-  }
+int
+WAL_append_sized(struct WAL* wal,
+                 const char* key,
+                 size_t key_len,
+                 int64_t value_loc,
+                 size_t value_size)
+{
+  // Locations are stored off by one, so a tombstone is a single zero byte.
+  uint64_t tag = ((uint64_t)value_loc + 1) << 1;
+  return WAL_append_record(wal, key, key_len, tag, value_size, NULL, 0);
+}
 
-  return 0;
+int
+WAL_append_value(struct WAL* wal,
+                 const char* key,
+                 size_t key_len,
+                 const char* value,
+                 size_t value_len)
+{
+  uint64_t tag = (uint64_t)value_len << 1 | 1;
+  return WAL_append_record(wal, key, key_len, tag, 0, value, value_len);
 }
 
 int
-WAL_sync(const struct WAL* wal)
+WAL_enable_io_uring(struct WAL* wal)
 {
-  int res = fflush(wal->file);
-  if (res == EOF) {
-    perror("fflush");
-    return -1;
+  pthread_mutex_lock(&wal->lock);
+  if (wal->uring == NULL) {
+    wal->uring = Uring_new();
   }
+  int res = wal->uring != NULL ? 0 : -1;
+  pthread_mutex_unlock(&wal->lock);
 
-  res = fsync(fileno(wal->file));
-  if (res == -1) {
-    perror("fsync");
-    return -1;
+  return res;
+}
+
+int
+WAL_is_full(struct WAL* wal)
+{
+  pthread_mutex_lock(&wal->lock);
+  int full = wal->segment_size > 0 && wal->size >= wal->segment_size;
+  pthread_mutex_unlock(&wal->lock);
+
+  return full;
+}
+
+int
+WAL_sync(struct WAL* wal)
+{
+  pthread_mutex_lock(&wal->lock);
+
+  uint64_t target = wal->appended;
+  while (wal->durable < target && !wal->error) {
+    if (wal->syncing) {
+      // Follower: a leader is already syncing, wait for it to finish and check
+      // whether it covered this record.
+      pthread_cond_wait(&wal->cond, &wal->lock);
+      continue;
+    }
+
+    // Leader: take the whole buffer, including the records of the followers
+    // that queued up behind the previous leader.
+    char* buf = wal->buf;
+    size_t len = wal->buf_len;
+    size_t offset = wal->offset;
+    uint64_t batch_end = wal->appended;
+
+    wal->buf = malloc(wal->buf_cap);
+    wal->buf_len = 0;
+    wal->offset += len;
+    wal->syncing = 1;
+    pthread_mutex_unlock(&wal->lock);
+
+    int res;
+    if (wal->uring != NULL) {
+      res = Uring_write_sync(wal->uring, wal->fd, buf, len, offset);
+    } else {
+      res = write_all(wal->fd, buf, len, offset);
+      if (res == 0 && fdatasync(wal->fd) == -1) {
+        perror("fdatasync");
+        res = -1;
+      }
+    }
+    free(buf);
+
+    pthread_mutex_lock(&wal->lock);
+    wal->syncing = 0;
+    wal->syncs++;
+    if (res == -1) {
+      wal->error = 1;
+    } else {
+      wal->durable = batch_end;
+    }
+    pthread_cond_broadcast(&wal->cond);
   }
-  return 0;
+
+  int res = wal->error ? -1 : 0;
+  pthread_mutex_unlock(&wal->lock);
+
+  return res;
 }
 
 void
 WAL_free(struct WAL* wal)
 {
-  int res = fclose(wal->file);
+  if (wal->buf_len > 0 && !wal->error) {
+    WAL_write_buffer(wal);
+  }
+
+  int res = close(wal->fd);
   if (res == -1) {
-    perror("fclose");
+    perror("close");
   }
 
+  Uring_free(wal->uring);
+  pthread_cond_destroy(&wal->cond);
+  pthread_mutex_destroy(&wal->lock);
+  free(wal->buf);
   free(wal);
 }
@@ -17,10 +17,13 @@
 #ifndef WISCKEY_WAL_H
 #define WISCKEY_WAL_H
 
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 
+#include "common.h"
 #include "memtable.h"
+#include "uring.h"
 
 /**
  * @file
@@ -30,29 +33,129 @@
  * @brief Write-Ahead Log for the keys and the value positions.
  */
 
+#define WAL_BUFFER_SIZE                                                        \
+  (64 * 1024) ///< Buffered bytes that trigger a write without a sync.
+#define WAL_REPLAY_BATCH                                                       \
+  4096 ///< Number of records applied to the MemTable at once on replay.
+#define WAL_MAGIC 0x4C41574BU ///< Magic number at the start of a segment.
+#define WAL_VERSION 4         ///< Version of the segments that are written.
+#define WAL_VERSION_FIXED 1   ///< Version with fixed-size record headers.
+#define WAL_VERSION_LOC 2     ///< Version without inline values.
+#define WAL_VERSION_INLINE 3  ///< Version without ValueLog entry sizes.
+#define WAL_HEADER_SIZE 16    ///< Size of the segment header in bytes.
+#define WAL_RECORD_HEADER_SIZE                                                 \
+  16 ///< Size of a record header in bytes in the fixed-size format.
+#define WAL_RECORD_MAX_HEADER_SIZE                                             \
+  (4 + 3 * WISCKEY_VARINT_MAX) ///< Longest record header in bytes.
+
 /**
  * @brief Write-Ahead Log(WAL) of the Database.
  *
  * The WAL holds a running log of the operations that were applied to the
  * MemTable. When the database restarts, the WAL is replayed to recover the
  * MemTable.
+ *
+ * A WAL is a segment file of a fixed size that is preallocated when it is
+ * created, so appends overwrite blocks that already belong to the file and
+ * `fdatasync` doesn't have to update the file's metadata. Once the MemTable of
+ * a segment is flushed, the file can be recycled for a later segment without
+ * allocating it again. Appends past `segment_size` still grow the file;
+ * WAL_is_full tells the database when to move to the next segment.
+ *
+ * The segment starts with a header of WAL_HEADER_SIZE bytes: the WAL_MAGIC,
+ * the version, and the sequence number of the segment, each little-endian.
+ * Every record then has a header followed by the key and an inline value:
+ *
+ * | Field     | Type     | Description                                  |
+ * |-----------|----------|----------------------------------------------|
+ * | crc       | uint32_t | CRC-32C of the segment's sequence number,    |
+ * |           |          | then the rest of the record.                 |
+ * | key_len   | varint   | The length of the key.                       |
+ * | value_tag | varint   | The location of the value plus one, times    |
+ * |           |          | two, or 0 to delete. An odd tag holds the    |
+ * |           |          | length of an inline value, times two plus 1. |
+ * | size      | varint   | The length of the ValueLog entry at the      |
+ * |           |          | location, or 0. Only after a location.       |
+ * | key       | char[]   | The key.                                     |
+ * | value     | char[]   | The inline value, if the tag is odd.         |
+ *
+ * The lengths and locations are LEB128 varints (see WiscKey_varint_encode),
+ * so the header of a record with a short key is 6 to 12 bytes. New segments
+ * are always written in the WAL_VERSION format. Segments of the older
+ * WAL_VERSION_INLINE format, whose records have no ValueLog entry sizes, of the
+ * WAL_VERSION_LOC format, whose records hold the value location plus one and
+ * no inline values, and of the WAL_VERSION_FIXED format, whose records have a
+ * `uint32_t` key length and an `int64_t` value location, can still be
+ * replayed.
+ *
+ * A recycled segment still holds the records of its previous use behind the
+ * new ones. Their checksums were seeded with the old sequence number, so
+ * replay stops at the first record whose checksum doesn't match. That also
+ * ends the log at a record that was torn by a crash.
+ *
+ * Appended records are collected in a buffer that is written to the file once
+ * it holds WAL_BUFFER_SIZE bytes or when the WAL is synced. WAL_sync uses group
+ * commit: the first caller becomes the leader and writes the whole buffer with
+ * one `pwrite` and one `fdatasync`, while concurrent callers wait until the
+ * leader has made their records durable. Many writers that sync at the same
+ * time share a single `fdatasync` instead of paying for one each.
+ *
+ * With WAL_enable_io_uring, the leader submits its write and `fdatasync` to an
+ * io_uring as linked requests and enters the kernel once per group instead of
+ * twice.
  */
 struct WAL
 {
-  FILE* file; ///< The file that the WAL writes the keys to.
-  char* path; ///< The path of the WAL file.
+  int fd;              ///< The file that the WAL writes the keys to.
+  char* path;          ///< The path of the WAL file.
+  uint64_t seq;        ///< The sequence number of the segment.
+  uint32_t version;    ///< The format version of the segment.
+  size_t segment_size; ///< The preallocated size of the segment.
+  size_t offset;       ///< File offset of the next write.
+  size_t size;         ///< Bytes in the segment, including the buffer.
+
+  char* buf;      ///< Records that haven't been written to the file.
+  size_t buf_len; ///< The number of bytes in `buf`.
+  size_t buf_cap; ///< The capacity of `buf`.
+
+  uint64_t appended;   ///< The number of records appended.
+  uint64_t durable;    ///< The number of records known to be on disk.
+  uint64_t syncs;      ///< The number of `fdatasync` calls.
+  int syncing;         ///< Set while a leader is writing and syncing.
+  int error;           ///< Set once a write or sync has failed.
+  struct Uring* uring; ///< Ring that the syncs are submitted to or NULL.
+
+  pthread_mutex_t lock; ///< Guards all of the above.
+  pthread_cond_t cond;  ///< Signals the end of a sync.
 };
 
 /**
- * @brief Creates a new emtpy WAL.
+ * @brief Creates a new empty WAL segment.
  *
- * Note: If a WAL already exists at this path, the file will not be overwritten.
+ * If a file already exists at this path, it is reused as a recycled segment:
+ * its blocks are kept and its old records are left to be overwritten. The
+ * header is synced before this function returns.
  *
  * @param path The path of the new WAL file.
- * @return A pointer to a new WAL.
+ * @param seq The sequence number of the segment.
+ * @param segment_size The size to preallocate the segment to or 0 to let the
+ * file grow with the appends.
+ * @return A pointer to a new WAL or NULL if there was an error.
  */
 struct WAL*
-WAL_new(char* path);
+WAL_new(char* path, uint64_t seq, size_t segment_size);
+
+/**
+ * @brief Opens an existing WAL segment to replay it.
+ *
+ * A file with an all-zero header is a segment that was never written to and
+ * opens as an empty WAL with a sequence number of 0.
+ *
+ * @param path The path of the WAL file.
+ * @return A pointer to the WAL or NULL if the file isn't a WAL segment.
+ */
+struct WAL*
+WAL_open(char* path);
 
 /**
  * @brief Replays the WAL from the start and recreates the MemTable.
@@ -60,6 +163,11 @@ WAL_new(char* path);
  * This is the main recovery function for the WAL for when the Database
  * restarts.
  *
+ * The WAL file is mapped with `mmap` and the records are decoded straight from
+ * the mapped bytes until the first record with a bad checksum. They are
+ * applied to the MemTable WAL_REPLAY_BATCH records at a time with
+ * MemTable_set_batch, which keeps the order of the log.
+ *
  * @param wal The WAL to replay the log from.
  * @param memtable A empty MemTable to replay the log into.
  * @return This function returns 0 if the WAL successfully replayed and -1 if
@@ -68,6 +176,48 @@ WAL_new(char* path);
 int
 WAL_load_memtable(struct WAL* wal, struct MemTable* memtable);
 
+/**
+ * @brief Replays the records of the WAL from an offset up to a bound.
+ *
+ * Like WAL_load_memtable, but only maps and replays the records in
+ * `[*offset, end)`. Ranges from WAL_split can be replayed on their own
+ * threads, into MemTables that are kept in the order of the ranges.
+ *
+ * @param wal The WAL to replay the records from.
+ * @param memtable A MemTable to replay the records into.
+ * @param offset The offset of the first record, which is assigned to the
+ * offset after the last record replayed. The replay stopped at the end of the
+ * log if it is short of `end`.
+ * @param end The offset to stop at, or SIZE_MAX for the end of the file.
+ * @return This function returns 0 if the records were replayed and -1 if there
+ * was an error.
+ */
+int
+WAL_load_range(struct WAL* wal,
+               struct MemTable* memtable,
+               size_t* offset,
+               size_t end);
+
+/**
+ * @brief Splits the records of the WAL into ranges of about the same size.
+ *
+ * The ranges start at record boundaries, which are found by walking the lengths
+ * in the record headers without checking the records. A walk past the end of
+ * the log may split the records left over from an earlier use of the segment,
+ * so a range only holds records of the log if the range before it was replayed
+ * up to its end.
+ *
+ * @param wal The WAL to split.
+ * @param parts The largest number of ranges.
+ * @param min_len The smallest number of bytes in a range.
+ * @param bounds An array of `parts + 1` offsets that is assigned to the bounds
+ * of the ranges. Range `i` is `[bounds[i], bounds[i + 1])`, and the last bound
+ * is SIZE_MAX.
+ * @return The number of ranges.
+ */
+size_t
+WAL_split(struct WAL* wal, size_t parts, size_t min_len, size_t* bounds);
+
 /**
  * @brief Appends a new MemTable operation to the WAL.
  *
@@ -75,6 +225,8 @@ WAL_load_memtable(struct WAL* wal, struct MemTable* memtable);
  * value entry was written to. For deletes, `value_loc` should be -1 to indicate
  * a tombstone.
  *
+ * The record is buffered in memory. Call WAL_sync to make it durable.
+ *
  * @param wal The WAL to append a MemTable operation to.
  * @param key The key to apply an operation to.
  * @param key_len The length of the key.
@@ -86,24 +238,97 @@ WAL_load_memtable(struct WAL* wal, struct MemTable* memtable);
 int
 WAL_append(struct WAL* wal, const char* key, size_t key_len, int64_t value_loc);
 
+/**
+ * @brief Appends a set of a key to a ValueLog location along with the length
+ * of its ValueLog entry.
+ *
+ * Same as WAL_append, and the entry size is replayed into the MemTable record's
+ * `value_size`.
+ *
+ * @param wal The WAL to append the set to.
+ * @param key The key to set.
+ * @param key_len The length of the key.
+ * @param value_loc The location in the ValueLog of the value.
+ * @param value_size The length of the ValueLog entry at `value_loc`, or 0 if it
+ * isn't known.
+ * @return This function returns 0 if the set was successfully written to the
+ * WAL and -1 if there was an error.
+ */
+int
+WAL_append_sized(struct WAL* wal,
+                 const char* key,
+                 size_t key_len,
+                 int64_t value_loc,
+                 size_t value_size);
+
+/**
+ * @brief Appends a set of a key to a value held inline to the WAL.
+ *
+ * The value is written in the record itself and is replayed into the MemTable
+ * with MemTable_set_value.
+ *
+ * The record is buffered in memory. Call WAL_sync to make it durable.
+ *
+ * @param wal The WAL to append the set to.
+ * @param key The key to set.
+ * @param key_len The length of the key.
+ * @param value The value.
+ * @param value_len The length of the value.
+ * @return This function returns 0 if the set was successfully written to the
+ * WAL and -1 if there was an error.
+ */
+int
+WAL_append_value(struct WAL* wal,
+                 const char* key,
+                 size_t key_len,
+                 const char* value,
+                 size_t value_len);
+
+/**
+ * @brief Submits the writes and syncs of WAL_sync through io_uring.
+ *
+ * The WAL keeps using `pwrite` and `fdatasync` if io_uring isn't available.
+ *
+ * @param wal The WAL to submit through io_uring.
+ * @return This function returns 0 if io_uring is used and -1 if it isn't
+ * available.
+ */
+int
+WAL_enable_io_uring(struct WAL* wal);
+
+/**
+ * @brief Checks if a WAL has filled its preallocated segment.
+ *
+ * @param wal The WAL to check.
+ * @return This function returns 1 if the WAL should be replaced by a new
+ * segment and 0 if it still has room.
+ */
+int
+WAL_is_full(struct WAL* wal);
+
 /**
  * @brief Syncs the WAl to the disk.
  *
- * This function forcefully flushes the changes to the WAL to disk. Use this
- * function sparingly as is will heavily reduce the write throughput of the WAL.
+ * This function returns once every record appended before the call is on
+ * disk. Concurrent callers are committed as a group with a single `pwrite`
+ * and `fdatasync`, so syncing from many threads at once is much cheaper than
+ * syncing from one thread at a time.
+ *
+ * This function is thread-safe with WAL_append.
  *
  * @param wal The WAL to flush to disk.
  * @return This function returns 0 if the WAL successfully synced to the disk
  * and -1 if there was an error.
  */
 int
-WAL_sync(const struct WAL* wal);
+WAL_sync(struct WAL* wal);
 
 /**
  * @brief Frees the WAL.
  *
  * Note: This function won't delete the file or the underlying data in the WAL.
- * This function only frees the memory allocated to a WAL.
+ * Buffered records are written to the file but not synced. This function only
+ * frees the memory allocated to a WAL.
  *
  * @param wal The WAL to free.
  */
@@ -14,56 +14,2841 @@
  * limitations under the License.
  */
 
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "codec.h"
+#include "common.h"
 #include "include/wisckey.h"
 #include "memtable.h"
+#include "read_pool.h"
+#include "sstable.h"
+#include "value_cache.h"
+#include "value_log.h"
+#include "wal.h"
 
+#define WISCKEY_VALUE_LOG_FILENAME "value.log"
+#define WISCKEY_WAL_RECYCLE_SUFFIX ".recycle"
+#define WISCKEY_CHECKPOINT_FILENAME "value.log.checkpoint"
+#define WISCKEY_GC_CHUNK (1024 * 1024)
+#define WISCKEY_REPLAY_CHUNK (1024 * 1024)
+
+/*
+ * Each shard of the database keeps two MemTables. Writes go to the active
+ * MemTable and its WAL. When the active MemTable fills up, it is frozen into
+ * the immutable slot and a fresh MemTable and WAL take its place. The flush
+ * thread of the shard writes the immutable MemTable to a SSTable in the
+ * background and only retires its WAL once the SSTable is on disk. Writers only
+ * wait if the active MemTable fills up again before the previous flush has
+ * finished.
+ *
+ * Every key belongs to exactly one shard, picked by the split keys or by the
+ * hash of the key. Writers to different shards only meet on the ValueLog, and
+ * the shards flush their MemTables to SSTables in parallel.
+ *
+ * With `sync_writes`, a writer releases the shard lock before it waits for its
+ * WAL record to be synced, so writers of the same shard are group committed.
+ * The writer pins the WAL while it waits, and the flush thread doesn't free a
+ * frozen WAL until its pins are released.
+ *
+ * With `value_log_wal`, the shards have no WALs. The ValueLog entries already
+ * hold the keys, so the MemTables are recovered by replaying the ValueLog from
+ * the oldest entry that isn't in a SSTable yet.
+ */
+struct WiscKeyDBShard
+{
+  struct WiscKeyDB* db; ///< The database that owns the shard.
+
+  struct MemTable* memtable;  ///< The active MemTable.
+  size_t memtable_start;      ///< ValueLog head when `memtable` was created.
+  struct WAL* wal;            ///< The WAL of the active MemTable.
+  struct MemTable* immutable; ///< The frozen MemTable being flushed or NULL.
+  struct WAL* immutable_wal;  ///< The WAL of the frozen MemTable or NULL.
+  size_t wal_pins;            ///< Writers syncing `wal`.
+  size_t immutable_wal_pins;  ///< Writers syncing `immutable_wal`.
+
+  pthread_mutex_t lock;      ///< Guards all of the above.
+  pthread_cond_t flush_cond; ///< Signals a change to `immutable`.
+  pthread_t flush_thread;    ///< Background thread flushing `immutable`.
+  int flush_thread_running;  ///< Set once `flush_thread` is started.
+  int closing;               ///< Set when the database is shutting down.
+  int flush_error;           ///< Set if a background flush failed.
+
+  size_t log_start; ///< ValueLog position of the oldest entry of the shard
+                    ///< that isn't in a SSTable. Guarded by the database lock.
+};
+
+/*
+ * Each WAL covers exactly one MemTable and is named by a sequence number that
+ * is shared by all shards, so a restart replays the WALs in order and flushes
+ * each of them to its own SSTable. The WALs don't record their shard, so the
+ * database can be reopened with a different number of shards.
+ *
+ * Retired WALs are renamed to `<seq>.wal.recycle` and kept in a pool of up to
+ * one file per shard. The next WAL takes a file from the pool instead of
+ * allocating a new one, so the log doesn't pay for block allocation and file
+ * metadata updates on every MemTable.
+ *
+ * With `value_log_wal`, the database persists a checkpoint: the smallest
+ * `log_start` of the shards. Every ValueLog entry before it is in a SSTable,
+ * so recovery replays the ValueLog from the checkpoint. A shard with empty
+ * MemTables counts as starting at the head, and a flush freezes the shards
+ * that lag the head by more than a MemTable, so idle shards don't pin it.
+ *
+ * The garbage collector walks the ValueLog from the tail in chunks. An entry is
+ * live if the lookup of its key still points at it, and it is then written
+ * again through the shard of its key like any other write. Once the ValueLog
+ * and the WALs are synced, the tail is moved past the chunk and its space is
+ * freed. With `value_log_wal`, the collector stops at the checkpoint.
+ *
+ * A segmented ValueLog counts the garbage of each segment instead. A write
+ * reports the value it replaces in the active MemTable, and a flush reports
+ * the values its records replace in the SSTables. The collector walks the
+ * sealed segments with the most garbage first, copies their live entries like
+ * above and deletes the segments.
+ *
+ * Values shorter than `inline_value_size` are kept with their keys in the
+ * MemTables, the WALs and the SSTables, and a read doesn't go to the
+ * ValueLog for them. With `value_log_wal`, they are still appended to the
+ * ValueLog, which is the log. Only a MemTable replayed from the ValueLog
+ * points at those entries, and the collector moves their values back inline.
+ *
+ * Reads take the lock of their shard only to look up the MemTables and to
+ * take a snapshot of the SSTables. The SSTables and the ValueLog are read with
+ * `pread` and no locks. A grown SSTables array is retired instead of freed, so
+ * a snapshot stays valid until the database is closed. The collector bumps
+ * `gc_epoch` before it frees a chunk, and a read that sees the epoch change
+ * looks up its key again, since its value may have moved. A slice is checked
+ * against the epoch after it is pinned, since the ValueLog doesn't punch holes
+ * while slices are pinned.
+ *
+ * Values read into a buffer are kept in the value cache by their ValueLog
+ * location. A location is never reused, so a cached value never goes stale.
+ * The collector and deletes erase the locations they leave behind, so the cache
+ * doesn't hold on to values that can't be read anymore. A reader that raced
+ * the collector may add such a value back, and CLOCK ages it out.
+ *
+ * The locks are always taken in the order GC, shard, database, ValueLog. The
+ * sync lock is taken with no other lock held but the one of GC. Appends to the
+ * ValueLog don't take its lock in the database, since the ValueLog serializes
+ * them itself once their values are compressed.
+ */
 struct WiscKeyDB
 {
-  char* dir;
-  struct MemTable* memtable;
+  char* dir;                       ///< Directory of the database.
+  struct WiscKeyDBOptions options; ///< Options the database was opened with.
+  struct ValueLog* value_log;      ///< The ValueLog that holds the values.
+  size_t value_log_synced;         ///< Bytes of the ValueLog known to be on
+                                   ///< disk.
+  pthread_mutex_t sync_lock;       ///< Serializes the syncs of the ValueLog
+                                   ///< and guards the bytes on disk.
+  pthread_mutex_t value_log_lock;  ///< Guards the tail of the ValueLog.
+  struct ValueCache* value_cache;  ///< Cache of values read or NULL.
+  struct ReadPool* read_pool;      ///< Threads that read ahead for scans or
+                                   ///< NULL.
+
+  struct WiscKeyDBShard* shards; ///< The MemTable shards.
+  size_t shards_len;             ///< The number of shards.
+
+  struct SSTable** sstables; ///< SSTables sorted from oldest to newest.
+  size_t sstables_len;       ///< The number of SSTables.
+  size_t sstables_cap;       ///< The capacity of the SSTables array.
+  struct SSTable*** retired_sstables; ///< Outgrown SSTables arrays.
+  size_t retired_sstables_len;        ///< The number of outgrown arrays.
+
+  uint64_t next_wal_seq;         ///< Sequence number of the next WAL.
+  char** recycled_wals;          ///< Paths of retired WAL files to reuse.
+  size_t recycled_wals_len;      ///< The number of recycled WAL files.
+  unsigned long last_sstable_ts; ///< Timestamp of the newest SSTable.
+  pthread_mutex_t lock;          ///< Guards the SSTables and the counters.
+
+  size_t checkpoint;               ///< The persisted ValueLog checkpoint.
+  pthread_mutex_t checkpoint_lock; ///< Serializes checkpoint writes.
+
+  size_t gc_size;          ///< Size of the ValueLog after the last GC pass.
+  int gc_closing;          ///< Set when the database is shutting down.
+  pthread_mutex_t gc_lock; ///< Serializes GC passes and guards the above.
+  pthread_cond_t gc_cond;  ///< Wakes the GC thread when the database closes.
+  pthread_t gc_thread;     ///< Background thread collecting the ValueLog.
+  int gc_thread_running;   ///< Set once `gc_thread` is started.
+  _Atomic uint64_t gc_epoch; ///< Number of chunks freed by the collector.
+};
+
+static char*
+WiscKeyDB_path(const struct WiscKeyDB* db, const char* filename)
+{
+  size_t len = strlen(db->dir) + 1 + strlen(filename) + 1;
+  char* path = malloc(len);
+  snprintf(path, len, "%s/%s", db->dir, filename);
+
+  return path;
+}
+
+static struct MemTable*
+WiscKeyDB_memtable_new(struct WiscKeyDB* db)
+{
+  struct MemTable* memtable = MemTable_new(db->options.memtable_size);
+  if (db->options.memtable_hash_index) {
+    MemTable_enable_hash_index(memtable);
+  }
+
+  return memtable;
+}
+
+static char*
+WiscKeyDB_wal_path(struct WiscKeyDB* db, uint64_t seq)
+{
+  char filename[32];
+  snprintf(filename, sizeof(filename), "%lu.wal", (unsigned long)seq);
+
+  return WiscKeyDB_path(db, filename);
+}
+
+/*
+ * Creates the WAL for the next MemTable of a shard, reusing a recycled WAL
+ * file if there is one.
+ */
+static struct WAL*
+WiscKeyDB_wal_next(struct WiscKeyDB* db)
+{
+  char* recycled = NULL;
+
+  pthread_mutex_lock(&db->lock);
+  uint64_t seq = db->next_wal_seq++;
+  if (db->recycled_wals_len > 0) {
+    recycled = db->recycled_wals[--db->recycled_wals_len];
+  }
+  pthread_mutex_unlock(&db->lock);
+
+  char* path = WiscKeyDB_wal_path(db, seq);
+  if (recycled != NULL) {
+    // A crash after the rename leaves a WAL with a stale header behind, which
+    // recovery skips.
+    if (rename(recycled, path) == -1) {
+      perror("rename");
+    }
+    free(recycled);
+  }
+
+  size_t segment_size = db->options.wal_segment_size;
+  if (segment_size == 0) {
+    segment_size = db->options.memtable_size;
+  }
+
+  struct WAL* wal = WAL_new(path, seq, segment_size);
+  if (wal == NULL) {
+    free(path);
+  } else if (db->options.wal_io_uring) {
+    WAL_enable_io_uring(wal);
+  }
+
+  return wal;
+}
+
+/*
+ * Retires a WAL whose MemTable is on disk. The file is kept for reuse if the
+ * pool has room and removed otherwise.
+ */
+static void
+WiscKeyDB_wal_retire(struct WiscKeyDB* db, const char* path)
+{
+  size_t len = strlen(path) + strlen(WISCKEY_WAL_RECYCLE_SUFFIX) + 1;
+  char* recycled = malloc(len);
+  snprintf(recycled, len, "%s%s", path, WISCKEY_WAL_RECYCLE_SUFFIX);
+
+  pthread_mutex_lock(&db->lock);
+  int keep = db->recycled_wals_len < db->shards_len;
+  if (keep) {
+    db->recycled_wals[db->recycled_wals_len++] = recycled;
+  }
+  pthread_mutex_unlock(&db->lock);
+
+  if (!keep) {
+    free(recycled);
+    if (remove(path) == -1) {
+      perror("remove");
+    }
+  } else if (rename(path, recycled) == -1) {
+    perror("rename");
+  }
+}
+
+static void
+WiscKeyDB_wal_free(struct WAL* wal)
+{
+  char* path = wal->path;
+  WAL_free(wal);
+  free(path);
+}
+
+static struct WiscKeyDBShard*
+WiscKeyDB_shard(struct WiscKeyDB* db, const char* key, size_t key_len)
+{
+  if (db->shards_len == 1) {
+    return &db->shards[0];
+  }
+
+  if (db->options.split_keys == NULL) {
+    return &db->shards[WiscKey_key_hash(key, key_len) % db->shards_len];
+  }
+
+  // The shard is the number of split keys that are less than or equal to the
+  // key.
+  size_t a = 0;
+  size_t b = db->shards_len - 1;
+  while (a < b) {
+    size_t m = a + (b - a) / 2;
+    if (WiscKey_key_cmp(db->options.split_keys[m],
+                        db->options.split_key_lengths[m],
+                        key,
+                        key_len) < 0) {
+      b = m;
+    } else {
+      a = m + 1;
+    }
+  }
+
+  return &db->shards[a];
+}
+
+static int
+WiscKeyDB_add_sstable(struct WiscKeyDB* db, struct SSTable* table)
+{
+  if (db->sstables_len == db->sstables_cap) {
+    // Readers may still search the old array, so it is kept until close.
+    struct SSTable*** retired =
+      realloc(db->retired_sstables,
+              (db->retired_sstables_len + 1) * sizeof(struct SSTable**));
+    if (retired == NULL) {
+      return -1;
+    }
+    db->retired_sstables = retired;
+
+    size_t cap = db->sstables_cap == 0 ? 16 : db->sstables_cap * 2;
+    struct SSTable** sstables = malloc(cap * sizeof(struct SSTable*));
+    if (sstables == NULL) {
+      return -1;
+    }
+    if (db->sstables_len > 0) {
+      memcpy(
+        sstables, db->sstables, db->sstables_len * sizeof(struct SSTable*));
+    }
+    if (db->sstables != NULL) {
+      db->retired_sstables[db->retired_sstables_len++] = db->sstables;
+    }
+    db->sstables = sstables;
+    db->sstables_cap = cap;
+  }
+
+  db->sstables[db->sstables_len++] = table;
+  return 0;
+}
+
+static char*
+WiscKeyDB_sstable_path(struct WiscKeyDB* db)
+{
+  pthread_mutex_lock(&db->lock);
+
+  // SSTables are ordered by their timestamp, so it must strictly increase even
+  // if two flushes finish within the same microsecond.
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  unsigned long now =
+    (unsigned long)ts.tv_sec * 1000000UL + (unsigned long)ts.tv_nsec / 1000UL;
+  if (now <= db->last_sstable_ts) {
+    now = db->last_sstable_ts + 1;
+  }
+  db->last_sstable_ts = now;
+
+  pthread_mutex_unlock(&db->lock);
+
+  char filename[64];
+  snprintf(filename, sizeof(filename), "%lu-0.sstable", now);
+
+  return WiscKeyDB_path(db, filename);
+}
+
+/*
+ * Looks up a key in a snapshot of the SSTables. Needs no locks. An inline value
+ * is copied to `value` unless it is NULL, and the length of the ValueLog entry
+ * is assigned to `value_size` unless it is NULL.
+ */
+static int64_t
+WiscKeyDB_sstable_lookup(struct SSTable** sstables,
+                         size_t sstables_len,
+                         char* key,
+                         size_t key_length,
+                         char** value,
+                         size_t* value_len,
+                         size_t* value_size)
+{
+  // Newer SSTables shadow older ones.
+  for (size_t i = sstables_len; i > 0; i--) {
+    struct SSTable* table = sstables[i - 1];
+    if (!SSTable_in_key_range(table, key, key_length)) {
+      continue;
+    }
+
+    int64_t loc =
+      SSTable_get(table, key, key_length, value, value_len, value_size);
+    if (loc != SSTABLE_KEY_NOT_FOUND) {
+      return loc;
+    }
+  }
+
+  return -1;
+}
+
+/*
+ * Counts the values that the records of a MemTable replace in the SSTables as
+ * garbage in their ValueLog segments. The values replaced in the MemTable
+ * itself were counted by the writes. A replayed record can already be in a
+ * SSTable, or be older than the value there, and then replaces nothing, since
+ * a value is only replaced by the writes after it in the ValueLog.
+ */
+static void
+WiscKeyDB_discard_flushed_values(struct WiscKeyDB* db,
+                                 struct MemTable* memtable)
+{
+  pthread_mutex_lock(&db->lock);
+  struct SSTable** sstables = db->sstables;
+  size_t sstables_len = db->sstables_len;
+  pthread_mutex_unlock(&db->lock);
+
+  struct MemTableIterator iter;
+  MemTableIterator_init(&iter, memtable);
+  struct MemTableRecord* record;
+  while ((record = MemTableIterator_next(&iter)) != NULL) {
+    size_t value_size = 0;
+    int64_t value_loc = WiscKeyDB_sstable_lookup(sstables,
+                                                 sstables_len,
+                                                 record->key,
+                                                 record->key_len,
+                                                 NULL,
+                                                 NULL,
+                                                 &value_size);
+    if (value_loc >= 0 &&
+        (record->value_loc < 0 || value_loc < record->value_loc)) {
+      ValueLog_discard(db->value_log, (size_t)value_loc, value_size);
+    }
+  }
+}
+
+static int
+WiscKeyDB_flush_memtable(struct WiscKeyDB* db,
+                         struct MemTable* memtable,
+                         char* path)
+{
+  struct SSTable* table = SSTable_new_from_memtable(path, memtable);
+  if (table == NULL) {
+    fprintf(stderr, "Error flushing MemTable to %s\n", path);
+    free(path);
+    return -1;
+  }
+
+  // The entry of the SSTable in the directory must be durable before the log
+  // that could replay the MemTable is retired.
+  if (WiscKey_sync_dir(db->dir) == -1) {
+    SSTable_free(table);
+    free(path);
+    return -1;
+  }
+  if (db->value_log->segment_size > 0) {
+    WiscKeyDB_discard_flushed_values(db, memtable);
+  }
+
+  pthread_mutex_lock(&db->lock);
+  int res = WiscKeyDB_add_sstable(db, table);
+  pthread_mutex_unlock(&db->lock);
+  if (res == -1) {
+    SSTable_free(table);
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Syncs the ValueLog unless the bytes up to `end` are already on disk. Writers
+ * that queue on the sync lock behind a sync return without syncing again, and
+ * appends go on while the ValueLog syncs.
+ */
+static int
+WiscKeyDB_sync_value_log(struct WiscKeyDB* db, size_t end)
+{
+  int res = 0;
+
+  pthread_mutex_lock(&db->sync_lock);
+  if (db->value_log_synced < end) {
+    // The sync writes out every entry up to the head read before it.
+    size_t head = ValueLog_head(db->value_log);
+    res = ValueLog_sync(db->value_log);
+    if (res == 0) {
+      db->value_log_synced = head;
+    }
+  }
+  pthread_mutex_unlock(&db->sync_lock);
+
+  return res;
+}
+
+/*
+ * Reads the ValueLog checkpoint. Returns 1 if there is one, 0 if there isn't,
+ * and -1 if there was an error.
+ */
+static int
+WiscKeyDB_read_checkpoint(struct WiscKeyDB* db, size_t* checkpoint)
+{
+  char* path = WiscKeyDB_path(db, WISCKEY_CHECKPOINT_FILENAME);
+  FILE* file = fopen(path, "r");
+  free(path);
+  if (file == NULL) {
+    if (errno == ENOENT) {
+      return 0;
+    }
+    perror("fopen");
+    return -1;
+  }
+
+  uint64_t checkpoint_64;
+  size_t b_read = fread(&checkpoint_64, sizeof(uint64_t), 1, file);
+  fclose(file);
+  if (b_read != 1) {
+    fprintf(stderr, "Corrupt ValueLog checkpoint\n");
+    return -1;
+  }
+
+  *checkpoint = checkpoint_64;
+  return 1;
+}
+
+/*
+ * Persists a ValueLog checkpoint. The checkpoint is written to a temporary
+ * file that replaces the old one, so a crash leaves one of them intact, and
+ * the rename is synced before the checkpoint is used. Must be called with the
+ * checkpoint lock held.
+ */
+static int
+WiscKeyDB_write_checkpoint(struct WiscKeyDB* db, size_t checkpoint)
+{
+  char* path = WiscKeyDB_path(db, WISCKEY_CHECKPOINT_FILENAME);
+  char* tmp_path = WiscKeyDB_path(db, WISCKEY_CHECKPOINT_FILENAME ".tmp");
+  uint64_t checkpoint_64 = checkpoint;
+
+  int res = -1;
+  FILE* file = fopen(tmp_path, "w");
+  if (file == NULL) {
+    perror("fopen");
+  } else {
+    if (fwrite(&checkpoint_64, sizeof(uint64_t), 1, file) != 1) {
+      perror("fwrite");
+    } else if (fflush(file) == EOF || fsync(fileno(file)) == -1) {
+      perror("fsync");
+    } else {
+      res = 0;
+    }
+    fclose(file);
+  }
+
+  if (res == 0 && rename(tmp_path, path) == -1) {
+    perror("rename");
+    res = -1;
+  }
+  if (res == 0 && WiscKey_sync_dir(db->dir) == -1) {
+    res = -1;
+  }
+  if (res == 0) {
+    db->checkpoint = checkpoint;
+  }
+
+  free(tmp_path);
+  free(path);
+
+  return res;
+}
+
+/*
+ * Hands the active MemTable of a shard to its flush thread. Must be called
+ * with the lock of the shard held and the immutable slot empty.
+ */
+static int
+WiscKeyDB_freeze(struct WiscKeyDBShard* shard)
+{
+  struct WAL* wal = NULL;
+  if (!shard->db->options.value_log_wal) {
+    wal = WiscKeyDB_wal_next(shard->db);
+    if (wal == NULL) {
+      return -1;
+    }
+  }
+
+  shard->immutable = shard->memtable;
+  shard->immutable_wal = shard->wal;
+  shard->immutable_wal_pins = shard->wal_pins;
+  shard->memtable = WiscKeyDB_memtable_new(shard->db);
+  shard->memtable_start = ValueLog_head(shard->db->value_log);
+  shard->wal = wal;
+  shard->wal_pins = 0;
+
+  pthread_cond_broadcast(&shard->flush_cond);
+
+  return 0;
+}
+
+/*
+ * Moves the checkpoint up to the oldest ValueLog entry that isn't in a
+ * SSTable. A shard with nothing in its MemTables starts at the head, and a
+ * shard that lags the head by more than a MemTable is frozen, so a shard with
+ * few writes doesn't hold the checkpoint back. Must be called without the
+ * lock of a shard or the database.
+ */
+static int
+WiscKeyDB_advance_checkpoint(struct WiscKeyDB* db)
+{
+  size_t checkpoint = SIZE_MAX;
+  for (size_t i = 0; i < db->shards_len; i++) {
+    struct WiscKeyDBShard* shard = &db->shards[i];
+
+    // Writes append to the ValueLog with the lock of their shard held.
+    pthread_mutex_lock(&shard->lock);
+    size_t head = ValueLog_head(db->value_log);
+    pthread_mutex_lock(&db->lock);
+    size_t start = shard->log_start;
+    pthread_mutex_unlock(&db->lock);
+    if (shard->immutable == NULL && shard->memtable->size == 0) {
+      start = head;
+    } else if (shard->immutable == NULL && !shard->closing &&
+               !shard->flush_error &&
+               head - start > db->options.memtable_size) {
+      WiscKeyDB_freeze(shard);
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    if (start < checkpoint) {
+      checkpoint = start;
+    }
+  }
+
+  int res = 0;
+  pthread_mutex_lock(&db->checkpoint_lock);
+  if (checkpoint > db->checkpoint) {
+    res = WiscKeyDB_write_checkpoint(db, checkpoint);
+  }
+  pthread_mutex_unlock(&db->checkpoint_lock);
+
+  return res;
+}
+
+/*
+ * Releases a writer's pin on a WAL. Must be called with the lock of the shard
+ * held.
+ */
+static void
+WiscKeyDB_unpin_wal(struct WiscKeyDBShard* shard, const struct WAL* wal)
+{
+  if (wal == shard->wal) {
+    shard->wal_pins--;
+    return;
+  }
+
+  shard->immutable_wal_pins--;
+  if (shard->immutable_wal_pins == 0) {
+    pthread_cond_broadcast(&shard->flush_cond);
+  }
+}
+
+static void*
+WiscKeyDB_flush_thread(void* arg)
+{
+  struct WiscKeyDBShard* shard = arg;
+  struct WiscKeyDB* db = shard->db;
+
+  pthread_mutex_lock(&shard->lock);
+  while (1) {
+    while (shard->immutable == NULL && !shard->closing) {
+      pthread_cond_wait(&shard->flush_cond, &shard->lock);
+    }
+    if (shard->immutable == NULL) {
+      break;
+    }
+
+    struct MemTable* memtable = shard->immutable;
+    struct WAL* wal = shard->immutable_wal;
+    char* path = WiscKeyDB_sstable_path(db);
+
+    pthread_mutex_unlock(&shard->lock);
+
+    // The SSTable points into the ValueLog, so the values must be on disk
+    // before the WAL that could replay them is removed. The sync runs without
+    // the lock of the shard, so writers aren't held up by it.
+    int res = WiscKeyDB_sync_value_log(db, SIZE_MAX);
+
+    if (res == 0) {
+      res = WiscKeyDB_flush_memtable(db, memtable, path);
+    } else {
+      free(path);
+    }
+
+    pthread_mutex_lock(&shard->lock);
+    if (res == -1) {
+      // Leave the WAL in place so the MemTable is recovered on restart.
+      shard->flush_error = 1;
+      pthread_cond_broadcast(&shard->flush_cond);
+      break;
+    }
+
+    // Writers may still be waiting on a sync of the frozen WAL.
+    while (shard->immutable_wal_pins > 0) {
+      pthread_cond_wait(&shard->flush_cond, &shard->lock);
+    }
+
+    shard->immutable = NULL;
+    shard->immutable_wal = NULL;
+    pthread_cond_broadcast(&shard->flush_cond);
+
+    pthread_mutex_lock(&db->lock);
+    shard->log_start = shard->memtable_start;
+    pthread_mutex_unlock(&db->lock);
+    pthread_mutex_unlock(&shard->lock);
+
+    // The SSTable is durable, the log of the frozen MemTable can be retired.
+    if (wal != NULL) {
+      WiscKeyDB_wal_retire(db, wal->path);
+      WiscKeyDB_wal_free(wal);
+    } else if (WiscKeyDB_advance_checkpoint(db) == -1) {
+      // An older checkpoint only means more of the ValueLog to replay.
+      fprintf(stderr, "Failed to advance the ValueLog checkpoint\n");
+    }
+    MemTable_free(memtable);
+
+    pthread_mutex_lock(&shard->lock);
+  }
+  pthread_mutex_unlock(&shard->lock);
+
+  return NULL;
+}
+
+/*
+ * Freezes the active MemTable of a shard once it or its WAL segment is full.
+ * Must be called with
+ * the lock of the shard held. Waits for the previous flush if the immutable
+ * slot is still taken.
+ */
+static int
+WiscKeyDB_make_room(struct WiscKeyDBShard* shard)
+{
+  while (MemTable_should_flush(shard->memtable) ||
+         (shard->wal != NULL && WAL_is_full(shard->wal))) {
+    if (shard->flush_error) {
+      return -1;
+    }
+
+    if (shard->immutable != NULL) {
+      pthread_cond_wait(&shard->flush_cond, &shard->lock);
+      continue;
+    }
+
+    if (WiscKeyDB_freeze(shard) == -1) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Looks up a key in the MemTables of its shard. Returns 1 and assigns
+ * `value_loc` and `value_size` if the key is found, and copies an inline value
+ * to `value` unless it is NULL. Otherwise returns 0 and assigns `sstables` and
+ * `sstables_len` to a snapshot of the SSTables to search next. Must be called
+ * with the lock of the key's shard held.
+ */
+static int
+WiscKeyDB_memtable_lookup(struct WiscKeyDB* db,
+                          struct WiscKeyDBShard* shard,
+                          char* key,
+                          size_t key_length,
+                          int64_t* value_loc,
+                          size_t* value_size,
+                          char** value,
+                          size_t* value_len,
+                          struct SSTable*** sstables,
+                          size_t* sstables_len)
+{
+  struct MemTableRecord* record =
+    MemTable_get(shard->memtable, key, key_length);
+  if (record == NULL && shard->immutable != NULL) {
+    record = MemTable_get(shard->immutable, key, key_length);
+  }
+  if (record != NULL) {
+    *value_loc = record->value_loc;
+    if (value_size != NULL) {
+      *value_size = record->value_size;
+    }
+    if (record->value_loc == MEMTABLE_VALUE_INLINE && value != NULL) {
+      size_t len = record->value->len;
+      *value = malloc(len > 0 ? len : 1);
+      memcpy(*value, record->value->data, len);
+      *value_len = len;
+    }
+    return 1;
+  }
+
+  // A flushed MemTable is added to the SSTables before it leaves the shard.
+  pthread_mutex_lock(&db->lock);
+  *sstables = db->sstables;
+  *sstables_len = db->sstables_len;
+  pthread_mutex_unlock(&db->lock);
+
+  return 0;
+}
+
+/*
+ * Looks up the value location of a key. Must be called with the lock of the
+ * key's shard held.
+ */
+static int64_t
+WiscKeyDB_get_value_loc(struct WiscKeyDB* db,
+                        struct WiscKeyDBShard* shard,
+                        char* key,
+                        size_t key_length)
+{
+  int64_t value_loc;
+  struct SSTable** sstables;
+  size_t sstables_len;
+  if (WiscKeyDB_memtable_lookup(db,
+                                shard,
+                                key,
+                                key_length,
+                                &value_loc,
+                                NULL,
+                                NULL,
+                                NULL,
+                                &sstables,
+                                &sstables_len)) {
+    return value_loc;
+  }
+
+  return WiscKeyDB_sstable_lookup(
+    sstables, sstables_len, key, key_length, NULL, NULL, NULL);
+}
+
+/*
+ * Counts the value that a write replaces in the active MemTable as garbage in
+ * its ValueLog segment. Must be called with the lock of the shard held.
+ */
+static void
+WiscKeyDB_discard_memtable_value(struct WiscKeyDB* db,
+                                 struct WiscKeyDBShard* shard,
+                                 const char* key,
+                                 size_t key_length)
+{
+  if (db->value_log->segment_size == 0) {
+    return;
+  }
+
+  struct MemTableRecord* record =
+    MemTable_get(shard->memtable, key, key_length);
+  if (record != NULL && record->value_loc >= 0) {
+    ValueLog_discard(
+      db->value_log, (size_t)record->value_loc, record->value_size);
+  }
+}
+
+/*
+ * Writes a value to the ValueLog, the WAL and the MemTable of a shard. A value
+ * shorter than `inline_value_size` is written to the WAL and the MemTable
+ * instead of the ValueLog. Must be called with the lock of the shard held,
+ * after making room. `value_log_end` is assigned to the end of the ValueLog
+ * entry or 0 if there is none.
+ */
+static int
+WiscKeyDB_set_locked(struct WiscKeyDB* db,
+                     struct WiscKeyDBShard* shard,
+                     const char* key,
+                     size_t key_length,
+                     const char* value,
+                     size_t value_length,
+                     size_t* value_log_end)
+{
+  int inline_value = value_length < db->options.inline_value_size;
+  size_t pos = 0;
+  size_t value_size = 0;
+  int res = 0;
+  *value_log_end = 0;
+
+  // Without a WAL, the ValueLog is the log of the inline values too.
+  if (!inline_value || shard->wal == NULL) {
+    res = ValueLog_append_sized(
+      db->value_log, &pos, &value_size, key, key_length, value, value_length);
+    *value_log_end = pos + value_size;
+  }
+  if (res == 0 && shard->wal != NULL) {
+    if (inline_value) {
+      res = WAL_append_value(shard->wal, key, key_length, value, value_length);
+    } else {
+      res = WAL_append_sized(
+        shard->wal, key, key_length, (int64_t)pos, value_size);
+    }
+  }
+  if (res == 0) {
+    WiscKeyDB_discard_memtable_value(db, shard, key, key_length);
+    if (!inline_value) {
+      MemTable_set_sized(
+        shard->memtable, key, key_length, (int64_t)pos, value_size);
+    } else {
+      // Nothing points at the entry of an inline value, which is only
+      // replayed, so it is garbage in its segment right away.
+      if (shard->wal == NULL) {
+        ValueLog_discard(db->value_log, pos, value_size);
+      }
+      MemTable_set_value(
+        shard->memtable, key, key_length, value, value_length);
+    }
+  }
+
+  return res;
+}
+
+/*
+ * Copies a ValueLog entry to the head if it still holds the value of its key.
+ */
+static int
+WiscKeyDB_gc_relocate(struct WiscKeyDB* db,
+                      const struct ValueLogEntry* entry,
+                      size_t pos)
+{
+  struct WiscKeyDBShard* shard =
+    WiscKeyDB_shard(db, entry->key, entry->key_len);
+
+  pthread_mutex_lock(&shard->lock);
+  if (WiscKeyDB_make_room(shard) == -1) {
+    pthread_mutex_unlock(&shard->lock);
+    return -1;
+  }
+
+  int res = 0;
+  int64_t value_loc =
+    WiscKeyDB_get_value_loc(db, shard, entry->key, entry->key_len);
+  if (value_loc == (int64_t)pos) {
+    size_t value_log_end;
+    res = WiscKeyDB_set_locked(db,
+                               shard,
+                               entry->key,
+                               entry->key_len,
+                               entry->value,
+                               entry->value_len,
+                               &value_log_end);
+  }
+  pthread_mutex_unlock(&shard->lock);
+
+  return res;
+}
+
+/*
+ * Syncs the ValueLog and the WALs of every shard, so the relocated values are
+ * found after a crash.
+ */
+static int
+WiscKeyDB_gc_sync(struct WiscKeyDB* db)
+{
+  int res = WiscKeyDB_sync_value_log(db, SIZE_MAX);
+
+  for (size_t i = 0; i < db->shards_len && res == 0; i++) {
+    struct WiscKeyDBShard* shard = &db->shards[i];
+
+    // The relocations of a MemTable whose WAL is already retired are in a
+    // SSTable.
+    pthread_mutex_lock(&shard->lock);
+    struct WAL* wal = shard->wal;
+    struct WAL* immutable_wal = shard->immutable_wal;
+    if (wal != NULL) {
+      shard->wal_pins++;
+    }
+    if (immutable_wal != NULL) {
+      shard->immutable_wal_pins++;
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    if (immutable_wal != NULL) {
+      res = WAL_sync(immutable_wal);
+    }
+    if (wal != NULL && res == 0) {
+      res = WAL_sync(wal);
+    }
+
+    pthread_mutex_lock(&shard->lock);
+    if (immutable_wal != NULL) {
+      WiscKeyDB_unpin_wal(shard, immutable_wal);
+    }
+    if (wal != NULL) {
+      WiscKeyDB_unpin_wal(shard, wal);
+    }
+    pthread_mutex_unlock(&shard->lock);
+  }
+
+  return res;
+}
+
+/*
+ * Copies the live entries from `pos` to `end` to the head. `pos` is assigned
+ * to the position after the last entry.
+ */
+static int
+WiscKeyDB_gc_entries(struct WiscKeyDB* db, size_t* pos, size_t end)
+{
+  while (*pos < end) {
+    struct ValueLogEntry entry;
+    int res = ValueLog_read_entry(db->value_log, *pos, &entry);
+    if (res == -1) {
+      return -1;
+    }
+
+    // Tombstones are only needed to replay the MemTables, which never reach
+    // back past the limit.
+    if (!entry.tombstone) {
+      res = WiscKeyDB_gc_relocate(db, &entry, *pos);
+    }
+    if (db->value_cache != NULL) {
+      ValueCache_erase(db->value_cache, *pos);
+    }
+    free(entry.key);
+    if (res == -1) {
+      return -1;
+    }
+
+    *pos += entry.len;
+  }
+
+  return 0;
+}
+
+/*
+ * Collects up to WISCKEY_GC_CHUNK bytes at the tail of the ValueLog, stopping
+ * at `limit`. The live entries are copied to the head, and the tail is moved
+ * past the chunk once the copies are on disk. Returns the number of bytes
+ * collected or -1 if there was an error.
+ */
+static ssize_t
+WiscKeyDB_gc_chunk(struct WiscKeyDB* db, size_t limit)
+{
+  pthread_mutex_lock(&db->value_log_lock);
+  size_t tail = db->value_log->tail;
+  pthread_mutex_unlock(&db->value_log_lock);
+  if (tail >= limit) {
+    return 0;
+  }
+
+  size_t end = tail + WISCKEY_GC_CHUNK;
+  if (end > limit) {
+    end = limit;
+  }
+  size_t pos = tail;
+  if (WiscKeyDB_gc_entries(db, &pos, end) == -1 ||
+      WiscKeyDB_gc_sync(db) == -1) {
+    return -1;
+  }
+
+  // Readers that looked up a value in the chunk before it moved try again.
+  atomic_fetch_add(&db->gc_epoch, 1);
+
+  pthread_mutex_lock(&db->value_log_lock);
+  int res = ValueLog_set_tail(db->value_log, pos);
+  pthread_mutex_unlock(&db->value_log_lock);
+  if (res == -1) {
+    return -1;
+  }
+
+  return (ssize_t)(pos - tail);
+}
+
+/*
+ * Collects a sealed segment of the ValueLog. The live entries are copied to
+ * the head, and the segment is deleted once the copies are on disk. Returns
+ * the size of the segment or -1 if there was an error.
+ */
+static ssize_t
+WiscKeyDB_gc_segment(struct WiscKeyDB* db,
+                     const struct ValueLogSegmentStats* segment)
+{
+  size_t pos = segment->start;
+  if (WiscKeyDB_gc_entries(db, &pos, segment->end) == -1 ||
+      WiscKeyDB_gc_sync(db) == -1) {
+    return -1;
+  }
+
+  // Readers that looked up a value in the segment before it moved try again.
+  atomic_fetch_add(&db->gc_epoch, 1);
+
+  if (ValueLog_remove_segment(db->value_log, segment->id) == -1) {
+    return -1;
+  }
+
+  return (ssize_t)(segment->end - segment->start + VALUE_LOG_HEADER_SIZE);
+}
+
+static struct timespec
+WiscKeyDB_deadline(struct timespec start, double seconds)
+{
+  struct timespec deadline = start;
+  deadline.tv_sec += (time_t)seconds;
+  deadline.tv_nsec += (long)((seconds - (double)(time_t)seconds) * 1e9);
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+
+  return deadline;
+}
+
+/*
+ * Runs a garbage collection pass up to the head of the ValueLog at its start.
+ * A segmented ValueLog is collected a segment at a time, from the one with the
+ * most garbage to the least, and the others a chunk at a time from the tail.
+ * With a `rate`, the pass sleeps between chunks or segments to collect at most
+ * `rate` bytes per second and ends early when the database closes. With a
+ * `budget`, the pass ends once it collected that many bytes, and the size the
+ * next pass waits on is left as it was. Must be called with the GC lock held.
+ */
+static int
+WiscKeyDB_gc_pass(struct WiscKeyDB* db, size_t rate, size_t budget)
+{
+  if (db->value_log->version == VALUE_LOG_VERSION_FIXED) {
+    fprintf(stderr, "ValueLog in the fixed-size format can't be collected\n");
+    return -1;
+  }
+
+  size_t limit = ValueLog_head(db->value_log);
+  if (db->options.value_log_wal) {
+    // The entries after the checkpoint are replayed on restart.
+    pthread_mutex_lock(&db->checkpoint_lock);
+    if (db->checkpoint < limit) {
+      limit = db->checkpoint;
+    }
+    pthread_mutex_unlock(&db->checkpoint_lock);
+  }
+
+  struct ValueLogSegmentStats* segments;
+  size_t segments_len = ValueLog_garbage_segments(
+    db->value_log, limit, db->options.value_log_gc_ratio, &segments);
+  size_t next_segment = 0;
+
+  struct timespec start;
+  clock_gettime(CLOCK_REALTIME, &start);
+  size_t collected = 0;
+
+  int res = 0;
+  while (!db->gc_closing) {
+    ssize_t len;
+    if (db->value_log->segment_size == 0) {
+      len = WiscKeyDB_gc_chunk(db, limit);
+    } else if (next_segment < segments_len) {
+      len = WiscKeyDB_gc_segment(db, &segments[next_segment++]);
+    } else {
+      len = 0;
+    }
+    if (len <= 0) {
+      res = (int)len;
+      break;
+    }
+    collected += (size_t)len;
+    if (budget > 0 && collected >= budget) {
+      break;
+    }
+
+    if (rate > 0) {
+      struct timespec deadline =
+        WiscKeyDB_deadline(start, (double)collected / (double)rate);
+      int wait = 0;
+      while (!db->gc_closing && wait != ETIMEDOUT) {
+        wait = pthread_cond_timedwait(&db->gc_cond, &db->gc_lock, &deadline);
+      }
+    }
+  }
+
+  free(segments);
+
+  if (budget == 0 || collected < budget) {
+    pthread_mutex_lock(&db->value_log_lock);
+    db->gc_size = ValueLog_size(db->value_log);
+    pthread_mutex_unlock(&db->value_log_lock);
+  }
+
+  return res;
+}
+
+/*
+ * Starts a rate-limited pass whenever the ValueLog has doubled in size since
+ * the last one. Copying the live entries then costs at most one extra write
+ * per byte written to the database. A pass that used up its budget is
+ * followed by the next one right away.
+ */
+static void*
+WiscKeyDB_gc_thread(void* arg)
+{
+  struct WiscKeyDB* db = arg;
+
+  pthread_mutex_lock(&db->gc_lock);
+  while (!db->gc_closing) {
+    pthread_mutex_lock(&db->value_log_lock);
+    size_t size = ValueLog_size(db->value_log);
+    pthread_mutex_unlock(&db->value_log_lock);
+
+    if (size >= WISCKEY_GC_CHUNK && size >= 2 * db->gc_size) {
+      if (WiscKeyDB_gc_pass(db,
+                            db->options.value_log_gc_rate,
+                            db->options.value_log_gc_limit) == -1) {
+        fprintf(stderr, "ValueLog garbage collection failed\n");
+      }
+      continue;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    struct timespec deadline = WiscKeyDB_deadline(now, 1.0);
+    pthread_cond_timedwait(&db->gc_cond, &db->gc_lock, &deadline);
+  }
+  pthread_mutex_unlock(&db->gc_lock);
+
+  return NULL;
+}
+
+static int
+uint64_cmp(const void* a, const void* b)
+{
+  uint64_t lhs = *(const uint64_t*)a;
+  uint64_t rhs = *(const uint64_t*)b;
+  return lhs < rhs ? -1 : lhs > rhs;
+}
+
+static int
+sstable_cmp(const void* a, const void* b)
+{
+  const struct SSTable* lhs = *(struct SSTable* const*)a;
+  const struct SSTable* rhs = *(struct SSTable* const*)b;
+  return lhs->timestamp < rhs->timestamp ? -1 : lhs->timestamp > rhs->timestamp;
+}
+
+/*
+ * Replays the ValueLog from a checkpoint into SSTables of up to one MemTable
+ * each.
+ */
+static int
+WiscKeyDB_replay_value_log(struct WiscKeyDB* db, size_t pos)
+{
+  while (pos < db->value_log->head) {
+    struct MemTable* memtable = MemTable_new(db->options.memtable_size);
+    MemTable_enable_hash_index(memtable);
+    int res = ValueLog_load_memtable(db->value_log, &pos, memtable);
+    if (res == 0 && memtable->size > 0) {
+      res = WiscKeyDB_flush_memtable(db, memtable, WiscKeyDB_sstable_path(db));
+    }
+    size_t size = memtable->size;
+    MemTable_free(memtable);
+
+    if (res == -1) {
+      return -1;
+    }
+    if (size == 0) {
+      break;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * A range of the records of a WAL that is replayed into its own MemTable and
+ * SSTable. A WAL is split into ranges when there are fewer WALs than threads.
+ */
+struct WiscKeyDBReplayRange
+{
+  uint64_t seq;       ///< Sequence number of the WAL.
+  size_t start;       ///< Offset of the first record of the range.
+  size_t end;         ///< Offset after the range or SIZE_MAX.
+  char* sstable_path; ///< SSTable path of the range.
+  int decoded;        ///< Set once the range is in its MemTable.
+  int live;           ///< Set if the range holds records of the log.
+  int complete;       ///< Set if the replay reached the end of the range.
+};
+
+/*
+ * WALs that are replayed on open by a pool of threads. Every range gets its
+ * own MemTable and a SSTable path that is taken in the order of the ranges up
+ * front, so the SSTables keep the order of the records no matter which replay
+ * finishes first.
+ */
+struct WiscKeyDBReplay
+{
+  struct WiscKeyDB* db;                ///< The database being recovered.
+  struct WiscKeyDBReplayRange* ranges; ///< Ranges of the WALs in order.
+  size_t len;                          ///< The number of ranges.
+  size_t next;                         ///< Index of the next range to replay.
+  int error;                           ///< Set once a replay has failed.
+  pthread_mutex_t lock; ///< Guards the ranges, `next` and `error`.
+  pthread_cond_t cond;  ///< Signals a decoded range.
+};
+
+/*
+ * Replays one range of a WAL into a SSTable. A WAL whose header doesn't carry
+ * the sequence number of its name is skipped. The log may end in any range,
+ * so a range is only flushed once the one before it in its WAL is known to
+ * have reached its end.
+ */
+static int
+WiscKeyDB_replay_range(struct WiscKeyDBReplay* replay, size_t i)
+{
+  struct WiscKeyDB* db = replay->db;
+  struct WiscKeyDBReplayRange* range = &replay->ranges[i];
+  char* path = WiscKeyDB_wal_path(db, range->seq);
+  struct WAL* wal = WAL_open(path);
+  if (wal == NULL) {
+    free(path);
+  }
+
+  // Replay overwrites the same keys over and over, so the hash index pays
+  // for itself even on a MemTable that is only used to build a SSTable.
+  struct MemTable* memtable = MemTable_new(db->options.memtable_size);
+  MemTable_enable_hash_index(memtable);
+  int res = wal != NULL ? 0 : -1;
+  int live = 0;
+  size_t offset = range->start;
+  if (wal != NULL && wal->seq == range->seq) {
+    res = WAL_load_range(wal, memtable, &offset, range->end);
+    live = 1;
+  }
+  if (wal != NULL) {
+    WiscKeyDB_wal_free(wal);
+  }
+
+  pthread_mutex_lock(&replay->lock);
+  if (i > 0 && replay->ranges[i - 1].seq == range->seq) {
+    // The range before was taken first, so its replay is already running.
+    struct WiscKeyDBReplayRange* prev = &replay->ranges[i - 1];
+    while (!prev->decoded && !replay->error) {
+      pthread_cond_wait(&replay->cond, &replay->lock);
+    }
+    live = live && prev->live && prev->complete;
+  }
+  range->live = live;
+  range->complete = offset == range->end;
+  range->decoded = 1;
+  if (res == -1) {
+    replay->error = 1;
+  }
+  pthread_cond_broadcast(&replay->cond);
+  pthread_mutex_unlock(&replay->lock);
+
+  char* sstable_path = range->sstable_path;
+  range->sstable_path = NULL;
+  if (res == 0 && live && memtable->size > 0) {
+    res = WiscKeyDB_flush_memtable(db, memtable, sstable_path);
+  } else {
+    free(sstable_path);
+  }
+  MemTable_free(memtable);
+
+  return res;
+}
+
+static void*
+WiscKeyDB_replay_thread(void* arg)
+{
+  struct WiscKeyDBReplay* replay = arg;
+
+  pthread_mutex_lock(&replay->lock);
+  while (replay->next < replay->len && !replay->error) {
+    size_t i = replay->next++;
+    pthread_mutex_unlock(&replay->lock);
+
+    int res = WiscKeyDB_replay_range(replay, i);
+
+    pthread_mutex_lock(&replay->lock);
+    if (res == -1) {
+      replay->error = 1;
+      pthread_cond_broadcast(&replay->cond);
+    }
+  }
+  pthread_mutex_unlock(&replay->lock);
+
+  return NULL;
+}
+
+/*
+ * Splits the WALs into ranges, so every thread has a range to replay even
+ * when there are fewer WALs than threads. Returns the number of ranges or -1
+ * if there was an error.
+ */
+static ssize_t
+WiscKeyDB_replay_ranges(struct WiscKeyDB* db,
+                        const uint64_t* seqs,
+                        size_t len,
+                        size_t threads,
+                        struct WiscKeyDBReplayRange* ranges)
+{
+  size_t parts = (threads + len - 1) / len;
+  size_t* bounds = malloc((parts + 1) * sizeof(size_t));
+  size_t n = 0;
+  for (size_t i = 0; i < len; i++) {
+    size_t count = 1;
+    bounds[0] = WAL_HEADER_SIZE;
+    bounds[1] = SIZE_MAX;
+    if (parts > 1) {
+      char* path = WiscKeyDB_wal_path(db, seqs[i]);
+      struct WAL* wal = WAL_open(path);
+      if (wal == NULL) {
+        free(path);
+        free(bounds);
+        return -1;
+      }
+      if (wal->seq == seqs[i]) {
+        count = WAL_split(wal, parts, WISCKEY_REPLAY_CHUNK, bounds);
+      }
+      WiscKeyDB_wal_free(wal);
+    }
+
+    for (size_t j = 0; j < count; j++) {
+      ranges[n].seq = seqs[i];
+      ranges[n].start = bounds[j];
+      ranges[n].end = bounds[j + 1];
+      ranges[n].sstable_path = WiscKeyDB_sstable_path(db);
+      ranges[n].decoded = 0;
+      ranges[n].live = 0;
+      ranges[n].complete = 0;
+      n++;
+    }
+  }
+  free(bounds);
+
+  return (ssize_t)n;
+}
+
+/*
+ * Replays the WALs in parallel, each range into its own SSTable. The WALs are
+ * only retired once all of them are in SSTables. Otherwise a WAL that failed
+ * would be replayed on the next open into a SSTable newer than those of the
+ * WALs after it.
+ */
+static int
+WiscKeyDB_replay_wals(struct WiscKeyDB* db, const uint64_t* seqs, size_t len)
+{
+  if (len == 0) {
+    return 0;
+  }
+
+  size_t threads = db->options.recovery_threads;
+  if (threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? (size_t)cpus : 1;
+  }
+
+  struct WiscKeyDBReplay replay;
+  replay.db = db;
+  replay.ranges = malloc(len * ((threads + len - 1) / len) *
+                         sizeof(struct WiscKeyDBReplayRange));
+  ssize_t ranges_len =
+    WiscKeyDB_replay_ranges(db, seqs, len, threads, replay.ranges);
+  if (ranges_len == -1) {
+    free(replay.ranges);
+    return -1;
+  }
+  replay.len = (size_t)ranges_len;
+  replay.next = 0;
+  replay.error = 0;
+  pthread_mutex_init(&replay.lock, NULL);
+  pthread_cond_init(&replay.cond, NULL);
+  if (threads > replay.len) {
+    threads = replay.len;
+  }
+
+  // The calling thread replays too.
+  pthread_t* tids = calloc(threads, sizeof(pthread_t));
+  size_t started = 0;
+  for (size_t i = 1; i < threads; i++) {
+    if (pthread_create(&tids[i], NULL, WiscKeyDB_replay_thread, &replay) != 0) {
+      break;
+    }
+    started++;
+  }
+  WiscKeyDB_replay_thread(&replay);
+  for (size_t i = 1; i <= started; i++) {
+    pthread_join(tids[i], NULL);
+  }
+  free(tids);
+
+  for (size_t i = 0; i < replay.len; i++) {
+    free(replay.ranges[i].sstable_path);
+  }
+  free(replay.ranges);
+  pthread_cond_destroy(&replay.cond);
+  pthread_mutex_destroy(&replay.lock);
+  if (replay.error) {
+    return -1;
+  }
+
+  // The replays added their SSTables in the order they finished.
+  qsort(db->sstables, db->sstables_len, sizeof(struct SSTable*), sstable_cmp);
+
+  for (size_t i = 0; i < len; i++) {
+    char* path = WiscKeyDB_wal_path(db, seqs[i]);
+    WiscKeyDB_wal_retire(db, path);
+    free(path);
+  }
+
+  return 0;
+}
+
+/*
+ * Loads the SSTables and replays the WALs left in the directory. Each WAL is
+ * flushed to its own SSTable and retired. A WAL whose header doesn't carry
+ * the sequence number of its name was recycled but never written to and is
+ * retired without a replay. The WALs are replayed by `recovery_threads`
+ * threads.
+ *
+ * If there is a ValueLog checkpoint, the ValueLog is replayed from it after
+ * the WALs.
+ */
+static int
+WiscKeyDB_recover(struct WiscKeyDB* db)
+{
+  DIR* dir = opendir(db->dir);
+  if (dir == NULL) {
+    perror("opendir");
+    return -1;
+  }
+
+  uint64_t* wal_seqs = NULL;
+  size_t wal_seqs_len = 0;
+  size_t wal_seqs_cap = 0;
+
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    size_t len = strlen(entry->d_name);
+
+    if (len > 8 && strcmp(entry->d_name + len - 8, ".sstable") == 0) {
+      struct SSTable* table = SSTable_new(WiscKeyDB_path(db, entry->d_name));
+      if (table == NULL || WiscKeyDB_add_sstable(db, table) == -1) {
+        closedir(dir);
+        free(wal_seqs);
+        return -1;
+      }
+      if (table->timestamp > db->last_sstable_ts) {
+        db->last_sstable_ts = table->timestamp;
+      }
+    } else if (len > 4 && strcmp(entry->d_name + len - 4, ".wal") == 0) {
+      if (wal_seqs_len == wal_seqs_cap) {
+        wal_seqs_cap = wal_seqs_cap == 0 ? 4 : wal_seqs_cap * 2;
+        wal_seqs = realloc(wal_seqs, wal_seqs_cap * sizeof(uint64_t));
+      }
+      wal_seqs[wal_seqs_len++] = strtoull(entry->d_name, NULL, 10);
+    } else if (strstr(entry->d_name, ".wal" WISCKEY_WAL_RECYCLE_SUFFIX)) {
+      char* path = WiscKeyDB_path(db, entry->d_name);
+      if (db->recycled_wals_len < db->shards_len) {
+        db->recycled_wals[db->recycled_wals_len++] = path;
+      } else {
+        if (remove(path) == -1) {
+          perror("remove");
+        }
+        free(path);
+      }
+    }
+  }
+  closedir(dir);
+
+  if (db->sstables_len > 0) {
+    qsort(
+      db->sstables, db->sstables_len, sizeof(struct SSTable*), sstable_cmp);
+  }
+  if (wal_seqs_len > 0) {
+    qsort(wal_seqs, wal_seqs_len, sizeof(uint64_t), uint64_cmp);
+    db->next_wal_seq = wal_seqs[wal_seqs_len - 1] + 1;
+  }
+
+  int res = WiscKeyDB_replay_wals(db, wal_seqs, wal_seqs_len);
+  free(wal_seqs);
+  if (res == -1) {
+    return -1;
+  }
+
+  size_t checkpoint;
+  res = WiscKeyDB_read_checkpoint(db, &checkpoint);
+  if (res == 1) {
+    res = WiscKeyDB_replay_value_log(db, checkpoint);
+  }
+
+  return res == -1 ? -1 : 0;
+}
+
+void
+WiscKeyDBOptions_init(struct WiscKeyDBOptions* options)
+{
+  options->memtable_size = MEMTABLE_DEFAULT_BUDGET;
+  options->memtable_hash_index = 0;
+  options->memtable_shards = 1;
+  options->split_keys = NULL;
+  options->split_key_lengths = NULL;
+  options->sync_writes = 0;
+  options->wal_segment_size = 0;
+  options->wal_io_uring = 0;
+  options->value_log_wal = 0;
+  options->recovery_threads = 0;
+  options->value_log_gc_rate = 0;
+  options->value_log_gc_limit = 256 * 1024 * 1024;
+  options->value_log_gc_ratio = 0.5;
+  options->value_log_segment = 0;
+  options->value_cache_size = 0;
+  options->scan_threads = 8;
+  options->scan_prefetch = 64;
+  options->inline_value_size = 0;
+  options->compression = WISCKEY_COMPRESSION_NONE;
+  options->compress_min_size = 64;
+  options->compress_min_ratio = 1.1;
+}
+
+struct WiscKeyDB*
+WiscKeyDB_new(char* dir)
+{
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+
+  return WiscKeyDB_open(dir, &options);
+}
+
+/*
+ * Copies the split keys into the database so the caller can free them.
+ */
+static int
+WiscKeyDB_copy_split_keys(struct WiscKeyDB* db,
+                          const struct WiscKeyDBOptions* options)
+{
+  db->options.split_keys = NULL;
+  db->options.split_key_lengths = NULL;
+  if (options->split_keys == NULL) {
+    return 0;
+  }
+
+  size_t n = db->shards_len - 1;
+  for (size_t i = 1; i < n; i++) {
+    if (WiscKey_key_cmp(options->split_keys[i - 1],
+                        options->split_key_lengths[i - 1],
+                        options->split_keys[i],
+                        options->split_key_lengths[i]) <= 0) {
+      fprintf(stderr, "Shard split keys must be sorted and unique\n");
+      return -1;
+    }
+  }
+
+  db->options.split_keys = calloc(n, sizeof(char*));
+  db->options.split_key_lengths = calloc(n, sizeof(size_t));
+  for (size_t i = 0; i < n; i++) {
+    size_t len = options->split_key_lengths[i];
+    db->options.split_keys[i] = malloc(len > 0 ? len : 1);
+    memcpy(db->options.split_keys[i], options->split_keys[i], len);
+    db->options.split_key_lengths[i] = len;
+  }
+
+  return 0;
+}
+
+static int
+WiscKeyDB_shard_init(struct WiscKeyDB* db, struct WiscKeyDBShard* shard)
+{
+  shard->db = db;
+  pthread_mutex_init(&shard->lock, NULL);
+  pthread_cond_init(&shard->flush_cond, NULL);
+
+  shard->memtable = WiscKeyDB_memtable_new(db);
+  shard->memtable_start = db->value_log->head;
+  shard->log_start = db->value_log->head;
+  if (!db->options.value_log_wal) {
+    shard->wal = WiscKeyDB_wal_next(db);
+    if (shard->wal == NULL) {
+      return -1;
+    }
+  }
+
+  if (pthread_create(
+        &shard->flush_thread, NULL, WiscKeyDB_flush_thread, shard) != 0) {
+    return -1;
+  }
+  shard->flush_thread_running = 1;
+
+  return 0;
+}
+
+struct WiscKeyDB*
+WiscKeyDB_open(char* dir, const struct WiscKeyDBOptions* options)
+{
+  if (mkdir(dir, 0755) == -1 && errno != EEXIST) {
+    perror("mkdir");
+    return NULL;
+  }
+
+  struct WiscKeyDB* db = calloc(1, sizeof(struct WiscKeyDB));
+  db->dir = strdup(dir);
+  db->options = *options;
+  pthread_mutex_init(&db->lock, NULL);
+  pthread_mutex_init(&db->sync_lock, NULL);
+  pthread_mutex_init(&db->value_log_lock, NULL);
+  pthread_mutex_init(&db->checkpoint_lock, NULL);
+  pthread_mutex_init(&db->gc_lock, NULL);
+  pthread_cond_init(&db->gc_cond, NULL);
+
+  db->shards_len = options->memtable_shards > 0 ? options->memtable_shards : 1;
+  db->shards = calloc(db->shards_len, sizeof(struct WiscKeyDBShard));
+  db->recycled_wals = calloc(db->shards_len, sizeof(char*));
+
+  // Sequence number 0 is left for segments whose header was never written.
+  db->next_wal_seq = 1;
+  if (WiscKeyDB_copy_split_keys(db, options) == -1) {
+    WiscKeyDB_free(db);
+    return NULL;
+  }
+
+  // New values are appended at the end of the ValueLog.
+  char* value_log_path = WiscKeyDB_path(db, WISCKEY_VALUE_LOG_FILENAME);
+  struct stat st;
+  int exists = stat(value_log_path, &st) == 0;
+  if (options->value_log_segment == 0) {
+    db->value_log =
+      ValueLog_new(value_log_path, exists ? (size_t)st.st_size : 0, 0);
+  } else if (exists) {
+    fprintf(stderr, "%s isn't a segmented ValueLog\n", value_log_path);
+  } else {
+    db->value_log = ValueLog_new_segmented(db->dir, options->value_log_segment);
+  }
+  free(value_log_path);
+
+  if (db->value_log != NULL && options->compression != CODEC_NONE) {
+    int codec = options->compression;
+    if (!Codec_supported(codec)) {
+      codec = CODEC_LZ;
+    }
+    ValueLog_set_compression(db->value_log,
+                             codec,
+                             options->compress_min_size,
+                             options->compress_min_ratio);
+  }
+  if (db->value_log != NULL && options->wal_io_uring) {
+    ValueLog_enable_io_uring(db->value_log);
+  }
+
+  if (db->value_log == NULL || WiscKeyDB_recover(db) == -1) {
+    WiscKeyDB_free(db);
+    return NULL;
+  }
+
+  // Everything up to the head is in a SSTable now. Without `value_log_wal`,
+  // the WALs cover the new writes and the ValueLog must not be replayed, since
+  // it doesn't hold their deletes.
+  int res = 0;
+  if (options->value_log_wal) {
+    res = WiscKeyDB_write_checkpoint(db, db->value_log->head);
+  } else {
+    char* path = WiscKeyDB_path(db, WISCKEY_CHECKPOINT_FILENAME);
+    if (remove(path) == -1 && errno != ENOENT) {
+      perror("remove");
+      res = -1;
+    }
+    free(path);
+  }
+  if (res == -1) {
+    WiscKeyDB_free(db);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < db->shards_len; i++) {
+    if (WiscKeyDB_shard_init(db, &db->shards[i]) == -1) {
+      WiscKeyDB_free(db);
+      return NULL;
+    }
+  }
+
+  if (options->value_cache_size > 0) {
+    db->value_cache = ValueCache_new(options->value_cache_size);
+  }
+  if (options->scan_threads > 0) {
+    db->read_pool = ReadPool_new(db->value_log, options->scan_threads);
+    if (db->read_pool == NULL) {
+      WiscKeyDB_free(db);
+      return NULL;
+    }
+  }
+
+  // The ValueLog as it was left has been collected as much as it is going to
+  // be, so a restart doesn't copy all of it again.
+  db->gc_size = ValueLog_size(db->value_log);
+  if (options->value_log_gc_rate > 0 &&
+      db->value_log->version != VALUE_LOG_VERSION_FIXED) {
+    if (pthread_create(&db->gc_thread, NULL, WiscKeyDB_gc_thread, db) != 0) {
+      WiscKeyDB_free(db);
+      return NULL;
+    }
+    db->gc_thread_running = 1;
+  }
+
+  return db;
+}
+
+/*
+ * Looks up the value location of a key without holding the lock of its shard
+ * past the MemTables. Returns -1 if the key doesn't exist. If it returns
+ * MEMTABLE_VALUE_INLINE, `value` is assigned to a copy of the value that the
+ * caller frees. Otherwise `value_size` is assigned to the length of the
+ * ValueLog entry or 0 if it isn't known.
+ */
+static int64_t
+WiscKeyDB_find(struct WiscKeyDB* db,
+               char* key,
+               size_t key_length,
+               size_t* value_size,
+               char** value,
+               size_t* value_len)
+{
+  struct WiscKeyDBShard* shard = WiscKeyDB_shard(db, key, key_length);
+
+  int64_t value_loc;
+  struct SSTable** sstables;
+  size_t sstables_len;
+  pthread_mutex_lock(&shard->lock);
+  int found = WiscKeyDB_memtable_lookup(db,
+                                        shard,
+                                        key,
+                                        key_length,
+                                        &value_loc,
+                                        value_size,
+                                        value,
+                                        value_len,
+                                        &sstables,
+                                        &sstables_len);
+  pthread_mutex_unlock(&shard->lock);
+  if (found) {
+    return value_loc;
+  }
+
+  return WiscKeyDB_sstable_lookup(
+    sstables, sstables_len, key, key_length, value, value_len, value_size);
+}
+
+size_t
+WiscKeyDB_get(struct WiscKeyDB* db, char* ptr, char* key, size_t key_length)
+{
+  size_t buf_len = ptr != NULL ? SIZE_MAX : 0;
+  return WiscKeyDB_get_into(db, ptr, buf_len, key, key_length);
+}
+
+size_t
+WiscKeyDB_get_into(struct WiscKeyDB* db,
+                   char* buf,
+                   size_t buf_len,
+                   char* key,
+                   size_t key_length)
+{
+  while (1) {
+    uint64_t epoch = atomic_load(&db->gc_epoch);
+
+    char* value;
+    size_t value_len;
+    size_t value_size = 0;
+    int64_t value_loc =
+      WiscKeyDB_find(db, key, key_length, &value_size, &value, &value_len);
+    if (value_loc == MEMTABLE_VALUE_INLINE) {
+      if (buf != NULL && buf_len >= value_len) {
+        memcpy(buf, value, value_len);
+      }
+      free(value);
+      return value_len;
+    }
+    if (value_loc < 0) {
+      return 0;
+    }
+
+    if (db->value_cache != NULL &&
+        ValueCache_get(
+          db->value_cache, value_loc, buf, buf_len, &value_len)) {
+      return value_len;
+    }
+
+    int res = ValueLog_read_sized(db->value_log,
+                                  buf,
+                                  buf_len,
+                                  &value_len,
+                                  value_loc,
+                                  value_size,
+                                  key,
+                                  key_length);
+
+    // The collector may have freed the value after the lookup.
+    if (atomic_load(&db->gc_epoch) != epoch) {
+      continue;
+    }
+    if (res == -1) {
+      return 0;
+    }
+
+    if (db->value_cache != NULL && buf != NULL && buf_len >= value_len) {
+      ValueCache_put(db->value_cache, value_loc, buf, value_len);
+    }
+    return value_len;
+  }
+}
+
+int
+WiscKeyDB_get_slice(struct WiscKeyDB* db,
+                    struct WiscKeyDBSlice* slice,
+                    char* key,
+                    size_t key_length)
+{
+  while (1) {
+    uint64_t epoch = atomic_load(&db->gc_epoch);
+
+    char* copy;
+    size_t copy_len;
+    int64_t value_loc =
+      WiscKeyDB_find(db, key, key_length, NULL, &copy, &copy_len);
+    if (value_loc == MEMTABLE_VALUE_INLINE) {
+      slice->data = copy;
+      slice->len = copy_len;
+      slice->pin = NULL;
+      return 0;
+    }
+    if (value_loc < 0) {
+      return -1;
+    }
+
+    struct ValueLogSlice value;
+    if (ValueLog_get_slice(db->value_log, &value, value_loc) == -1) {
+      if (atomic_load(&db->gc_epoch) != epoch) {
+        continue;
+      }
+      return -1;
+    }
+
+    // Once the slice is pinned, the collector can't punch a hole under it, but
+    // it may have done so after the lookup.
+    if (atomic_load(&db->gc_epoch) != epoch) {
+      ValueLog_release_slice(db->value_log, &value);
+      continue;
+    }
+
+    slice->data = value.data;
+    slice->len = value.len;
+    slice->pin = value.map;
+    return 0;
+  }
+}
+
+void
+WiscKeyDB_release_slice(struct WiscKeyDB* db, struct WiscKeyDBSlice* slice)
+{
+  // An inline value is a copy that nothing else pins.
+  if (slice->pin == NULL) {
+    free((char*)slice->data);
+  } else {
+    struct ValueLogSlice value = { slice->data, slice->len, slice->pin };
+    ValueLog_release_slice(db->value_log, &value);
+  }
+
+  slice->data = NULL;
+  slice->pin = NULL;
+}
+
+/*
+ * A source of the keys merged by a scan. The first source holds the records
+ * copied from the MemTables and the others are the SSTables from newest to
+ * oldest, so a source shadows the keys of the sources after it.
+ */
+struct WiscKeyDBScanSource
+{
+  struct SSTableRecord record;   ///< The current record of the source.
+  struct SSTableRecord* records; ///< Records copied from the MemTables or
+                                 ///< NULL for a SSTable.
+  size_t records_len;            ///< The number of copied records.
+  size_t records_pos;            ///< Index of the next copied record.
+  struct SSTableIterator iter;   ///< Iterator of a SSTable.
 };
 
-struct WiscKeyDB*
-WiscKeyDB_new(char* dir)
+/*
+ * A key of a scan whose value is read ahead.
+ */
+struct WiscKeyDBScanSlot
 {
-  struct WiscKeyDB* db = malloc(sizeof(struct WiscKeyDB));
-  db->dir = dir;
-  db->memtable = MemTable_new();
+  struct SSTableRecord record; ///< The key and the location of its value.
+  struct ReadPoolRead read;    ///< The read of the value.
+};
 
-  return db;
+/*
+ * The scan merges its sources with a binary heap ordered by key and source.
+ * The next `slots_len` live keys wait in a ring of slots with their values
+ * being read by the read pool, and are handed out in order.
+ */
+struct WiscKeyDBScan
+{
+  struct WiscKeyDB* db; ///< The database being scanned.
+  char* end;            ///< The key after the range or NULL.
+  size_t end_len;       ///< The length of `end`.
+  uint64_t epoch;       ///< GC epoch when the scan started.
+
+  struct WiscKeyDBScanSource* sources; ///< The sources of keys.
+  size_t sources_len;                  ///< The number of sources.
+  size_t* heap;                        ///< Sources that have a record.
+  size_t heap_len;                     ///< The number of sources in `heap`.
+
+  struct WiscKeyDBScanSlot* slots; ///< Ring of keys read ahead.
+  size_t slots_len;                ///< The capacity of the ring.
+  size_t slots_start;              ///< Index of the oldest slot.
+  size_t slots_count;              ///< The number of filled slots.
+
+  char* key;   ///< Key returned by the last WiscKeyDBScan_next.
+  char* value; ///< Value returned by the last WiscKeyDBScan_next.
+};
+
+/*
+ * Compares two keys with the sign of `lhs - rhs`.
+ */
+static int
+WiscKeyDB_scan_key_cmp(const char* lhs,
+                       size_t lhs_len,
+                       const char* rhs,
+                       size_t rhs_len)
+{
+  return WiscKey_key_cmp(rhs, rhs_len, lhs, lhs_len);
 }
 
-size_t
-WiscKeyDB_get(struct WiscKeyDB* db,
-              __attribute__((unused)) char* ptr,
-              char* key,
-              size_t key_length)
+static int
+WiscKeyDB_scan_past_end(const struct WiscKeyDBScan* scan,
+                        const char* key,
+                        size_t key_len)
+{
+  return scan->end != NULL &&
+         WiscKeyDB_scan_key_cmp(key, key_len, scan->end, scan->end_len) >= 0;
+}
+
+/*
+ * Orders the heap by key, and sources with the same key from newest to oldest.
+ */
+static int
+WiscKeyDB_scan_less(const struct WiscKeyDBScan* scan, size_t a, size_t b)
+{
+  const struct SSTableRecord* lhs = &scan->sources[a].record;
+  const struct SSTableRecord* rhs = &scan->sources[b].record;
+  int cmp =
+    WiscKeyDB_scan_key_cmp(lhs->key, lhs->key_len, rhs->key, rhs->key_len);
+  return cmp < 0 || (cmp == 0 && a < b);
+}
+
+static void
+WiscKeyDB_scan_push(struct WiscKeyDBScan* scan, size_t source)
+{
+  size_t i = scan->heap_len++;
+  while (i > 0) {
+    size_t parent = (i - 1) / 2;
+    if (!WiscKeyDB_scan_less(scan, source, scan->heap[parent])) {
+      break;
+    }
+    scan->heap[i] = scan->heap[parent];
+    i = parent;
+  }
+  scan->heap[i] = source;
+}
+
+static size_t
+WiscKeyDB_scan_pop(struct WiscKeyDBScan* scan)
+{
+  size_t top = scan->heap[0];
+  size_t last = scan->heap[--scan->heap_len];
+
+  size_t i = 0;
+  while (1) {
+    size_t child = 2 * i + 1;
+    if (child >= scan->heap_len) {
+      break;
+    }
+    if (child + 1 < scan->heap_len &&
+        WiscKeyDB_scan_less(scan, scan->heap[child + 1], scan->heap[child])) {
+      child++;
+    }
+    if (!WiscKeyDB_scan_less(scan, scan->heap[child], last)) {
+      break;
+    }
+    scan->heap[i] = scan->heap[child];
+    i = child;
+  }
+  if (scan->heap_len > 0) {
+    scan->heap[i] = last;
+  }
+
+  return top;
+}
+
+/*
+ * Moves a source to its next record and pushes it on the heap unless it is
+ * exhausted or past the end of the range.
+ */
+static int
+WiscKeyDB_scan_advance(struct WiscKeyDBScan* scan, size_t i)
 {
-  struct MemTableRecord* m_record = MemTable_get(db->memtable, key, key_length);
-  if (m_record != NULL) {
-    ptr = m_record->key;
-    return m_record->key_len;
+  struct WiscKeyDBScanSource* source = &scan->sources[i];
+  if (source->records != NULL) {
+    if (source->records_pos >= source->records_len) {
+      return 0;
+    }
+    source->record = source->records[source->records_pos++];
+  } else {
+    free(source->record.key);
+    free(source->record.value);
+    source->record.key = NULL;
+    source->record.value = NULL;
+
+    int res = SSTableIterator_next(&source->iter, &source->record);
+    if (res <= 0) {
+      source->record.key = NULL;
+      source->record.value = NULL;
+      return res;
+    }
+  }
+
+  if (WiscKeyDB_scan_past_end(
+        scan, source->record.key, source->record.key_len)) {
+    return 0;
   }
 
+  WiscKeyDB_scan_push(scan, i);
   return 0;
 }
 
-int
-WiscKeyDB_set(__attribute__((unused)) struct WiscKeyDB* db,
-              __attribute__((unused)) char* key,
-              __attribute__((unused)) char* value,
-              __attribute__((unused)) size_t key_length,
-              __attribute__((unused)) size_t value_length)
+/*
+ * Copies a record of a scan with its key and inline value.
+ */
+static void
+WiscKeyDB_scan_copy_record(struct SSTableRecord* copy,
+                           const struct SSTableRecord* record)
+{
+  copy->key = malloc(record->key_len > 0 ? record->key_len : 1);
+  memcpy(copy->key, record->key, record->key_len);
+  copy->key_len = record->key_len;
+  copy->value_loc = record->value_loc;
+  copy->value_size = record->value_size;
+  copy->value = NULL;
+  copy->value_len = record->value_len;
+  if (record->value != NULL) {
+    copy->value = malloc(record->value_len > 0 ? record->value_len : 1);
+    memcpy(copy->value, record->value, record->value_len);
+  }
+}
+
+/*
+ * Takes the next live key of the merged sources. Returns 1 if there was one, 0
+ * if the sources are exhausted and -1 if there was an error.
+ */
+static int
+WiscKeyDB_scan_next_record(struct WiscKeyDBScan* scan,
+                           struct SSTableRecord* record)
+{
+  while (scan->heap_len > 0) {
+    size_t top = WiscKeyDB_scan_pop(scan);
+    struct SSTableRecord* newest = &scan->sources[top].record;
+
+    // Older sources with the same key are shadowed.
+    while (scan->heap_len > 0) {
+      struct SSTableRecord* next = &scan->sources[scan->heap[0]].record;
+      if (WiscKeyDB_scan_key_cmp(
+            next->key, next->key_len, newest->key, newest->key_len) != 0) {
+        break;
+      }
+      if (WiscKeyDB_scan_advance(scan, WiscKeyDB_scan_pop(scan)) == -1) {
+        return -1;
+      }
+    }
+
+    int live =
+      newest->value_loc >= 0 || newest->value_loc == MEMTABLE_VALUE_INLINE;
+    if (live) {
+      WiscKeyDB_scan_copy_record(record, newest);
+    }
+    if (WiscKeyDB_scan_advance(scan, top) == -1) {
+      if (live) {
+        free(record->key);
+        free(record->value);
+      }
+      return -1;
+    }
+    if (live) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static int
+WiscKeyDB_scan_record_cmp(const void* a, const void* b)
+{
+  const struct SSTableRecord* lhs = a;
+  const struct SSTableRecord* rhs = b;
+  return WiscKeyDB_scan_key_cmp(lhs->key, lhs->key_len, rhs->key, rhs->key_len);
+}
+
+/*
+ * Copies the records of a MemTable in the range of a scan.
+ */
+static void
+WiscKeyDB_scan_copy_memtable(struct WiscKeyDBScan* scan,
+                             struct MemTable* memtable,
+                             const char* start,
+                             size_t start_len,
+                             struct SSTableRecord** records,
+                             size_t* records_len,
+                             size_t* records_cap)
+{
+  struct MemTableIterator iter;
+  if (start != NULL) {
+    MemTableIterator_seek(&iter, memtable, start, start_len);
+  } else {
+    MemTableIterator_init(&iter, memtable);
+  }
+
+  struct MemTableRecord* record;
+  while ((record = MemTableIterator_next(&iter)) != NULL &&
+         !WiscKeyDB_scan_past_end(scan, record->key, record->key_len)) {
+    if (*records_len == *records_cap) {
+      *records_cap = *records_cap == 0 ? 64 : *records_cap * 2;
+      *records = realloc(*records, *records_cap * sizeof(struct SSTableRecord));
+    }
+
+    struct SSTableRecord* copy = &(*records)[(*records_len)++];
+    copy->key = malloc(record->key_len > 0 ? record->key_len : 1);
+    memcpy(copy->key, record->key, record->key_len);
+    copy->key_len = record->key_len;
+    copy->value_loc = record->value_loc;
+    copy->value_size = record->value_size;
+    copy->value = NULL;
+    copy->value_len = 0;
+    if (record->value_loc == MEMTABLE_VALUE_INLINE) {
+      copy->value_len = record->value->len;
+      copy->value = malloc(copy->value_len > 0 ? copy->value_len : 1);
+      memcpy(copy->value, record->value->data, copy->value_len);
+    }
+  }
+}
+
+/*
+ * Sets up the first source with the records of every MemTable in the range,
+ * and returns a snapshot of the SSTables to merge with them.
+ */
+static void
+WiscKeyDB_scan_memtables(struct WiscKeyDBScan* scan,
+                         const char* start,
+                         size_t start_len,
+                         struct SSTable*** sstables,
+                         size_t* sstables_len)
+{
+  struct WiscKeyDB* db = scan->db;
+  struct SSTableRecord* records = NULL;
+  size_t records_len = 0;
+  size_t records_cap = 0;
+
+  for (size_t i = 0; i < db->shards_len; i++) {
+    struct WiscKeyDBShard* shard = &db->shards[i];
+    pthread_mutex_lock(&shard->lock);
+    size_t active_len = records_len;
+    WiscKeyDB_scan_copy_memtable(scan,
+                                 shard->memtable,
+                                 start,
+                                 start_len,
+                                 &records,
+                                 &records_len,
+                                 &records_cap);
+    active_len = records_len - active_len;
+    if (shard->immutable != NULL) {
+      size_t immutable_start = records_len;
+      WiscKeyDB_scan_copy_memtable(scan,
+                                   shard->immutable,
+                                   start,
+                                   start_len,
+                                   &records,
+                                   &records_len,
+                                   &records_cap);
+
+      // Drop the frozen records that the active MemTable shadows.
+      size_t kept = immutable_start;
+      size_t a = immutable_start - active_len;
+      for (size_t j = immutable_start; j < records_len; j++) {
+        struct SSTableRecord* r = &records[j];
+        while (a < immutable_start &&
+               WiscKeyDB_scan_key_cmp(records[a].key,
+                                      records[a].key_len,
+                                      r->key,
+                                      r->key_len) < 0) {
+          a++;
+        }
+        if (a < immutable_start &&
+            WiscKeyDB_scan_key_cmp(
+              records[a].key, records[a].key_len, r->key, r->key_len) == 0) {
+          free(r->key);
+          free(r->value);
+          continue;
+        }
+        records[kept++] = *r;
+      }
+      records_len = kept;
+    }
+    pthread_mutex_unlock(&shard->lock);
+  }
+
+  // A flushed MemTable is added to the SSTables before it leaves its shard, so
+  // the SSTables are taken after the MemTables.
+  pthread_mutex_lock(&db->lock);
+  *sstables = db->sstables;
+  *sstables_len = db->sstables_len;
+  pthread_mutex_unlock(&db->lock);
+
+  // A key belongs to a single shard, so the keys are unique.
+  if (records_len > 0) {
+    qsort(records,
+          records_len,
+          sizeof(struct SSTableRecord),
+          WiscKeyDB_scan_record_cmp);
+  }
+
+  struct WiscKeyDBScanSource* source = &scan->sources[0];
+  source->records = records != NULL ? records : malloc(1);
+  source->records_len = records_len;
+  source->records_pos = 0;
+}
+
+/*
+ * Reads ahead the values of the next keys until the ring of slots is full.
+ */
+static int
+WiscKeyDB_scan_fill(struct WiscKeyDBScan* scan)
 {
+  while (scan->slots_count < scan->slots_len) {
+    size_t i = (scan->slots_start + scan->slots_count) % scan->slots_len;
+    struct WiscKeyDBScanSlot* slot = &scan->slots[i];
+
+    int res = WiscKeyDB_scan_next_record(scan, &slot->record);
+    if (res <= 0) {
+      return res;
+    }
+
+    // An inline value came with its key and is handed out as it is.
+    if (slot->record.value_loc == MEMTABLE_VALUE_INLINE) {
+      slot->read.value = slot->record.value;
+      slot->read.value_len = slot->record.value_len;
+      slot->read.res = 0;
+      slot->record.value = NULL;
+    } else {
+      slot->read.loc = (size_t)slot->record.value_loc;
+      slot->read.size = slot->record.value_size;
+      slot->read.key = slot->record.key;
+      slot->read.key_len = slot->record.key_len;
+      if (scan->db->read_pool != NULL) {
+        ReadPool_submit(scan->db->read_pool, &slot->read);
+      }
+    }
+    scan->slots_count++;
+  }
+
   return 0;
 }
 
+/*
+ * Reads the value of a key like WiscKeyDB_get, into a new allocation. Returns
+ * 1 if the key was found, 0 if it doesn't exist and -1 if there was an error.
+ */
+static int
+WiscKeyDB_get_alloc(struct WiscKeyDB* db,
+                    char* key,
+                    size_t key_length,
+                    char** value,
+                    size_t* value_len)
+{
+  while (1) {
+    uint64_t epoch = atomic_load(&db->gc_epoch);
+
+    size_t value_size = 0;
+    int64_t value_loc =
+      WiscKeyDB_find(db, key, key_length, &value_size, value, value_len);
+    if (value_loc == MEMTABLE_VALUE_INLINE) {
+      return 1;
+    }
+    if (value_loc < 0) {
+      return 0;
+    }
+
+    int res = ValueLog_get_sized(db->value_log,
+                                 value,
+                                 value_len,
+                                 value_loc,
+                                 value_size,
+                                 key,
+                                 key_length);
+    if (atomic_load(&db->gc_epoch) != epoch) {
+      if (res == 0) {
+        free(*value);
+      }
+      continue;
+    }
+
+    return res == -1 ? -1 : 1;
+  }
+}
+
+/*
+ * Waits for the value of a slot. Returns 1 if the value was read, 0 if the key
+ * was deleted since the scan started and -1 if there was an error.
+ */
+static int
+WiscKeyDB_scan_value(struct WiscKeyDBScan* scan,
+                     struct WiscKeyDBScanSlot* slot)
+{
+  struct WiscKeyDB* db = scan->db;
+  struct ReadPoolRead* read = &slot->read;
+  if (slot->record.value_loc == MEMTABLE_VALUE_INLINE) {
+    return 1;
+  }
+  if (db->read_pool != NULL) {
+    ReadPool_wait(db->read_pool, read);
+  } else {
+    read->res = ValueLog_get_sized(db->value_log,
+                                   &read->value,
+                                   &read->value_len,
+                                   read->loc,
+                                   read->size,
+                                   read->key,
+                                   read->key_len);
+  }
+
+  if (atomic_load(&db->gc_epoch) == scan->epoch) {
+    return read->res == -1 ? -1 : 1;
+  }
+
+  // Once the collector runs, the locations taken when the scan started may
+  // point at freed space, so the values are looked up again.
+  if (read->res == 0) {
+    free(read->value);
+  }
+  return WiscKeyDB_get_alloc(db,
+                             slot->record.key,
+                             slot->record.key_len,
+                             &read->value,
+                             &read->value_len);
+}
+
+struct WiscKeyDBScan*
+WiscKeyDB_scan(struct WiscKeyDB* db,
+               char* start,
+               size_t start_length,
+               char* end,
+               size_t end_length)
+{
+  struct WiscKeyDBScan* scan = calloc(1, sizeof(struct WiscKeyDBScan));
+  scan->db = db;
+  if (end != NULL) {
+    scan->end = malloc(end_length > 0 ? end_length : 1);
+    memcpy(scan->end, end, end_length);
+    scan->end_len = end_length;
+  }
+  scan->epoch = atomic_load(&db->gc_epoch);
+
+  scan->sources = calloc(1, sizeof(struct WiscKeyDBScanSource));
+  scan->sources_len = 1;
+  struct SSTable** sstables;
+  size_t sstables_len;
+  WiscKeyDB_scan_memtables(scan, start, start_length, &sstables, &sstables_len);
+
+  scan->sources = realloc(
+    scan->sources, (sstables_len + 1) * sizeof(struct WiscKeyDBScanSource));
+  scan->heap = malloc((sstables_len + 1) * sizeof(size_t));
+  for (size_t i = sstables_len; i > 0; i--) {
+    struct SSTable* table = sstables[i - 1];
+    if (table->size == 0 ||
+        (start != NULL &&
+         WiscKeyDB_scan_key_cmp(
+           table->high_key, table->high_key_len, start, start_length) < 0) ||
+        WiscKeyDB_scan_past_end(scan, table->low_key, table->low_key_len)) {
+      continue;
+    }
+
+    struct WiscKeyDBScanSource* source = &scan->sources[scan->sources_len++];
+    memset(source, 0, sizeof(struct WiscKeyDBScanSource));
+    if (SSTableIterator_seek(&source->iter, table, start, start_length) ==
+        -1) {
+      WiscKeyDBScan_free(scan);
+      return NULL;
+    }
+  }
+
+  for (size_t i = 0; i < scan->sources_len; i++) {
+    if (WiscKeyDB_scan_advance(scan, i) == -1) {
+      WiscKeyDBScan_free(scan);
+      return NULL;
+    }
+  }
+
+  scan->slots_len =
+    db->options.scan_prefetch > 0 ? db->options.scan_prefetch : 1;
+  scan->slots = calloc(scan->slots_len, sizeof(struct WiscKeyDBScanSlot));
+  if (WiscKeyDB_scan_fill(scan) == -1) {
+    WiscKeyDBScan_free(scan);
+    return NULL;
+  }
+
+  return scan;
+}
+
 int
-WiscKeyDB_delete(__attribute__((unused)) struct WiscKeyDB* db,
-                 __attribute__((unused)) char* key,
-                 __attribute__((unused)) size_t key_length)
+WiscKeyDBScan_next(struct WiscKeyDBScan* scan,
+                   const char** key,
+                   size_t* key_length,
+                   const char** value,
+                   size_t* value_length)
 {
+  free(scan->key);
+  free(scan->value);
+  scan->key = NULL;
+  scan->value = NULL;
+
+  while (scan->slots_count > 0) {
+    struct WiscKeyDBScanSlot* slot = &scan->slots[scan->slots_start];
+    scan->slots_start = (scan->slots_start + 1) % scan->slots_len;
+    scan->slots_count--;
+
+    int res = WiscKeyDB_scan_value(scan, slot);
+    if (res != 1) {
+      free(slot->record.key);
+      if (res == -1) {
+        return -1;
+      }
+      if (WiscKeyDB_scan_fill(scan) == -1) {
+        return -1;
+      }
+      continue;
+    }
+
+    scan->key = slot->record.key;
+    scan->value = slot->read.value;
+    *key = scan->key;
+    *key_length = slot->record.key_len;
+    *value = scan->value;
+    *value_length = slot->read.value_len;
+
+    // The slot is free again, so the next key is read while the caller uses
+    // this one.
+    if (WiscKeyDB_scan_fill(scan) == -1) {
+      return -1;
+    }
+    return 1;
+  }
+
   return 0;
 }
+
+void
+WiscKeyDBScan_free(struct WiscKeyDBScan* scan)
+{
+  for (size_t i = 0; i < scan->slots_count; i++) {
+    struct WiscKeyDBScanSlot* slot =
+      &scan->slots[(scan->slots_start + i) % scan->slots_len];
+    if (slot->record.value_loc == MEMTABLE_VALUE_INLINE) {
+      free(slot->read.value);
+    } else if (scan->db->read_pool != NULL) {
+      ReadPool_wait(scan->db->read_pool, &slot->read);
+      if (slot->read.res == 0) {
+        free(slot->read.value);
+      }
+    }
+    free(slot->record.key);
+  }
+  free(scan->slots);
+
+  for (size_t i = 0; i < scan->sources_len; i++) {
+    struct WiscKeyDBScanSource* source = &scan->sources[i];
+    if (source->records != NULL) {
+      for (size_t j = 0; j < source->records_len; j++) {
+        free(source->records[j].key);
+        free(source->records[j].value);
+      }
+      free(source->records);
+    } else {
+      free(source->record.key);
+      free(source->record.value);
+    }
+  }
+  free(scan->sources);
+  free(scan->heap);
+
+  free(scan->key);
+  free(scan->value);
+  free(scan->end);
+  free(scan);
+}
+
+/*
+ * Waits until a write is durable. Must be called without the lock of the shard
+ * after pinning the WAL. `value_log_end` is the end of the write's ValueLog
+ * entry or 0 if it has none.
+ */
+static int
+WiscKeyDB_sync_write(struct WiscKeyDB* db,
+                     struct WiscKeyDBShard* shard,
+                     struct WAL* wal,
+                     size_t value_log_end)
+{
+  // The WAL points into the ValueLog, so the value must be on disk first.
+  int res = 0;
+  if (value_log_end > 0) {
+    res = WiscKeyDB_sync_value_log(db, value_log_end);
+  }
+  if (res == 0) {
+    res = WAL_sync(wal);
+  }
+
+  pthread_mutex_lock(&shard->lock);
+  WiscKeyDB_unpin_wal(shard, wal);
+  pthread_mutex_unlock(&shard->lock);
+
+  return res;
+}
+
+int
+WiscKeyDB_set(struct WiscKeyDB* db,
+              char* key,
+              char* value,
+              size_t key_length,
+              size_t value_length)
+{
+  struct WiscKeyDBShard* shard = WiscKeyDB_shard(db, key, key_length);
+
+  pthread_mutex_lock(&shard->lock);
+
+  if (WiscKeyDB_make_room(shard) == -1) {
+    pthread_mutex_unlock(&shard->lock);
+    return -1;
+  }
+
+  size_t value_log_end;
+  int res = WiscKeyDB_set_locked(
+    db, shard, key, key_length, value, value_length, &value_log_end);
+
+  if (res == -1 || !db->options.sync_writes) {
+    pthread_mutex_unlock(&shard->lock);
+    return res;
+  }
+  if (shard->wal == NULL) {
+    // The ValueLog is the log, so the write is durable once it is synced.
+    pthread_mutex_unlock(&shard->lock);
+    return WiscKeyDB_sync_value_log(db, value_log_end);
+  }
+
+  struct WAL* wal = shard->wal;
+  shard->wal_pins++;
+  pthread_mutex_unlock(&shard->lock);
+
+  return WiscKeyDB_sync_write(db, shard, wal, value_log_end);
+}
+
+int
+WiscKeyDB_delete(struct WiscKeyDB* db, char* key, size_t key_length)
+{
+  struct WiscKeyDBShard* shard = WiscKeyDB_shard(db, key, key_length);
+
+  pthread_mutex_lock(&shard->lock);
+
+  if (WiscKeyDB_make_room(shard) == -1) {
+    pthread_mutex_unlock(&shard->lock);
+    return -1;
+  }
+
+  // The deleted value can't be read anymore.
+  if (db->value_cache != NULL) {
+    int64_t value_loc = WiscKeyDB_get_value_loc(db, shard, key, key_length);
+    if (value_loc >= 0) {
+      ValueCache_erase(db->value_cache, value_loc);
+    }
+  }
+
+  int res;
+  size_t value_log_end = 0;
+  if (shard->wal != NULL) {
+    res = WAL_append(shard->wal, key, key_length, -1);
+  } else {
+    size_t pos;
+    size_t len;
+    res = ValueLog_append_tombstone_sized(
+      db->value_log, &pos, &len, key, key_length);
+    value_log_end = pos + len;
+  }
+  if (res == 0) {
+    WiscKeyDB_discard_memtable_value(db, shard, key, key_length);
+    MemTable_delete(shard->memtable, key, key_length);
+  }
+
+  if (res == -1 || !db->options.sync_writes) {
+    pthread_mutex_unlock(&shard->lock);
+    return res;
+  }
+  if (shard->wal == NULL) {
+    pthread_mutex_unlock(&shard->lock);
+    return WiscKeyDB_sync_value_log(db, value_log_end);
+  }
+
+  struct WAL* wal = shard->wal;
+  shard->wal_pins++;
+  pthread_mutex_unlock(&shard->lock);
+
+  return WiscKeyDB_sync_write(db, shard, wal, 0);
+}
+
+int
+WiscKeyDB_gc(struct WiscKeyDB* db)
+{
+  pthread_mutex_lock(&db->gc_lock);
+  int res = WiscKeyDB_gc_pass(db, 0, 0);
+  pthread_mutex_unlock(&db->gc_lock);
+
+  return res;
+}
+
+void
+WiscKeyDB_cache_stats(struct WiscKeyDB* db, struct WiscKeyDBCacheStats* stats)
+{
+  struct ValueCacheStats cache_stats = { 0 };
+  if (db->value_cache != NULL) {
+    ValueCache_stats(db->value_cache, &cache_stats);
+  }
+
+  stats->hits = cache_stats.hits;
+  stats->misses = cache_stats.misses;
+  stats->evictions = cache_stats.evictions;
+  stats->len = cache_stats.len;
+  stats->size = cache_stats.size;
+}
+
+/*
+ * Stops the flush thread of a shard once it has flushed the frozen MemTable.
+ */
+static void
+WiscKeyDB_shard_stop(struct WiscKeyDBShard* shard)
+{
+  if (shard->db == NULL || !shard->flush_thread_running) {
+    return;
+  }
+
+  pthread_mutex_lock(&shard->lock);
+  shard->closing = 1;
+  pthread_cond_broadcast(&shard->flush_cond);
+  pthread_mutex_unlock(&shard->lock);
+
+  pthread_join(shard->flush_thread, NULL);
+  shard->flush_thread_running = 0;
+}
+
+static void
+WiscKeyDB_shard_free(struct WiscKeyDBShard* shard)
+{
+  if (shard->db == NULL) {
+    // The shard was never initialized.
+    return;
+  }
+
+  // A MemTable that failed to flush is still in its WAL or the ValueLog.
+  if (shard->immutable != NULL) {
+    if (shard->immutable_wal != NULL) {
+      WiscKeyDB_wal_free(shard->immutable_wal);
+    }
+    MemTable_free(shard->immutable);
+  }
+  if (shard->wal != NULL) {
+    WAL_sync(shard->wal);
+    WiscKeyDB_wal_free(shard->wal);
+  }
+  if (shard->memtable != NULL) {
+    MemTable_free(shard->memtable);
+  }
+
+  pthread_cond_destroy(&shard->flush_cond);
+  pthread_mutex_destroy(&shard->lock);
+}
+
+void
+WiscKeyDB_free(struct WiscKeyDB* db)
+{
+  // The garbage collector writes through the shards.
+  if (db->gc_thread_running) {
+    pthread_mutex_lock(&db->gc_lock);
+    db->gc_closing = 1;
+    pthread_cond_broadcast(&db->gc_cond);
+    pthread_mutex_unlock(&db->gc_lock);
+
+    pthread_join(db->gc_thread, NULL);
+  }
+
+  // A flush takes the locks of the other shards to advance the checkpoint.
+  for (size_t i = 0; i < db->shards_len; i++) {
+    WiscKeyDB_shard_stop(&db->shards[i]);
+  }
+  // The WALs are synced as the shards are freed, and their records point at
+  // the ValueLog, so it must be on disk first.
+  if (db->value_log != NULL) {
+    WiscKeyDB_sync_value_log(db, SIZE_MAX);
+  }
+  for (size_t i = 0; i < db->shards_len; i++) {
+    WiscKeyDB_shard_free(&db->shards[i]);
+  }
+  free(db->shards);
+
+  for (size_t i = 0; i < db->recycled_wals_len; i++) {
+    free(db->recycled_wals[i]);
+  }
+  free(db->recycled_wals);
+
+  if (db->read_pool != NULL) {
+    ReadPool_free(db->read_pool);
+  }
+  if (db->value_log != NULL) {
+    ValueLog_sync(db->value_log);
+    ValueLog_free(db->value_log);
+  }
+  if (db->value_cache != NULL) {
+    ValueCache_free(db->value_cache);
+  }
+
+  for (size_t i = 0; i < db->sstables_len; i++) {
+    char* path = db->sstables[i]->path;
+    SSTable_free(db->sstables[i]);
+    free(path);
+  }
+  free(db->sstables);
+  for (size_t i = 0; i < db->retired_sstables_len; i++) {
+    free(db->retired_sstables[i]);
+  }
+  free(db->retired_sstables);
+
+  if (db->options.split_keys != NULL) {
+    for (size_t i = 0; i + 1 < db->shards_len; i++) {
+      free(db->options.split_keys[i]);
+    }
+    free(db->options.split_keys);
+    free(db->options.split_key_lengths);
+  }
+
+  pthread_cond_destroy(&db->gc_cond);
+  pthread_mutex_destroy(&db->gc_lock);
+  pthread_mutex_destroy(&db->checkpoint_lock);
+  pthread_mutex_destroy(&db->value_log_lock);
+  pthread_mutex_destroy(&db->sync_lock);
+  pthread_mutex_destroy(&db->lock);
+  free(db->dir);
+  free(db);
+}
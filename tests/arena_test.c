@@ -0,0 +1,168 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../src/arena.h"
+
+void
+TestArena_new()
+{
+  struct Arena* arena = Arena_new(ARENA_BLOCK_SIZE);
+
+  assert(arena != NULL);
+  assert(arena->blocks == NULL);
+  assert(arena->large == NULL);
+  assert(arena->block_size == ARENA_BLOCK_SIZE);
+  assert(arena->allocations == 0);
+  assert(arena->bytes_used == 0);
+  assert(arena->bytes_reserved == 0);
+
+  Arena_free(arena);
+}
+
+void
+TestArena_alloc()
+{
+  struct Arena* arena = Arena_new(1024);
+
+  char* a = Arena_alloc(arena, 5);
+  char* b = Arena_alloc(arena, 16);
+
+  assert(a != NULL);
+  assert(b != NULL);
+  assert((uintptr_t)a % ARENA_ALIGNMENT == 0);
+  assert((uintptr_t)b % ARENA_ALIGNMENT == 0);
+  assert(b == a + 8);
+
+  memcpy(a, "apple", 5);
+  memcpy(b, "Apple Pie Recipe", 16);
+  assert(memcmp(a, "apple", 5) == 0);
+
+  assert(arena->allocations == 2);
+  assert(arena->bytes_used == 24);
+  assert(arena->bytes_reserved == 1024);
+
+  Arena_free(arena);
+}
+
+void
+TestArena_alloc_new_block()
+{
+  struct Arena* arena = Arena_new(1024);
+
+  for (int i = 0; i < 200; i++) {
+    char* mem = Arena_alloc(arena, 8);
+    assert(mem != NULL);
+    memset(mem, i, 8);
+  }
+
+  assert(arena->allocations == 200);
+  assert(arena->bytes_used == 1600);
+  assert(arena->bytes_reserved == 2048);
+  assert(arena->blocks->next != NULL);
+  assert(arena->blocks->next->next == NULL);
+  assert(arena->large == NULL);
+
+  Arena_free(arena);
+}
+
+void
+TestArena_alloc_large()
+{
+  struct Arena* arena = Arena_new(1024);
+
+  Arena_alloc(arena, 8);
+  char* small = Arena_alloc(arena, 760);
+  char* large = Arena_alloc(arena, 512);
+  char* next = Arena_alloc(arena, 8);
+
+  assert(small != NULL);
+  assert(large != NULL);
+
+  // The large allocation doesn't fit in the current block, so it gets a
+  // dedicated block and the current block keeps serving small allocations.
+  assert(next == small + 760);
+  assert(arena->bytes_reserved == 1024 + 512);
+  assert(arena->blocks->next == NULL);
+  assert(arena->large->size == 512);
+
+  Arena_free(arena);
+}
+
+static void*
+concurrent_alloc(void* arg)
+{
+  struct Arena* arena = arg;
+
+  for (int i = 0; i < 10000; i++) {
+    uint64_t* mem = Arena_alloc(arena, sizeof(uint64_t) * 3);
+    assert(mem != NULL);
+    mem[0] = (uint64_t)(uintptr_t)mem;
+    mem[1] = (uint64_t)(uintptr_t)mem;
+    mem[2] = (uint64_t)(uintptr_t)mem;
+  }
+
+  return NULL;
+}
+
+void
+TestArena_alloc_concurrent()
+{
+  struct Arena* arena = Arena_new(1024);
+
+  pthread_t threads[8];
+  for (int i = 0; i < 8; i++) {
+    pthread_create(&threads[i], NULL, concurrent_alloc, arena);
+  }
+  for (int i = 0; i < 8; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  assert(arena->allocations == 8 * 10000);
+  assert(arena->bytes_used == 8 * 10000 * 24);
+
+  // Every allocation must be disjoint, so each one still holds its address.
+  for (struct ArenaBlock* block = arena->blocks; block != NULL;
+       block = block->next) {
+    size_t used = block->used < block->size ? block->used : block->size;
+    for (size_t off = 0; off + 24 <= used; off += 24) {
+      uint64_t* mem = (uint64_t*)(block->data + off);
+      assert(mem[0] == (uint64_t)(uintptr_t)mem);
+      assert(mem[2] == (uint64_t)(uintptr_t)mem);
+    }
+  }
+
+  Arena_free(arena);
+}
+
+int
+main()
+{
+  // New
+  TestArena_new();
+
+  // Alloc
+  TestArena_alloc();
+  TestArena_alloc_new_block();
+  TestArena_alloc_large();
+  TestArena_alloc_concurrent();
+
+  return 0;
+}
@@ -0,0 +1,218 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/codec.h"
+
+#define TEST_VALUE_SIZE (64 * 1024)
+
+static const int codecs[] = { CODEC_LZ, CODEC_ZLIB, CODEC_ZSTD };
+
+/*
+ * Fills a buffer with JSON-like records, which compress well.
+ */
+static void
+make_json(char* buf, size_t len)
+{
+  size_t n = 0;
+  for (uint32_t i = 0; n < len; i++) {
+    char record[128];
+    int record_len = snprintf(record,
+                              sizeof(record),
+                              "{\"id\":%u,\"name\":\"user-%u\",\"active\":%s},",
+                              i * 7919,
+                              i % 97,
+                              i % 3 == 0 ? "true" : "false");
+    size_t copy = (size_t)record_len < len - n ? (size_t)record_len : len - n;
+    memcpy(buf + n, record, copy);
+    n += copy;
+  }
+}
+
+static void
+make_random(char* buf, size_t len)
+{
+  srand(7);
+  for (size_t i = 0; i < len; i++) {
+    buf[i] = (char)(rand() & 0xFF);
+  }
+}
+
+static void
+check_round_trip(int codec, const char* value, size_t len)
+{
+  size_t cap = len + len / 8 + 64;
+  char* compressed = malloc(cap);
+  size_t compressed_len = Codec_compress(codec, compressed, cap, value, len);
+  assert(compressed_len > 0);
+
+  char* decompressed = malloc(len);
+  assert(Codec_decompress(
+           codec, decompressed, len, compressed, compressed_len) == 0);
+  assert(memcmp(decompressed, value, len) == 0);
+
+  // The decompressed length has to match exactly.
+  if (len > 1) {
+    assert(Codec_decompress(
+             codec, decompressed, len - 1, compressed, compressed_len) == -1);
+  }
+
+  free(decompressed);
+  free(compressed);
+}
+
+void
+TestCodec_supported()
+{
+  assert(Codec_supported(CODEC_NONE));
+  assert(Codec_supported(CODEC_LZ));
+#ifdef WISCKEY_HAVE_ZLIB
+  assert(Codec_supported(CODEC_ZLIB));
+#else
+  assert(!Codec_supported(CODEC_ZLIB));
+#endif
+#ifdef WISCKEY_HAVE_ZSTD
+  assert(Codec_supported(CODEC_ZSTD));
+#else
+  assert(!Codec_supported(CODEC_ZSTD));
+#endif
+  assert(!Codec_supported(255));
+
+  // A codec that isn't built in neither compresses nor decompresses.
+  char buf[16] = { 0 };
+  char out[16];
+  assert(Codec_compress(255, out, sizeof(out), buf, sizeof(buf)) == 0);
+  assert(Codec_decompress(255, out, sizeof(out), buf, sizeof(buf)) == -1);
+}
+
+void
+TestCodec_round_trip()
+{
+  char* value = malloc(TEST_VALUE_SIZE);
+
+  for (size_t c = 0; c < sizeof(codecs) / sizeof(codecs[0]); c++) {
+    int codec = codecs[c];
+    if (!Codec_supported(codec)) {
+      continue;
+    }
+
+    make_json(value, TEST_VALUE_SIZE);
+    check_round_trip(codec, value, TEST_VALUE_SIZE);
+    check_round_trip(codec, value, 100);
+    check_round_trip(codec, value, 1);
+
+    // A long run, which is a match that overlaps its own output and has a
+    // length that takes many extra bytes.
+    memset(value, 'a', TEST_VALUE_SIZE);
+    check_round_trip(codec, value, TEST_VALUE_SIZE);
+
+    // Long runs of literals between matches.
+    make_random(value, TEST_VALUE_SIZE);
+    memcpy(value + TEST_VALUE_SIZE / 2, value, 1000);
+    check_round_trip(codec, value, TEST_VALUE_SIZE);
+  }
+
+  free(value);
+}
+
+void
+TestCodec_cap()
+{
+  char* value = malloc(TEST_VALUE_SIZE);
+  char* compressed = malloc(TEST_VALUE_SIZE);
+
+  for (size_t c = 0; c < sizeof(codecs) / sizeof(codecs[0]); c++) {
+    int codec = codecs[c];
+    if (!Codec_supported(codec)) {
+      continue;
+    }
+
+    // Random bytes don't shrink, so they don't fit below their own length.
+    make_random(value, TEST_VALUE_SIZE);
+    assert(Codec_compress(
+             codec, compressed, TEST_VALUE_SIZE - 16, value, TEST_VALUE_SIZE) ==
+           0);
+
+    make_json(value, TEST_VALUE_SIZE);
+    size_t len = Codec_compress(
+      codec, compressed, TEST_VALUE_SIZE, value, TEST_VALUE_SIZE);
+    assert(len > 0 && len < TEST_VALUE_SIZE / 3);
+    assert(Codec_compress(codec, compressed, len - 1, value, TEST_VALUE_SIZE) ==
+           0);
+
+    assert(Codec_compress(codec, compressed, TEST_VALUE_SIZE, value, 0) == 0);
+  }
+
+  free(compressed);
+  free(value);
+}
+
+void
+TestCodec_corrupt()
+{
+  char value[1024];
+  char compressed[2048];
+  char out[1024];
+
+  make_json(value, sizeof(value));
+  size_t len = Codec_compress(
+    CODEC_LZ, compressed, sizeof(compressed), value, sizeof(value));
+  assert(len > 0);
+
+  // Cut short.
+  for (size_t i = 0; i < len; i++) {
+    assert(Codec_decompress(CODEC_LZ, out, sizeof(out), compressed, i) == -1);
+  }
+
+  // A match before the start of the output.
+  char far[] = { 0x10, 'a', 0x05, 0x00 };
+  assert(Codec_decompress(CODEC_LZ, out, 5, far, sizeof(far)) == -1);
+  char zero[] = { 0x10, 'a', 0x00, 0x00 };
+  assert(Codec_decompress(CODEC_LZ, out, 5, zero, sizeof(zero)) == -1);
+  char near[] = { 0x10, 'a', 0x01, 0x00 };
+  assert(Codec_decompress(CODEC_LZ, out, 5, near, sizeof(near)) == 0);
+  assert(memcmp(out, "aaaaa", 5) == 0);
+
+  // Flipped bytes either fail or decode to some value, but stay in bounds.
+  for (size_t i = 0; i < len; i++) {
+    compressed[i] ^= 0x5A;
+    Codec_decompress(CODEC_LZ, out, sizeof(out), compressed, len);
+    compressed[i] ^= 0x5A;
+  }
+  assert(Codec_decompress(CODEC_LZ, out, sizeof(out), compressed, len) == 0);
+  assert(memcmp(out, value, sizeof(value)) == 0);
+}
+
+int
+main()
+{
+  // Supported
+  TestCodec_supported();
+
+  // Round Trip
+  TestCodec_round_trip();
+  TestCodec_cap();
+
+  // Corrupt
+  TestCodec_corrupt();
+
+  return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../src/common.h"
+#include "../src/hash_index.h"
+
+#define TEST_RECORDS 1000
+
+void
+TestHashIndex_new()
+{
+  struct HashIndex* index = HashIndex_new();
+
+  assert(index != NULL);
+  assert(index->capacity == HASH_INDEX_MIN_CAPACITY);
+  assert(index->size == 0);
+  assert(HashIndex_get(index, "key", 3, WiscKey_key_hash("key", 3)) == NULL);
+  assert(index->lookups == 1);
+  assert(index->hits == 0);
+
+  HashIndex_free(index);
+}
+
+void
+TestHashIndex_put()
+{
+  struct HashIndex* index = HashIndex_new();
+
+  struct MemTableRecord records[TEST_RECORDS];
+  uint32_t keys[TEST_RECORDS];
+  for (uint32_t i = 0; i < TEST_RECORDS; i++) {
+    keys[i] = i;
+    records[i].key = (char*)&keys[i];
+    records[i].key_len = sizeof(keys[i]);
+    records[i].value_loc = i;
+
+    HashIndex_put(
+      index, &records[i], WiscKey_key_hash(records[i].key, sizeof(keys[i])));
+  }
+
+  assert(index->size == TEST_RECORDS);
+  assert(index->capacity >= 2 * TEST_RECORDS);
+  assert(HashIndex_memory(index) >=
+         index->capacity * sizeof(struct HashIndexEntry));
+
+  for (uint32_t i = 0; i < TEST_RECORDS; i++) {
+    uint32_t key = i;
+    struct MemTableRecord* record = HashIndex_get(
+      index, (char*)&key, sizeof(key), WiscKey_key_hash((char*)&key, 4));
+    assert(record == &records[i]);
+  }
+
+  // Same bytes with a different length.
+  uint32_t key = 0;
+  uint64_t hash = WiscKey_key_hash((char*)&key, 3);
+  assert(HashIndex_get(index, (char*)&key, 3, hash) == NULL);
+
+  struct HashIndexStats stats;
+  HashIndex_stats(index, &stats);
+  assert(stats.lookups == TEST_RECORDS + 1);
+  assert(stats.hits == TEST_RECORDS);
+  assert(stats.probes >= stats.lookups);
+  assert(stats.probes == index->probes);
+
+  HashIndex_free(index);
+}
+
+void
+TestHashIndex_collision()
+{
+  struct HashIndex* index = HashIndex_new();
+
+  // Records with the same hash are told apart by their keys.
+  struct MemTableRecord a = { "a", 1, 1, 0, NULL };
+  struct MemTableRecord b = { "b", 1, 2, 0, NULL };
+  HashIndex_put(index, &a, 42);
+  HashIndex_put(index, &b, 42);
+
+  assert(HashIndex_get(index, "a", 1, 42) == &a);
+  assert(HashIndex_get(index, "b", 1, 42) == &b);
+  assert(HashIndex_get(index, "c", 1, 42) == NULL);
+
+  HashIndex_free(index);
+}
+
+void
+TestWiscKey_key_hash()
+{
+  assert(WiscKey_key_hash("abc", 3) == WiscKey_key_hash("abc", 3));
+  assert(WiscKey_key_hash("abc", 3) != WiscKey_key_hash("abd", 3));
+  assert(WiscKey_key_hash("abc", 3) != WiscKey_key_hash("abc", 4));
+  assert(WiscKey_key_hash("abcdefghi", 9) != WiscKey_key_hash("abcdefghj", 9));
+}
+
+int
+main()
+{
+  // New
+  TestHashIndex_new();
+
+  // Put
+  TestHashIndex_put();
+  TestHashIndex_collision();
+
+  // Hash
+  TestWiscKey_key_hash();
+
+  return 0;
+}
@@ -15,16 +15,23 @@
  */
 
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 
+#include "../src/common.h"
+#include "../src/hash_index.h"
 #include "../src/memtable.h"
 
 void
 TestMemTable_new()
 {
-  struct MemTable* m = MemTable_new();
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
 
   assert(m->size == 0);
+  assert(m->bytes == 0);
+  assert(m->budget == MEMTABLE_DEFAULT_BUDGET);
+  assert(m->arena != NULL);
+  assert(m->arena->allocations == 0);
 
   MemTable_free(m);
 }
@@ -32,7 +39,7 @@ TestMemTable_new()
 void
 TestMemTable_set_start()
 {
-  struct MemTable* m = MemTable_new();
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
 
   char* key1 = "lime";
   char* value1 = "Key Lime Pie";
@@ -88,7 +95,7 @@ TestMemTable_set_start()
 void
 TestMemTable_set_end()
 {
-  struct MemTable* m = MemTable_new();
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
 
   char* key1 = "apple";
   char* value1 = "Apple Pie";
@@ -141,10 +148,31 @@ TestMemTable_set_end()
   MemTable_free(m);
 }
 
+void
+TestMemTable_set_middle()
+{
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+
+  char* keys[] = { "apple", "lime", "cherry", "banana", "kiwi" };
+  char* sorted[] = { "apple", "banana", "cherry", "kiwi", "lime" };
+
+  for (int i = 0; i < 5; i++) {
+    MemTable_set(m, keys[i], strlen(keys[i]) + 1, i);
+  }
+
+  assert(m->size == 5);
+  for (int i = 0; i < 5; i++) {
+    assert(m->records[i]->key_len == strlen(sorted[i]) + 1);
+    assert(memcmp(m->records[i]->key, sorted[i], strlen(sorted[i]) + 1) == 0);
+  }
+
+  MemTable_free(m);
+}
+
 void
 TestMemTable_set_overwrite()
 {
-  struct MemTable* m = MemTable_new();
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
 
   char* key1 = "apple";
   char* value1 = "Apple Pie";
@@ -175,7 +203,7 @@ TestMemTable_set_overwrite()
 void
 TestMemTable_delete_empty()
 {
-  struct MemTable* m = MemTable_new();
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
 
   char* key1 = "apple";
 
@@ -191,7 +219,7 @@ TestMemTable_delete_empty()
 void
 TestMemTable_delete_remove()
 {
-  struct MemTable* m = MemTable_new();
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
 
   char* key = "apple";
   long long value_offset = 0;
@@ -216,7 +244,7 @@ TestMemTable_delete_remove()
 void
 TestMemTable_get()
 {
-  struct MemTable* m = MemTable_new();
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
 
   char* key = "apple";
   size_t value_offset = 0;
@@ -238,6 +266,469 @@ TestMemTable_get()
   MemTable_free(m);
 }
 
+void
+TestMemTable_set_value()
+{
+  struct MemTable* tables[] = {
+    MemTable_new(MEMTABLE_DEFAULT_BUDGET),
+    MemTable_new_concurrent(MEMTABLE_DEFAULT_BUDGET),
+  };
+
+  for (int t = 0; t < 2; t++) {
+    struct MemTable* m = tables[t];
+
+    MemTable_set_value(m, "key-0001", 8, "apple", 5);
+    struct MemTableRecord* r = MemTable_get(m, "key-0001", 8);
+    assert(r->value_loc == MEMTABLE_VALUE_INLINE);
+    assert(r->value->len == 5);
+    assert(memcmp(r->value->data, "apple", 5) == 0);
+    assert(m->bytes == 8 + MEMTABLE_RECORD_OVERHEAD +
+                         sizeof(struct MemTableValue) + 5);
+
+    // An overwrite charges the new value, and a location replaces the value.
+    MemTable_set_value(m, "key-0001", 8, "", 0);
+    r = MemTable_get(m, "key-0001", 8);
+    assert(r->value_loc == MEMTABLE_VALUE_INLINE);
+    assert(r->value->len == 0);
+    assert(m->bytes == 8 + MEMTABLE_RECORD_OVERHEAD +
+                         2 * sizeof(struct MemTableValue) + 5);
+
+    MemTable_set(m, "key-0001", 8, 10);
+    assert(MemTable_get(m, "key-0001", 8)->value_loc == 10);
+
+    // Inline entries of a batch.
+    struct MemTableBatchEntry entries[] = {
+      { "key-0002", 8, MEMTABLE_VALUE_INLINE, 0, "cherry", 6 },
+      { "key-0001", 8, MEMTABLE_VALUE_INLINE, 0, "banana", 6 },
+      { "key-0003", 8, 20, 7, NULL, 0 },
+    };
+    MemTable_set_batch(m, entries, 3);
+    for (int i = 0; i < 2; i++) {
+      r = MemTable_get(m, entries[i].key, 8);
+      assert(r->value_loc == MEMTABLE_VALUE_INLINE);
+      assert(r->value->len == 6);
+      assert(memcmp(r->value->data, entries[i].value, 6) == 0);
+    }
+    assert(MemTable_get(m, "key-0003", 8)->value_loc == 20);
+    assert(MemTable_get(m, "key-0003", 8)->value_size == 7);
+
+    MemTable_free(m);
+  }
+}
+
+void
+TestMemTable_arena()
+{
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+
+  char* key1 = "apple";
+  char* key2 = "cherry";
+
+  MemTable_set(m, key1, strlen(key1) + 1, 0);
+  MemTable_set(m, key2, strlen(key2) + 1, 10);
+
+  // One allocation per record, with the key stored behind the record
+  assert(m->arena->allocations == 2);
+  assert(m->arena->bytes_used >= 2 * sizeof(struct MemTableRecord) +
+                                   strlen(key1) + 1 + strlen(key2) + 1);
+  assert(m->records[0]->key == (char*)(m->records[0] + 1));
+
+  // Overwrites and deletes of existing keys don't allocate
+  MemTable_set(m, key1, strlen(key1) + 1, 20);
+  MemTable_delete(m, key2, strlen(key2) + 1);
+  assert(m->arena->allocations == 2);
+
+  MemTable_free(m);
+}
+
+void
+TestMemTable_budget()
+{
+  struct MemTable* tables[] = {
+    MemTable_new(4 * (8 + MEMTABLE_RECORD_OVERHEAD)),
+    MemTable_new_concurrent(4 * (8 + MEMTABLE_RECORD_OVERHEAD)),
+  };
+
+  for (int t = 0; t < 2; t++) {
+    struct MemTable* m = tables[t];
+
+    MemTable_set(m, "key-0001", 8, 0);
+    MemTable_set(m, "key-0002", 8, 10);
+    MemTable_delete(m, "key-0003", 8);
+    assert(m->bytes == 3 * (8 + MEMTABLE_RECORD_OVERHEAD));
+    assert(MemTable_should_flush(m) == 0);
+
+    // Overwrites and deletes of existing keys don't charge the budget.
+    MemTable_set(m, "key-0001", 8, 20);
+    MemTable_delete(m, "key-0002", 8);
+    assert(m->bytes == 3 * (8 + MEMTABLE_RECORD_OVERHEAD));
+    assert(MemTable_should_flush(m) == 0);
+
+    MemTable_set(m, "key-0004", 8, 30);
+    assert(m->bytes == 4 * (8 + MEMTABLE_RECORD_OVERHEAD));
+    assert(MemTable_should_flush(m) == 1);
+
+    MemTable_free(m);
+  }
+}
+
+void
+TestMemTable_grow()
+{
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+
+  // Insert in reverse order so every insert shifts the whole array.
+  for (uint32_t i = 0; i < 10 * MEMTABLE_MIN_CAPACITY; i++) {
+    uint32_t key = __builtin_bswap32(10 * MEMTABLE_MIN_CAPACITY - i);
+    MemTable_set(m, (char*)&key, sizeof(key), i);
+  }
+
+  assert(m->size == 10 * MEMTABLE_MIN_CAPACITY);
+  assert(m->capacity >= m->size);
+  for (uint32_t i = 0; i < m->size; i++) {
+    uint32_t key = __builtin_bswap32(i + 1);
+    assert(memcmp(m->records[i]->key, &key, sizeof(key)) == 0);
+  }
+
+  MemTable_free(m);
+}
+
+void
+TestMemTable_prefix()
+{
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+
+  // Keys that tie on their inline prefix and keys with trailing zeros.
+  struct
+  {
+    char* key;
+    size_t key_len;
+  } keys[] = {
+    { "abcdefghb", 9 }, { "a\0", 2 },        { "abcdefgh", 8 },
+    { "b", 1 },         { "abcdefgh\0", 9 }, { "a", 1 },
+    { "abcdefg", 7 },   { "abcdefghab", 10 }, { "", 0 },
+    { "a\0\0", 3 },
+  };
+  size_t n = sizeof(keys) / sizeof(keys[0]);
+
+  for (size_t i = 0; i < n; i++) {
+    MemTable_set(m, keys[i].key, keys[i].key_len, (int64_t)i);
+  }
+  assert(m->size == n);
+
+  for (size_t i = 1; i < m->size; i++) {
+    assert(WiscKey_key_cmp(m->records[i - 1]->key,
+                           m->records[i - 1]->key_len,
+                           m->records[i]->key,
+                           m->records[i]->key_len) > 0);
+  }
+  for (size_t i = 0; i < m->size; i++) {
+    assert(m->prefixes[i].key_len == m->records[i]->key_len);
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    struct MemTableRecord* r = MemTable_get(m, keys[i].key, keys[i].key_len);
+    assert(r != NULL);
+    assert(r->key_len == keys[i].key_len);
+    assert(r->value_loc == (int64_t)i);
+  }
+
+  assert(MemTable_get(m, "abcdefghaa", 10) == NULL);
+  assert(MemTable_get(m, "a\0\0\0", 4) == NULL);
+
+  MemTable_free(m);
+}
+
+void
+TestMemTable_hash_index()
+{
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  assert(MemTable_hash_index_memory(m) == 0);
+
+  // Records set before the index is enabled are indexed too.
+  for (uint32_t i = 0; i < MEMTABLE_MIN_CAPACITY; i++) {
+    uint32_t key = __builtin_bswap32(2 * i);
+    MemTable_set(m, (char*)&key, sizeof(key), i);
+  }
+  assert(MemTable_enable_hash_index(m) == 0);
+  assert(MemTable_enable_hash_index(m) == 0);
+  assert(m->hash_index->size == MEMTABLE_MIN_CAPACITY);
+  assert(MemTable_hash_index_memory(m) > 0);
+
+  for (uint32_t i = 0; i < MEMTABLE_MIN_CAPACITY; i++) {
+    uint32_t key = __builtin_bswap32(2 * i + 1);
+    MemTable_set(m, (char*)&key, sizeof(key), MEMTABLE_MIN_CAPACITY + i);
+  }
+  assert(m->size == 2 * MEMTABLE_MIN_CAPACITY);
+  assert(m->hash_index->size == m->size);
+
+  // The sorted array is still kept in order for the iterator.
+  for (uint32_t i = 0; i < m->size; i++) {
+    uint32_t key = __builtin_bswap32(i);
+    assert(memcmp(m->records[i]->key, &key, sizeof(key)) == 0);
+  }
+
+  // Overwrites and deletes update the indexed record.
+  uint32_t key = __builtin_bswap32(3);
+  MemTable_set(m, (char*)&key, sizeof(key), 1000);
+  assert(MemTable_get(m, (char*)&key, sizeof(key))->value_loc == 1000);
+  MemTable_delete(m, (char*)&key, sizeof(key));
+  assert(MemTable_get(m, (char*)&key, sizeof(key))->value_loc == -1);
+  assert(m->size == 2 * MEMTABLE_MIN_CAPACITY);
+
+  // Deleting a missing key inserts an indexed tombstone.
+  key = __builtin_bswap32(10000);
+  assert(MemTable_get(m, (char*)&key, sizeof(key)) == NULL);
+  MemTable_delete(m, (char*)&key, sizeof(key));
+  assert(MemTable_get(m, (char*)&key, sizeof(key))->value_loc == -1);
+  assert(m->size == 2 * MEMTABLE_MIN_CAPACITY + 1);
+
+  struct HashIndexStats before;
+  MemTable_hash_index_stats(m, &before);
+  key = __builtin_bswap32(0);
+  assert(MemTable_get(m, (char*)&key, sizeof(key))->value_loc == 0);
+  key = __builtin_bswap32(20000);
+  assert(MemTable_get(m, (char*)&key, sizeof(key)) == NULL);
+  struct HashIndexStats after;
+  MemTable_hash_index_stats(m, &after);
+  assert(after.lookups == before.lookups + 2);
+  assert(after.hits == before.hits + 1);
+  assert(after.probes >= before.probes + 2);
+
+  MemTable_free(m);
+
+  struct MemTable* c = MemTable_new_concurrent(MEMTABLE_DEFAULT_BUDGET);
+  assert(MemTable_enable_hash_index(c) == -1);
+  assert(MemTable_hash_index_memory(c) == 0);
+  MemTable_hash_index_stats(c, &after);
+  assert(after.lookups == 0 && after.hits == 0 && after.probes == 0);
+  MemTable_free(c);
+}
+
+static void
+check_batch(struct MemTable* m, struct MemTable* expected)
+{
+  assert(m->size == expected->size);
+  assert(m->bytes == expected->bytes);
+
+  struct MemTableIterator iter;
+  struct MemTableIterator expected_iter;
+  MemTableIterator_init(&iter, m);
+  MemTableIterator_init(&expected_iter, expected);
+
+  struct MemTableRecord* record;
+  while ((record = MemTableIterator_next(&iter)) != NULL) {
+    struct MemTableRecord* expected_record =
+      MemTableIterator_next(&expected_iter);
+    assert(expected_record != NULL);
+    assert(record->key_len == expected_record->key_len);
+    assert(memcmp(record->key, expected_record->key, record->key_len) == 0);
+    assert(record->value_loc == expected_record->value_loc);
+
+    assert(MemTable_get(m, record->key, record->key_len) == record);
+  }
+  assert(MemTableIterator_next(&expected_iter) == NULL);
+}
+
+static void
+run_batch(struct MemTable* m)
+{
+  struct MemTable* expected = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+
+  // Batches that mix new keys, existing keys, and keys repeated within the
+  // batch. Each batch must match the same writes made one at a time.
+  uint32_t keys[3 * MEMTABLE_MIN_CAPACITY];
+  struct MemTableBatchEntry entries[3 * MEMTABLE_MIN_CAPACITY];
+  uint32_t state = 7;
+  for (int round = 0; round < 4; round++) {
+    for (size_t i = 0; i < 3 * MEMTABLE_MIN_CAPACITY; i++) {
+      state = state * 1103515245 + 12345;
+      keys[i] = __builtin_bswap32((state >> 8) % (4 * MEMTABLE_MIN_CAPACITY));
+      entries[i].key = (char*)&keys[i];
+      entries[i].key_len = sizeof(keys[i]);
+      entries[i].value_loc = round * 1000 + (int64_t)i;
+    }
+
+    if (round == 3) {
+      MemTable_delete_batch(m, entries, 3 * MEMTABLE_MIN_CAPACITY);
+      for (size_t i = 0; i < 3 * MEMTABLE_MIN_CAPACITY; i++) {
+        MemTable_delete(expected, entries[i].key, entries[i].key_len);
+      }
+    } else {
+      MemTable_set_batch(m, entries, 3 * MEMTABLE_MIN_CAPACITY);
+      for (size_t i = 0; i < 3 * MEMTABLE_MIN_CAPACITY; i++) {
+        MemTable_set(expected,
+                     entries[i].key,
+                     entries[i].key_len,
+                     entries[i].value_loc);
+      }
+    }
+
+    check_batch(m, expected);
+  }
+
+  MemTable_set_batch(m, entries, 0);
+  check_batch(m, expected);
+
+  MemTable_free(expected);
+}
+
+void
+TestMemTable_set_batch()
+{
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  run_batch(m);
+  MemTable_free(m);
+
+  m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  MemTable_enable_hash_index(m);
+  run_batch(m);
+  assert(m->hash_index->size == m->size);
+  MemTable_free(m);
+
+  m = MemTable_new_concurrent(MEMTABLE_DEFAULT_BUDGET);
+  run_batch(m);
+  MemTable_free(m);
+}
+
+void
+TestMemTable_set_batch_order()
+{
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+
+  MemTable_set(m, "b", 2, 1);
+  MemTable_set(m, "d", 2, 2);
+
+  // The last write of a key wins.
+  struct MemTableBatchEntry entries[] = {
+    { "e", 2, 10, 0, NULL, 0 }, { "a", 2, 11, 0, NULL, 0 },
+    { "d", 2, 12, 0, NULL, 0 }, { "a", 2, 13, 0, NULL, 0 },
+    { "c", 2, 14, 0, NULL, 0 }, { "e", 2, 15, 0, NULL, 0 },
+  };
+  MemTable_set_batch(m, entries, sizeof(entries) / sizeof(entries[0]));
+
+  char* keys[] = { "a", "b", "c", "d", "e" };
+  int64_t locs[] = { 13, 1, 14, 12, 15 };
+  assert(m->size == 5);
+  for (size_t i = 0; i < m->size; i++) {
+    assert(memcmp(m->records[i]->key, keys[i], 2) == 0);
+    assert(m->records[i]->value_loc == locs[i]);
+    assert(m->prefixes[i].key_len == 2);
+  }
+
+  MemTable_free(m);
+}
+
+void
+TestMemTable_concurrent()
+{
+  struct MemTable* m = MemTable_new_concurrent(MEMTABLE_DEFAULT_BUDGET);
+
+  assert(m->size == 0);
+  assert(m->skiplist != NULL);
+
+  char* key1 = "lime";
+  char* key2 = "apple";
+
+  assert(MemTable_get(m, key1, strlen(key1) + 1) == NULL);
+
+  MemTable_set(m, key1, strlen(key1) + 1, 0);
+  MemTable_set(m, key2, strlen(key2) + 1, 10);
+  MemTable_set(m, key1, strlen(key1) + 1, 20);
+  assert(m->size == 2);
+
+  struct MemTableRecord* r = MemTable_get(m, key1, strlen(key1) + 1);
+  assert(r != NULL);
+  assert(r->value_loc == 20);
+
+  MemTable_delete(m, key2, strlen(key2) + 1);
+  r = MemTable_get(m, key2, strlen(key2) + 1);
+  assert(r != NULL);
+  assert(r->value_loc == -1);
+
+  char* key3 = "cherry";
+  MemTable_delete(m, key3, strlen(key3) + 1);
+  assert(m->size == 3);
+
+  MemTable_free(m);
+}
+
+void
+TestMemTable_iterator()
+{
+  char* keys[] = { "lime", "apple", "cherry" };
+  char* sorted[] = { "apple", "cherry", "lime" };
+
+  struct MemTable* tables[] = {
+    MemTable_new(MEMTABLE_DEFAULT_BUDGET),
+    MemTable_new_concurrent(MEMTABLE_DEFAULT_BUDGET),
+  };
+
+  for (int t = 0; t < 2; t++) {
+    struct MemTable* m = tables[t];
+    for (int i = 0; i < 3; i++) {
+      MemTable_set(m, keys[i], strlen(keys[i]) + 1, i);
+    }
+
+    struct MemTableIterator iter;
+    MemTableIterator_init(&iter, m);
+
+    for (int i = 0; i < 3; i++) {
+      struct MemTableRecord* r = MemTableIterator_next(&iter);
+      assert(r != NULL);
+      assert(memcmp(r->key, sorted[i], strlen(sorted[i]) + 1) == 0);
+    }
+    assert(MemTableIterator_next(&iter) == NULL);
+
+    MemTable_free(m);
+  }
+}
+
+void
+TestMemTable_iterator_seek()
+{
+  char* keys[] = { "lime", "apple", "cherry" };
+
+  struct MemTable* tables[] = {
+    MemTable_new(MEMTABLE_DEFAULT_BUDGET),
+    MemTable_new_concurrent(MEMTABLE_DEFAULT_BUDGET),
+  };
+
+  for (int t = 0; t < 2; t++) {
+    struct MemTable* m = tables[t];
+    for (int i = 0; i < 3; i++) {
+      MemTable_set(m, keys[i], strlen(keys[i]) + 1, i);
+    }
+
+    // A key in the MemTable.
+    struct MemTableIterator iter;
+    MemTableIterator_seek(&iter, m, "cherry", 7);
+    struct MemTableRecord* r = MemTableIterator_next(&iter);
+    assert(r != NULL);
+    assert(memcmp(r->key, "cherry", 7) == 0);
+
+    // A key between two records.
+    MemTableIterator_seek(&iter, m, "banana", 7);
+    r = MemTableIterator_next(&iter);
+    assert(r != NULL);
+    assert(memcmp(r->key, "cherry", 7) == 0);
+    r = MemTableIterator_next(&iter);
+    assert(r != NULL);
+    assert(memcmp(r->key, "lime", 5) == 0);
+    assert(MemTableIterator_next(&iter) == NULL);
+
+    // Keys before the first and after the last record.
+    MemTableIterator_seek(&iter, m, "", 0);
+    r = MemTableIterator_next(&iter);
+    assert(r != NULL);
+    assert(memcmp(r->key, "apple", 6) == 0);
+    MemTableIterator_seek(&iter, m, "mango", 6);
+    assert(MemTableIterator_next(&iter) == NULL);
+
+    MemTable_free(m);
+  }
+}
+
 int
 main()
 {
@@ -247,6 +738,7 @@ main()
   // Set
   TestMemTable_set_start();
   TestMemTable_set_end();
+  TestMemTable_set_middle();
   TestMemTable_set_overwrite();
 
   // Delete
@@ -256,5 +748,32 @@ main()
   // Get
   TestMemTable_get();
 
+  // Inline Values
+  TestMemTable_set_value();
+
+  // Arena
+  TestMemTable_arena();
+
+  // Budget
+  TestMemTable_budget();
+  TestMemTable_grow();
+
+  // Prefix
+  TestMemTable_prefix();
+
+  // Hash Index
+  TestMemTable_hash_index();
+
+  // Batch
+  TestMemTable_set_batch();
+  TestMemTable_set_batch_order();
+
+  // Concurrent
+  TestMemTable_concurrent();
+
+  // Iterator
+  TestMemTable_iterator();
+  TestMemTable_iterator_seek();
+
   return 0;
 }
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/read_pool.h"
+
+#define TEST_VALUES 1000
+
+static void
+make_value(char* value, uint32_t i)
+{
+  snprintf(value, 32, "value-%08u", i);
+}
+
+void
+TestReadPool_new()
+{
+  char* filename = "read_pool.data";
+
+  struct ValueLog* log = ValueLog_new(filename, 0, 0);
+  struct ReadPool* pool = ReadPool_new(log, 4);
+
+  assert(pool != NULL);
+  assert(pool->threads_len == 4);
+  assert(pool->head == NULL);
+
+  ReadPool_free(pool);
+  ValueLog_free(log);
+
+  remove(filename);
+}
+
+void
+TestReadPool_read()
+{
+  char* filename = "read_pool.data";
+
+  struct ValueLog* log = ValueLog_new(filename, 0, 0);
+  struct ReadPool* pool = ReadPool_new(log, 4);
+
+  char key[] = "key";
+  char value[32];
+  struct ReadPoolRead reads[TEST_VALUES];
+  for (uint32_t i = 0; i < TEST_VALUES; i++) {
+    make_value(value, i);
+    assert(ValueLog_append(
+             log, &reads[i].loc, key, sizeof(key), value, strlen(value)) == 0);
+
+    // Every other read knows the length of its entry.
+    reads[i].size = i % 2 == 0 ? log->head - reads[i].loc : 0;
+    reads[i].key = key;
+    reads[i].key_len = sizeof(key);
+  }
+
+  // Every read is in flight before the first one is waited for.
+  for (uint32_t i = 0; i < TEST_VALUES; i++) {
+    ReadPool_submit(pool, &reads[i]);
+  }
+  for (uint32_t i = 0; i < TEST_VALUES; i++) {
+    ReadPool_wait(pool, &reads[i]);
+    assert(reads[i].res == 0);
+
+    make_value(value, i);
+    assert(reads[i].value_len == strlen(value));
+    assert(memcmp(reads[i].value, value, reads[i].value_len) == 0);
+    free(reads[i].value);
+  }
+
+  // A read can be submitted again once it is done.
+  ReadPool_submit(pool, &reads[0]);
+  ReadPool_wait(pool, &reads[0]);
+  assert(reads[0].res == 0);
+  free(reads[0].value);
+
+  ReadPool_free(pool);
+  ValueLog_free(log);
+
+  remove(filename);
+}
+
+int
+main()
+{
+  // New
+  TestReadPool_new();
+
+  // Read
+  TestReadPool_read();
+
+  return 0;
+}
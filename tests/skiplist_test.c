@@ -0,0 +1,195 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../src/common.h"
+#include "../src/skiplist.h"
+
+#define THREADS 8
+#define KEYS_PER_THREAD 4096
+
+void
+TestSkipList_new()
+{
+  struct Arena* arena = Arena_new(ARENA_BLOCK_SIZE);
+  struct SkipList* list = SkipList_new(arena);
+
+  assert(list != NULL);
+  assert(list->size == 0);
+  assert(SkipList_first(list) == NULL);
+
+  SkipList_free(list);
+  Arena_free(arena);
+}
+
+void
+TestSkipList_put()
+{
+  struct Arena* arena = Arena_new(ARENA_BLOCK_SIZE);
+  struct SkipList* list = SkipList_new(arena);
+
+  char* key1 = "lime";
+  char* key2 = "apple";
+  char* key3 = "cherry";
+
+  assert(SkipList_put(list, key1, strlen(key1) + 1, 0, 0, NULL) == 1);
+  assert(SkipList_put(list, key2, strlen(key2) + 1, 10, 0, NULL) == 1);
+  assert(SkipList_put(list, key3, strlen(key3) + 1, 20, 0, NULL) == 1);
+  assert(list->size == 3);
+
+  struct SkipListNode* node = SkipList_first(list);
+  assert(memcmp(node->record.key, key2, strlen(key2) + 1) == 0);
+  assert(node->record.value_loc == 10);
+
+  node = SkipList_next(node);
+  assert(memcmp(node->record.key, key3, strlen(key3) + 1) == 0);
+  assert(node->record.value_loc == 20);
+
+  node = SkipList_next(node);
+  assert(memcmp(node->record.key, key1, strlen(key1) + 1) == 0);
+  assert(node->record.value_loc == 0);
+
+  assert(SkipList_next(node) == NULL);
+
+  SkipList_free(list);
+  Arena_free(arena);
+}
+
+void
+TestSkipList_put_overwrite()
+{
+  struct Arena* arena = Arena_new(ARENA_BLOCK_SIZE);
+  struct SkipList* list = SkipList_new(arena);
+
+  char* key = "apple";
+
+  assert(SkipList_put(list, key, strlen(key) + 1, 0, 0, NULL) == 1);
+  assert(SkipList_put(list, key, strlen(key) + 1, 10, 42, NULL) == 0);
+
+  struct MemTableRecord* record = SkipList_get(list, key, strlen(key) + 1);
+  assert(record != NULL);
+  assert(record->value_loc == 10);
+  assert(record->value_size == 42);
+
+  assert(SkipList_put(list, key, strlen(key) + 1, -1, 0, NULL) == 0);
+  assert(list->size == 1);
+  assert(record->value_loc == -1);
+
+  SkipList_free(list);
+  Arena_free(arena);
+}
+
+void
+TestSkipList_get()
+{
+  struct Arena* arena = Arena_new(ARENA_BLOCK_SIZE);
+  struct SkipList* list = SkipList_new(arena);
+
+  for (uint32_t i = 0; i < 1000; i += 2) {
+    uint32_t key = __builtin_bswap32(i);
+    SkipList_put(list, (char*)&key, sizeof(key), i, 0, NULL);
+  }
+
+  for (uint32_t i = 0; i < 1000; i++) {
+    uint32_t key = __builtin_bswap32(i);
+    struct MemTableRecord* record =
+      SkipList_get(list, (char*)&key, sizeof(key));
+    if (i % 2 == 0) {
+      assert(record != NULL);
+      assert(record->value_loc == i);
+    } else {
+      assert(record == NULL);
+    }
+  }
+
+  SkipList_free(list);
+  Arena_free(arena);
+}
+
+struct ConcurrentPutArgs
+{
+  struct SkipList* list;
+  uint32_t thread;
+};
+
+static void*
+concurrent_put(void* arg)
+{
+  struct ConcurrentPutArgs* args = arg;
+
+  // Threads interleave their keys so they fight over the same splices.
+  for (uint32_t i = 0; i < KEYS_PER_THREAD; i++) {
+    uint32_t key = __builtin_bswap32(i * THREADS + args->thread);
+    SkipList_put(args->list, (char*)&key, sizeof(key), (int64_t)key, 0, NULL);
+  }
+
+  return NULL;
+}
+
+void
+TestSkipList_put_concurrent()
+{
+  struct Arena* arena = Arena_new(ARENA_BLOCK_SIZE);
+  struct SkipList* list = SkipList_new(arena);
+
+  pthread_t threads[THREADS];
+  struct ConcurrentPutArgs args[THREADS];
+  for (uint32_t i = 0; i < THREADS; i++) {
+    args[i].list = list;
+    args[i].thread = i;
+    pthread_create(&threads[i], NULL, concurrent_put, &args[i]);
+  }
+  for (int i = 0; i < THREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  assert(list->size == THREADS * KEYS_PER_THREAD);
+
+  uint32_t expected = 0;
+  for (struct SkipListNode* node = SkipList_first(list); node != NULL;
+       node = SkipList_next(node)) {
+    uint32_t key;
+    memcpy(&key, node->record.key, sizeof(key));
+    assert(__builtin_bswap32(key) == expected);
+    assert(node->record.value_loc == (int64_t)key);
+    expected++;
+  }
+  assert(expected == THREADS * KEYS_PER_THREAD);
+
+  SkipList_free(list);
+  Arena_free(arena);
+}
+
+int
+main()
+{
+  // New
+  TestSkipList_new();
+
+  // Put
+  TestSkipList_put();
+  TestSkipList_put_overwrite();
+  TestSkipList_put_concurrent();
+
+  // Get
+  TestSkipList_get();
+
+  return 0;
+}
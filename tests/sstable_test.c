@@ -21,14 +21,30 @@
 
 #include "../src/sstable.h"
 
+#define TEST_RECORDS 1024
+
+/*
+ * Offset of the i-th test record, which has a 4-byte key and a value location
+ * of i * 128.
+ */
+static uint64_t
+record_offset(size_t i)
+{
+  uint64_t offset = SSTABLE_HEADER_SIZE;
+  for (size_t j = 0; j < i; j++) {
+    offset += 1 + WiscKey_varint_len((j * 128 + 1) << 1) + 1 + 4;
+  }
+  return offset;
+}
+
 void
 TestSSTable_new_from_memtable()
 {
   char* path = "./123456789-1.sstable";
 
-  struct MemTable* memtable = MemTable_new();
+  struct MemTable* memtable = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
 
-  for (int i = 0; i < MEMTABLE_SIZE; i++) {
+  for (int i = 0; i < TEST_RECORDS; i++) {
     unsigned char bytes[4];
     bytes[0] = (i >> 24) & 0xFF;
     bytes[1] = (i >> 16) & 0xFF;
@@ -41,10 +57,11 @@ TestSSTable_new_from_memtable()
   struct SSTable* table = SSTable_new_from_memtable(path, memtable);
 
   assert(table != NULL);
-  assert(table->size == MEMTABLE_SIZE);
-  assert(table->capacity == MEMTABLE_SIZE);
+  assert(table->version == SSTABLE_VERSION);
+  assert(table->size == TEST_RECORDS);
+  assert(table->capacity == SSTABLE_MIN_SIZE);
   for (size_t i = 0; i < table->size; i++) {
-    assert(table->records[i] == i * 20);
+    assert(table->records[i] == record_offset(i));
   }
 
   assert(table->low_key_len == 4);
@@ -64,9 +81,9 @@ TestSSTable_new()
 {
   char* path = "./123456789-1.sstable";
 
-  struct MemTable* memtable = MemTable_new();
+  struct MemTable* memtable = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
 
-  for (int i = 0; i < MEMTABLE_SIZE; i++) {
+  for (int i = 0; i < TEST_RECORDS; i++) {
     unsigned char bytes[4];
     bytes[0] = (i >> 24) & 0xFF;
     bytes[1] = (i >> 16) & 0xFF;
@@ -86,10 +103,10 @@ TestSSTable_new()
   assert(new_table != NULL);
   assert(new_table->timestamp == 123456789);
   assert(new_table->level == 1);
-  assert(new_table->size == MEMTABLE_SIZE);
-  assert(new_table->capacity == MEMTABLE_SIZE);
+  assert(new_table->size == TEST_RECORDS);
+  assert(new_table->capacity == SSTABLE_MIN_SIZE);
   for (size_t i = 0; i < new_table->size; i++) {
-    assert(new_table->records[i] == i * 20);
+    assert(new_table->records[i] == record_offset(i));
   }
 
   assert(new_table->low_key_len == 4);
@@ -107,14 +124,142 @@ TestSSTable_new()
   remove(path);
 }
 
+void
+TestSSTable_new_fixed()
+{
+  char* path = "./123456789-1.sstable";
+
+  // A SSTable written in the fixed-size format by hand.
+  FILE* file = fopen(path, "w");
+  for (int i = 0; i < TEST_RECORDS; i++) {
+    unsigned char bytes[4];
+    bytes[0] = (i >> 24) & 0xFF;
+    bytes[1] = (i >> 16) & 0xFF;
+    bytes[2] = (i >> 8) & 0xFF;
+    bytes[3] = i & 0xFF;
+
+    uint64_t key_len = 4;
+    int64_t value_loc = i % 2 == 0 ? i * 128 : -1;
+    fwrite(&key_len, sizeof(uint64_t), 1, file);
+    fwrite(&value_loc, sizeof(int64_t), 1, file);
+    fwrite(bytes, sizeof(char), 4, file);
+  }
+  fclose(file);
+
+  struct SSTable* table = SSTable_new(path);
+
+  assert(table != NULL);
+  assert(table->version == SSTABLE_VERSION_FIXED);
+  assert(table->size == TEST_RECORDS);
+  for (size_t i = 0; i < table->size; i++) {
+    assert(table->records[i] == i * 20);
+  }
+
+  assert(table->low_key_len == 4);
+  assert(memcmp(table->low_key, "\x00\x00\x00\x00", table->low_key_len) == 0);
+
+  assert(table->high_key_len == 4);
+  assert(memcmp(table->high_key, "\x00\x00\x03\xff", table->high_key_len) == 0);
+
+  assert(SSTable_get_value_loc(table, "\x00\x00\x00\x02", 4) == 256);
+  assert(SSTable_get_value_loc(table, "\x00\x00\x00\x03", 4) == -1);
+
+  SSTable_free(table);
+
+  remove(path);
+}
+
+void
+TestSSTable_new_loc()
+{
+  char* path = "./123456789-1.sstable";
+
+  // A SSTable written in the format without inline values by hand.
+  FILE* file = fopen(path, "w");
+  uint32_t header[2] = { SSTABLE_MAGIC, SSTABLE_VERSION_LOC };
+  fwrite(header, sizeof(uint32_t), 2, file);
+  for (int i = 0; i < TEST_RECORDS; i++) {
+    unsigned char bytes[4];
+    bytes[0] = (i >> 24) & 0xFF;
+    bytes[1] = (i >> 16) & 0xFF;
+    bytes[2] = (i >> 8) & 0xFF;
+    bytes[3] = i & 0xFF;
+
+    char record_header[SSTABLE_RECORD_MAX_HEADER_SIZE];
+    int64_t value_loc = i % 2 == 0 ? i * 128 : -1;
+    size_t header_len = WiscKey_varint_encode(record_header, 4);
+    header_len += WiscKey_varint_encode(record_header + header_len,
+                                        (uint64_t)(value_loc + 1));
+    fwrite(record_header, sizeof(char), header_len, file);
+    fwrite(bytes, sizeof(char), 4, file);
+  }
+  fclose(file);
+
+  struct SSTable* table = SSTable_new(path);
+
+  assert(table != NULL);
+  assert(table->version == SSTABLE_VERSION_LOC);
+  assert(table->size == TEST_RECORDS);
+  assert(SSTable_get_value_loc(table, "\x00\x00\x00\x02", 4) == 256);
+  assert(SSTable_get_value_loc(table, "\x00\x00\x00\x03", 4) == -1);
+  assert(SSTable_get_value_loc(table, "\x00\x00\x03\xfe", 4) == 1022 * 128);
+
+  SSTable_free(table);
+
+  remove(path);
+}
+
+void
+TestSSTable_new_inline()
+{
+  char* path = "./123456789-1.sstable";
+
+  // A SSTable written in the format without ValueLog entry sizes by hand.
+  FILE* file = fopen(path, "w");
+  uint32_t header[2] = { SSTABLE_MAGIC, SSTABLE_VERSION_INLINE };
+  fwrite(header, sizeof(uint32_t), 2, file);
+  for (int i = 0; i < TEST_RECORDS; i++) {
+    unsigned char bytes[4];
+    bytes[0] = (i >> 24) & 0xFF;
+    bytes[1] = (i >> 16) & 0xFF;
+    bytes[2] = (i >> 8) & 0xFF;
+    bytes[3] = i & 0xFF;
+
+    char record_header[SSTABLE_RECORD_MAX_HEADER_SIZE];
+    int64_t value_loc = i % 2 == 0 ? i * 128 : -1;
+    size_t header_len = WiscKey_varint_encode(record_header, 4);
+    header_len += WiscKey_varint_encode(record_header + header_len,
+                                        (uint64_t)(value_loc + 1) << 1);
+    fwrite(record_header, sizeof(char), header_len, file);
+    fwrite(bytes, sizeof(char), 4, file);
+  }
+  fclose(file);
+
+  struct SSTable* table = SSTable_new(path);
+
+  assert(table != NULL);
+  assert(table->version == SSTABLE_VERSION_INLINE);
+  assert(table->size == TEST_RECORDS);
+  size_t value_size = 1;
+  assert(SSTable_get(table, "\x00\x00\x00\x02", 4, NULL, NULL, &value_size) ==
+         256);
+  assert(value_size == 0);
+  assert(SSTable_get_value_loc(table, "\x00\x00\x00\x03", 4) == -1);
+  assert(SSTable_get_value_loc(table, "\x00\x00\x03\xfe", 4) == 1022 * 128);
+
+  SSTable_free(table);
+
+  remove(path);
+}
+
 void
 TestSSTable_get_value_loc()
 {
   char* path = "./123456789-1.sstable";
 
-  struct MemTable* memtable = MemTable_new();
+  struct MemTable* memtable = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
 
-  for (int i = 0; i < MEMTABLE_SIZE; i++) {
+  for (int i = 0; i < TEST_RECORDS; i++) {
     unsigned char bytes[4];
     bytes[0] = (i >> 24) & 0xFF;
     bytes[1] = (i >> 16) & 0xFF;
@@ -156,14 +301,149 @@ TestSSTable_get_value_loc()
   remove(path);
 }
 
+static void
+make_key(unsigned char* key, uint32_t i)
+{
+  key[0] = (i >> 24) & 0xFF;
+  key[1] = (i >> 16) & 0xFF;
+  key[2] = (i >> 8) & 0xFF;
+  key[3] = i & 0xFF;
+}
+
+void
+TestSSTable_iterator()
+{
+  char* path = "./123456789-1.sstable";
+
+  // Every other key, so a seek can land between two of them.
+  struct MemTable* memtable = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  unsigned char key[4];
+  for (int i = 0; i < TEST_RECORDS; i += 2) {
+    make_key(key, i);
+    MemTable_set(memtable, (const char*)key, 4, i * 128);
+  }
+
+  struct SSTable* table = SSTable_new_from_memtable(path, memtable);
+  assert(table != NULL);
+  MemTable_free(memtable);
+
+  struct SSTableIterator iter;
+  struct SSTableRecord record;
+  assert(SSTableIterator_seek(&iter, table, NULL, 0) == 0);
+  for (int i = 0; i < TEST_RECORDS; i += 2) {
+    assert(SSTableIterator_next(&iter, &record) == 1);
+    make_key(key, i);
+    assert(record.key_len == 4);
+    assert(memcmp(record.key, key, 4) == 0);
+    assert(record.value_loc == i * 128);
+    free(record.key);
+  }
+  assert(SSTableIterator_next(&iter, &record) == 0);
+
+  // Seeks to a key in the table and to a key between two of them.
+  for (int i = 0; i < TEST_RECORDS - 1; i++) {
+    make_key(key, i);
+    assert(SSTableIterator_seek(&iter, table, (const char*)key, 4) == 0);
+    assert(SSTableIterator_next(&iter, &record) == 1);
+    assert(record.value_loc == (i + 1) / 2 * 2 * 128);
+    free(record.key);
+  }
+
+  // A seek past the highest key is exhausted.
+  make_key(key, TEST_RECORDS);
+  assert(SSTableIterator_seek(&iter, table, (const char*)key, 4) == 0);
+  assert(SSTableIterator_next(&iter, &record) == 0);
+
+  SSTable_free(table);
+
+  remove(path);
+}
+
+void
+TestSSTable_values()
+{
+  char* path = "./123456789-1.sstable";
+
+  // Inline values of every third key, some too long to come with the header,
+  // between keys with value locations and tombstones.
+  char long_value[3 * SSTABLE_INLINE_KEY_SIZE];
+  memset(long_value, 'v', sizeof(long_value));
+  struct MemTable* memtable = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  unsigned char key[4];
+  for (int i = 0; i < TEST_RECORDS; i++) {
+    make_key(key, i);
+    if (i % 3 == 0) {
+      MemTable_set_value(memtable, (const char*)key, 4, long_value, i % 100);
+    } else if (i % 3 == 1) {
+      MemTable_set_sized(memtable, (const char*)key, 4, i * 128, i + 20);
+    } else {
+      MemTable_delete(memtable, (const char*)key, 4);
+    }
+  }
+
+  struct SSTable* table = SSTable_new_from_memtable(path, memtable);
+  assert(table != NULL);
+  MemTable_free(memtable);
+  SSTable_free(table);
+  table = SSTable_new(path);
+  assert(table != NULL);
+  assert(table->size == TEST_RECORDS);
+
+  for (int i = 0; i < TEST_RECORDS; i++) {
+    make_key(key, i);
+    char* value = NULL;
+    size_t value_len = 0;
+    size_t value_size = 1;
+    int64_t value_loc =
+      SSTable_get(table, (char*)key, 4, &value, &value_len, &value_size);
+    assert(value_size == (i % 3 == 1 ? (size_t)i + 20 : 0));
+    if (i % 3 == 0) {
+      assert(value_loc == MEMTABLE_VALUE_INLINE);
+      assert(value_len == (size_t)(i % 100));
+      assert(memcmp(value, long_value, value_len) == 0);
+      free(value);
+      assert(SSTable_get_value_loc(table, (char*)key, 4) ==
+             MEMTABLE_VALUE_INLINE);
+    } else {
+      assert(value_loc == (i % 3 == 1 ? i * 128 : -1));
+      assert(value == NULL);
+    }
+  }
+
+  // The iterator reads the inline values.
+  struct SSTableIterator iter;
+  struct SSTableRecord record;
+  assert(SSTableIterator_seek(&iter, table, NULL, 0) == 0);
+  for (int i = 0; i < TEST_RECORDS; i++) {
+    assert(SSTableIterator_next(&iter, &record) == 1);
+    make_key(key, i);
+    assert(memcmp(record.key, key, 4) == 0);
+    if (i % 3 == 0) {
+      assert(record.value_loc == MEMTABLE_VALUE_INLINE);
+      assert(record.value_len == (size_t)(i % 100));
+      assert(memcmp(record.value, long_value, record.value_len) == 0);
+    } else {
+      assert(record.value == NULL);
+    }
+    assert(record.value_size == (i % 3 == 1 ? (size_t)i + 20 : 0));
+    free(record.key);
+    free(record.value);
+  }
+  assert(SSTableIterator_next(&iter, &record) == 0);
+
+  SSTable_free(table);
+
+  remove(path);
+}
+
 void
 TestSSTable_in_key_range()
 {
   char* path = "./123456789-1.sstable";
 
-  struct MemTable* memtable = MemTable_new();
+  struct MemTable* memtable = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
 
-  for (int i = 0; i < MEMTABLE_SIZE; i++) {
+  for (int i = 0; i < TEST_RECORDS; i++) {
     unsigned char bytes[4];
     bytes[0] = (i >> 24) & 0xFF;
     bytes[1] = (i >> 16) & 0xFF;
@@ -211,10 +491,19 @@ main()
   // New
   TestSSTable_new_from_memtable();
   TestSSTable_new();
+  TestSSTable_new_fixed();
+  TestSSTable_new_loc();
+  TestSSTable_new_inline();
 
   // Get Value Loc
   TestSSTable_get_value_loc();
 
+  // Iterator
+  TestSSTable_iterator();
+
+  // Inline Values
+  TestSSTable_values();
+
   // In Key Range
   TestSSTable_in_key_range();
 
@@ -0,0 +1,196 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/value_cache.h"
+
+#define TEST_VALUES 1000
+#define TEST_VALUE_SIZE 100
+
+/*
+ * Capacity for `n` values of TEST_VALUE_SIZE bytes in every shard.
+ */
+static size_t
+capacity_for(size_t n)
+{
+  return VALUE_CACHE_SHARDS * n *
+         (sizeof(struct ValueCacheEntry) + TEST_VALUE_SIZE);
+}
+
+static void
+make_value(char* value, uint64_t loc)
+{
+  memset(value, 0, TEST_VALUE_SIZE);
+  snprintf(value, TEST_VALUE_SIZE, "value-%lu", loc);
+}
+
+void
+TestValueCache_new()
+{
+  struct ValueCache* cache = ValueCache_new(capacity_for(1));
+
+  assert(cache != NULL);
+  for (size_t i = 0; i < VALUE_CACHE_SHARDS; i++) {
+    assert(cache->shards[i].len == 0);
+    assert(cache->shards[i].buckets_len == VALUE_CACHE_MIN_BUCKETS);
+  }
+
+  size_t value_len;
+  assert(ValueCache_get(cache, 16, NULL, 0, &value_len) == 0);
+
+  struct ValueCacheStats stats;
+  ValueCache_stats(cache, &stats);
+  assert(stats.hits == 0);
+  assert(stats.misses == 1);
+  assert(stats.len == 0);
+
+  ValueCache_free(cache);
+}
+
+void
+TestValueCache_put_get()
+{
+  struct ValueCache* cache = ValueCache_new(capacity_for(TEST_VALUES));
+
+  char value[TEST_VALUE_SIZE];
+  for (uint64_t loc = 0; loc < TEST_VALUES; loc++) {
+    make_value(value, loc);
+    ValueCache_put(cache, loc, value, sizeof(value));
+  }
+
+  // Every value fits, no matter how the locations fall on the shards.
+  char buf[TEST_VALUE_SIZE];
+  size_t value_len;
+  for (uint64_t loc = 0; loc < TEST_VALUES; loc++) {
+    make_value(value, loc);
+    assert(ValueCache_get(cache, loc, buf, sizeof(buf), &value_len) == 1);
+    assert(value_len == sizeof(value));
+    assert(memcmp(buf, value, value_len) == 0);
+  }
+
+  // A buffer that is too small only gets the length.
+  memset(buf, 0, sizeof(buf));
+  assert(ValueCache_get(cache, 0, buf, sizeof(buf) - 1, &value_len) == 1);
+  assert(value_len == sizeof(value));
+  assert(buf[0] == 0);
+
+  // A value that is already cached isn't replaced.
+  ValueCache_put(cache, 0, "other", 6);
+  assert(ValueCache_get(cache, 0, buf, sizeof(buf), &value_len) == 1);
+  assert(value_len == sizeof(value));
+
+  struct ValueCacheStats stats;
+  ValueCache_stats(cache, &stats);
+  assert(stats.hits == TEST_VALUES + 2);
+  assert(stats.misses == 0);
+  assert(stats.evictions == 0);
+  assert(stats.len == TEST_VALUES);
+  assert(stats.size ==
+         TEST_VALUES * (sizeof(struct ValueCacheEntry) + TEST_VALUE_SIZE));
+
+  ValueCache_free(cache);
+}
+
+void
+TestValueCache_evict()
+{
+  struct ValueCache* cache = ValueCache_new(capacity_for(4));
+
+  char value[TEST_VALUE_SIZE];
+  for (uint64_t loc = 0; loc < TEST_VALUES; loc++) {
+    make_value(value, loc);
+    ValueCache_put(cache, loc, value, sizeof(value));
+
+    // The first location is read after every put, so the clock hand always
+    // finds it referenced.
+    size_t value_len;
+    assert(ValueCache_get(cache, 0, NULL, 0, &value_len) == 1);
+  }
+
+  struct ValueCacheStats stats;
+  ValueCache_stats(cache, &stats);
+  assert(stats.len <= 4 * VALUE_CACHE_SHARDS);
+  assert(stats.size <= capacity_for(4));
+  assert(stats.evictions == TEST_VALUES - stats.len);
+
+  // A value larger than a shard isn't cached.
+  char large[capacity_for(4) / VALUE_CACHE_SHARDS];
+  memset(large, 'l', sizeof(large));
+  ValueCache_put(cache, TEST_VALUES, large, sizeof(large));
+  size_t value_len;
+  assert(ValueCache_get(cache, TEST_VALUES, NULL, 0, &value_len) == 0);
+
+  ValueCache_free(cache);
+}
+
+void
+TestValueCache_erase()
+{
+  struct ValueCache* cache = ValueCache_new(capacity_for(TEST_VALUES));
+
+  char value[TEST_VALUE_SIZE];
+  for (uint64_t loc = 0; loc < TEST_VALUES; loc++) {
+    make_value(value, loc);
+    ValueCache_put(cache, loc, value, sizeof(value));
+  }
+  for (uint64_t loc = 0; loc < TEST_VALUES; loc += 2) {
+    ValueCache_erase(cache, loc);
+  }
+  ValueCache_erase(cache, TEST_VALUES);
+
+  size_t value_len;
+  for (uint64_t loc = 0; loc < TEST_VALUES; loc++) {
+    assert(ValueCache_get(cache, loc, NULL, 0, &value_len) == (int)(loc % 2));
+  }
+
+  struct ValueCacheStats stats;
+  ValueCache_stats(cache, &stats);
+  assert(stats.len == TEST_VALUES / 2);
+  assert(stats.evictions == 0);
+
+  // The clock keeps working after entries are erased from under the hand.
+  for (uint64_t loc = TEST_VALUES; loc < 20 * TEST_VALUES; loc++) {
+    make_value(value, loc);
+    ValueCache_put(cache, loc, value, sizeof(value));
+  }
+  ValueCache_stats(cache, &stats);
+  assert(stats.evictions > 0);
+  assert(stats.size <= capacity_for(TEST_VALUES));
+
+  ValueCache_free(cache);
+}
+
+int
+main()
+{
+  // New
+  TestValueCache_new();
+
+  // Put, Get
+  TestValueCache_put_get();
+
+  // Evict
+  TestValueCache_evict();
+
+  // Erase
+  TestValueCache_erase();
+
+  return 0;
+}
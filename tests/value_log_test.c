@@ -15,11 +15,16 @@
  */
 
 #include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "../src/codec.h"
 #include "../src/value_log.h"
 
 void
@@ -30,7 +35,8 @@ TestValueLog_new()
   struct ValueLog* log = ValueLog_new(filename, 0, 128);
 
   assert(log != NULL);
-  assert(log->head == 0);
+  assert(log->version == VALUE_LOG_VERSION);
+  assert(log->head == VALUE_LOG_HEADER_SIZE);
   assert(log->tail == 128);
 
   ValueLog_free(log);
@@ -38,6 +44,26 @@ TestValueLog_new()
   remove(filename);
 }
 
+static void
+check_entry(FILE* file, const char* key, const char* value)
+{
+  size_t key_len = strlen(key) + 1;
+  size_t value_len = strlen(value) + 1;
+
+  char header[VALUE_LOG_ENTRY_MAX_HEADER_SIZE];
+  size_t header_len = WiscKey_varint_encode(header, key_len);
+  header_len += WiscKey_varint_encode(header + header_len, value_len + 1);
+  header[header_len++] = CODEC_NONE;
+
+  char entry[header_len + key_len + value_len];
+  size_t file_res = fread(entry, sizeof(char), sizeof(entry), file);
+  assert(file_res == sizeof(entry));
+
+  assert(memcmp(entry, header, header_len) == 0);
+  assert(memcmp(entry + header_len, key, key_len) == 0);
+  assert(memcmp(entry + header_len + key_len, value, value_len) == 0);
+}
+
 void
 TestValueLog_append()
 {
@@ -57,30 +83,18 @@ TestValueLog_append()
   res = ValueLog_sync(log);
 
   assert(res == 0);
-  assert(pos == 0);
+  assert(pos == VALUE_LOG_HEADER_SIZE);
 
   FILE* file = fopen(filename, "r");
 
-  {
-    uint64_t value_log_key_len;
-    uint64_t value_log_value_len;
-    char value_log_key[strlen(key1) + 1];
-    char value_log_value[strlen(value1) + 1];
-
-    size_t file_res = fread(&value_log_key_len, sizeof(uint64_t), 1, file);
-    assert(file_res == 1);
-    file_res = fread(&value_log_value_len, sizeof(uint64_t), 1, file);
-    assert(file_res == 1);
-    file_res = fread(&value_log_key, sizeof(char), strlen(key1) + 1, file);
-    assert(file_res == strlen(key1) + 1);
-    file_res = fread(&value_log_value, sizeof(char), strlen(value1) + 1, file);
-    assert(file_res == strlen(value1) + 1);
-
-    assert(value_log_key_len == strlen(key1) + 1);
-    assert(value_log_value_len == strlen(value1) + 1);
-    assert(memcmp(value_log_key, key1, strlen(key1) + 1) == 0);
-    assert(memcmp(value_log_value, value1, strlen(value1) + 1) == 0);
-  }
+  uint32_t header[2];
+  size_t file_res = fread(header, sizeof(uint32_t), 2, file);
+  assert(file_res == 2);
+  assert(header[0] == VALUE_LOG_MAGIC);
+  assert(header[1] == VALUE_LOG_VERSION);
+
+  fseek(file, VALUE_LOG_HEADER_SIZE, SEEK_SET);
+  check_entry(file, key1, value1);
 
   char* key2 = "lime";
   char* value2 = "Key Lime Pie";
@@ -92,51 +106,11 @@ TestValueLog_append()
   res = ValueLog_sync(log);
 
   assert(res == 0);
-  assert(pos == 32);
-
-  fseek(file, 0, SEEK_SET);
-
-  {
-    uint64_t value_log_key_len;
-    uint64_t value_log_value_len;
-    char value_log_key[strlen(key1) + 1];
-    char value_log_value[strlen(value1) + 1];
-
-    size_t file_res = fread(&value_log_key_len, sizeof(uint64_t), 1, file);
-    assert(file_res == 1);
-    file_res = fread(&value_log_value_len, sizeof(uint64_t), 1, file);
-    assert(file_res == 1);
-    file_res = fread(&value_log_key, sizeof(char), strlen(key1) + 1, file);
-    assert(file_res == strlen(key1) + 1);
-    file_res = fread(&value_log_value, sizeof(char), strlen(value1) + 1, file);
-    assert(file_res == strlen(value1) + 1);
-
-    assert(value_log_key_len == strlen(key1) + 1);
-    assert(value_log_value_len == strlen(value1) + 1);
-    assert(memcmp(value_log_key, key1, strlen(key1) + 1) == 0);
-    assert(memcmp(value_log_value, value1, strlen(value1) + 1) == 0);
-  }
+  assert(pos == VALUE_LOG_HEADER_SIZE + 3 + 6 + 10);
 
-  {
-    uint64_t value_log_key_len;
-    uint64_t value_log_value_len;
-    char value_log_key[strlen(key2) + 1];
-    char value_log_value[strlen(value2) + 1];
-
-    size_t file_res = fread(&value_log_key_len, sizeof(uint64_t), 1, file);
-    assert(file_res == 1);
-    file_res = fread(&value_log_value_len, sizeof(uint64_t), 1, file);
-    assert(file_res == 1);
-    file_res = fread(&value_log_key, sizeof(char), strlen(key2) + 1, file);
-    assert(file_res == strlen(key2) + 1);
-    file_res = fread(&value_log_value, sizeof(char), strlen(value2) + 1, file);
-    assert(file_res == strlen(value2) + 1);
-
-    assert(value_log_key_len == strlen(key2) + 1);
-    assert(value_log_value_len == strlen(value2) + 1);
-    assert(memcmp(value_log_key, key2, strlen(key2) + 1) == 0);
-    assert(memcmp(value_log_value, value2, strlen(value2) + 1) == 0);
-  }
+  fseek(file, VALUE_LOG_HEADER_SIZE, SEEK_SET);
+  check_entry(file, key1, value1);
+  check_entry(file, key2, value2);
 
   fclose(file);
 
@@ -145,6 +119,121 @@ TestValueLog_append()
   remove(filename);
 }
 
+void
+TestValueLog_fixed()
+{
+  char* filename = "value_log.data";
+
+  // A ValueLog written in the fixed-size format by hand.
+  FILE* file = fopen(filename, "w");
+  uint64_t lens[2] = { 6, 10 };
+  fwrite(lens, sizeof(uint64_t), 2, file);
+  fwrite("apple", sizeof(char), 6, file);
+  fwrite("Apple Pie", sizeof(char), 10, file);
+  fclose(file);
+
+  struct ValueLog* log = ValueLog_new(filename, 32, 0);
+  assert(log != NULL);
+  assert(log->version == VALUE_LOG_VERSION_FIXED);
+  assert(log->tail == 0);
+
+  // New entries keep the format of the file.
+  size_t pos1, pos2;
+  assert(ValueLog_append(log, &pos1, "lime", 5, "Key Lime Pie", 13) == 0);
+  assert(ValueLog_append_tombstone(log, &pos2, "apple", 6) == 0);
+  assert(pos1 == 32);
+  assert(pos2 == 32 + VALUE_LOG_ENTRY_HEADER_SIZE + 5 + 13);
+  assert(ValueLog_sync(log) == 0);
+
+  char* value;
+  size_t value_len;
+  assert(ValueLog_get(log, &value, &value_len, 0) == 0);
+  assert(value_len == 10);
+  assert(memcmp(value, "Apple Pie", value_len) == 0);
+  free(value);
+  assert(ValueLog_get(log, &value, &value_len, pos1) == 0);
+  assert(value_len == 13);
+  assert(memcmp(value, "Key Lime Pie", value_len) == 0);
+  free(value);
+
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  size_t pos = 0;
+  assert(ValueLog_load_memtable(log, &pos, m) == 0);
+  assert(pos == log->head);
+  assert(m->size == 2);
+  assert(MemTable_get(m, "apple", 6)->value_loc == -1);
+  assert(MemTable_get(m, "lime", 5)->value_loc == (int64_t)pos1);
+  MemTable_free(m);
+
+  ValueLog_free(log);
+
+  remove(filename);
+}
+
+/*
+ * Writes a file header of the given version with an entry that has no codec
+ * byte.
+ */
+static void
+write_varint_file(FILE* file)
+{
+  uint32_t header[2] = { VALUE_LOG_MAGIC, VALUE_LOG_VERSION_VARINT };
+  uint64_t tail = 0;
+  fwrite(header, sizeof(uint32_t), 2, file);
+  fwrite(&tail, sizeof(uint64_t), 1, file);
+  char entry_header[2] = { 6, 11 };
+  fwrite(entry_header, sizeof(char), 2, file);
+  fwrite("apple", sizeof(char), 6, file);
+  fwrite("Apple Pie", sizeof(char), 10, file);
+}
+
+void
+TestValueLog_varint()
+{
+  char* filename = "value_log.data";
+
+  FILE* file = fopen(filename, "w");
+  write_varint_file(file);
+  fclose(file);
+
+  size_t first = VALUE_LOG_HEADER_SIZE;
+  struct ValueLog* log = ValueLog_new(filename, first + 2 + 6 + 10, 0);
+  assert(log != NULL);
+  assert(log->version == VALUE_LOG_VERSION_VARINT);
+
+  // New entries keep the format of the file and aren't compressed.
+  ValueLog_set_compression(log, CODEC_LZ, 0, 1);
+  char value[256];
+  memset(value, 'v', sizeof(value));
+  size_t pos1, pos2;
+  assert(ValueLog_append(log, &pos1, "lime", 5, value, sizeof(value)) == 0);
+  assert(ValueLog_append_tombstone(log, &pos2, "apple", 6) == 0);
+  assert(pos2 == pos1 + 3 + 5 + sizeof(value));
+
+  char* read;
+  size_t read_len;
+  assert(ValueLog_get(log, &read, &read_len, first) == 0);
+  assert(read_len == 10);
+  assert(memcmp(read, "Apple Pie", read_len) == 0);
+  free(read);
+  assert(ValueLog_get(log, &read, &read_len, pos1) == 0);
+  assert(read_len == sizeof(value));
+  assert(memcmp(read, value, read_len) == 0);
+  free(read);
+
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  size_t pos = 0;
+  assert(ValueLog_load_memtable(log, &pos, m) == 0);
+  assert(pos == log->head);
+  assert(MemTable_get(m, "apple", 6)->value_loc == -1);
+  assert(MemTable_get(m, "lime", 5)->value_loc == (int64_t)pos1);
+  MemTable_free(m);
+
+  ValueLog_free(log);
+
+  remove(filename);
+}
+
 void
 TestValueLog_get()
 {
@@ -213,6 +302,172 @@ TestValueLog_get()
   remove(filename);
 }
 
+void
+TestValueLog_read()
+{
+  char* filename = "value_log.data";
+
+  struct ValueLog* log = ValueLog_new(filename, 0, 0);
+
+  size_t pos1, pos2;
+  assert(ValueLog_append(log, &pos1, "apple", 6, "Apple Pie", 10) == 0);
+  assert(ValueLog_append(log, &pos2, "lime", 5, "Key Lime Pie", 13) == 0);
+
+  // The length is queried without a buffer.
+  size_t value_len;
+  assert(ValueLog_read(log, NULL, 0, &value_len, pos1) == 0);
+  assert(value_len == 10);
+
+  char buf[16];
+  assert(ValueLog_read(log, buf, sizeof(buf), &value_len, pos1) == 0);
+  assert(value_len == 10);
+  assert(memcmp(buf, "Apple Pie", 10) == 0);
+
+  // A buffer that is too small is left alone.
+  memset(buf, 0, sizeof(buf));
+  assert(ValueLog_read(log, buf, 12, &value_len, pos2) == 0);
+  assert(value_len == 13);
+  assert(buf[0] == 0);
+  assert(ValueLog_read(log, buf, 13, &value_len, pos2) == 0);
+  assert(memcmp(buf, "Key Lime Pie", 13) == 0);
+
+  size_t pos3;
+  assert(ValueLog_append_tombstone(log, &pos3, "apple", 6) == 0);
+  assert(ValueLog_read(log, buf, sizeof(buf), &value_len, pos3) == -1);
+
+  ValueLog_free(log);
+
+  remove(filename);
+}
+
+void
+TestValueLog_get_sized()
+{
+  char* filename = "value_log.data";
+
+  struct ValueLog* log = ValueLog_new(filename, 0, 0);
+
+  size_t pos1, pos2;
+  assert(ValueLog_append(log, &pos1, "apple", 6, "Apple Pie", 10) == 0);
+  assert(ValueLog_append(log, &pos2, "lime", 5, "Key Lime Pie", 13) == 0);
+  size_t size1 = pos2 - pos1;
+  size_t size2 = log->head - pos2;
+
+  char* value;
+  size_t value_len;
+  assert(ValueLog_get_sized(
+           log, &value, &value_len, pos1, size1, "apple", 6) == 0);
+  assert(value_len == 10);
+  assert(memcmp(value, "Apple Pie", 10) == 0);
+  free(value);
+
+  char buf[64];
+  assert(ValueLog_read_sized(
+           log, buf, sizeof(buf), &value_len, pos2, size2, "lime", 5) == 0);
+  assert(value_len == 13);
+  assert(memcmp(buf, "Key Lime Pie", 13) == 0);
+
+  // A buffer that holds the value but not the entry, and one that holds
+  // neither.
+  memset(buf, 0, sizeof(buf));
+  assert(ValueLog_read_sized(log, buf, 13, &value_len, pos2, size2, NULL, 0) ==
+         0);
+  assert(memcmp(buf, "Key Lime Pie", 13) == 0);
+  memset(buf, 0, sizeof(buf));
+  assert(ValueLog_read_sized(log, buf, 12, &value_len, pos2, size2, NULL, 0) ==
+         0);
+  assert(value_len == 13);
+  assert(buf[0] == 0);
+
+  // A stale size falls back to reading the header.
+  assert(ValueLog_get_sized(
+           log, &value, &value_len, pos1, size1 + 3, "apple", 6) == 0);
+  assert(memcmp(value, "Apple Pie", 10) == 0);
+  free(value);
+  assert(ValueLog_read_sized(
+           log, buf, sizeof(buf), &value_len, pos2, size2 + 100, "lime", 5) ==
+         0);
+  assert(memcmp(buf, "Key Lime Pie", 13) == 0);
+
+  // An entry of another key isn't taken for the value, with or without the
+  // size.
+  assert(ValueLog_get_sized(
+           log, &value, &value_len, pos1, size1, "lime", 5) == -1);
+  assert(ValueLog_get_sized(log, &value, &value_len, pos1, 0, "apply", 6) ==
+         -1);
+  assert(ValueLog_read_sized(
+           log, buf, sizeof(buf), &value_len, pos2, size2, "lim", 4) == -1);
+
+  // A compressed value is decompressed from the entry.
+  ValueLog_set_compression(log, CODEC_LZ, 0, 1);
+  char large[1024];
+  memset(large, 'z', sizeof(large));
+  size_t pos3;
+  assert(ValueLog_append(log, &pos3, "large", 6, large, sizeof(large)) == 0);
+  size_t size3 = log->head - pos3;
+  assert(size3 < sizeof(large) / 4);
+  char read[sizeof(large)];
+  assert(ValueLog_read_sized(
+           log, read, sizeof(read), &value_len, pos3, size3, "large", 6) == 0);
+  assert(value_len == sizeof(large));
+  assert(memcmp(read, large, sizeof(large)) == 0);
+  assert(ValueLog_get_sized(
+           log, &value, &value_len, pos3, size3, "large", 6) == 0);
+  assert(memcmp(value, large, sizeof(large)) == 0);
+  free(value);
+
+  ValueLog_free(log);
+
+  remove(filename);
+}
+
+void
+TestValueLog_slice()
+{
+  char* filename = "value_log.data";
+
+  struct ValueLog* log = ValueLog_new(filename, 0, 0);
+
+  size_t pos1, pos2;
+  assert(ValueLog_append(log, &pos1, "apple", 6, "Apple Pie", 10) == 0);
+
+  struct ValueLogSlice slice1;
+  assert(ValueLog_get_slice(log, &slice1, pos1) == 0);
+  assert(slice1.len == 10);
+  assert(memcmp(slice1.data, "Apple Pie", 10) == 0);
+  assert(log->pins == 1);
+
+  // An entry past the mapping maps the file again, and the old mapping stays
+  // alive for the slice that pins it.
+  assert(ValueLog_append(log, &pos2, "lime", 5, "Key Lime Pie", 13) == 0);
+  struct ValueLogSlice slice2;
+  assert(ValueLog_get_slice(log, &slice2, pos2) == 0);
+  assert(slice2.len == 13);
+  assert(memcmp(slice2.data, "Key Lime Pie", 13) == 0);
+  assert(slice1.map != slice2.map);
+  assert(memcmp(slice1.data, "Apple Pie", 10) == 0);
+
+  // The hole is punched once the last slice is released.
+  assert(ValueLog_set_tail(log, pos2) == 0);
+  assert(log->tail == pos2);
+  assert(log->punched < pos2);
+  assert(memcmp(slice1.data, "Apple Pie", 10) == 0);
+  ValueLog_release_slice(log, &slice1);
+  assert(log->punched < pos2);
+  ValueLog_release_slice(log, &slice2);
+  assert(log->pins == 0);
+  assert(log->punched == pos2);
+
+  size_t pos3;
+  assert(ValueLog_append_tombstone(log, &pos3, "lime", 5) == 0);
+  assert(ValueLog_get_slice(log, &slice1, pos3) == -1);
+  assert(log->pins == 0);
+
+  ValueLog_free(log);
+
+  remove(filename);
+}
+
 void
 TestValueLog_reload()
 {
@@ -287,6 +542,817 @@ TestValueLog_reload()
   remove(filename);
 }
 
+void
+TestValueLog_load_memtable()
+{
+  char* filename = "value_log.data";
+
+  struct ValueLog* log = ValueLog_new(filename, 0, 0);
+
+  size_t pos1, pos2, pos3, pos4;
+  assert(ValueLog_append(log, &pos1, "apple", 6, "Apple Pie", 10) == 0);
+  assert(ValueLog_append(log, &pos2, "lime", 5, "Key Lime Pie", 13) == 0);
+  assert(ValueLog_append_tombstone(log, &pos3, "apple", 6) == 0);
+  assert(ValueLog_append(log, &pos4, "cherry", 7, "Cherry Pie", 11) == 0);
+  assert(ValueLog_sync(log) == 0);
+
+  // Tombstones delete their key and can't be fetched.
+  char* value;
+  size_t value_len;
+  assert(ValueLog_get(log, &value, &value_len, pos3) == -1);
+
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  size_t pos = 0;
+  assert(ValueLog_load_memtable(log, &pos, m) == 0);
+  assert(pos == log->head);
+  assert(m->size == 3);
+  assert(MemTable_get(m, "apple", 6)->value_loc == -1);
+  assert(MemTable_get(m, "lime", 5)->value_loc == (int64_t)pos2);
+  assert(MemTable_get(m, "cherry", 7)->value_loc == (int64_t)pos4);
+  MemTable_free(m);
+
+  // The replay can start at any entry.
+  m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  pos = pos3;
+  assert(ValueLog_load_memtable(log, &pos, m) == 0);
+  assert(m->size == 2);
+  assert(MemTable_get(m, "lime", 5) == NULL);
+  MemTable_free(m);
+
+  // An entry torn by a crash is dropped and overwritten by the next append.
+  size_t head = log->head;
+  ValueLog_free(log);
+  assert(truncate(filename, (off_t)head - 4) == 0);
+  log = ValueLog_new(filename, head - 4, 0);
+
+  m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  pos = 0;
+  assert(ValueLog_load_memtable(log, &pos, m) == 0);
+  assert(pos == pos4);
+  assert(log->head == pos4);
+  assert(m->size == 2);
+  assert(MemTable_get(m, "cherry", 7) == NULL);
+  MemTable_free(m);
+
+  size_t pos5;
+  assert(ValueLog_append(log, &pos5, "peach", 6, "Peach Pie", 10) == 0);
+  assert(pos5 == pos4);
+
+  ValueLog_free(log);
+
+  remove(filename);
+}
+
+void
+TestValueLog_load_memtable_budget()
+{
+  char* filename = "value_log.data";
+
+  struct ValueLog* log = ValueLog_new(filename, 0, 0);
+
+  char key[16];
+  uint32_t entries = 4 * VALUE_LOG_REPLAY_BATCH;
+  for (uint32_t i = 0; i < entries; i++) {
+    size_t pos;
+    snprintf(key, sizeof(key), "key-%08u", i);
+    assert(ValueLog_append(log, &pos, key, strlen(key), "value", 5) == 0);
+  }
+
+  // A full MemTable ends the replay early, the next one picks up from there.
+  size_t pos = 0;
+  size_t replayed = 0;
+  size_t memtables = 0;
+  while (pos < log->head) {
+    struct MemTable* m = MemTable_new(64 * 1024);
+    assert(ValueLog_load_memtable(log, &pos, m) == 0);
+    replayed += m->size;
+    memtables++;
+    MemTable_free(m);
+  }
+  assert(replayed == entries);
+  assert(memtables > 1);
+
+  ValueLog_free(log);
+
+  remove(filename);
+}
+
+void
+TestValueLog_set_tail()
+{
+  char* filename = "value_log.data";
+
+  struct ValueLog* log = ValueLog_new(filename, 0, 0);
+
+  size_t pos1, pos2, pos3;
+  assert(ValueLog_append(log, &pos1, "apple", 6, "Apple Pie", 10) == 0);
+  assert(ValueLog_append_tombstone(log, &pos2, "apple", 6) == 0);
+  assert(ValueLog_append(log, &pos3, "lime", 5, "Key Lime Pie", 13) == 0);
+
+  struct ValueLogEntry entry;
+  assert(ValueLog_read_entry(log, pos1, &entry) == 0);
+  assert(entry.key_len == 6);
+  assert(memcmp(entry.key, "apple", 6) == 0);
+  assert(entry.value_len == 10);
+  assert(memcmp(entry.value, "Apple Pie", 10) == 0);
+  assert(!entry.tombstone);
+  assert(pos1 + entry.len == pos2);
+  free(entry.key);
+
+  assert(ValueLog_read_entry(log, pos2, &entry) == 0);
+  assert(entry.key_len == 6);
+  assert(entry.value_len == 0);
+  assert(entry.tombstone);
+  assert(pos2 + entry.len == pos3);
+  free(entry.key);
+
+  // The tail is kept in the header across a reopen.
+  assert(ValueLog_set_tail(log, pos3) == 0);
+  assert(log->tail == pos3);
+  assert(ValueLog_set_tail(log, pos1) == 0);
+  assert(log->tail == pos3);
+  size_t head = log->head;
+  ValueLog_free(log);
+
+  log = ValueLog_new(filename, head, 0);
+  assert(log->tail == pos3);
+
+  char* value;
+  size_t value_len;
+  assert(ValueLog_get(log, &value, &value_len, pos3) == 0);
+  assert(memcmp(value, "Key Lime Pie", value_len) == 0);
+  free(value);
+
+  // The replay starts at the tail.
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  size_t pos = log->tail;
+  assert(ValueLog_load_memtable(log, &pos, m) == 0);
+  assert(m->size == 1);
+  MemTable_free(m);
+  ValueLog_free(log);
+
+  // The fixed-size format has nowhere to keep the tail.
+  FILE* file = fopen(filename, "w");
+  uint64_t lens[2] = { 6, 10 };
+  fwrite(lens, sizeof(uint64_t), 2, file);
+  fwrite("apple", sizeof(char), 6, file);
+  fwrite("Apple Pie", sizeof(char), 10, file);
+  fclose(file);
+
+  log = ValueLog_new(filename, 32, 0);
+  assert(ValueLog_set_tail(log, 32) == -1);
+  ValueLog_free(log);
+
+  remove(filename);
+}
+
+static void
+remove_segments(const char* dir)
+{
+  for (unsigned long id = 0; id < 64; id++) {
+    char path[64];
+    snprintf(path, sizeof(path), "%s/%lu" VALUE_LOG_SEGMENT_SUFFIX, dir, id);
+    remove(path);
+  }
+  rmdir(dir);
+}
+
+void
+TestValueLog_segments()
+{
+  char* dir = "value_log_segments.data";
+  remove_segments(dir);
+  assert(mkdir(dir, 0755) == 0);
+
+  struct ValueLog* log = ValueLog_new_segmented(dir, 256);
+  assert(log != NULL);
+  assert(log->head == VALUE_LOG_HEADER_SIZE);
+
+  // Entries that don't fit in a segment start the next one.
+  char key[16];
+  char value[64];
+  size_t pos[32];
+  for (int i = 0; i < 32; i++) {
+    snprintf(key, sizeof(key), "key-%02d", i);
+    memset(value, 'a' + i % 26, sizeof(value));
+    assert(ValueLog_append(log, &pos[i], key, 7, value, sizeof(value)) == 0);
+  }
+  assert(pos[0] == VALUE_LOG_HEADER_SIZE);
+  assert(pos[31] >> VALUE_LOG_SEGMENT_SHIFT > 5);
+  for (int i = 1; i < 32; i++) {
+    assert(pos[i] > pos[i - 1]);
+    assert((pos[i] & VALUE_LOG_SEGMENT_MASK) + 7 + sizeof(value) < 256);
+  }
+
+  // An entry larger than a segment gets one of its own.
+  char large[1024];
+  memset(large, 'z', sizeof(large));
+  size_t large_pos;
+  assert(ValueLog_append(log, &large_pos, "large", 6, large, sizeof(large)) ==
+         0);
+  assert((large_pos & VALUE_LOG_SEGMENT_MASK) == VALUE_LOG_HEADER_SIZE);
+
+  char* read;
+  size_t read_len;
+  for (int i = 0; i < 32; i++) {
+    memset(value, 'a' + i % 26, sizeof(value));
+    assert(ValueLog_get(log, &read, &read_len, pos[i]) == 0);
+    assert(read_len == sizeof(value));
+    assert(memcmp(read, value, read_len) == 0);
+    free(read);
+  }
+  struct ValueLogSlice slice;
+  assert(ValueLog_get_slice(log, &slice, large_pos) == 0);
+  assert(slice.len == sizeof(large));
+  assert(memcmp(slice.data, large, slice.len) == 0);
+
+  // Only sealed segments with garbage are listed, the most garbage first. A
+  // discard reads the length of the entry unless it is given.
+  ValueLog_discard(log, pos[0], 0);
+  ValueLog_discard(log, pos[1], pos[1] - pos[0]);
+  ValueLog_discard(log, pos[31], 0);
+  ValueLog_discard(log, large_pos, 0);
+  struct ValueLogSegmentStats* segments;
+  size_t segments_len =
+    ValueLog_garbage_segments(log, log->head, 0, &segments);
+  assert(segments_len == 2);
+  assert(segments[0].id == 0);
+  assert(segments[0].start == VALUE_LOG_HEADER_SIZE);
+  size_t entry_len = pos[1] - pos[0];
+  assert(segments[0].end == pos[2] + entry_len);
+  assert(segments[0].garbage == 2 * entry_len);
+  assert(segments[1].id == pos[31] >> VALUE_LOG_SEGMENT_SHIFT);
+  free(segments);
+  segments_len = ValueLog_garbage_segments(log, pos[3], 0, &segments);
+  assert(segments_len == 1);
+  free(segments);
+
+  // Segments with less than the share of garbage are left out.
+  segments_len = ValueLog_garbage_segments(log, log->head, 0.5, &segments);
+  assert(segments_len == 1);
+  assert(segments[0].id == 0);
+  free(segments);
+
+  // The listing stores the garbage in the header, where a crash can't lose it.
+  char path[64];
+  snprintf(path, sizeof(path), "%s/0" VALUE_LOG_SEGMENT_SUFFIX, dir);
+  int fd = open(path, O_RDONLY);
+  assert(fd != -1);
+  uint64_t stored;
+  assert(pread(fd, &stored, sizeof(stored), 2 * sizeof(uint32_t)) ==
+         sizeof(stored));
+  assert(stored == 2 * entry_len);
+  close(fd);
+
+  // A removed segment can't be read, but the slices pinned in it stay valid.
+  size_t size = ValueLog_size(log);
+  struct ValueLogSlice pinned;
+  assert(ValueLog_get_slice(log, &pinned, pos[0]) == 0);
+  assert(ValueLog_remove_segment(log, 0) == 0);
+  assert(ValueLog_size(log) == size - VALUE_LOG_HEADER_SIZE - 3 * entry_len);
+  assert(ValueLog_get(log, &read, &read_len, pos[0]) == -1);
+  assert(pinned.data[0] == 'a');
+  ValueLog_release_slice(log, &pinned);
+  ValueLog_release_slice(log, &slice);
+  assert(ValueLog_remove_segment(log, large_pos >> VALUE_LOG_SEGMENT_SHIFT) ==
+         -1);
+
+  size_t head = log->head;
+  ValueLog_free(log);
+
+  // The segments and their garbage survive a reopen.
+  log = ValueLog_new_segmented(dir, 256);
+  assert(log->head == head);
+  assert(ValueLog_get(log, &read, &read_len, pos[4]) == 0);
+  free(read);
+  segments_len = ValueLog_garbage_segments(log, log->head, 0, &segments);
+  assert(segments_len == 1);
+  assert(segments[0].id == pos[31] >> VALUE_LOG_SEGMENT_SHIFT);
+  free(segments);
+
+  // The replay skips the removed segment and moves on between segments.
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  size_t replay = 0;
+  assert(ValueLog_load_memtable(log, &replay, m) == 0);
+  assert(replay == head);
+  assert(m->size == 30);
+  assert(MemTable_get(m, "key-00", 7) == NULL);
+  assert(MemTable_get(m, "key-05", 7)->value_loc == (int64_t)pos[5]);
+  assert(MemTable_get(m, "large", 6)->value_loc == (int64_t)large_pos);
+  assert(MemTable_get(m, "large", 6)->value_size == head - large_pos);
+  MemTable_free(m);
+  ValueLog_free(log);
+
+  remove_segments(dir);
+}
+
+/*
+ * Fills a buffer with JSON-like records, which compress well.
+ */
+static void
+make_json(char* buf, size_t len, int seed)
+{
+  size_t n = 0;
+  for (int i = 0; n < len; i++) {
+    char record[64];
+    int record_len = snprintf(
+      record, sizeof(record), "{\"id\":%d,\"fruit\":\"apple\"},", seed + i);
+    size_t copy = (size_t)record_len < len - n ? (size_t)record_len : len - n;
+    memcpy(buf + n, record, copy);
+    n += copy;
+  }
+}
+
+static void
+check_value(struct ValueLog* log, size_t pos, const char* value, size_t len)
+{
+  char* read;
+  size_t read_len;
+  assert(ValueLog_get(log, &read, &read_len, pos) == 0);
+  assert(read_len == len);
+  assert(memcmp(read, value, len) == 0);
+  free(read);
+
+  // The value is decompressed into a buffer of its exact length.
+  char* buf = malloc(len + 1);
+  assert(ValueLog_read(log, NULL, 0, &read_len, pos) == 0);
+  assert(read_len == len);
+  assert(ValueLog_read(log, buf, len, &read_len, pos) == 0);
+  assert(memcmp(buf, value, len) == 0);
+  free(buf);
+
+  struct ValueLogSlice slice;
+  assert(ValueLog_get_slice(log, &slice, pos) == 0);
+  assert(slice.len == len);
+  assert(memcmp(slice.data, value, len) == 0);
+  ValueLog_release_slice(log, &slice);
+  assert(log->pins == 0);
+
+  struct ValueLogEntry entry;
+  assert(ValueLog_read_entry(log, pos, &entry) == 0);
+  assert(entry.value_len == len);
+  assert(memcmp(entry.value, value, len) == 0);
+  free(entry.key);
+}
+
+void
+TestValueLog_compression()
+{
+  char* filename = "value_log.data";
+
+  struct ValueLog* log = ValueLog_new(filename, 0, 0);
+  ValueLog_set_compression(log, CODEC_LZ, 64, 1.5);
+
+  char json[4096];
+  char random[1024];
+  make_json(json, sizeof(json), 0);
+  srand(3);
+  for (size_t i = 0; i < sizeof(random); i++) {
+    random[i] = (char)(rand() & 0xFF);
+  }
+
+  size_t pos1, pos2, pos3, pos4, pos5;
+  assert(ValueLog_append(log, &pos1, "json", 5, json, sizeof(json)) == 0);
+  assert(pos1 == VALUE_LOG_HEADER_SIZE);
+
+  // Short values and values that don't shrink enough are stored as they are.
+  assert(ValueLog_append(log, &pos2, "short", 6, json, 63) == 0);
+  assert(pos2 - pos1 < sizeof(json) / 4);
+  assert(ValueLog_append(log, &pos3, "random", 7, random, sizeof(random)) ==
+         0);
+  assert(pos3 - pos2 == 3 + 6 + 63);
+  assert(ValueLog_append_tombstone(log, &pos4, "json", 5) == 0);
+  assert(pos4 - pos3 == 4 + 7 + sizeof(random));
+  assert(ValueLog_append(log, &pos5, "empty", 6, "", 0) == 0);
+
+  // Values are read from the buffer and from the file.
+  check_value(log, pos1, json, sizeof(json));
+  assert(ValueLog_sync(log) == 0);
+  check_value(log, pos1, json, sizeof(json));
+  check_value(log, pos2, json, 63);
+  check_value(log, pos3, random, sizeof(random));
+  check_value(log, pos5, "", 0);
+
+  struct ValueLogEntry entry;
+  assert(ValueLog_read_entry(log, pos1, &entry) == 0);
+  assert(entry.len == pos2 - pos1);
+  assert(entry.key_len == 5 && memcmp(entry.key, "json", 5) == 0);
+  free(entry.key);
+
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  size_t pos = 0;
+  assert(ValueLog_load_memtable(log, &pos, m) == 0);
+  assert(pos == log->head);
+  assert(m->size == 4);
+  assert(MemTable_get(m, "json", 5)->value_loc == -1);
+  assert(MemTable_get(m, "random", 7)->value_loc == (int64_t)pos3);
+  MemTable_free(m);
+
+  // The values are decompressed by their codec byte after a reopen.
+  size_t head = log->head;
+  ValueLog_free(log);
+  log = ValueLog_new(filename, head, 0);
+  check_value(log, pos1, json, sizeof(json));
+
+  // An unknown codec or a wrong length fails the read.
+  char header[8];
+  assert(pread(log->fd, header, sizeof(header), (off_t)pos1) == 8);
+  size_t codec_off = 1;
+  while (header[codec_off] & 0x80) {
+    codec_off++;
+  }
+  codec_off++;
+  char* read;
+  size_t read_len;
+  header[codec_off] = 99;
+  assert(pwrite(log->fd, header, sizeof(header), (off_t)pos1) == 8);
+  assert(ValueLog_get(log, &read, &read_len, pos1) == -1);
+  header[codec_off] = CODEC_LZ;
+  header[codec_off + 1]++;
+  assert(pwrite(log->fd, header, sizeof(header), (off_t)pos1) == 8);
+  assert(ValueLog_get(log, &read, &read_len, pos1) == -1);
+  ValueLog_free(log);
+
+  remove(filename);
+}
+
+void
+TestValueLog_compression_segments()
+{
+  char* dir = "value_log_segments.data";
+  remove_segments(dir);
+  assert(mkdir(dir, 0755) == 0);
+
+  // A segment of the format without the codec byte.
+  char path[64];
+  snprintf(path, sizeof(path), "%s/0" VALUE_LOG_SEGMENT_SUFFIX, dir);
+  FILE* file = fopen(path, "w");
+  write_varint_file(file);
+  fclose(file);
+
+  struct ValueLog* log = ValueLog_new_segmented(dir, 4096);
+  assert(log != NULL);
+  assert(log->version == VALUE_LOG_VERSION_VARINT);
+  ValueLog_set_compression(log, CODEC_LZ, 64, 1.5);
+
+  // Values are stored as they are until the next segment is started, and
+  // the entry that starts it is in the new format.
+  char json[2048];
+  size_t pos[4];
+  for (int i = 0; i < 4; i++) {
+    make_json(json, sizeof(json), i);
+    assert(ValueLog_append(log, &pos[i], "json", 5, json, sizeof(json)) == 0);
+  }
+  assert(pos[0] >> VALUE_LOG_SEGMENT_SHIFT == 0);
+  assert(pos[1] >> VALUE_LOG_SEGMENT_SHIFT == 1);
+  assert(pos[2] - pos[1] == 4 + 5 + sizeof(json));
+  assert(pos[3] - pos[2] < sizeof(json) / 4);
+  assert(log->version == VALUE_LOG_VERSION);
+
+  for (int i = 0; i < 4; i++) {
+    make_json(json, sizeof(json), i);
+    check_value(log, pos[i], json, sizeof(json));
+  }
+  check_value(log, VALUE_LOG_HEADER_SIZE, "Apple Pie", 10);
+
+  // Discards count the compressed length.
+  char large[4000];
+  srand(5);
+  for (size_t i = 0; i < sizeof(large); i++) {
+    large[i] = (char)(rand() & 0xFF);
+  }
+  size_t large_pos;
+  assert(ValueLog_append(log, &large_pos, "large", 6, large, sizeof(large)) ==
+         0);
+  assert(large_pos >> VALUE_LOG_SEGMENT_SHIFT == 2);
+  ValueLog_discard(log, pos[0], 0);
+  ValueLog_discard(log, pos[2], 0);
+  struct ValueLogEntry entry;
+  assert(ValueLog_read_entry(log, pos[2], &entry) == 0);
+  free(entry.key);
+  struct ValueLogSegmentStats* segments;
+  assert(ValueLog_garbage_segments(log, log->head, 0, &segments) == 2);
+  assert(segments[0].id == 0);
+  assert(segments[0].garbage == 3 + 5 + sizeof(json));
+  assert(segments[1].id == 1);
+  assert(segments[1].garbage == entry.len);
+  assert(entry.len < sizeof(json) / 4);
+  free(segments);
+
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  size_t replay = 0;
+  assert(ValueLog_load_memtable(log, &replay, m) == 0);
+  assert(replay == log->head);
+  assert(MemTable_get(m, "json", 5)->value_loc == (int64_t)pos[3]);
+  assert(MemTable_get(m, "large", 6)->value_loc == (int64_t)large_pos);
+  MemTable_free(m);
+  ValueLog_free(log);
+
+  remove_segments(dir);
+}
+
+/*
+ * Reads a whole file into a new allocation.
+ */
+static char*
+read_file(const char* filename, size_t* len)
+{
+  struct stat st;
+  assert(stat(filename, &st) == 0);
+  *len = (size_t)st.st_size;
+
+  char* buf = malloc(*len);
+  FILE* file = fopen(filename, "r");
+  assert(fread(buf, sizeof(char), *len, file) == *len);
+  fclose(file);
+
+  return buf;
+}
+
+void
+TestValueLog_append_batch()
+{
+  char* single_filename = "value_log_single.data";
+  char* batch_filename = "value_log_batch.data";
+
+  // Short values, which are gathered in the buffer, and values larger than
+  // the buffer, which are written directly.
+  size_t lens[] = { 10, 2 * VALUE_LOG_BUFFER_SIZE, 100, 0, 64, 1000 };
+  size_t count = sizeof(lens) / sizeof(lens[0]);
+  char keys[6][16];
+  char* values[6];
+  struct ValueLogBatchEntry entries[6];
+  for (size_t i = 0; i < count; i++) {
+    snprintf(keys[i], sizeof(keys[i]), "key-%zu", i);
+    values[i] = malloc(lens[i] + 1);
+    memset(values[i], 'a' + (int)i, lens[i]);
+    entries[i] = (struct ValueLogBatchEntry){
+      keys[i], strlen(keys[i]) + 1, values[i], lens[i]
+    };
+  }
+
+  // A batch is laid out exactly like a run of appends.
+  struct ValueLog* single = ValueLog_new(single_filename, 0, 0);
+  struct ValueLog* batch = ValueLog_new(batch_filename, 0, 0);
+  size_t single_pos[6];
+  size_t batch_pos[6];
+  for (int round = 0; round < 2; round++) {
+    for (size_t i = 0; i < count; i++) {
+      assert(ValueLog_append(single,
+                             &single_pos[i],
+                             entries[i].key,
+                             entries[i].key_len,
+                             entries[i].value,
+                             entries[i].value_len) == 0);
+    }
+    assert(ValueLog_append_batch(batch, batch_pos, entries, count) == 0);
+    assert(batch->head == single->head);
+    assert(memcmp(batch_pos, single_pos, sizeof(batch_pos)) == 0);
+
+    // Small batches are gathered in the buffer too.
+    assert(ValueLog_append_batch(batch, batch_pos, entries, 1) == 0);
+    assert(ValueLog_append(single,
+                           &single_pos[0],
+                           entries[0].key,
+                           entries[0].key_len,
+                           entries[0].value,
+                           entries[0].value_len) == 0);
+    assert(batch_pos[0] == single_pos[0]);
+  }
+
+  // An empty batch writes nothing.
+  size_t head = batch->head;
+  assert(ValueLog_append_batch(batch, NULL, entries, 0) == 0);
+  assert(batch->head == head);
+
+  for (size_t i = 0; i < count; i++) {
+    check_value(batch, single_pos[i], values[i], lens[i]);
+  }
+  assert(ValueLog_sync(single) == 0);
+  assert(ValueLog_sync(batch) == 0);
+  size_t single_len, batch_len;
+  char* single_file = read_file(single_filename, &single_len);
+  char* batch_file = read_file(batch_filename, &batch_len);
+  assert(single_len == batch_len);
+  assert(memcmp(single_file, batch_file, single_len) == 0);
+  free(batch_file);
+  free(single_file);
+  ValueLog_free(batch);
+  ValueLog_free(single);
+
+  // A batch with more entries than fit in one `pwritev`, which is compressed.
+  size_t many = 2000;
+  struct ValueLogBatchEntry* many_entries =
+    malloc(many * sizeof(struct ValueLogBatchEntry));
+  size_t* many_pos = malloc(many * sizeof(size_t));
+  char* json = malloc(many * 128);
+  for (size_t i = 0; i < many; i++) {
+    make_json(json + i * 128, 128, (int)i);
+    many_entries[i] =
+      (struct ValueLogBatchEntry){ "json", 5, json + i * 128, 128 };
+  }
+  batch = ValueLog_new(batch_filename, 0, 0);
+  ValueLog_set_compression(batch, CODEC_LZ, 0, 1);
+  assert(ValueLog_append_batch(batch, many_pos, many_entries, many) == 0);
+  head = batch->head;
+  ValueLog_free(batch);
+  batch = ValueLog_new(batch_filename, head, 0);
+  for (size_t i = 0; i < many; i++) {
+    check_value(batch, many_pos[i], json + i * 128, 128);
+  }
+  ValueLog_free(batch);
+  free(json);
+  free(many_pos);
+  free(many_entries);
+
+  for (size_t i = 0; i < count; i++) {
+    free(values[i]);
+  }
+  remove(batch_filename);
+  remove(single_filename);
+}
+
+void
+TestValueLog_append_batch_segments()
+{
+  char* dir = "value_log_segments.data";
+  remove_segments(dir);
+  assert(mkdir(dir, 0755) == 0);
+
+  struct ValueLog* log = ValueLog_new_segmented(dir, 4096);
+  assert(log != NULL);
+
+  char value[512];
+  memset(value, 'v', sizeof(value));
+  size_t pos[16];
+  assert(ValueLog_append(log, &pos[0], "first", 6, value, sizeof(value)) == 0);
+
+  // A batch that doesn't fit in the rest of the segment starts the next one,
+  // and a batch larger than a segment gets one of its own.
+  struct ValueLogBatchEntry entries[16];
+  for (int i = 0; i < 16; i++) {
+    entries[i] = (struct ValueLogBatchEntry){ "key", 4, value, sizeof(value) };
+  }
+  assert(ValueLog_append_batch(log, pos, entries, 7) == 0);
+  assert(pos[0] >> VALUE_LOG_SEGMENT_SHIFT == 1);
+  assert((pos[0] & VALUE_LOG_SEGMENT_MASK) == VALUE_LOG_HEADER_SIZE);
+  assert(ValueLog_append_batch(log, pos + 7, entries, 9) == 0);
+  assert(pos[7] >> VALUE_LOG_SEGMENT_SHIFT == 2);
+  assert((pos[7] & VALUE_LOG_SEGMENT_MASK) == VALUE_LOG_HEADER_SIZE);
+  for (int i = 1; i < 16; i++) {
+    if (i != 7) {
+      assert(pos[i] == pos[i - 1] + 4 + 4 + sizeof(value));
+    }
+  }
+  for (int i = 0; i < 16; i++) {
+    check_value(log, pos[i], value, sizeof(value));
+  }
+
+  // The entries are replayed after a reopen.
+  ValueLog_free(log);
+  log = ValueLog_new_segmented(dir, 4096);
+  assert(log->head == pos[15] + 4 + 4 + sizeof(value));
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  size_t replay = pos[7];
+  assert(ValueLog_load_memtable(log, &replay, m) == 0);
+  assert(MemTable_get(m, "key", 4)->value_loc == (int64_t)pos[15]);
+  MemTable_free(m);
+  ValueLog_free(log);
+
+  remove_segments(dir);
+}
+
+#define APPEND_THREADS 4
+#define APPEND_COUNT 256
+
+struct AppendArgs
+{
+  struct ValueLog* log;
+  int id;
+  size_t pos[APPEND_COUNT];
+  size_t len[APPEND_COUNT];
+};
+
+static void*
+append_thread(void* arg)
+{
+  struct AppendArgs* args = arg;
+  char value[100];
+  for (int i = 0; i < APPEND_COUNT; i++) {
+    memset(value, 'a' + args->id, sizeof(value));
+    memcpy(value, &i, sizeof(i));
+    assert(ValueLog_append_sized(args->log,
+                                 &args->pos[i],
+                                 &args->len[i],
+                                 "key",
+                                 4,
+                                 value,
+                                 sizeof(value)) == 0);
+  }
+  return NULL;
+}
+
+static int
+size_cmp(const void* a, const void* b)
+{
+  size_t lhs = *(const size_t*)a;
+  size_t rhs = *(const size_t*)b;
+  return lhs < rhs ? -1 : lhs > rhs;
+}
+
+void
+TestValueLog_append_concurrent()
+{
+  char* dir = "value_log_segments.data";
+  remove_segments(dir);
+  assert(mkdir(dir, 0755) == 0);
+
+  struct ValueLog* log = ValueLog_new_segmented(dir, 4096);
+  assert(log != NULL);
+
+  // Threads append at once and roll over to new segments under each other.
+  struct AppendArgs args[APPEND_THREADS];
+  pthread_t threads[APPEND_THREADS];
+  for (int t = 0; t < APPEND_THREADS; t++) {
+    args[t].log = log;
+    args[t].id = t;
+    pthread_create(&threads[t], NULL, append_thread, &args[t]);
+  }
+  for (int t = 0; t < APPEND_THREADS; t++) {
+    pthread_join(threads[t], NULL);
+  }
+
+  char value[100];
+  size_t ends[APPEND_THREADS * APPEND_COUNT][2];
+  for (int t = 0; t < APPEND_THREADS; t++) {
+    for (int i = 0; i < APPEND_COUNT; i++) {
+      memset(value, 'a' + t, sizeof(value));
+      memcpy(value, &i, sizeof(i));
+      check_value(log, args[t].pos[i], value, sizeof(value));
+      ends[t * APPEND_COUNT + i][0] = args[t].pos[i];
+      ends[t * APPEND_COUNT + i][1] = args[t].pos[i] + args[t].len[i];
+    }
+  }
+
+  // The entries are laid out next to each other, and each ends where its
+  // length says, at the next entry or at the end of its segment.
+  qsort(ends, APPEND_THREADS * APPEND_COUNT, sizeof(ends[0]), size_cmp);
+  for (int k = 1; k < APPEND_THREADS * APPEND_COUNT; k++) {
+    if (ends[k][0] >> VALUE_LOG_SEGMENT_SHIFT ==
+        ends[k - 1][0] >> VALUE_LOG_SEGMENT_SHIFT) {
+      assert(ends[k][0] == ends[k - 1][1]);
+    } else {
+      assert((ends[k][0] & VALUE_LOG_SEGMENT_MASK) == VALUE_LOG_HEADER_SIZE);
+    }
+  }
+  assert(ValueLog_head(log) == ends[APPEND_THREADS * APPEND_COUNT - 1][1]);
+
+  ValueLog_free(log);
+  remove_segments(dir);
+}
+
+void
+TestValueLog_io_uring()
+{
+  char* dir = "value_log_segments.data";
+  remove_segments(dir);
+  assert(mkdir(dir, 0755) == 0);
+
+  // io_uring is optional, the ValueLog falls back to `fsync` without it.
+  struct ValueLog* log = ValueLog_new_segmented(dir, 4096);
+  int res = ValueLog_enable_io_uring(log);
+  assert(res == 0 || log->uring == NULL);
+
+  // Buffered entries are read from the buffer until the sync writes them, and
+  // from the file after it. The syncs go on across a segment roll.
+  char value[512];
+  size_t pos[16];
+  for (int i = 0; i < 16; i++) {
+    memset(value, 'a' + i, sizeof(value));
+    assert(ValueLog_append(log, &pos[i], "key", 4, value, sizeof(value)) == 0);
+    check_value(log, pos[i], value, sizeof(value));
+    if (i % 3 == 0) {
+      assert(ValueLog_sync(log) == 0);
+      check_value(log, pos[i], value, sizeof(value));
+    }
+  }
+  assert(pos[15] >> VALUE_LOG_SEGMENT_SHIFT > 0);
+  assert(ValueLog_sync(log) == 0);
+  assert(ValueLog_sync(log) == 0);
+  size_t head = ValueLog_head(log);
+  ValueLog_free(log);
+
+  log = ValueLog_new_segmented(dir, 4096);
+  assert(ValueLog_head(log) == head);
+  for (int i = 0; i < 16; i++) {
+    memset(value, 'a' + i, sizeof(value));
+    check_value(log, pos[i], value, sizeof(value));
+  }
+  ValueLog_free(log);
+
+  remove_segments(dir);
+}
+
 int
 main()
 {
@@ -295,12 +1361,39 @@ main()
 
   // Append
   TestValueLog_append();
+  TestValueLog_fixed();
+  TestValueLog_varint();
 
   // Get
   TestValueLog_get();
+  TestValueLog_read();
+  TestValueLog_get_sized();
+  TestValueLog_slice();
 
   // Reload
   TestValueLog_reload();
 
+  // Replay
+  TestValueLog_load_memtable();
+  TestValueLog_load_memtable_budget();
+
+  // Garbage Collection
+  TestValueLog_set_tail();
+  TestValueLog_segments();
+
+  // Compression
+  TestValueLog_compression();
+  TestValueLog_compression_segments();
+
+  // Batch
+  TestValueLog_append_batch();
+  TestValueLog_append_batch_segments();
+
+  // Concurrency
+  TestValueLog_append_concurrent();
+
+  // Sync
+  TestValueLog_io_uring();
+
   return 0;
 }
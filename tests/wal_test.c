@@ -15,17 +15,24 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "../src/common.h"
 #include "../src/wal.h"
 
+#define THREADS 8
+#define RECORDS_PER_THREAD 256
+
 void
 TestWAL_new()
 {
   char* filename = "wal.data";
 
-  struct WAL* wal = WAL_new(filename);
+  struct WAL* wal = WAL_new(filename, 1, 0);
 
   assert(wal != NULL);
 
@@ -34,12 +41,44 @@ TestWAL_new()
   remove(filename);
 }
 
+static void
+check_record(FILE* file,
+             uint64_t seq,
+             const char* key,
+             size_t key_len,
+             int64_t value_loc,
+             size_t value_size)
+{
+  char header[WAL_RECORD_MAX_HEADER_SIZE];
+  size_t header_len = sizeof(uint32_t);
+  header_len += WiscKey_varint_encode(header + header_len, key_len);
+  header_len += WiscKey_varint_encode(header + header_len,
+                                      (uint64_t)(value_loc + 1) << 1);
+  header_len += WiscKey_varint_encode(header + header_len, value_size);
+
+  char record[header_len + key_len];
+  size_t file_res = fread(record, sizeof(char), sizeof(record), file);
+  assert(file_res == sizeof(record));
+
+  assert(memcmp(record + sizeof(uint32_t),
+                header + sizeof(uint32_t),
+                header_len - sizeof(uint32_t)) == 0);
+  assert(memcmp(record + header_len, key, key_len) == 0);
+
+  uint32_t wal_crc;
+  memcpy(&wal_crc, record, sizeof(uint32_t));
+  uint32_t crc = WiscKey_crc32c(0, &seq, sizeof(uint64_t));
+  crc = WiscKey_crc32c(
+    crc, record + sizeof(uint32_t), sizeof(record) - sizeof(uint32_t));
+  assert(wal_crc == crc);
+}
+
 void
 TestWAL_append()
 {
   char* filename = "wal.data";
 
-  struct WAL* wal = WAL_new(filename);
+  struct WAL* wal = WAL_new(filename, 7, 0);
 
   char* key1 = "apple";
   char* value1 = "Apple Pie";
@@ -53,66 +92,37 @@ TestWAL_append()
   FILE* file = fopen(filename, "r");
 
   {
-    uint64_t wal_key_len;
-    int64_t wal_value_loc;
-    char wal_key[strlen(key1) + 1];
+    uint32_t magic;
+    uint32_t version;
+    uint64_t seq;
 
-    size_t file_res = fread(&wal_key_len, sizeof(uint64_t), 1, file);
+    size_t file_res = fread(&magic, sizeof(uint32_t), 1, file);
     assert(file_res == 1);
-    file_res = fread(&wal_value_loc, sizeof(int64_t), 1, file);
+    file_res = fread(&version, sizeof(uint32_t), 1, file);
+    assert(file_res == 1);
+    file_res = fread(&seq, sizeof(uint64_t), 1, file);
     assert(file_res == 1);
-    file_res = fread(&wal_key, sizeof(char), strlen(key1) + 1, file);
-    assert(file_res == strlen(key1) + 1);
 
-    assert(wal_key_len == strlen(key1) + 1);
-    assert(wal_value_loc == 0);
-    assert(memcmp(wal_key, key1, strlen(key1) + 1) == 0);
+    assert(magic == WAL_MAGIC);
+    assert(version == WAL_VERSION);
+    assert(seq == 7);
   }
 
+  check_record(file, 7, key1, strlen(key1) + 1, 0, 0);
+
   char* key2 = "lime";
   long long value2_offset = (long long)strlen(value1) + 1;
 
-  res = WAL_append(wal, key2, strlen(key2) + 1, value2_offset);
+  res = WAL_append_sized(wal, key2, strlen(key2) + 1, value2_offset, 300);
   assert(res == 0);
 
   res = WAL_sync(wal);
   assert(res == 0);
 
-  fseek(file, 0, SEEK_SET);
+  fseek(file, WAL_HEADER_SIZE, SEEK_SET);
 
-  {
-    uint64_t wal_key_len;
-    int64_t wal_value_loc;
-    char wal_key[strlen(key1) + 1];
-
-    size_t file_res = fread(&wal_key_len, sizeof(uint64_t), 1, file);
-    assert(file_res == 1);
-    file_res = fread(&wal_value_loc, sizeof(int64_t), 1, file);
-    assert(file_res == 1);
-    file_res = fread(&wal_key, sizeof(char), strlen(key1) + 1, file);
-    assert(file_res == strlen(key1) + 1);
-
-    assert(wal_key_len == strlen(key1) + 1);
-    assert(wal_value_loc == 0);
-    assert(memcmp(wal_key, key1, strlen(key1) + 1) == 0);
-  }
-
-  {
-    uint64_t wal_key_len;
-    int64_t wal_value_loc;
-    char wal_key[strlen(key2) + 1];
-
-    size_t file_res = fread(&wal_key_len, sizeof(uint64_t), 1, file);
-    assert(file_res == 1);
-    file_res = fread(&wal_value_loc, sizeof(int64_t), 1, file);
-    assert(file_res == 1);
-    file_res = fread(&wal_key, sizeof(char), strlen(key2) + 1, file);
-    assert(file_res == strlen(key2) + 1);
-
-    assert(wal_key_len == strlen(key2) + 1);
-    assert(wal_value_loc == value2_offset);
-    assert(memcmp(wal_key, key2, strlen(key2) + 1) == 0);
-  }
+  check_record(file, 7, key1, strlen(key1) + 1, 0, 0);
+  check_record(file, 7, key2, strlen(key2) + 1, value2_offset, 300);
 
   fclose(file);
 
@@ -126,7 +136,7 @@ TestWAL_load_memtable()
 {
   char* filename = "wal.data";
 
-  struct WAL* wal = WAL_new(filename);
+  struct WAL* wal = WAL_new(filename, 1, 0);
 
   char* key1 = "apple";
   char* value1 = "Apple Pie";
@@ -151,9 +161,9 @@ TestWAL_load_memtable()
   // Simulate shutting down the database.
   WAL_free(wal);
 
-  struct MemTable* m = MemTable_new();
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
 
-  wal = WAL_new(filename);
+  wal = WAL_open(filename);
 
   res = WAL_load_memtable(wal, m);
   assert(res == 0);
@@ -178,6 +188,564 @@ TestWAL_load_memtable()
   remove(filename);
 }
 
+void
+TestWAL_load_memtable_batches()
+{
+  char* filename = "wal.data";
+
+  struct WAL* wal = WAL_new(filename, 1, 0);
+
+  // Enough records for several replay batches. Every key is written three
+  // times and some are deleted in between, across batch boundaries.
+  uint32_t keys = WAL_REPLAY_BATCH;
+  for (uint32_t round = 0; round < 3; round++) {
+    for (uint32_t key = 0; key < keys; key++) {
+      int64_t value_loc = round * keys + key;
+      if (round == 1 && key % 3 == 0) {
+        value_loc = -1;
+      }
+      assert(WAL_append(wal, (char*)&key, sizeof(key), value_loc) == 0);
+    }
+  }
+  for (uint32_t key = 0; key < keys; key += 5) {
+    assert(WAL_append(wal, (char*)&key, sizeof(key), -1) == 0);
+  }
+
+  WAL_free(wal);
+
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  wal = WAL_open(filename);
+  assert(WAL_load_memtable(wal, m) == 0);
+
+  assert(m->size == keys);
+  for (uint32_t key = 0; key < keys; key++) {
+    struct MemTableRecord* record = MemTable_get(m, (char*)&key, sizeof(key));
+    assert(record != NULL);
+    int64_t value_loc = key % 5 == 0 ? -1 : (int64_t)(2 * keys + key);
+    assert(record->value_loc == value_loc);
+  }
+
+  WAL_free(wal);
+  MemTable_free(m);
+
+  remove(filename);
+}
+
+void
+TestWAL_load_memtable_truncated()
+{
+  char* filename = "wal.data";
+
+  struct WAL* wal = WAL_new(filename, 1, 0);
+  assert(WAL_append(wal, "apple", 6, 0) == 0);
+  assert(WAL_append(wal, "lime", 5, 10) == 0);
+  WAL_free(wal);
+
+  // A record cut short by a crash ends the log.
+  off_t len = WAL_HEADER_SIZE + (4 + 1 + 1 + 6) + (4 + 1 + 1 + 2);
+  assert(truncate(filename, len) == 0);
+
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  wal = WAL_open(filename);
+  assert(WAL_load_memtable(wal, m) == 0);
+  assert(m->size == 1);
+  assert(MemTable_get(m, "apple", 6)->value_loc == 0);
+  WAL_free(wal);
+  MemTable_free(m);
+
+  // An empty WAL loads nothing.
+  remove(filename);
+  m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  wal = WAL_new(filename, 1, 0);
+  assert(WAL_load_memtable(wal, m) == 0);
+  assert(m->size == 0);
+  WAL_free(wal);
+  MemTable_free(m);
+
+  // A file that isn't a WAL is rejected.
+  FILE* file = fopen(filename, "w");
+  fputs("not a wal segment", file);
+  fclose(file);
+  assert(WAL_open(filename) == NULL);
+
+  remove(filename);
+}
+
+void
+TestWAL_load_memtable_fixed()
+{
+  char* filename = "wal.data";
+
+  // A segment written in the fixed-size format by hand.
+  FILE* file = fopen(filename, "w");
+  uint32_t magic = WAL_MAGIC;
+  uint32_t version = WAL_VERSION_FIXED;
+  uint64_t seq = 3;
+  fwrite(&magic, sizeof(uint32_t), 1, file);
+  fwrite(&version, sizeof(uint32_t), 1, file);
+  fwrite(&seq, sizeof(uint64_t), 1, file);
+
+  char* keys[] = { "apple", "lime", "apple" };
+  int64_t value_locs[] = { 0, 100, -1 };
+  for (int i = 0; i < 3; i++) {
+    uint32_t key_len = (uint32_t)strlen(keys[i]) + 1;
+    char record[WAL_RECORD_HEADER_SIZE + key_len];
+    memcpy(record + sizeof(uint32_t), &key_len, sizeof(uint32_t));
+    memcpy(record + 2 * sizeof(uint32_t), &value_locs[i], sizeof(int64_t));
+    memcpy(record + WAL_RECORD_HEADER_SIZE, keys[i], key_len);
+
+    uint32_t crc = WiscKey_crc32c(0, &seq, sizeof(uint64_t));
+    crc = WiscKey_crc32c(
+      crc, record + sizeof(uint32_t), sizeof(record) - sizeof(uint32_t));
+    memcpy(record, &crc, sizeof(uint32_t));
+    fwrite(record, sizeof(char), sizeof(record), file);
+  }
+  fclose(file);
+
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  struct WAL* wal = WAL_open(filename);
+  assert(wal != NULL);
+  assert(wal->version == WAL_VERSION_FIXED);
+  assert(WAL_load_memtable(wal, m) == 0);
+  assert(m->size == 2);
+  assert(MemTable_get(m, "apple", 6)->value_loc == -1);
+  assert(MemTable_get(m, "lime", 5)->value_loc == 100);
+  WAL_free(wal);
+  MemTable_free(m);
+
+  // A recycled segment is rewritten in the current format.
+  wal = WAL_new(filename, 4, 0);
+  assert(wal->version == WAL_VERSION);
+  WAL_free(wal);
+  wal = WAL_open(filename);
+  assert(wal->version == WAL_VERSION);
+  WAL_free(wal);
+
+  remove(filename);
+}
+
+void
+TestWAL_load_memtable_values()
+{
+  char* filename = "wal.data";
+
+  struct WAL* wal = WAL_new(filename, 1, 0);
+  assert(WAL_append_value(wal, "apple", 6, "Apple Pie", 10) == 0);
+  assert(WAL_append(wal, "lime", 5, 10) == 0);
+  assert(WAL_append_value(wal, "lime", 5, "Key Lime", 9) == 0);
+  assert(WAL_append_value(wal, "orange", 7, "", 0) == 0);
+  assert(WAL_append_value(wal, "pear", 5, "Pear", 5) == 0);
+  assert(WAL_append(wal, "pear", 5, -1) == 0);
+  WAL_free(wal);
+
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  wal = WAL_open(filename);
+  assert(WAL_load_memtable(wal, m) == 0);
+  assert(m->size == 4);
+
+  struct MemTableRecord* record = MemTable_get(m, "apple", 6);
+  assert(record->value_loc == MEMTABLE_VALUE_INLINE);
+  assert(record->value->len == 10);
+  assert(memcmp(record->value->data, "Apple Pie", 10) == 0);
+
+  record = MemTable_get(m, "lime", 5);
+  assert(record->value_loc == MEMTABLE_VALUE_INLINE);
+  assert(record->value->len == 9);
+  assert(memcmp(record->value->data, "Key Lime", 9) == 0);
+
+  record = MemTable_get(m, "orange", 7);
+  assert(record->value_loc == MEMTABLE_VALUE_INLINE);
+  assert(record->value->len == 0);
+
+  assert(MemTable_get(m, "pear", 5)->value_loc == -1);
+  WAL_free(wal);
+  MemTable_free(m);
+
+  // The checksum covers the value, so a value cut short ends the log.
+  off_t len = WAL_HEADER_SIZE + (4 + 1 + 1 + 6 + 10) + (4 + 1 + 1 + 1 + 5) +
+              (4 + 1 + 1 + 5 + 8);
+  assert(truncate(filename, len) == 0);
+
+  m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  wal = WAL_open(filename);
+  assert(WAL_load_memtable(wal, m) == 0);
+  assert(m->size == 2);
+  assert(MemTable_get(m, "lime", 5)->value_loc == 10);
+  WAL_free(wal);
+  MemTable_free(m);
+
+  remove(filename);
+}
+
+void
+TestWAL_load_memtable_loc()
+{
+  char* filename = "wal.data";
+
+  // A segment written in the format without inline values by hand.
+  FILE* file = fopen(filename, "w");
+  uint32_t magic = WAL_MAGIC;
+  uint32_t version = WAL_VERSION_LOC;
+  uint64_t seq = 3;
+  fwrite(&magic, sizeof(uint32_t), 1, file);
+  fwrite(&version, sizeof(uint32_t), 1, file);
+  fwrite(&seq, sizeof(uint64_t), 1, file);
+
+  char* keys[] = { "apple", "lime", "apple" };
+  int64_t value_locs[] = { 0, 100, -1 };
+  for (int i = 0; i < 3; i++) {
+    size_t key_len = strlen(keys[i]) + 1;
+    char record[WAL_RECORD_MAX_HEADER_SIZE + key_len];
+    size_t header_len = sizeof(uint32_t);
+    header_len += WiscKey_varint_encode(record + header_len, key_len);
+    header_len += WiscKey_varint_encode(record + header_len,
+                                        (uint64_t)(value_locs[i] + 1));
+    memcpy(record + header_len, keys[i], key_len);
+
+    uint32_t crc = WiscKey_crc32c(0, &seq, sizeof(uint64_t));
+    crc = WiscKey_crc32c(
+      crc, record + sizeof(uint32_t), header_len + key_len - sizeof(uint32_t));
+    memcpy(record, &crc, sizeof(uint32_t));
+    fwrite(record, sizeof(char), header_len + key_len, file);
+  }
+  fclose(file);
+
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  struct WAL* wal = WAL_open(filename);
+  assert(wal != NULL);
+  assert(wal->version == WAL_VERSION_LOC);
+  assert(WAL_load_memtable(wal, m) == 0);
+  assert(m->size == 2);
+  assert(MemTable_get(m, "apple", 6)->value_loc == -1);
+  assert(MemTable_get(m, "lime", 5)->value_loc == 100);
+  WAL_free(wal);
+  MemTable_free(m);
+
+  remove(filename);
+}
+
+void
+TestWAL_load_memtable_sized()
+{
+  char* filename = "wal.data";
+
+  struct WAL* wal = WAL_new(filename, 2, 0);
+  assert(WAL_append_sized(wal, "apple", 6, 0, 25) == 0);
+  assert(WAL_append(wal, "lime", 5, 25) == 0);
+  assert(WAL_append_sized(wal, "pear", 5, 50, 200) == 0);
+  assert(WAL_append(wal, "pear", 5, -1) == 0);
+  WAL_free(wal);
+
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  wal = WAL_open(filename);
+  assert(WAL_load_memtable(wal, m) == 0);
+  struct MemTableRecord* record = MemTable_get(m, "apple", 6);
+  assert(record->value_loc == 0 && record->value_size == 25);
+  record = MemTable_get(m, "lime", 5);
+  assert(record->value_loc == 25 && record->value_size == 0);
+  record = MemTable_get(m, "pear", 5);
+  assert(record->value_loc == -1 && record->value_size == 0);
+  WAL_free(wal);
+  MemTable_free(m);
+
+  // A segment of the format without entry sizes, written by hand.
+  FILE* file = fopen(filename, "w");
+  uint32_t magic = WAL_MAGIC;
+  uint32_t version = WAL_VERSION_INLINE;
+  uint64_t seq = 3;
+  fwrite(&magic, sizeof(uint32_t), 1, file);
+  fwrite(&version, sizeof(uint32_t), 1, file);
+  fwrite(&seq, sizeof(uint64_t), 1, file);
+  char bytes[4 + 1 + 2 + 6];
+  bytes[4] = 6;
+  WiscKey_varint_encode(bytes + 5, (100 + 1) << 1);
+  memcpy(bytes + 7, "apple", 6);
+  uint32_t crc = WiscKey_crc32c(0, &seq, sizeof(uint64_t));
+  crc = WiscKey_crc32c(crc, bytes + 4, sizeof(bytes) - 4);
+  memcpy(bytes, &crc, sizeof(uint32_t));
+  fwrite(bytes, sizeof(char), sizeof(bytes), file);
+  fclose(file);
+
+  m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  wal = WAL_open(filename);
+  assert(wal->version == WAL_VERSION_INLINE);
+  assert(WAL_load_memtable(wal, m) == 0);
+  record = MemTable_get(m, "apple", 6);
+  assert(record->value_loc == 100 && record->value_size == 0);
+  WAL_free(wal);
+  MemTable_free(m);
+
+  remove(filename);
+}
+
+void
+TestWAL_segment()
+{
+  char* filename = "wal.data";
+  size_t segment_size = 4096;
+
+  // The segment is preallocated and fills up at its preallocated size.
+  struct WAL* wal = WAL_new(filename, 1, segment_size);
+  struct stat st;
+  assert(stat(filename, &st) == 0);
+  assert((size_t)st.st_size == segment_size);
+
+  char key[64];
+  memset(key, 'a', sizeof(key));
+  uint32_t first_records = 0;
+  while (!WAL_is_full(wal)) {
+    assert(WAL_append(wal, key, sizeof(key), first_records) == 0);
+    first_records++;
+  }
+  assert(WAL_sync(wal) == 0);
+  WAL_free(wal);
+
+  // Recycle the file for a new segment with fewer, different records. The
+  // records of the first use are still in the file but are not replayed.
+  wal = WAL_new(filename, 2, segment_size);
+  memset(key, 'b', sizeof(key));
+  for (uint32_t i = 0; i < 3; i++) {
+    assert(WAL_append(wal, key, sizeof(key), i) == 0);
+  }
+  assert(WAL_sync(wal) == 0);
+  WAL_free(wal);
+
+  assert(stat(filename, &st) == 0);
+  assert((size_t)st.st_size >= segment_size);
+
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  wal = WAL_open(filename);
+  assert(wal->seq == 2);
+  assert(WAL_load_memtable(wal, m) == 0);
+  assert(m->size == 1);
+  assert(m->records[0]->key[0] == 'b');
+  assert(m->records[0]->value_loc == 2);
+  WAL_free(wal);
+  MemTable_free(m);
+
+  remove(filename);
+}
+
+void
+TestWAL_split()
+{
+  char* filename = "wal.data";
+
+  // Every key is written three times, so the ranges overwrite each other.
+  struct WAL* wal = WAL_new(filename, 1, 0);
+  uint32_t keys = WAL_REPLAY_BATCH;
+  for (uint32_t round = 0; round < 3; round++) {
+    for (uint32_t key = 0; key < keys; key++) {
+      assert(WAL_append(wal, (char*)&key, sizeof(key), round * keys + key) ==
+             0);
+    }
+  }
+  WAL_free(wal);
+
+  // The ranges are replayed in order up to their ends.
+  wal = WAL_open(filename);
+  size_t bounds[5];
+  assert(WAL_split(wal, 4, 0, bounds) == 4);
+  assert(bounds[0] == WAL_HEADER_SIZE);
+  assert(bounds[4] == SIZE_MAX);
+  struct MemTable* m[4];
+  for (int i = 0; i < 4; i++) {
+    assert(bounds[i] < bounds[i + 1]);
+    m[i] = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+    size_t offset = bounds[i];
+    assert(WAL_load_range(wal, m[i], &offset, bounds[i + 1]) == 0);
+    if (i < 3) {
+      assert(offset == bounds[i + 1]);
+    }
+  }
+  for (uint32_t key = 0; key < keys; key++) {
+    struct MemTableRecord* record = NULL;
+    for (int i = 3; i >= 0 && record == NULL; i--) {
+      record = MemTable_get(m[i], (char*)&key, sizeof(key));
+    }
+    assert(record != NULL);
+    assert(record->value_loc == (int64_t)(2 * keys + key));
+  }
+  for (int i = 0; i < 4; i++) {
+    MemTable_free(m[i]);
+  }
+
+  // Ranges are no smaller than asked for.
+  assert(WAL_split(wal, 4, SIZE_MAX / 2, bounds) == 1);
+  assert(bounds[1] == SIZE_MAX);
+  WAL_free(wal);
+  remove(filename);
+
+  // The ranges of a preallocated segment end where its records do.
+  wal = WAL_new(filename, 1, 4096);
+  char key[64];
+  memset(key, 'a', sizeof(key));
+  for (uint32_t i = 0; i < 8; i++) {
+    assert(WAL_append(wal, key, sizeof(key), i) == 0);
+  }
+  assert(WAL_sync(wal) == 0);
+  size_t end = wal->offset;
+  WAL_free(wal);
+
+  wal = WAL_open(filename);
+  assert(WAL_split(wal, 4, 0, bounds) == 4);
+  assert(bounds[3] < end);
+  WAL_free(wal);
+
+  // Records left over from an earlier use of the segment are framed, but the
+  // replay of the range that the log ends in stops short of its end.
+  wal = WAL_new(filename, 2, 4096);
+  memset(key, 'b', sizeof(key));
+  assert(WAL_append(wal, key, sizeof(key), 0) == 0);
+  assert(WAL_sync(wal) == 0);
+  WAL_free(wal);
+
+  wal = WAL_open(filename);
+  assert(WAL_split(wal, 4, 0, bounds) == 4);
+  struct MemTable* first = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  size_t offset = bounds[0];
+  assert(WAL_load_range(wal, first, &offset, bounds[1]) == 0);
+  assert(first->size == 1);
+  assert(offset < bounds[1]);
+  MemTable_free(first);
+  WAL_free(wal);
+
+  remove(filename);
+}
+
+struct SyncArgs
+{
+  struct WAL* wal;
+  uint32_t thread;
+};
+
+static void*
+append_sync(void* arg)
+{
+  struct SyncArgs* args = arg;
+
+  for (uint32_t i = 0; i < RECORDS_PER_THREAD; i++) {
+    uint32_t key = args->thread * RECORDS_PER_THREAD + i;
+    assert(WAL_append(args->wal, (char*)&key, sizeof(key), key) == 0);
+    assert(WAL_sync(args->wal) == 0);
+  }
+
+  return NULL;
+}
+
+void
+TestWAL_group_commit()
+{
+  char* filename = "wal.data";
+
+  struct WAL* wal = WAL_new(filename, 1, 0);
+
+  pthread_t threads[THREADS];
+  struct SyncArgs args[THREADS];
+  for (uint32_t i = 0; i < THREADS; i++) {
+    args[i].wal = wal;
+    args[i].thread = i;
+    assert(pthread_create(&threads[i], NULL, append_sync, &args[i]) == 0);
+  }
+  for (uint32_t i = 0; i < THREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  // Every record is durable, with at most one sync per record.
+  assert(wal->appended == THREADS * RECORDS_PER_THREAD);
+  assert(wal->durable == wal->appended);
+  assert(wal->syncs > 0 && wal->syncs <= wal->appended);
+  assert(wal->buf_len == 0);
+
+  WAL_free(wal);
+
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  wal = WAL_open(filename);
+  assert(WAL_load_memtable(wal, m) == 0);
+
+  assert(m->size == THREADS * RECORDS_PER_THREAD);
+  for (uint32_t key = 0; key < THREADS * RECORDS_PER_THREAD; key++) {
+    struct MemTableRecord* record = MemTable_get(m, (char*)&key, sizeof(key));
+    assert(record != NULL);
+    assert(record->value_loc == key);
+  }
+
+  WAL_free(wal);
+  MemTable_free(m);
+
+  remove(filename);
+}
+
+void
+TestWAL_buffer()
+{
+  char* filename = "wal.data";
+
+  struct WAL* wal = WAL_new(filename, 1, 0);
+
+  // Records beyond the buffer size are written out without a sync.
+  char key[1024];
+  memset(key, 'k', sizeof(key));
+  for (int i = 0; i < 2 * WAL_BUFFER_SIZE / (int)sizeof(key); i++) {
+    assert(WAL_append(wal, key, sizeof(key), i) == 0);
+  }
+  assert(wal->buf_len < WAL_BUFFER_SIZE);
+  assert(wal->syncs == 0);
+
+  FILE* file = fopen(filename, "r");
+  fseek(file, 0, SEEK_END);
+  assert(ftell(file) > WAL_HEADER_SIZE);
+  fclose(file);
+
+  assert(WAL_sync(wal) == 0);
+  assert(wal->syncs == 1);
+  assert(wal->buf_len == 0);
+
+  // A sync with nothing new to write returns right away.
+  assert(WAL_sync(wal) == 0);
+  assert(wal->syncs == 1);
+
+  WAL_free(wal);
+
+  remove(filename);
+}
+
+void
+TestWAL_io_uring()
+{
+  char* filename = "wal.data";
+
+  // io_uring is optional, the WAL falls back to `fdatasync` without it.
+  struct WAL* wal = WAL_new(filename, 1, 0);
+  int res = WAL_enable_io_uring(wal);
+  assert(res == 0 || wal->uring == NULL);
+
+  // Enough records for a write larger than the buffer.
+  char key[1024];
+  memset(key, 'k', sizeof(key));
+  for (int i = 0; i < 2 * WAL_BUFFER_SIZE / (int)sizeof(key); i++) {
+    key[0] = (char)i;
+    assert(WAL_append(wal, key, sizeof(key), i) == 0);
+  }
+  assert(WAL_sync(wal) == 0);
+  assert(wal->durable == wal->appended);
+
+  // A sync of the last record alone.
+  assert(WAL_append(wal, "apple", 6, 7) == 0);
+  assert(WAL_sync(wal) == 0);
+  WAL_free(wal);
+
+  struct MemTable* m = MemTable_new(MEMTABLE_DEFAULT_BUDGET);
+  wal = WAL_open(filename);
+  assert(WAL_load_memtable(wal, m) == 0);
+  assert(m->size == 2 * WAL_BUFFER_SIZE / sizeof(key) + 1);
+  assert(MemTable_get(m, "apple", 6)->value_loc == 7);
+  WAL_free(wal);
+  MemTable_free(m);
+
+  remove(filename);
+}
+
 int
 main()
 {
@@ -190,6 +758,21 @@ main()
 
   // Load MemTable
   TestWAL_load_memtable();
+  TestWAL_load_memtable_batches();
+  TestWAL_load_memtable_truncated();
+  TestWAL_load_memtable_fixed();
+  TestWAL_load_memtable_values();
+  TestWAL_load_memtable_loc();
+  TestWAL_load_memtable_sized();
+
+  // Segments
+  TestWAL_segment();
+  TestWAL_split();
+
+  // Group Commit
+  TestWAL_group_commit();
+  TestWAL_buffer();
+  TestWAL_io_uring();
 
   return 0;
 }
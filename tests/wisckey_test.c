@@ -0,0 +1,1554 @@
+/*
+ * Copyright 2025 Adam Bishop Comer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/wisckey.h"
+
+#define TEST_DIR "wisckey_test.db"
+#define TEST_KEYS 3000
+#define TEST_MEMTABLE_SIZE (32 * 1024)
+#define TEST_THREADS 4
+#define TEST_GC_VALUE_SIZE 512
+#define TEST_GC_ROUNDS 4
+
+static void
+remove_dir(const char* path)
+{
+  DIR* dir = opendir(path);
+  if (dir == NULL) {
+    return;
+  }
+
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    char file[512];
+    snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+    remove(file);
+  }
+  closedir(dir);
+
+  rmdir(path);
+}
+
+static size_t
+count_files(const char* path, const char* suffix)
+{
+  DIR* dir = opendir(path);
+  assert(dir != NULL);
+
+  size_t count = 0;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    size_t len = strlen(entry->d_name);
+    size_t suffix_len = strlen(suffix);
+    if (len > suffix_len &&
+        strcmp(entry->d_name + len - suffix_len, suffix) == 0) {
+      count++;
+    }
+  }
+  closedir(dir);
+
+  return count;
+}
+
+static struct WiscKeyDB*
+open_db_with(struct WiscKeyDBOptions* options)
+{
+  // Small MemTables so the tests go through several flushes.
+  options->memtable_size = TEST_MEMTABLE_SIZE;
+
+  return WiscKeyDB_open(TEST_DIR, options);
+}
+
+static struct WiscKeyDB*
+open_db()
+{
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+
+  return open_db_with(&options);
+}
+
+static void
+make_key(char* key, uint32_t i)
+{
+  snprintf(key, 16, "key-%08u", i);
+}
+
+static void
+make_value(char* value, uint32_t i, uint32_t version)
+{
+  snprintf(value, 32, "value-%08u-%u", i, version);
+}
+
+void
+TestWiscKeyDB_new()
+{
+  remove_dir(TEST_DIR);
+
+  struct WiscKeyDB* db = WiscKeyDB_new(TEST_DIR);
+  assert(db != NULL);
+  assert(count_files(TEST_DIR, ".wal") == 1);
+
+  WiscKeyDB_free(db);
+
+  remove_dir(TEST_DIR);
+}
+
+void
+TestWiscKeyDB_set_get_delete()
+{
+  remove_dir(TEST_DIR);
+
+  struct WiscKeyDB* db = WiscKeyDB_new(TEST_DIR);
+
+  char* key = "apple";
+  char* value1 = "Apple Pie";
+  char* value2 = "Apple Crumble";
+
+  assert(WiscKeyDB_get(db, NULL, key, strlen(key) + 1) == 0);
+
+  assert(WiscKeyDB_set(db, key, value1, strlen(key) + 1, strlen(value1) + 1) ==
+         0);
+
+  char buf[64];
+  size_t len = WiscKeyDB_get(db, NULL, key, strlen(key) + 1);
+  assert(len == strlen(value1) + 1);
+  assert(WiscKeyDB_get(db, buf, key, strlen(key) + 1) == len);
+  assert(memcmp(buf, value1, len) == 0);
+
+  assert(WiscKeyDB_set(db, key, value2, strlen(key) + 1, strlen(value2) + 1) ==
+         0);
+  len = WiscKeyDB_get(db, buf, key, strlen(key) + 1);
+  assert(len == strlen(value2) + 1);
+  assert(memcmp(buf, value2, len) == 0);
+
+  assert(WiscKeyDB_delete(db, key, strlen(key) + 1) == 0);
+  assert(WiscKeyDB_get(db, buf, key, strlen(key) + 1) == 0);
+
+  WiscKeyDB_free(db);
+
+  remove_dir(TEST_DIR);
+}
+
+void
+TestWiscKeyDB_get_into()
+{
+  remove_dir(TEST_DIR);
+
+  struct WiscKeyDB* db = WiscKeyDB_new(TEST_DIR);
+
+  char* key = "apple";
+  char* value = "Apple Pie";
+  assert(WiscKeyDB_set(db, key, value, strlen(key) + 1, strlen(value) + 1) ==
+         0);
+
+  // The length is returned when the buffer is too small.
+  char buf[64];
+  memset(buf, 0, sizeof(buf));
+  size_t len = WiscKeyDB_get_into(db, NULL, 0, key, strlen(key) + 1);
+  assert(len == strlen(value) + 1);
+  assert(WiscKeyDB_get_into(db, buf, len - 1, key, strlen(key) + 1) == len);
+  assert(buf[0] == 0);
+  assert(WiscKeyDB_get_into(db, buf, len, key, strlen(key) + 1) == len);
+  assert(memcmp(buf, value, len) == 0);
+
+  assert(WiscKeyDB_get_into(db, buf, sizeof(buf), "lime", 5) == 0);
+
+  WiscKeyDB_free(db);
+
+  remove_dir(TEST_DIR);
+}
+
+void
+TestWiscKeyDB_get_slice()
+{
+  remove_dir(TEST_DIR);
+
+  struct WiscKeyDB* db = open_db();
+
+  char key[16];
+  char value[32];
+  for (uint32_t i = 0; i < TEST_KEYS; i++) {
+    make_key(key, i);
+    make_value(value, i, 0);
+    assert(WiscKeyDB_set(db, key, value, strlen(key), strlen(value)) == 0);
+  }
+
+  // Slices stay valid while other values are written and read.
+  struct WiscKeyDBSlice slices[TEST_THREADS];
+  for (uint32_t i = 0; i < TEST_THREADS; i++) {
+    make_key(key, i);
+    assert(WiscKeyDB_get_slice(db, &slices[i], key, strlen(key)) == 0);
+    make_key(key, i + TEST_THREADS);
+    make_value(value, i + TEST_THREADS, 1);
+    assert(WiscKeyDB_set(db, key, value, strlen(key), strlen(value)) == 0);
+  }
+  for (uint32_t i = 0; i < TEST_THREADS; i++) {
+    make_value(value, i, 0);
+    assert(slices[i].len == strlen(value));
+    assert(memcmp(slices[i].data, value, slices[i].len) == 0);
+    WiscKeyDB_release_slice(db, &slices[i]);
+  }
+
+  assert(WiscKeyDB_delete(db, key, strlen(key)) == 0);
+  assert(WiscKeyDB_get_slice(db, &slices[0], key, strlen(key)) == -1);
+
+  WiscKeyDB_free(db);
+
+  remove_dir(TEST_DIR);
+}
+
+static void
+check_values(struct WiscKeyDB* db)
+{
+  char key[16];
+  char value[32];
+  char buf[32];
+
+  for (uint32_t i = 0; i < TEST_KEYS; i++) {
+    make_key(key, i);
+    size_t len = WiscKeyDB_get(db, buf, key, strlen(key));
+
+    if (i % 7 == 0 && i % 2 == 1) {
+      assert(len == 0);
+      continue;
+    }
+
+    make_value(value, i, i % 7 == 0 ? 1 : 0);
+    assert(len == strlen(value));
+    assert(memcmp(buf, value, len) == 0);
+  }
+}
+
+static void
+check_flush(struct WiscKeyDB* db)
+{
+  char key[16];
+  char value[32];
+
+  // Fill several MemTables so they are frozen and flushed in the background.
+  for (uint32_t i = 0; i < TEST_KEYS; i++) {
+    make_key(key, i);
+    make_value(value, i, 0);
+    assert(WiscKeyDB_set(db, key, value, strlen(key), strlen(value)) == 0);
+  }
+
+  // Overwrite and delete keys that have already been flushed.
+  for (uint32_t i = 0; i < TEST_KEYS; i += 7) {
+    make_key(key, i);
+    if (i % 2 == 0) {
+      make_value(value, i, 1);
+      assert(WiscKeyDB_set(db, key, value, strlen(key), strlen(value)) == 0);
+    } else {
+      assert(WiscKeyDB_delete(db, key, strlen(key)) == 0);
+    }
+  }
+
+  check_values(db);
+
+  WiscKeyDB_free(db);
+}
+
+void
+TestWiscKeyDB_flush()
+{
+  remove_dir(TEST_DIR);
+
+  check_flush(open_db());
+
+  // Only the WAL of the active MemTable is left, the others were retired.
+  assert(count_files(TEST_DIR, ".wal") == 1);
+  assert(count_files(TEST_DIR, ".sstable") >= 3);
+
+  remove_dir(TEST_DIR);
+}
+
+void
+TestWiscKeyDB_flush_hash_index()
+{
+  remove_dir(TEST_DIR);
+
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.memtable_hash_index = 1;
+
+  check_flush(open_db_with(&options));
+  assert(count_files(TEST_DIR, ".sstable") >= 3);
+
+  remove_dir(TEST_DIR);
+}
+
+void
+TestWiscKeyDB_shards_hash()
+{
+  remove_dir(TEST_DIR);
+
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.memtable_shards = 4;
+
+  check_flush(open_db_with(&options));
+  assert(count_files(TEST_DIR, ".wal") == 4);
+
+  // The database can be reopened with a different number of shards.
+  struct WiscKeyDB* db = open_db();
+  assert(db != NULL);
+  check_values(db);
+  WiscKeyDB_free(db);
+
+  remove_dir(TEST_DIR);
+}
+
+void
+TestWiscKeyDB_recover_parallel()
+{
+  remove_dir(TEST_DIR);
+
+  // Every shard leaves the WAL of its active MemTable behind.
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.memtable_shards = 8;
+  options.memtable_size = 1024 * 1024;
+
+  struct WiscKeyDB* db = WiscKeyDB_open(TEST_DIR, &options);
+  char key[16];
+  char value[32];
+  for (uint32_t version = 0; version < 2; version++) {
+    for (uint32_t i = 0; i < TEST_KEYS; i++) {
+      make_key(key, i);
+      make_value(value, i, version);
+      assert(WiscKeyDB_set(db, key, value, strlen(key), strlen(value)) == 0);
+    }
+  }
+  WiscKeyDB_free(db);
+  assert(count_files(TEST_DIR, ".wal") == 8);
+  assert(count_files(TEST_DIR, ".sstable") == 0);
+
+  // The WALs are replayed by several threads into one SSTable each.
+  WiscKeyDBOptions_init(&options);
+  options.recovery_threads = 3;
+  db = WiscKeyDB_open(TEST_DIR, &options);
+  assert(db != NULL);
+  assert(count_files(TEST_DIR, ".sstable") == 8);
+
+  char buf[32];
+  for (uint32_t i = 0; i < TEST_KEYS; i++) {
+    make_key(key, i);
+    make_value(value, i, 1);
+    assert(WiscKeyDB_get(db, buf, key, strlen(key)) == strlen(value));
+    assert(memcmp(buf, value, strlen(value)) == 0);
+  }
+  WiscKeyDB_free(db);
+
+  remove_dir(TEST_DIR);
+
+  // A single WAL of inline values is split into ranges for the threads, and
+  // the later ranges override the earlier ones.
+  WiscKeyDBOptions_init(&options);
+  options.memtable_size = 64 * 1024 * 1024;
+  options.inline_value_size = 2048;
+  db = WiscKeyDB_open(TEST_DIR, &options);
+  char large[1024];
+  for (uint32_t version = 0; version < 2; version++) {
+    for (uint32_t i = 0; i < TEST_KEYS; i++) {
+      make_key(key, i);
+      memset(large, 'a' + (char)version, sizeof(large));
+      memcpy(large, &i, sizeof(i));
+      assert(WiscKeyDB_set(db, key, large, strlen(key), sizeof(large)) == 0);
+    }
+  }
+  WiscKeyDB_free(db);
+  assert(count_files(TEST_DIR, ".wal") == 1);
+
+  options.recovery_threads = 4;
+  db = WiscKeyDB_open(TEST_DIR, &options);
+  assert(db != NULL);
+  assert(count_files(TEST_DIR, ".sstable") == 4);
+
+  char large_buf[1024];
+  for (uint32_t i = 0; i < TEST_KEYS; i++) {
+    make_key(key, i);
+    memset(large, 'b', sizeof(large));
+    memcpy(large, &i, sizeof(i));
+    assert(WiscKeyDB_get(db, large_buf, key, strlen(key)) == sizeof(large));
+    assert(memcmp(large_buf, large, sizeof(large)) == 0);
+  }
+  WiscKeyDB_free(db);
+
+  remove_dir(TEST_DIR);
+}
+
+void
+TestWiscKeyDB_shards_split()
+{
+  remove_dir(TEST_DIR);
+
+  char* split_keys[] = { "key-00001000", "key-00002000" };
+  size_t split_key_lengths[] = { 12, 12 };
+
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.memtable_shards = 3;
+  options.split_keys = split_keys;
+  options.split_key_lengths = split_key_lengths;
+
+  check_flush(open_db_with(&options));
+  assert(count_files(TEST_DIR, ".wal") == 3);
+
+  // Split keys that are out of order are rejected.
+  split_keys[0] = "key-00003000";
+  assert(open_db_with(&options) == NULL);
+
+  remove_dir(TEST_DIR);
+}
+
+static void
+copy_file(const char* from, const char* to)
+{
+  FILE* src = fopen(from, "r");
+  FILE* dst = fopen(to, "w");
+  assert(src != NULL && dst != NULL);
+
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), src)) > 0) {
+    assert(fwrite(buf, 1, n, dst) == n);
+  }
+
+  fclose(src);
+  fclose(dst);
+}
+
+void
+TestWiscKeyDB_wal_segments()
+{
+  remove_dir(TEST_DIR);
+
+  // Segments smaller than the MemTables freeze the MemTables early.
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.wal_segment_size = TEST_MEMTABLE_SIZE / 4;
+
+  check_flush(open_db_with(&options));
+  assert(count_files(TEST_DIR, ".sstable") >= 8);
+
+  // Retired WALs are kept for reuse, one per shard.
+  assert(count_files(TEST_DIR, ".wal") == 1);
+  assert(count_files(TEST_DIR, ".wal.recycle") <= 1);
+
+  // A WAL whose header doesn't match its name, like a recycled file that was
+  // renamed but never written to, is skipped on recovery.
+  DIR* dir = opendir(TEST_DIR);
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    size_t len = strlen(entry->d_name);
+    if (len > 4 && strcmp(entry->d_name + len - 4, ".wal") == 0) {
+      break;
+    }
+  }
+  assert(entry != NULL);
+  char from[512];
+  snprintf(from, sizeof(from), "%s/%s", TEST_DIR, entry->d_name);
+  closedir(dir);
+  copy_file(from, TEST_DIR "/1000000.wal");
+
+  struct WiscKeyDB* db = open_db_with(&options);
+  assert(db != NULL);
+  check_values(db);
+  WiscKeyDB_free(db);
+
+  assert(count_files(TEST_DIR, ".wal") == 1);
+  assert(count_files(TEST_DIR, ".wal.recycle") <= 1);
+
+  remove_dir(TEST_DIR);
+}
+
+struct WriterArgs
+{
+  struct WiscKeyDB* db;
+  uint32_t thread;
+};
+
+static void*
+write_keys(void* arg)
+{
+  struct WriterArgs* args = arg;
+
+  char key[16];
+  char value[32];
+  for (uint32_t i = args->thread; i < TEST_KEYS; i += TEST_THREADS) {
+    make_key(key, i);
+    make_value(value, i, 0);
+    assert(WiscKeyDB_set(args->db, key, value, strlen(key), strlen(value)) ==
+           0);
+  }
+
+  return NULL;
+}
+
+static void
+check_concurrent(struct WiscKeyDBOptions* options)
+{
+  remove_dir(TEST_DIR);
+
+  struct WiscKeyDB* db = open_db_with(options);
+
+  pthread_t threads[TEST_THREADS];
+  struct WriterArgs args[TEST_THREADS];
+  for (uint32_t i = 0; i < TEST_THREADS; i++) {
+    args[i].db = db;
+    args[i].thread = i;
+    assert(pthread_create(&threads[i], NULL, write_keys, &args[i]) == 0);
+  }
+  for (uint32_t i = 0; i < TEST_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  char key[16];
+  char value[32];
+  char buf[32];
+  for (uint32_t i = 0; i < TEST_KEYS; i++) {
+    make_key(key, i);
+    make_value(value, i, 0);
+    assert(WiscKeyDB_get(db, buf, key, strlen(key)) == strlen(value));
+    assert(memcmp(buf, value, strlen(value)) == 0);
+  }
+
+  WiscKeyDB_free(db);
+
+  remove_dir(TEST_DIR);
+}
+
+void
+TestWiscKeyDB_shards_concurrent()
+{
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.memtable_shards = TEST_THREADS;
+
+  check_concurrent(&options);
+}
+
+void
+TestWiscKeyDB_sync_writes()
+{
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.sync_writes = 1;
+
+  check_concurrent(&options);
+
+  remove_dir(TEST_DIR);
+
+  // Synced deletes.
+  struct WiscKeyDB* db = open_db_with(&options);
+  assert(WiscKeyDB_set(db, "key", "value", 3, 5) == 0);
+  assert(WiscKeyDB_delete(db, "key", 3) == 0);
+  assert(WiscKeyDB_get(db, NULL, "key", 3) == 0);
+  WiscKeyDB_free(db);
+
+  remove_dir(TEST_DIR);
+
+  // Synced writes through io_uring, or `fdatasync` if it isn't available.
+  options.wal_io_uring = 1;
+  check_concurrent(&options);
+}
+
+void
+TestWiscKeyDB_recover()
+{
+  remove_dir(TEST_DIR);
+
+  struct WiscKeyDB* db = open_db();
+
+  char key[16];
+  char value[32];
+  char buf[32];
+
+  for (uint32_t i = 0; i < TEST_KEYS; i++) {
+    make_key(key, i);
+    make_value(value, i, 0);
+    assert(WiscKeyDB_set(db, key, value, strlen(key), strlen(value)) == 0);
+  }
+  make_key(key, 0);
+  assert(WiscKeyDB_delete(db, key, strlen(key)) == 0);
+
+  WiscKeyDB_free(db);
+
+  db = open_db();
+  assert(db != NULL);
+
+  // The WAL of the last run is flushed on open.
+  assert(count_files(TEST_DIR, ".wal") == 1);
+
+  assert(WiscKeyDB_get(db, buf, key, strlen(key)) == 0);
+  for (uint32_t i = 1; i < TEST_KEYS; i++) {
+    make_key(key, i);
+    make_value(value, i, 0);
+    size_t len = WiscKeyDB_get(db, buf, key, strlen(key));
+    assert(len == strlen(value));
+    assert(memcmp(buf, value, len) == 0);
+  }
+
+  // New values are appended after the recovered ones.
+  make_key(key, 1);
+  make_value(value, 1, 2);
+  assert(WiscKeyDB_set(db, key, value, strlen(key), strlen(value)) == 0);
+  assert(WiscKeyDB_get(db, buf, key, strlen(key)) == strlen(value));
+  assert(memcmp(buf, value, strlen(value)) == 0);
+
+  make_key(key, 2);
+  make_value(value, 2, 0);
+  assert(WiscKeyDB_get(db, buf, key, strlen(key)) == strlen(value));
+  assert(memcmp(buf, value, strlen(value)) == 0);
+
+  WiscKeyDB_free(db);
+
+  remove_dir(TEST_DIR);
+}
+
+void
+TestWiscKeyDB_value_log_wal()
+{
+  remove_dir(TEST_DIR);
+
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.value_log_wal = 1;
+
+  // The active MemTable is only in the ValueLog when the database closes.
+  check_flush(open_db_with(&options));
+  assert(count_files(TEST_DIR, ".wal") == 0);
+  assert(count_files(TEST_DIR, ".checkpoint") == 1);
+
+  struct WiscKeyDB* db = open_db_with(&options);
+  assert(db != NULL);
+  check_values(db);
+  WiscKeyDB_free(db);
+
+  // Deletes survive a switch between the two modes.
+  db = open_db();
+  assert(db != NULL);
+  check_values(db);
+  assert(WiscKeyDB_delete(db, "key-00000002", 12) == 0);
+  WiscKeyDB_free(db);
+  assert(count_files(TEST_DIR, ".checkpoint") == 0);
+
+  db = open_db_with(&options);
+  assert(db != NULL);
+  assert(WiscKeyDB_get(db, NULL, "key-00000002", 12) == 0);
+  assert(WiscKeyDB_delete(db, "key-00000003", 12) == 0);
+  WiscKeyDB_free(db);
+
+  db = open_db();
+  assert(db != NULL);
+  assert(WiscKeyDB_get(db, NULL, "key-00000003", 12) == 0);
+  WiscKeyDB_free(db);
+
+  // Synced writes only sync the ValueLog.
+  options.sync_writes = 1;
+  check_concurrent(&options);
+}
+
+static size_t
+read_checkpoint()
+{
+  FILE* file = fopen(TEST_DIR "/value.log.checkpoint", "r");
+  assert(file != NULL);
+  uint64_t checkpoint;
+  assert(fread(&checkpoint, sizeof(checkpoint), 1, file) == 1);
+  fclose(file);
+
+  return checkpoint;
+}
+
+void
+TestWiscKeyDB_value_log_wal_checkpoint()
+{
+  remove_dir(TEST_DIR);
+
+  char* split_keys[] = { "key-00001000" };
+  size_t split_key_lengths[] = { 12 };
+
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.value_log_wal = 1;
+  options.memtable_shards = 2;
+  options.split_keys = split_keys;
+  options.split_key_lengths = split_key_lengths;
+
+  // Only the first shard is written to, or the second one only once, and the
+  // flushes of the first shard still move the checkpoint.
+  char key[16];
+  char value[32];
+  for (uint32_t cold_writes = 0; cold_writes < 2; cold_writes++) {
+    struct WiscKeyDB* db = open_db_with(&options);
+    assert(db != NULL);
+    size_t checkpoint = read_checkpoint();
+
+    if (cold_writes > 0) {
+      make_key(key, 2000);
+      make_value(value, 2000, 0);
+      assert(WiscKeyDB_set(db, key, value, strlen(key), strlen(value)) == 0);
+    }
+    for (uint32_t version = 0; version < TEST_GC_ROUNDS; version++) {
+      for (uint32_t i = 0; i < 1000; i++) {
+        make_key(key, i);
+        make_value(value, i, version);
+        assert(WiscKeyDB_set(db, key, value, strlen(key), strlen(value)) ==
+               0);
+      }
+    }
+    WiscKeyDB_free(db);
+
+    assert(read_checkpoint() > checkpoint);
+  }
+
+  struct WiscKeyDB* db = open_db_with(&options);
+  assert(db != NULL);
+  char buf[32];
+  make_key(key, 2000);
+  make_value(value, 2000, 0);
+  assert(WiscKeyDB_get(db, buf, key, strlen(key)) == strlen(value));
+  assert(memcmp(buf, value, strlen(value)) == 0);
+  WiscKeyDB_free(db);
+
+  remove_dir(TEST_DIR);
+}
+
+static size_t
+value_log_allocated()
+{
+  struct stat st;
+  assert(stat(TEST_DIR "/value.log", &st) == 0);
+
+  return (size_t)st.st_blocks * 512;
+}
+
+static void
+make_gc_value(char* value, uint32_t i, uint32_t round)
+{
+  memset(value, 'a' + round, TEST_GC_VALUE_SIZE);
+  make_value(value, i, round);
+}
+
+/*
+ * Overwrites every key TEST_GC_ROUNDS times, so all but the last round of
+ * values are garbage, and deletes every 7th key.
+ */
+static void
+write_gc_rounds(struct WiscKeyDB* db)
+{
+  char key[16];
+  char value[TEST_GC_VALUE_SIZE];
+
+  for (uint32_t round = 0; round < TEST_GC_ROUNDS; round++) {
+    for (uint32_t i = 0; i < TEST_KEYS; i++) {
+      make_key(key, i);
+      make_gc_value(value, i, round);
+      assert(WiscKeyDB_set(db, key, value, strlen(key), sizeof(value)) == 0);
+    }
+  }
+  for (uint32_t i = 0; i < TEST_KEYS; i += 7) {
+    make_key(key, i);
+    assert(WiscKeyDB_delete(db, key, strlen(key)) == 0);
+  }
+}
+
+static void
+check_gc_values(struct WiscKeyDB* db)
+{
+  char key[16];
+  char value[TEST_GC_VALUE_SIZE];
+  char buf[TEST_GC_VALUE_SIZE];
+
+  for (uint32_t i = 0; i < TEST_KEYS; i++) {
+    make_key(key, i);
+    size_t len = WiscKeyDB_get(db, buf, key, strlen(key));
+    if (i % 7 == 0) {
+      assert(len == 0);
+      continue;
+    }
+
+    make_gc_value(value, i, TEST_GC_ROUNDS - 1);
+    assert(len == sizeof(value));
+    assert(memcmp(buf, value, len) == 0);
+  }
+}
+
+static void
+check_gc(struct WiscKeyDBOptions* options)
+{
+  remove_dir(TEST_DIR);
+
+  struct WiscKeyDB* db = open_db_with(options);
+  write_gc_rounds(db);
+  size_t before = value_log_allocated();
+
+  assert(WiscKeyDB_gc(db) == 0);
+  check_gc_values(db);
+  size_t after = value_log_allocated();
+  assert(after < before / 2);
+  WiscKeyDB_free(db);
+
+  // The tail is persisted, and the values moved by the collector survive a
+  // restart.
+  db = open_db_with(options);
+  assert(db != NULL);
+  check_gc_values(db);
+  assert(WiscKeyDB_gc(db) == 0);
+  check_gc_values(db);
+  WiscKeyDB_free(db);
+
+  remove_dir(TEST_DIR);
+}
+
+void
+TestWiscKeyDB_gc()
+{
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.memtable_shards = TEST_THREADS;
+  check_gc(&options);
+
+  // Only the entries before the checkpoint are collected, which is all of them
+  // after a restart.
+  options.value_log_wal = 1;
+  check_gc(&options);
+}
+
+void
+TestWiscKeyDB_gc_thread()
+{
+  remove_dir(TEST_DIR);
+
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.value_log_gc_rate = 64 * 1024 * 1024;
+
+  // The collector runs alongside the writes.
+  struct WiscKeyDB* db = open_db_with(&options);
+  write_gc_rounds(db);
+  size_t before = value_log_allocated();
+
+  for (int i = 0; i < 100 && value_log_allocated() >= before / 2; i++) {
+    usleep(100 * 1000);
+  }
+  assert(value_log_allocated() < before / 2);
+  check_gc_values(db);
+  WiscKeyDB_free(db);
+
+  db = open_db_with(&options);
+  assert(db != NULL);
+  check_gc_values(db);
+  WiscKeyDB_free(db);
+
+  remove_dir(TEST_DIR);
+}
+
+static size_t
+segments_allocated()
+{
+  DIR* dir = opendir(TEST_DIR);
+  assert(dir != NULL);
+
+  size_t allocated = 0;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    size_t len = strlen(entry->d_name);
+    if (len > 5 && strcmp(entry->d_name + len - 5, ".vlog") == 0) {
+      char file[512];
+      snprintf(file, sizeof(file), "%s/%s", TEST_DIR, entry->d_name);
+      struct stat st;
+      assert(stat(file, &st) == 0);
+      allocated += (size_t)st.st_blocks * 512;
+    }
+  }
+  closedir(dir);
+
+  return allocated;
+}
+
+static size_t
+segments_garbage()
+{
+  DIR* dir = opendir(TEST_DIR);
+  assert(dir != NULL);
+
+  // The garbage of a segment is stored after its magic number and version.
+  size_t garbage = 0;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    size_t len = strlen(entry->d_name);
+    if (len > 5 && strcmp(entry->d_name + len - 5, ".vlog") == 0) {
+      char file[512];
+      snprintf(file, sizeof(file), "%s/%s", TEST_DIR, entry->d_name);
+      FILE* segment = fopen(file, "r");
+      assert(segment != NULL);
+      uint64_t segment_garbage;
+      assert(fseek(segment, 2 * sizeof(uint32_t), SEEK_SET) == 0);
+      assert(fread(&segment_garbage, sizeof(uint64_t), 1, segment) == 1);
+      fclose(segment);
+      garbage += segment_garbage;
+    }
+  }
+  closedir(dir);
+
+  return garbage;
+}
+
+static void
+check_gc_segments(struct WiscKeyDBOptions* options)
+{
+  remove_dir(TEST_DIR);
+
+  struct WiscKeyDB* db = open_db_with(options);
+  write_gc_rounds(db);
+  size_t before = segments_allocated();
+  size_t files = count_files(TEST_DIR, ".vlog");
+  assert(files > 1);
+
+  // The collected segments are deleted.
+  assert(WiscKeyDB_gc(db) == 0);
+  check_gc_values(db);
+  assert(segments_allocated() < before / 2);
+  assert(count_files(TEST_DIR, ".vlog") < files);
+  WiscKeyDB_free(db);
+
+  // The values moved by the collector survive a restart.
+  db = open_db_with(options);
+  assert(db != NULL);
+  check_gc_values(db);
+  assert(WiscKeyDB_gc(db) == 0);
+  check_gc_values(db);
+  WiscKeyDB_free(db);
+
+  remove_dir(TEST_DIR);
+}
+
+void
+TestWiscKeyDB_gc_segments()
+{
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.value_log_segment = 64 * 1024;
+  check_gc_segments(&options);
+
+  options.value_log_wal = 1;
+  check_gc_segments(&options);
+
+  // Segments with less than the share of garbage are left alone.
+  options.value_log_wal = 0;
+  options.value_log_gc_ratio = 1.1;
+  remove_dir(TEST_DIR);
+  struct WiscKeyDB* db = open_db_with(&options);
+  write_gc_rounds(db);
+  size_t files = count_files(TEST_DIR, ".vlog");
+  assert(WiscKeyDB_gc(db) == 0);
+  assert(count_files(TEST_DIR, ".vlog") == files);
+  check_gc_values(db);
+  WiscKeyDB_free(db);
+  remove_dir(TEST_DIR);
+  options.value_log_gc_ratio = 0.5;
+
+  // A database with a single ValueLog file can't be opened with segments.
+  options.value_log_wal = 0;
+  options.value_log_segment = 0;
+  db = open_db_with(&options);
+  WiscKeyDB_free(db);
+  options.value_log_segment = 64 * 1024;
+  assert(open_db_with(&options) == NULL);
+
+  remove_dir(TEST_DIR);
+}
+
+void
+TestWiscKeyDB_gc_segments_replay()
+{
+  remove_dir(TEST_DIR);
+
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.memtable_shards = TEST_THREADS;
+  options.value_log_segment = 64 * 1024;
+  options.value_log_wal = 1;
+  options.inline_value_size = 0;
+
+  // Every key is written once, so none of the values are garbage.
+  struct WiscKeyDB* db = open_db_with(&options);
+  char key[16];
+  char value[32];
+  for (uint32_t i = 0; i < TEST_KEYS; i++) {
+    make_key(key, i);
+    make_value(value, i, 0);
+    assert(WiscKeyDB_set(db, key, value, strlen(key), strlen(value)) == 0);
+  }
+  WiscKeyDB_free(db);
+  assert(segments_garbage() == 0);
+
+  // The replayed records that are already in SSTables point at the same
+  // values, which stay live.
+  char buf[32];
+  for (int i = 0; i < 2; i++) {
+    db = open_db_with(&options);
+    assert(db != NULL);
+    for (uint32_t j = 0; j < TEST_KEYS; j++) {
+      make_key(key, j);
+      make_value(value, j, 0);
+      assert(WiscKeyDB_get(db, buf, key, strlen(key)) == strlen(value));
+      assert(memcmp(buf, value, strlen(value)) == 0);
+    }
+    WiscKeyDB_free(db);
+    assert(segments_garbage() == 0);
+  }
+
+  remove_dir(TEST_DIR);
+}
+
+static void
+check_gc_slices(struct WiscKeyDB* db)
+{
+  char key[16];
+  char value[TEST_GC_VALUE_SIZE];
+
+  for (uint32_t i = 1; i < TEST_KEYS; i += 7) {
+    make_key(key, i);
+    struct WiscKeyDBSlice slice;
+    assert(WiscKeyDB_get_slice(db, &slice, key, strlen(key)) == 0);
+
+    make_gc_value(value, i, TEST_GC_ROUNDS - 1);
+    assert(slice.len == sizeof(value));
+    assert(memcmp(slice.data, value, slice.len) == 0);
+    WiscKeyDB_release_slice(db, &slice);
+  }
+}
+
+void
+TestWiscKeyDB_value_cache()
+{
+  remove_dir(TEST_DIR);
+
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.value_cache_size = 4 * 1024 * 1024;
+  struct WiscKeyDB* db = open_db_with(&options);
+  write_gc_rounds(db);
+
+  // The first read of every value misses and the second one hits.
+  check_gc_values(db);
+  check_gc_values(db);
+  size_t live = TEST_KEYS - (TEST_KEYS + 6) / 7;
+  struct WiscKeyDBCacheStats stats;
+  WiscKeyDB_cache_stats(db, &stats);
+  assert(stats.misses == live);
+  assert(stats.hits == live);
+  assert(stats.evictions == 0);
+  assert(stats.len == live);
+
+  // Deletes and the collector erase the values they leave behind.
+  char key[16];
+  make_key(key, 1);
+  assert(WiscKeyDB_delete(db, key, strlen(key)) == 0);
+  WiscKeyDB_cache_stats(db, &stats);
+  assert(stats.len == live - 1);
+  assert(WiscKeyDB_gc(db) == 0);
+  WiscKeyDB_cache_stats(db, &stats);
+  assert(stats.len == 0);
+
+  char value[TEST_GC_VALUE_SIZE];
+  assert(WiscKeyDB_get(db, value, key, strlen(key)) == 0);
+  make_gc_value(value, 1, TEST_GC_ROUNDS - 1);
+  assert(WiscKeyDB_set(db, key, value, strlen(key), sizeof(value)) == 0);
+  check_gc_values(db);
+  WiscKeyDB_free(db);
+
+  // A cache smaller than the values evicts them.
+  options.value_cache_size = 64 * 1024;
+  db = open_db_with(&options);
+  check_gc_values(db);
+  WiscKeyDB_cache_stats(db, &stats);
+  assert(stats.evictions > 0);
+  assert(stats.size <= options.value_cache_size);
+  WiscKeyDB_free(db);
+
+  remove_dir(TEST_DIR);
+}
+
+static void*
+read_gc_values(void* arg)
+{
+  struct WriterArgs* args = arg;
+
+  for (uint32_t i = 0; i < TEST_GC_ROUNDS; i++) {
+    check_gc_values(args->db);
+    check_gc_slices(args->db);
+  }
+
+  return NULL;
+}
+
+static void
+check_gc_concurrent_reads(struct WiscKeyDBOptions* options)
+{
+  remove_dir(TEST_DIR);
+
+  options->memtable_shards = TEST_THREADS;
+  struct WiscKeyDB* db = open_db_with(options);
+  write_gc_rounds(db);
+
+  // Readers that race the collector find the moved values.
+  pthread_t threads[TEST_THREADS];
+  struct WriterArgs args[TEST_THREADS];
+  for (uint32_t i = 0; i < TEST_THREADS; i++) {
+    args[i].db = db;
+    args[i].thread = i;
+    assert(pthread_create(&threads[i], NULL, read_gc_values, &args[i]) == 0);
+  }
+  assert(WiscKeyDB_gc(db) == 0);
+  for (uint32_t i = 0; i < TEST_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  check_gc_values(db);
+
+  WiscKeyDB_free(db);
+
+  remove_dir(TEST_DIR);
+}
+
+void
+TestWiscKeyDB_gc_concurrent_reads()
+{
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  check_gc_concurrent_reads(&options);
+
+  // Readers that race the removal of a segment.
+  options.value_log_segment = 64 * 1024;
+  check_gc_concurrent_reads(&options);
+}
+
+/*
+ * Scans the keys in [start, end) and checks that they are in order, hold the
+ * values of `version` and skip every 7th key, which is deleted.
+ */
+static void
+check_scan(struct WiscKeyDB* db, uint32_t start, uint32_t end, uint32_t version)
+{
+  char start_key[16];
+  char end_key[16];
+  make_key(start_key, start);
+  make_key(end_key, end);
+  struct WiscKeyDBScan* scan =
+    WiscKeyDB_scan(db,
+                   start > 0 ? start_key : NULL,
+                   strlen(start_key),
+                   end < TEST_KEYS ? end_key : NULL,
+                   strlen(end_key));
+  assert(scan != NULL);
+
+  char expected_key[16];
+  char expected_value[32];
+  const char* key;
+  size_t key_len;
+  const char* value;
+  size_t value_len;
+  for (uint32_t i = start; i < end; i++) {
+    if (i % 7 == 0) {
+      continue;
+    }
+    assert(WiscKeyDBScan_next(scan, &key, &key_len, &value, &value_len) == 1);
+
+    make_key(expected_key, i);
+    make_value(expected_value, i, version);
+    assert(key_len == strlen(expected_key));
+    assert(memcmp(key, expected_key, key_len) == 0);
+    assert(value_len == strlen(expected_value));
+    assert(memcmp(value, expected_value, value_len) == 0);
+  }
+  assert(WiscKeyDBScan_next(scan, &key, &key_len, &value, &value_len) == 0);
+
+  WiscKeyDBScan_free(scan);
+}
+
+static void
+check_scans(struct WiscKeyDBOptions* options)
+{
+  remove_dir(TEST_DIR);
+
+  struct WiscKeyDB* db = open_db_with(options);
+  char key[16];
+  char value[32];
+
+  // The first version is flushed to SSTables and the second one shadows it
+  // from the SSTables and MemTables.
+  for (uint32_t version = 0; version < 2; version++) {
+    for (uint32_t i = 0; i < TEST_KEYS; i++) {
+      make_key(key, i);
+      make_value(value, i, version);
+      assert(WiscKeyDB_set(db, key, value, strlen(key), strlen(value)) == 0);
+    }
+  }
+  for (uint32_t i = 0; i < TEST_KEYS; i += 7) {
+    make_key(key, i);
+    assert(WiscKeyDB_delete(db, key, strlen(key)) == 0);
+  }
+
+  check_scan(db, 0, TEST_KEYS, 1);
+  check_scan(db, 100, 200, 1);
+  check_scan(db, TEST_KEYS - 10, TEST_KEYS, 1);
+  check_scan(db, 500, 500, 1);
+
+  // A scan that is freed before it is done.
+  struct WiscKeyDBScan* scan = WiscKeyDB_scan(db, NULL, 0, NULL, 0);
+  const char* scan_key;
+  size_t key_len;
+  const char* scan_value;
+  size_t value_len;
+  assert(WiscKeyDBScan_next(
+           scan, &scan_key, &key_len, &scan_value, &value_len) == 1);
+  WiscKeyDBScan_free(scan);
+  WiscKeyDB_free(db);
+
+  // Every key is in a SSTable after a restart.
+  db = open_db_with(options);
+  check_scan(db, 0, TEST_KEYS, 1);
+  WiscKeyDB_free(db);
+
+  remove_dir(TEST_DIR);
+}
+
+void
+TestWiscKeyDB_scan()
+{
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  check_scans(&options);
+
+  options.memtable_shards = TEST_THREADS;
+  options.scan_prefetch = 7;
+  check_scans(&options);
+
+  // Values are read by the caller's thread without a read pool.
+  options.scan_threads = 0;
+  check_scans(&options);
+}
+
+static void*
+scan_gc_values(void* arg)
+{
+  struct WriterArgs* args = arg;
+  char expected[TEST_GC_VALUE_SIZE];
+
+  for (uint32_t round = 0; round < TEST_GC_ROUNDS; round++) {
+    struct WiscKeyDBScan* scan = WiscKeyDB_scan(args->db, NULL, 0, NULL, 0);
+    assert(scan != NULL);
+
+    const char* key;
+    size_t key_len;
+    const char* value;
+    size_t value_len;
+    for (uint32_t i = 0; i < TEST_KEYS; i++) {
+      if (i % 7 == 0) {
+        continue;
+      }
+      assert(WiscKeyDBScan_next(scan, &key, &key_len, &value, &value_len) ==
+             1);
+      make_gc_value(expected, i, TEST_GC_ROUNDS - 1);
+      assert(value_len == sizeof(expected));
+      assert(memcmp(value, expected, value_len) == 0);
+    }
+    assert(WiscKeyDBScan_next(scan, &key, &key_len, &value, &value_len) == 0);
+    WiscKeyDBScan_free(scan);
+  }
+
+  return NULL;
+}
+
+void
+TestWiscKeyDB_scan_gc()
+{
+  remove_dir(TEST_DIR);
+
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.memtable_shards = TEST_THREADS;
+  struct WiscKeyDB* db = open_db_with(&options);
+  write_gc_rounds(db);
+
+  // Scans that race the collector find the moved values.
+  pthread_t threads[TEST_THREADS];
+  struct WriterArgs args[TEST_THREADS];
+  for (uint32_t i = 0; i < TEST_THREADS; i++) {
+    args[i].db = db;
+    args[i].thread = i;
+    assert(pthread_create(&threads[i], NULL, scan_gc_values, &args[i]) == 0);
+  }
+  assert(WiscKeyDB_gc(db) == 0);
+  for (uint32_t i = 0; i < TEST_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  WiscKeyDB_free(db);
+
+  remove_dir(TEST_DIR);
+}
+
+/*
+ * Checks the mix of inline and separated values written by
+ * check_inline_values through every read path.
+ */
+static void
+check_inline_reads(struct WiscKeyDB* db, uint32_t round)
+{
+  char key[16];
+  char expected[TEST_GC_VALUE_SIZE];
+  char value[TEST_GC_VALUE_SIZE];
+
+  for (uint32_t i = 0; i < TEST_KEYS; i++) {
+    make_key(key, i);
+    size_t expected_len = 16;
+    if (i % 2 == 0) {
+      make_value(expected, i, round);
+    } else {
+      make_gc_value(expected, i, round);
+      expected_len = sizeof(expected);
+    }
+
+    if (i % 7 == 0) {
+      assert(WiscKeyDB_get_into(db, value, sizeof(value), key, 12) == 0);
+      continue;
+    }
+    assert(WiscKeyDB_get_into(db, value, sizeof(value), key, 12) ==
+           expected_len);
+    assert(memcmp(value, expected, expected_len) == 0);
+    assert(WiscKeyDB_get_into(db, NULL, 0, key, 12) == expected_len);
+
+    struct WiscKeyDBSlice slice;
+    assert(WiscKeyDB_get_slice(db, &slice, key, 12) == 0);
+    assert(slice.len == expected_len);
+    assert(memcmp(slice.data, expected, expected_len) == 0);
+    WiscKeyDB_release_slice(db, &slice);
+  }
+
+  struct WiscKeyDBScan* scan = WiscKeyDB_scan(db, NULL, 0, NULL, 0);
+  assert(scan != NULL);
+  const char* scan_key;
+  size_t key_len;
+  const char* scan_value;
+  size_t value_len;
+  for (uint32_t i = 0; i < TEST_KEYS; i++) {
+    if (i % 7 == 0) {
+      continue;
+    }
+    assert(WiscKeyDBScan_next(
+             scan, &scan_key, &key_len, &scan_value, &value_len) == 1);
+    make_key(key, i);
+    assert(key_len == 12 && memcmp(scan_key, key, 12) == 0);
+    assert(value_len == (i % 2 == 0 ? 16 : TEST_GC_VALUE_SIZE));
+    assert(value_len == 16 || scan_value[value_len - 1] == 'a' + (int)round);
+  }
+  assert(WiscKeyDBScan_next(
+           scan, &scan_key, &key_len, &scan_value, &value_len) == 0);
+  WiscKeyDBScan_free(scan);
+}
+
+static void
+check_inline_values(struct WiscKeyDBOptions* options)
+{
+  remove_dir(TEST_DIR);
+
+  // Every other value is short enough to be kept inline.
+  options->inline_value_size = 64;
+  struct WiscKeyDB* db = open_db_with(options);
+  char key[16];
+  char value[TEST_GC_VALUE_SIZE];
+  for (uint32_t round = 0; round < 2; round++) {
+    for (uint32_t i = 0; i < TEST_KEYS; i++) {
+      make_key(key, i);
+      size_t value_len = 16;
+      if (i % 2 == 0) {
+        make_value(value, i, round);
+      } else {
+        make_gc_value(value, i, round);
+        value_len = sizeof(value);
+      }
+      assert(WiscKeyDB_set(db, key, value, 12, value_len) == 0);
+    }
+  }
+  for (uint32_t i = 0; i < TEST_KEYS; i += 7) {
+    make_key(key, i);
+    assert(WiscKeyDB_delete(db, key, 12) == 0);
+  }
+  check_inline_reads(db, 1);
+  WiscKeyDB_free(db);
+
+  // The inline values are replayed and flushed to SSTables on open.
+  db = open_db_with(options);
+  assert(db != NULL);
+  check_inline_reads(db, 1);
+  WiscKeyDB_free(db);
+
+  // The threshold can change between opens, and the collector keeps the
+  // inline values.
+  options->inline_value_size = 0;
+  db = open_db_with(options);
+  assert(db != NULL);
+  check_inline_reads(db, 1);
+  assert(WiscKeyDB_gc(db) == 0);
+  check_inline_reads(db, 1);
+  WiscKeyDB_free(db);
+
+  remove_dir(TEST_DIR);
+}
+
+void
+TestWiscKeyDB_inline_values()
+{
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  check_inline_values(&options);
+
+  options.memtable_shards = TEST_THREADS;
+  check_inline_values(&options);
+
+  // The inline values are still written to the ValueLog when it is the log.
+  options.value_log_wal = 1;
+  check_inline_values(&options);
+
+  options.value_log_segment = 64 * 1024;
+  check_inline_values(&options);
+}
+
+void
+TestWiscKeyDB_compression()
+{
+  remove_dir(TEST_DIR);
+
+  struct WiscKeyDBOptions options;
+  WiscKeyDBOptions_init(&options);
+  options.compression = WISCKEY_COMPRESSION_LZ;
+  struct WiscKeyDB* db = open_db_with(&options);
+  write_gc_rounds(db);
+  check_gc_values(db);
+  check_gc_slices(db);
+  WiscKeyDB_free(db);
+
+  // The values are mostly a run of one byte, so they shrink to a fraction of
+  // their size.
+  struct stat st;
+  assert(stat(TEST_DIR "/value.log", &st) == 0);
+  assert((size_t)st.st_size <
+         TEST_GC_ROUNDS * TEST_KEYS * TEST_GC_VALUE_SIZE / 4);
+
+  // The collector moves the compressed values, and they are read by their
+  // codec once compression is turned off.
+  db = open_db_with(&options);
+  assert(WiscKeyDB_gc(db) == 0);
+  check_gc_values(db);
+  WiscKeyDB_free(db);
+  options.compression = WISCKEY_COMPRESSION_NONE;
+  db = open_db_with(&options);
+  check_gc_values(db);
+  WiscKeyDB_free(db);
+
+  // A codec that WiscKey was built without falls back to the built-in one.
+  options.compression = WISCKEY_COMPRESSION_ZSTD;
+  db = open_db_with(&options);
+  assert(db != NULL);
+  write_gc_rounds(db);
+  check_gc_values(db);
+  WiscKeyDB_free(db);
+
+  options.compression = WISCKEY_COMPRESSION_LZ;
+  options.value_log_segment = 64 * 1024;
+  check_gc_segments(&options);
+
+  // Short values are compressed too without a minimum size.
+  options.value_log_segment = 0;
+  options.compress_min_size = 0;
+  options.compress_min_ratio = 1;
+  options.scan_prefetch = 7;
+  check_scans(&options);
+
+  remove_dir(TEST_DIR);
+}
+
+int
+main()
+{
+  // New
+  TestWiscKeyDB_new();
+
+  // Set, Get, Delete
+  TestWiscKeyDB_set_get_delete();
+  TestWiscKeyDB_get_into();
+  TestWiscKeyDB_get_slice();
+
+  // Flush
+  TestWiscKeyDB_flush();
+  TestWiscKeyDB_flush_hash_index();
+
+  // Shards
+  TestWiscKeyDB_shards_hash();
+  TestWiscKeyDB_shards_split();
+  TestWiscKeyDB_shards_concurrent();
+
+  // WAL Segments
+  TestWiscKeyDB_wal_segments();
+
+  // Sync
+  TestWiscKeyDB_sync_writes();
+
+  // Recover
+  TestWiscKeyDB_recover();
+  TestWiscKeyDB_recover_parallel();
+  TestWiscKeyDB_value_log_wal();
+  TestWiscKeyDB_value_log_wal_checkpoint();
+
+  // Garbage Collection
+  TestWiscKeyDB_gc();
+  TestWiscKeyDB_gc_thread();
+  TestWiscKeyDB_gc_segments();
+  TestWiscKeyDB_gc_segments_replay();
+  TestWiscKeyDB_gc_concurrent_reads();
+
+  // Value Cache
+  TestWiscKeyDB_value_cache();
+
+  // Scan
+  TestWiscKeyDB_scan();
+  TestWiscKeyDB_scan_gc();
+
+  // Inline Values
+  TestWiscKeyDB_inline_values();
+
+  // Compression
+  TestWiscKeyDB_compression();
+
+  return 0;
+}